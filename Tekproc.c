@@ -161,6 +161,33 @@ static XSegment *Tline;
 static const int *curstate = Talptable;
 static const int *Tparsestate = Talptable;
 
+/*
+ * The display list holds what has been drawn on the page, in Tek
+ * coordinates, so that an expose (or resize) can scale and redraw it without
+ * parsing the recorded data again.  A segment's type is its line type; a
+ * character's type is TEK_TEXT_ITEM plus its font size, with the character
+ * split between the x2/y2 fields.  If the list cannot be kept, e.g., after
+ * the font size is changed from the menu, the recorded data is parsed again,
+ * rebuilding the list.
+ */
+#define TEK_LIST_INIT	1024
+#define TEK_TEXT_ITEM	0x10
+#define TekItemIsText(item) ((item)->type >= TEK_TEXT_ITEM)
+#define TekItemChar(item) \
+	(IChar) (((unsigned) (unsigned short) (item)->y2 << 16) \
+		 | (unsigned) (unsigned short) (item)->x2)
+
+typedef struct {
+    short x1, y1;
+    short x2, y2;
+    Char type;
+} TekItem;
+
+static TekItem *TekList;
+static size_t TekListUsed;
+static size_t TekListSize;
+static Bool TekListValid = True;
+
 static char defaultTranslations[] = "\
                 ~Meta<KeyPress>: insert-seven-bit() \n\
                  Meta<KeyPress>: insert-eight-bit() \n\
@@ -272,6 +299,11 @@ static void TekEnq(TekWidget /* tw */ ,
 		   int /* x */ ,
 		   int /* y */ );
 static void TekFlush(TekWidget /* tw */ );
+static void TekListAdd(int /* x1 */ ,
+		       int /* y1 */ ,
+		       int /* x2 */ ,
+		       int /* y2 */ ,
+		       int /* type */ );
 static void TekInitialize(Widget /* request */ ,
 			  Widget /* wnew */ ,
 			  ArgList /* args */ ,
@@ -701,6 +733,9 @@ Tekparse(TekWidget tw)
 	    ch = c;
 	    x = (int) ScaledX(tw, tekscr->cur_X);
 	    y = (int) ScaledY(tw, tekscr->cur_Y);
+	    TekListAdd(tekscr->cur_X, tekscr->cur_Y,
+		       (int) (ch & 0xffff), (int) (ch >> 16),
+		       TEK_TEXT_ITEM + tekscr->cur.fontsize);
 
 #if OPT_WIDE_CHARS
 	    if (screen->wide_chars
@@ -853,6 +888,167 @@ Tinput(TekWidget tw)
     return (IChar) (*tek->ptr++ = (char) nextPtyData(screen, VTbuffer));
 }
 
+static void
+TekListAdd(int x1, int y1, int x2, int y2, int type)
+{
+    TekItem *item;
+
+    if (!TekListValid)
+	return;
+    if (TekListUsed >= TekListSize) {
+	size_t want = (TekListSize != 0) ? (TekListSize * 2) : TEK_LIST_INIT;
+	TekItem *grown = TypeRealloc(TekItem, want, TekList);
+
+	if (grown == NULL) {
+	    TRACE(("TekListAdd: cannot grow list past %lu items\n",
+		   (unsigned long) TekListSize));
+	    free(TekList);
+	    TekList = NULL;
+	    TekListUsed = TekListSize = 0;
+	    TekListValid = False;
+	    return;
+	}
+	TekList = grown;
+	TekListSize = want;
+    }
+    item = &TekList[TekListUsed++];
+    item->x1 = (short) x1;
+    item->y1 = (short) y1;
+    item->x2 = (short) x2;
+    item->y2 = (short) y2;
+    item->type = (Char) type;
+}
+
+static void
+TekListReset(Bool valid)
+{
+    TekListUsed = 0;
+    TekListValid = valid;
+}
+
+static void
+TekSetGCFont(TekWidget tw, int size)
+{
+    TekScreen *tekscr = TekScreenOf(tw);
+    Font fid = tw->tek.Tfont[size]->fid;
+
+    if (fid == DefaultGCID(tw)) {
+	/* we didn't succeed in opening a real font
+	   for this size.  Instead, use server default. */
+	XCopyGC(XtDisplay(tw),
+		DefaultGC(XtDisplay(tw), DefaultScreen(XtDisplay(tw))),
+		GCFont, tekscr->TnormalGC);
+    } else {
+	XSetFont(XtDisplay(tw), tekscr->TnormalGC, fid);
+    }
+}
+
+#define TekListFlush() \
+    do { \
+	if (nsegs != 0) { \
+	    XDrawSegments(display, window, \
+			  ((linetype == SOLIDLINE) \
+			   ? tekscr->TnormalGC \
+			   : tekscr->linepat[linetype - 1]), \
+			  segs, nsegs); \
+	    nsegs = 0; \
+	} \
+    } while (0)
+
+/*
+ * Redraw the display list at the current scale, skipping segments which are
+ * outside the exposed region.  Segments are drawn in batches, except that
+ * (as in TekDraw) unconnected segments with a line pattern are drawn apart.
+ */
+static void
+TekReplay(TekWidget tw, Region region)
+{
+    TekScreen *tekscr = TekScreenOf(tw);
+#if OPT_WIDE_CHARS
+    TScreen *screen = TScreenOf(tw->vt);
+#endif
+    Display *display = XtDisplay(tw);
+    Window window = TWindow(tekscr);
+    XSegment segs[MAX_VTX];
+    XRectangle clip;
+    int nsegs = 0;
+    int linetype = SOLIDLINE;
+    int fontsize = tekscr->cur.fontsize;
+    size_t n;
+
+    if (region != NULL) {
+	XClipBox(region, &clip);
+    } else {
+	clip.x = 0;
+	clip.y = 0;
+	clip.width = (unsigned short) tw->core.width;
+	clip.height = (unsigned short) tw->core.height;
+    }
+    TRACE(("TekReplay %lu items, clip %dx%d+%d+%d\n",
+	   (unsigned long) TekListUsed,
+	   clip.height, clip.width, clip.y, clip.x));
+
+    for (n = 0; n < TekListUsed; ++n) {
+	TekItem *item = &TekList[n];
+	int x1 = (int) ScaledX(tw, item->x1);
+	int y1 = (int) ScaledY(tw, item->y1);
+
+	if (TekItemIsText(item)) {
+	    int size = item->type - TEK_TEXT_ITEM;
+	    IChar ch = TekItemChar(item);
+
+	    if (size != fontsize) {
+		TekSetGCFont(tw, size);
+		fontsize = size;
+	    }
+#if OPT_WIDE_CHARS
+	    if (screen->wide_chars && (ch > 255)) {
+		XChar2b sbuf;
+		sbuf.byte2 = LO_BYTE(ch);
+		sbuf.byte1 = HI_BYTE(ch);
+		XDrawImageString16(display, window, tekscr->TnormalGC,
+				   x1, y1, &sbuf, 1);
+	    } else
+#endif
+	    {
+		char ch2 = (char) ch;
+		XDrawString(display, window, tekscr->TnormalGC,
+			    x1, y1, &ch2, 1);
+	    }
+	} else {
+	    int x2 = (int) ScaledX(tw, item->x2);
+	    int y2 = (int) ScaledY(tw, item->y2);
+
+	    if (Max(x1, x2) < clip.x
+		|| Min(x1, x2) > clip.x + (int) clip.width
+		|| Max(y1, y2) < clip.y
+		|| Min(y1, y2) > clip.y + (int) clip.height)
+		continue;
+
+	    if (item->type != linetype
+		|| nsegs >= MAX_VTX
+		|| (linetype != SOLIDLINE
+		    && nsegs != 0
+		    && (segs[nsegs - 1].x2 != x1
+			|| segs[nsegs - 1].y2 != y1))) {
+		TekListFlush();
+		linetype = item->type;
+	    }
+	    segs[nsegs].x1 = (short) x1;
+	    segs[nsegs].y1 = (short) y1;
+	    segs[nsegs].x2 = (short) x2;
+	    segs[nsegs].y2 = (short) y2;
+	    nsegs++;
+	}
+    }
+    TekListFlush();
+
+    if (fontsize != tekscr->cur.fontsize)
+	TekSetGCFont(tw, tekscr->cur.fontsize);
+}
+
+#undef TekListFlush
+
 static void
 TekClear(TekWidget tw)
 {
@@ -940,7 +1136,7 @@ TekResize(Widget w)
 void
 TekExpose(Widget w,
 	  XEvent *event GCC_UNUSED,
-	  Region region GCC_UNUSED)
+	  Region region)
 {
     TekWidget tw = getTekWidget(w);
     if (tw != NULL) {
@@ -948,12 +1144,19 @@ TekExpose(Widget w,
 
 	TRACE(("TekExpose " TRACE_L "\n"));
 
-#ifdef lint
-	region = region;
-#endif
 	if (!Ttoggled)
 	    TCursorToggle(tw, CLEAR);
 	Ttoggled = True;
+
+	/* redraw from the display list, unless it must be rebuilt */
+	if (TekListValid && !tekRefreshList) {
+	    first_map_occurred();
+	    TekReplay(tw, region);
+	    TRACE((TRACE_R " TekExpose\n"));
+	    return;
+	}
+	TekListReset(True);
+
 	Tpushback = Tpushb;
 	tekscr->cur_X = 0;
 	tekscr->cur_Y = TEKHOME;
@@ -1013,6 +1216,7 @@ TekPage(TekWidget tw)
 
     TRACE(("TekPage\n"));
     TekClear(tw);
+    TekListReset(True);
     tekscr->cur_X = 0;
     tekscr->cur_Y = TEKHOME;
     tekscr->margin = MARGIN1;
@@ -1184,6 +1388,7 @@ AddToDraw(TekWidget tw, int x1, int y1, int x2, int y2)
     lp->x2 = (short) ScaledX(tw, x2);
     lp->y2 = (short) ScaledY(tw, y2);
     nplot++;
+    TekListAdd(x1, y1, x2, y2, TekScreenOf(tw)->cur.linetype);
     TRACE(("...AddToDraw %d points\n", nplot));
 }
 
@@ -1737,7 +1942,6 @@ TekSetFontSize(TekWidget tw, Bool fromMenu, int newitem)
 	TekScreen *tekscr = TekScreenOf(tw);
 	int oldsize = tekscr->cur.fontsize;
 	int newsize = MI2FS(newitem);
-	Font fid;
 
 	TRACE(("TekSetFontSize(%d) size %d ->%d\n", newitem, oldsize, newsize));
 	if (newsize < 0 || newsize >= TEKNUMFONTS) {
@@ -1752,16 +1956,7 @@ TekSetFontSize(TekWidget tw, Bool fromMenu, int newitem)
 	    if (fromMenu)
 		tekscr->page.fontsize = newsize;
 
-	    fid = tw->tek.Tfont[newsize]->fid;
-	    if (fid == DefaultGCID(tw)) {
-		/* we didn't succeed in opening a real font
-		   for this size.  Instead, use server default. */
-		XCopyGC(XtDisplay(tw),
-			DefaultGC(XtDisplay(tw), DefaultScreen(XtDisplay(tw))),
-			GCFont, tekscr->TnormalGC);
-	    } else {
-		XSetFont(XtDisplay(tw), tekscr->TnormalGC, fid);
-	    }
+	    TekSetGCFont(tw, newsize);
 
 	    set_tekfont_menu_item(newsize, True);
 	    if (!Ttoggled)
@@ -1770,9 +1965,10 @@ TekSetFontSize(TekWidget tw, Bool fromMenu, int newitem)
 	    if (fromMenu) {
 		/* we'll get an exposure event after changing fontsize, so we
 		 * have to clear the screen to avoid painting over the previous
-		 * text.
+		 * text.  The text must be laid out again for the new size.
 		 */
 		TekClear(tw);
+		TekListReset(False);
 	    }
 	}
     }
@@ -77,47 +77,11 @@ button.c	Handles button events in the terminal emulator.
 #include <charclass.h>
 #include <xstrings.h>
 #include <xterm_io.h>
+#include <search.h>
 
-#if OPT_SELECT_REGEX
-#if defined(HAVE_PCRE2POSIX_H)
-#include <pcre2posix.h>
-
-/* pcre2 used to provide its "POSIX" entrypoints using the same names as the
- * standard ones in the C runtime, but that never worked because the linker
- * would use the C runtime.  Debian patched the library to fix this symbol
- * conflict, but overlooked the header file, and Debian's patch was made
- * obsolete when pcre2 was changed early in 2019 to provide different names.
- *
- * Here is a workaround to make the older version of Debian's package work.
- */
-#if !defined(PCRE2regcomp) && defined(HAVE_PCRE2REGCOMP)
-
-#undef regcomp
-#undef regexec
-#undef regfree
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-    PCRE2POSIX_EXP_DECL int PCRE2regcomp(regex_t *, const char *, int);
-    PCRE2POSIX_EXP_DECL int PCRE2regexec(const regex_t *, const char *, size_t,
-					 regmatch_t *, int);
-    PCRE2POSIX_EXP_DECL void PCRE2regfree(regex_t *);
-#ifdef __cplusplus
-}				/* extern "C" */
-#endif
-#define regcomp(r,s,n)          PCRE2regcomp(r,s,n)
-#define regexec(r,s,n,m,x)      PCRE2regexec(r,s,n,m,x)
-#define regfree(r)              PCRE2regfree(r)
+#ifdef OPT_LUA_SCRIPTING
+#include <lua_api.h>
 #endif
-/* end workaround... */
-#elif defined(HAVE_PCREPOSIX_H)
-#include <pcreposix.h>
-#else /* POSIX regex.h */
-#include <sys/types.h>
-#include <regex.h>
-#endif
-#endif /* OPT_SELECT_REGEX */
 
 #ifdef HAVE_X11_TRANSLATEI_H
 #include <X11/ConvertI.h>
@@ -207,6 +171,9 @@ static void UnHiliteText(XtermWidget xw);
 static void _OwnSelection(XtermWidget xw, String *selections, Cardinal count);
 static void do_select_end(XtermWidget xw, XEvent *event, String *params,
 			  Cardinal *num_params, Bool use_cursor_loc);
+#if OPT_SELECT_REGEX && defined(NO_LEAKS)
+static void freeRegexCache(void);
+#endif
 
 #define MOUSE_LIMIT (255 - 32)
 
@@ -660,6 +627,45 @@ InterpretEvent(XtermWidget xw, XEvent *event)
 #define OverrideEvent(event)  InterpretEvent(xw, event)
 #define OverrideButton(event) InterpretButton(xw, event)
 
+#ifdef OPT_LUA_SCRIPTING
+/*
+ * Pass a mouse event to the Lua hooks, as the button number (0 for motion)
+ * and the cell's column and row.  Returns true if a hook consumed it.
+ */
+static Bool
+lua_mouse_hook(XtermWidget xw, XEvent *event)
+{
+    TScreen *screen = TScreenOf(xw);
+    LuaHookType type;
+    int button = 0;
+    CELL cell;
+
+    switch (event->type) {
+    case ButtonPress:
+	type = LUA_HOOK_MOUSE_PRESS;
+	button = (int) event->xbutton.button;
+	break;
+    case ButtonRelease:
+	type = LUA_HOOK_MOUSE_RELEASE;
+	button = (int) event->xbutton.button;
+	break;
+    case MotionNotify:
+	type = LUA_HOOK_MOUSE_MOTION;
+	break;
+    default:
+	return False;
+    }
+    if (!lua_xterm_has_hook(type))
+	return False;
+
+    PointToCELL(screen, event->xbutton.y, event->xbutton.x, &cell);
+    return (Bool) lua_xterm_call_hook(type,
+				      button,
+				      cell.col,
+				      ROW2INX(screen, cell.row));
+}
+#endif
+
 /*
  * Returns true if we handled the event here, and nothing more is needed.
  */
@@ -669,6 +675,15 @@ SendMousePosition(XtermWidget xw, XEvent *event)
     XButtonEvent *my_event = (XButtonEvent *) event;
     Bool result = False;
 
+#ifdef OPT_LUA_SCRIPTING
+    if (lua_hook_mask & (LUA_HOOK_BIT(LUA_HOOK_MOUSE_PRESS)
+			 | LUA_HOOK_BIT(LUA_HOOK_MOUSE_RELEASE)
+			 | LUA_HOOK_BIT(LUA_HOOK_MOUSE_MOTION))) {
+	if (lua_mouse_hook(xw, event))
+	    return True;
+    }
+#endif
+
     switch (okSendMousePos(xw)) {
     case MOUSE_OFF:
 	/* If send_mouse_pos mode isn't on, we shouldn't be here */
@@ -2287,41 +2302,21 @@ GettingSelection(Display *dpy, Atom type, Char *line, unsigned long len)
 #define tty_vwrite(pty,lag,l)		v_write(pty,lag,(size_t) l)
 
 #if OPT_PASTE64
-/* Return base64 code character given 6-bit number */
-static const char base64_code[] = "\
-ABCDEFGHIJKLMNOPQRSTUVWXYZ\
-abcdefghijklmnopqrstuvwxyz\
-0123456789+/";
+/* input bytes per chunk when encoding a paste as base64 */
+#define BASE64_CHUNK 3072
+
 static void
 base64_flush(TScreen *screen)
 {
-    Char x;
+    char buf[4];
+    size_t x;
 
-    TRACE(("base64_flush count %d, pad %d (%d)\n",
-	   screen->base64_count,
-	   screen->base64_pad,
-	   screen->base64_pad & 3));
+    TRACE(("base64_flush count %d\n", screen->base64_count));
 
-    switch (screen->base64_count) {
-    case 0:
-	break;
-    case 2:
-	x = CharOf(base64_code[screen->base64_accu << 4]);
-	tty_vwrite(screen->respond, &x, 1);
-	break;
-    case 4:
-	x = CharOf(base64_code[screen->base64_accu << 2]);
-	tty_vwrite(screen->respond, &x, 1);
-	break;
-    }
-    if (screen->base64_pad & 3) {
-	tty_vwrite(screen->respond,
-		   (const Char *) "===",
-		   (unsigned) (3 - (screen->base64_pad & 3)));
+    x = x_finish_base64(buf, &screen->base64_accu, &screen->base64_count);
+    if (x != 0) {
+	tty_vwrite(screen->respond, (Char *) buf, x);
     }
-    screen->base64_count = 0;
-    screen->base64_accu = 0;
-    screen->base64_pad = 0;
 }
 #endif /* OPT_PASTE64 */
 
@@ -2402,13 +2397,11 @@ _qWriteSelectionData(XtermWidget xw, Char *lag, size_t length)
 #if OPT_PASTE64
     if (screen->base64_paste) {
 	/* Send data as base64 */
-	Char *p = lag;
-	Char buf[64];
-	unsigned x = 0;
+	char buf[(BASE64_CHUNK / 3) * 4 + 2];
 
 	TRACE(("convert to base64 %lu:%s\n",
 	       (unsigned long) length,
-	       visibleChars(p, length)));
+	       visibleChars(lag, length)));
 
 	/*
 	 * Handle the case where the selection is from _this_ xterm, which
@@ -2418,42 +2411,18 @@ _qWriteSelectionData(XtermWidget xw, Char *lag, size_t length)
 	if (screen->base64_paste && screen->unparse_len) {
 	    unparse_end(xw);
 	}
-	while (length--) {
-	    switch (screen->base64_count) {
-	    case 0:
-		buf[x++] = CharOf(base64_code[*p >> 2]);
-		screen->base64_accu = (unsigned) (*p & 0x3);
-		screen->base64_count = 2;
-		++p;
-		break;
-	    case 2:
-		buf[x++] = CharOf(base64_code[(screen->base64_accu << 4) +
-					      (*p >> 4)]);
-		screen->base64_accu = (unsigned) (*p & 0xF);
-		screen->base64_count = 4;
-		++p;
-		break;
-	    case 4:
-		buf[x++] = CharOf(base64_code[(screen->base64_accu << 2) +
-					      (*p >> 6)]);
-		buf[x++] = CharOf(base64_code[*p & 0x3F]);
-		screen->base64_accu = 0;
-		screen->base64_count = 0;
-		++p;
-		break;
-	    }
-	    if (x >= 63) {
-		/* Write 63 or 64 characters */
-		screen->base64_pad += x;
-		TRACE(("writing base64 interim %s\n", visibleChars(buf, x)));
-		tty_vwrite(screen->respond, buf, x);
-		x = 0;
+	while (length != 0) {
+	    size_t chunk = Min(length, BASE64_CHUNK);
+	    size_t x = x_encode_base64(buf, (char *) lag, chunk,
+				       &screen->base64_accu,
+				       &screen->base64_count);
+
+	    if (x != 0) {
+		TRACE(("writing base64 %lu chars\n", (unsigned long) x));
+		tty_vwrite(screen->respond, (Char *) buf, x);
 	    }
-	}
-	if (x != 0) {
-	    screen->base64_pad += x;
-	    TRACE(("writing base64 finish %s\n", visibleChars(buf, x)));
-	    tty_vwrite(screen->respond, buf, x);
+	    lag += chunk;
+	    length -= chunk;
 	}
     } else
 #endif /* OPT_PASTE64 */
@@ -2677,6 +2646,221 @@ finishInternalSelect(XtermWidget xw)
 #define finishInternalSelect(xw)	/* nothing */
 #endif /* OPT_SELECTION_OPS */
 
+/*
+ * Large pastes are queued rather than handed to v_write() all at once, which
+ * would copy them into its buffer and leave the whole paste to drain through
+ * the pty.  The event loop calls xtermPasteContinue() each time the pty has
+ * taken all of the data written so far, and that converts and writes the next
+ * chunk: control characters are filtered, newlines mapped and the bracketed
+ * paste markers added as the chunks go by.
+ *
+ * Anything else written to the pty between chunks (typed keys, replies to
+ * queries) is not part of the paste, so xtermPasteInterrupt() closes the
+ * brackets before it and the next chunk opens them again.
+ */
+#define PASTE_CHUNK 4096
+
+typedef struct PasteQueue {
+    char **text_list;
+    int text_list_count;
+    int item;			/* current string in text_list */
+    size_t item_length;
+    size_t offset;		/* how much of it has been written */
+    size_t total;
+    size_t sent;
+    Bool started;
+    struct PasteQueue *next;
+} PasteQueue;
+
+static PasteQueue *paste_queue;
+static Bool paste_writing;	/* true while the paste itself writes */
+
+static Bool
+QueuePaste(XtermWidget xw, char **text_list, int text_list_count)
+{
+    TScreen *screen = TScreenOf(xw);
+    PasteQueue *pq;
+    PasteQueue **tail;
+    size_t total = 0;
+    int i;
+
+    if (screen->selectToBuffer)
+	return False;
+#if OPT_PASTE64
+    if (screen->base64_paste)
+	return False;
+#endif
+
+    for (i = 0; i < text_list_count; ++i)
+	total += strlen(text_list[i]);
+
+    /* small pastes go straight through, unless they would overtake one */
+    if (total <= PASTE_CHUNK && paste_queue == NULL)
+	return False;
+
+    if ((pq = TypeCalloc(PasteQueue)) == NULL)
+	return False;
+
+    pq->text_list = text_list;
+    pq->text_list_count = text_list_count;
+    pq->item_length = strlen(text_list[0]);
+    pq->total = total;
+
+    for (tail = &paste_queue; *tail != NULL; tail = &(*tail)->next) {
+	;
+    }
+    *tail = pq;
+
+    TRACE(("QueuePaste %lu bytes\n", (unsigned long) total));
+    xtermPasteContinue(xw);
+    return True;
+}
+
+static void
+FinishPaste(XtermWidget xw, Bool cancelled)
+{
+    PasteQueue *pq = paste_queue;
+#if OPT_PASTE64 || OPT_READLINE
+    TScreen *screen = TScreenOf(xw);
+
+    /* do not leave the application expecting more of the paste */
+    if (pq->started && SCREEN_FLAG(screen, paste_brackets)) {
+	paste_writing = True;
+	_WriteKey(screen, (const Char *) "201");
+	paste_writing = False;
+    }
+#else
+    (void) xw;
+#endif
+    TRACE(("FinishPaste %s %lu of %lu bytes\n",
+	   cancelled ? "cancelled" : "finished",
+	   (unsigned long) pq->sent,
+	   (unsigned long) pq->total));
+    (void) cancelled;
+
+    paste_queue = pq->next;
+    XFreeStringList(pq->text_list);
+    free(pq);
+}
+
+Bool
+xtermPastePending(void)
+{
+    return (paste_queue != NULL);
+}
+
+/*
+ * Returns the percentage written of the paste in progress, or -1 if none.
+ */
+int
+xtermPasteProgress(void)
+{
+    int result = -1;
+
+    if (paste_queue != NULL) {
+	result = (int) ((100.0 * (double) paste_queue->sent)
+			/ (double) Max(paste_queue->total, 1));
+    }
+    return result;
+}
+
+/*
+ * Write the next chunk of the paste in progress.
+ */
+void
+xtermPasteContinue(XtermWidget xw)
+{
+    PasteQueue *pq = paste_queue;
+    size_t budget = PASTE_CHUNK;
+    char chunk[PASTE_CHUNK + 1];
+
+    if (pq == NULL)
+	return;
+
+    paste_writing = True;
+    if (!pq->started) {
+#if OPT_PASTE64 || OPT_READLINE
+	TScreen *screen = TScreenOf(xw);
+	if (SCREEN_FLAG(screen, paste_brackets)) {
+	    _WriteKey(screen, (const Char *) "200");
+	}
+#endif
+	pq->started = True;
+    }
+
+    while (budget != 0 && pq->item < pq->text_list_count) {
+	size_t want = Min(budget, pq->item_length - pq->offset);
+
+	if (want != 0) {
+	    size_t len;
+
+	    memcpy(chunk, pq->text_list[pq->item] + pq->offset, want);
+	    chunk[want] = '\0';
+	    len = removeControls(xw, chunk);
+	    _WriteSelectionData(xw, (Char *) chunk, len);
+
+	    pq->offset += want;
+	    pq->sent += want;
+	    budget -= want;
+	}
+	if (pq->offset >= pq->item_length) {
+	    if (++(pq->item) < pq->text_list_count) {
+		pq->item_length = strlen(pq->text_list[pq->item]);
+		pq->offset = 0;
+	    }
+	}
+    }
+    paste_writing = False;
+
+    if (pq->item >= pq->text_list_count) {
+	FinishPaste(xw, False);
+    }
+}
+
+/*
+ * Something other than the paste is about to be written to the pty.  Close
+ * the brackets around the part of the paste written so far.
+ */
+void
+xtermPasteInterrupt(XtermWidget xw)
+{
+    PasteQueue *pq = paste_queue;
+
+    if (pq != NULL && pq->started && !paste_writing) {
+#if OPT_PASTE64 || OPT_READLINE
+	TScreen *screen = TScreenOf(xw);
+	if (SCREEN_FLAG(screen, paste_brackets)) {
+	    paste_writing = True;
+	    _WriteKey(screen, (const Char *) "201");
+	    paste_writing = False;
+	}
+#else
+	(void) xw;
+#endif
+	pq->started = False;
+    }
+}
+
+/*
+ * Discard whatever is left of the pastes in progress.
+ */
+/* ARGSUSED */
+void
+HandleCancelPaste(Widget w,
+		  XEvent *event GCC_UNUSED,
+		  String *params GCC_UNUSED,
+		  Cardinal *num_params GCC_UNUSED)
+{
+    XtermWidget xw;
+
+    if ((xw = getXtermWidget(w)) != NULL) {
+	TRACE(("HandleCancelPaste\n"));
+	while (paste_queue != NULL) {
+	    FinishPaste(xw, True);
+	}
+    }
+}
+
 /* SelectionReceived: stuff received selection text into pty */
 
 /* ARGSUSED */
@@ -2771,7 +2955,11 @@ SelectionReceived(Widget w,
 	}
     }
 
-    if (text_list != NULL && text_list_count != 0) {
+    if (text_list != NULL
+	&& text_list_count != 0
+	&& QueuePaste(xw, text_list, text_list_count)) {
+	TRACE(("...paste queued\n"));
+    } else if (text_list != NULL && text_list_count != 0) {
 	int i;
 
 #if OPT_PASTE64
@@ -3580,6 +3768,8 @@ static int charClass[256] =
      48,  48,  48,  48,  48,  48,  48,  48};
 /* *INDENT-ON* */
 
+static unsigned long charClassChanges;
+
 int
 SetCharacterClassRange(int low,	/* in range of [0..255] */
 		       int high,
@@ -3592,8 +3782,15 @@ SetCharacterClassRange(int low,	/* in range of [0..255] */
     for (; low <= high; low++)
 	charClass[low] = value;
 
+    charClassChanges++;
     return (0);
 }
+
+unsigned long
+CharacterClassChanges(void)
+{
+    return charClassChanges;
+}
 #endif
 
 static int
@@ -3612,16 +3809,189 @@ class_of(LineData *ld, const CELL *cell)
     return result;
 }
 
+/*
+ * Word selection compares the class of each cell with its neighbors, which
+ * is slow for very long wrapped lines.  Cache the classes of a few lines
+ * (the ends of a selection) as runs, so a selection steps over a whole run
+ * at once.  The cache is discarded whenever the screen's cells or the class
+ * table may change.
+ */
+typedef struct {
+    int first;			/* first column of the run */
+    int cclass;
+} ClassRun;
+
+typedef struct {
+    LineData *ld;
+    unsigned long writes;	/* screen->cell_writes when computed */
+    unsigned long classes;	/* CharacterClassChanges() when computed */
+    int width;			/* number of columns covered by runs[] */
+    int count;
+    int size;
+    ClassRun *runs;
+} ClassRuns;
+
+#define CLASS_RUN_LINES 4
+
+static ClassRuns classRuns[CLASS_RUN_LINES];
+static int classRunsNext;
+
+static ClassRuns *
+class_runs(TScreen *screen, LineData *ld)
+{
+    ClassRuns *p;
+    CELL cell;
+    int n;
+
+    if (ld == NULL)
+	return NULL;
+
+    for (n = 0; n < CLASS_RUN_LINES; ++n) {
+	p = &classRuns[n];
+	if (p->ld == ld
+	    && p->writes == screen->cell_writes
+	    && p->classes == CharacterClassChanges())
+	    return p;
+    }
+
+    p = &classRuns[classRunsNext];
+    classRunsNext = (classRunsNext + 1) % CLASS_RUN_LINES;
+
+    p->ld = NULL;
+    p->writes = screen->cell_writes;
+    p->classes = CharacterClassChanges();
+    p->width = (int) ld->lineSize;
+#if OPT_DEC_CHRSET
+    if (CSET_DOUBLE(GetLineDblCS(ld))) {
+	p->width *= 2;
+    }
+#endif
+    p->count = 0;
+
+    cell.row = 0;
+    for (cell.col = 0; cell.col < p->width; ++cell.col) {
+	int cclass;
+
 #if OPT_WIDE_CHARS
-#define CClassSelects(name, cclass) \
-	 (CClassOf(name) == cclass \
-	 || XTERM_CELL(screen->name.row, screen->name.col) == HIDDEN_CHAR)
-#else
-#define CClassSelects(name, cclass) \
-	 (class_of(ld.name, &((screen->name))) == cclass)
+	/* the right half of a wide character goes with its left half */
+	if (cell.col > 0
+	    && cell.col < (int) ld->lineSize
+	    && ld->charData[cell.col] == HIDDEN_CHAR)
+	    continue;
+#endif
+	cclass = class_of(ld, &cell);
+	if (p->count == 0 || p->runs[p->count - 1].cclass != cclass) {
+	    if (p->count >= p->size) {
+		p->size = (p->size + 16) * 2;
+		p->runs = TypeRealloc(ClassRun, (size_t) p->size, p->runs);
+		if (p->runs == NULL) {
+		    p->size = 0;
+		    return NULL;
+		}
+	    }
+	    p->runs[p->count].first = cell.col;
+	    p->runs[p->count].cclass = cclass;
+	    p->count++;
+	}
+    }
+    p->ld = ld;
+    TRACE(("class_runs: %d columns in %d runs\n", p->width, p->count));
+    return p;
+}
+
+/*
+ * Return the index of the run containing the given column, or -1 if the
+ * column is not covered by the runs.
+ */
+static int
+class_run_index(const ClassRuns *p, int col)
+{
+    int lo = 0;
+    int hi;
+
+    if (p == NULL || col < 0 || col >= p->width || p->count == 0)
+	return -1;
+
+    hi = p->count - 1;
+    while (lo < hi) {
+	int mid = (lo + hi + 1) / 2;
+	if (p->runs[mid].first <= col)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    return lo;
+}
+
+/*
+ * Like the runs, give the right half of a wide character the class of its
+ * left half, so a selection does not take it for a cell of its own class.
+ */
+static int
+class_at(TScreen *screen, LineData *ld, const CELL *cell)
+{
+    ClassRuns *p = class_runs(screen, ld);
+    int n = class_run_index(p, cell->col);
+    CELL temp = *cell;
+
+    if (n >= 0)
+	return p->runs[n].cclass;
+#if OPT_WIDE_CHARS
+    if (temp.col > 0
+	&& temp.col < (int) ld->lineSize
+	&& ld->charData[temp.col] == HIDDEN_CHAR)
+	temp.col--;
+#endif
+    return class_of(ld, &temp);
+}
+
+/* first column of the run containing the cell */
+static int
+class_run_first(TScreen *screen, LineData *ld, const CELL *cell)
+{
+    ClassRuns *p = class_runs(screen, ld);
+    int n = class_run_index(p, cell->col);
+
+    return (n >= 0) ? p->runs[n].first : cell->col;
+}
+
+/* last column of the run containing the cell */
+static int
+class_run_last(TScreen *screen, LineData *ld, const CELL *cell)
+{
+    ClassRuns *p = class_runs(screen, ld);
+    int n = class_run_index(p, cell->col);
+
+    if (n < 0)
+	return cell->col;
+    return ((n + 1 < p->count)
+	    ? p->runs[n + 1].first
+	    : p->width) - 1;
+}
+
+#ifdef NO_LEAKS
+void
+noleaks_button(void)
+{
+    int n;
+
+    for (n = 0; n < CLASS_RUN_LINES; ++n) {
+	FreeAndNull(classRuns[n].runs);
+	classRuns[n].size = 0;
+	classRuns[n].ld = NULL;
+    }
+#if OPT_SELECT_REGEX
+    freeRegexCache();
+#endif
+}
 #endif
 
-#define CClassOf(name) class_of(ld.name, &((screen->name)))
+#define CClassSelects(name, cclass) \
+	 (CClassOf(name) == cclass)
+
+#define CClassOf(name) class_at(screen, ld.name, &((screen->name)))
+#define CClassFirst(name) class_run_first(screen, ld.name, &((screen->name)))
+#define CClassLast(name) class_run_last(screen, ld.name, &((screen->name)))
 
 #if OPT_REPORT_CCLASS
 static int
@@ -3844,10 +4214,11 @@ lengthOfLines(TScreen *screen, int firstRow, int lastRow)
 /*
  * Make a copy of the wrapped-line which corresponds to the given row as a
  * string of bytes.  Construct an index for the columns from the beginning of
- * the line.
+ * the line, and return the number of columns in *columns.
  */
 static char *
-make_indexed_text(TScreen *screen, int row, unsigned length, int *indexed)
+make_indexed_text(TScreen *screen, int row, unsigned length, int *indexed,
+		  int *columns)
 {
     Char *result = NULL;
     size_t need = (length + 1);
@@ -3907,6 +4278,7 @@ make_indexed_text(TScreen *screen, int row, unsigned length, int *indexed)
 		 LineTstWrapped(ld) &&
 		 (ld = GET_LINEDATA(screen, ++row)) != NULL &&
 		 row < screen->max_row);
+	*columns = (int) used;
     }
     /* TRACE(("result:%s\n", result)); */
     return (char *) result;
@@ -3914,18 +4286,25 @@ make_indexed_text(TScreen *screen, int row, unsigned length, int *indexed)
 
 /*
  * Find the column given an offset into the character string by using the
- * index constructed in make_indexed_text().
+ * index constructed in make_indexed_text().  The index is nondecreasing, so
+ * this is a binary search for the first column at or past the offset.
  */
 static int
-indexToCol(const int *indexed, int len, int off)
+indexToCol(const int *indexed, int columns, int len, int off)
 {
-    int col = 0;
-    while (indexed[col] < len) {
-	if (indexed[col] >= off)
-	    break;
-	++col;
+    int lo = 0;
+    int hi = columns;
+
+    if (off > len)
+	off = len;
+    while (lo < hi) {
+	int mid = lo + (hi - lo) / 2;
+	if (indexed[mid] >= off)
+	    hi = mid;
+	else
+	    lo = mid + 1;
     }
-    return col;
+    return lo;
 }
 
 /*
@@ -3985,36 +4364,103 @@ cellToColumn(TScreen *screen, CELL *cell)
     return col;
 }
 
+/*
+ * Compiled expressions for the selectExpr slots.  Each is kept with a copy of
+ * its source, and compiled again only when the slot's expression changes.
+ */
+typedef struct {
+    char *expr;
+    regex_t preg;
+    Bool compiled;
+    Bool context;		/* matches depend on text before the start */
+} RegexCache;
+
+static RegexCache regex_cache[NSELECTUNITS];
+
+/*
+ * The word-boundary operators look at the character before the point where
+ * a match starts.  Searching from the middle of a line hides that character,
+ * so an expression using them must be tried from every column.
+ */
+static Bool
+regexHasContext(const char *expr)
+{
+    const char *s;
+
+    for (s = expr; (s = strchr(s, '\\')) != NULL && s[1] != '\0'; s += 2) {
+	if (strchr("<>bB`", s[1]) != NULL)
+	    return True;
+    }
+    return False;
+}
+
+static regex_t *
+cachedRegex(int inx, const char *expr)
+{
+    RegexCache *cache = &regex_cache[inx];
+
+    if (cache->expr == NULL || strcmp(cache->expr, expr)) {
+	if (cache->compiled)
+	    regfree(&cache->preg);
+	free(cache->expr);
+	cache->expr = x_strdup(expr);
+	cache->compiled = (cache->expr != NULL
+			   && regcomp(&cache->preg, expr, REG_EXTENDED) == 0);
+	cache->context = regexHasContext(expr);
+	TRACE(("regcomp[%d] %s\n", inx, cache->compiled ? "ok" : "failed"));
+    }
+    return cache->compiled ? &cache->preg : NULL;
+}
+
+#ifdef NO_LEAKS
+static void
+freeRegexCache(void)
+{
+    int n;
+
+    for (n = 0; n < NSELECTUNITS; ++n) {
+	if (regex_cache[n].compiled)
+	    regfree(&regex_cache[n].preg);
+	regex_cache[n].compiled = False;
+	FreeAndNull(regex_cache[n].expr);
+    }
+}
+#endif
+
 static void
 do_select_regex(TScreen *screen, CELL *startc, CELL *endc)
 {
     LineData *ld = GET_LINEDATA(screen, startc->row);
     int inx = ((screen->numberOfClicks - 1) % screen->maxClicks);
     char *expr = screen->selectExpr[inx];
-    regex_t preg;
+    regex_t *preg;
     regmatch_t match;
 
     TRACE(("Select_REGEX[%d]:%s\n", inx, NonNull(expr)));
     if (okPosition(screen, &ld, startc) && expr != NULL) {
-	if (regcomp(&preg, expr, REG_EXTENDED) == 0) {
+	if ((preg = cachedRegex(inx, expr)) != NULL) {
 	    int firstRow = firstRowOfLine(screen, startc->row, True);
 	    int lastRow = lastRowOfLine(screen, firstRow);
 	    unsigned size = lengthOfLines(screen, firstRow, lastRow);
 	    int actual = cellToColumn(screen, startc);
 	    int *indexed;
+	    Bool context = regex_cache[inx].context;
 
 	    TRACE(("regcomp ok rows %d..%d bytes %d\n",
 		   firstRow, lastRow, size));
 
 	    if ((indexed = TypeCallocN(int, size + 1)) != NULL) {
 		char *search;
+		int columns = 0;
 		if ((search = make_indexed_text(screen,
 						firstRow,
 						size,
-						indexed)) != NULL) {
+						indexed,
+						&columns)) != NULL) {
 		    int len = (int) strlen(search);
 		    int col;
 		    int offset;
+		    int start_col = 0;
 		    int best_col = -1;
 		    int best_len = -1;
 
@@ -4023,26 +4469,46 @@ do_select_regex(TScreen *screen, CELL *startc, CELL *endc)
 		    endc->row = 0;
 		    endc->col = 0;
 
-		    for (col = 0; (offset = indexed[col]) < len; ++col) {
-			if (regexec(&preg,
+		    /*
+		     * Scan left to right for the leftmost match from each
+		     * column up to the click.  Unless the expression looks
+		     * behind the start of the text, every column up to a
+		     * match's start yields that same match, so resume after
+		     * its start, and stop when nothing matches.
+		     */
+		    for (col = 0;
+			 col <= actual && (offset = indexed[col]) < len;
+			 col = (context
+				? col + 1
+				: Max(col, start_col) + 1)) {
+			int start_inx;
+			int finis_inx;
+			int finis_col;
+
+			if (regexec(preg,
 				    search + offset,
 				    (size_t) 1, &match,
-				    col ? REG_NOTBOL : 0) == 0) {
-			    int start_inx = (int) (match.rm_so + offset);
-			    int finis_inx = (int) (match.rm_eo + offset);
-			    int start_col = indexToCol(indexed, len, start_inx);
-			    int finis_col = indexToCol(indexed, len, finis_inx);
-
-			    if (start_col <= actual &&
-				actual <= finis_col) {
-				int test = finis_col - start_col;
-				if (best_len < test) {
-				    best_len = test;
-				    best_col = start_col;
-				    TRACE(("match column %d len %d\n",
-					   best_col,
-					   best_len));
-				}
+				    col ? REG_NOTBOL : 0) != 0) {
+			    if (!context)
+				break;
+			    continue;
+			}
+			start_inx = (int) (match.rm_so + offset);
+			finis_inx = (int) (match.rm_eo + offset);
+			start_col = indexToCol(indexed, columns, len, start_inx);
+			finis_col = indexToCol(indexed, columns, len, finis_inx);
+
+			if (start_col > actual) {
+			    if (!context)
+				break;
+			} else if (actual <= finis_col) {
+			    int test = finis_col - start_col;
+			    if (best_len < test) {
+				best_len = test;
+				best_col = start_col;
+				TRACE(("match column %d len %d\n",
+				       best_col,
+				       best_len));
 			    }
 			}
 		    }
@@ -4076,7 +4542,6 @@ do_select_regex(TScreen *screen, CELL *startc, CELL *endc)
 		}
 #endif
 	    }
-	    regfree(&preg);
 	}
     }
 }
@@ -4174,6 +4639,7 @@ ComputeSelect(XtermWidget xw,
 	    cclass = CClassOf(startSel);
 	    TRACE(("...starting with class %d\n", cclass));
 	    do {
+		screen->startSel.col = CClassFirst(startSel);
 		mark = screen->startSel;
 		--screen->startSel.col;
 		if (screen->startSel.col < 0
@@ -4207,6 +4673,8 @@ ComputeSelect(XtermWidget xw,
 	    cclass = CClassOf(endSel);
 	    TRACE(("...ending with class %d\n", cclass));
 	    do {
+		if (screen->endSel.col < length)
+		    screen->endSel.col = Min(CClassLast(endSel), length);
 		++screen->endSel.col;
 		if (screen->endSel.col > length
 		    && LineTstWrapped(ld.endSel)) {
@@ -4591,81 +5059,41 @@ ClearSelectionBuffer(TScreen *screen, String selection)
     screen->base64_count = 0;
 }
 
-static void
-AppendStrToSelectionBuffer(SelectedCells * scp, Char *text, size_t len)
-{
-    if (len != 0) {
-	size_t j = (scp->data_length + len);
-	size_t k = j + (j >> 2) + 80;
-	if (j + 1 >= scp->data_limit) {
-	    Char *line;
-	    if (!scp->data_length) {
-		line = (Char *) malloc(k);
-	    } else {
-		line = (Char *) realloc(scp->data_buffer, k);
-	    }
-	    if (line == NULL)
-		SysError(ERROR_BMALLOC2);
-	    scp->data_buffer = line;
-	    scp->data_limit = k;
-	}
-	if (scp->data_buffer != NULL) {
-	    memcpy(scp->data_buffer + scp->data_length, text, len);
-	    scp->data_length += len;
-	    scp->data_buffer[scp->data_length] = 0;
-	}
-    }
-}
-
+/*
+ * Decode base64 text, appending it to the selection buffer.  OSC 52 passes
+ * its whole payload at once; a partial group would be carried over in
+ * base64_accu and base64_count.
+ */
 void
-AppendToSelectionBuffer(TScreen *screen, unsigned c, String selection)
+AppendToSelectionBuffer(TScreen *screen, const char *text, size_t len, String selection)
 {
     int which = TargetToSelection(screen, selection);
     SelectedCells *scp = &(screen->selected_cells[okSelectionCode(which)]);
-    unsigned six;
-    Char ch;
-
-    /* Decode base64 character */
-    if (c >= 'A' && c <= 'Z')
-	six = c - 'A';
-    else if (c >= 'a' && c <= 'z')
-	six = c - 'a' + 26;
-    else if (c >= '0' && c <= '9')
-	six = c - '0' + 52;
-    else if (c == '+')
-	six = 62;
-    else if (c == '/')
-	six = 63;
-    else
-	return;
+    size_t need = ((len * 3) / 4) + 1;
 
-    /* Accumulate bytes */
-    switch (screen->base64_count) {
-    case 0:
-	screen->base64_accu = six;
-	screen->base64_count = 6;
-	break;
+    if (len == 0)
+	return;
 
-    case 2:
-	ch = CharOf((screen->base64_accu << 6) + six);
-	screen->base64_count = 0;
-	AppendStrToSelectionBuffer(scp, &ch, (size_t) 1);
-	break;
+    if (scp->data_length + need + 1 >= scp->data_limit) {
+	size_t k = scp->data_length + need + ((scp->data_length + need) >> 2) + 80;
+	Char *line;
 
-    case 4:
-	ch = CharOf((screen->base64_accu << 4) + (six >> 2));
-	screen->base64_accu = (six & 0x3);
-	screen->base64_count = 2;
-	AppendStrToSelectionBuffer(scp, &ch, (size_t) 1);
-	break;
-
-    case 6:
-	ch = CharOf((screen->base64_accu << 2) + (six >> 4));
-	screen->base64_accu = (six & 0xF);
-	screen->base64_count = 4;
-	AppendStrToSelectionBuffer(scp, &ch, (size_t) 1);
-	break;
+	if (!scp->data_length) {
+	    free(scp->data_buffer);
+	    line = (Char *) malloc(k);
+	} else {
+	    line = (Char *) realloc(scp->data_buffer, k);
+	}
+	if (line == NULL)
+	    SysError(ERROR_BMALLOC2);
+	scp->data_buffer = line;
+	scp->data_limit = k;
     }
+    scp->data_length += x_decode_base64((char *) scp->data_buffer + scp->data_length,
+					text, len,
+					&screen->base64_accu,
+					&screen->base64_count);
+    scp->data_buffer[scp->data_length] = 0;
 }
 
 void
@@ -4793,6 +5221,23 @@ SaveConvertedLength(XtPointer *target, unsigned long source)
 #define keepClipboard(d,atom) ((screen->keepClipboard) && \
 	 (atom == XA_CLIPBOARD(d)))
 
+static SelectedCells *
+SelectionToCells(XtermWidget xw, Atom selection)
+{
+    TScreen *screen = TScreenOf(xw);
+    Display *dpy = screen->display;
+    SelectedCells *scp;
+
+    if (keepClipboard(dpy, selection)) {
+	TRACE(("asked for clipboard\n"));
+	scp = &(screen->clipboard_data);
+    } else {
+	TRACE(("asked for selection\n"));
+	scp = &(screen->selected_cells[AtomToSelection(dpy, selection)]);
+    }
+    return scp;
+}
+
 static Boolean
 ConvertSelection(Widget w,
 		 Atom *selection,
@@ -4821,13 +5266,7 @@ ConvertSelection(Widget w,
 	   TraceAtomName(screen->display, *selection),
 	   visibleSelectionTarget(dpy, *target)));
 
-    if (keepClipboard(dpy, *selection)) {
-	TRACE(("asked for clipboard\n"));
-	scp = &(screen->clipboard_data);
-    } else {
-	TRACE(("asked for selection\n"));
-	scp = &(screen->selected_cells[AtomToSelection(dpy, *selection)]);
-    }
+    scp = SelectionToCells(xw, *selection);
 
     data = scp->data_buffer;
     data_length = scp->data_length;
@@ -5010,6 +5449,15 @@ LoseSelection(Widget w, Atom *selection)
 
     if (screen->selection_count == 0)
 	UnHiliteText(xw);
+
+#ifdef OPT_LUA_SCRIPTING
+    if (lua_xterm_has_listeners()) {
+	char *name = XGetAtomName(screen->display, *selection);
+	lua_xterm_emit("selection_lose", "s", name);
+	if (name != NULL)
+	    XFree(name);
+    }
+#endif
 }
 
 /* ARGSUSED */
@@ -5022,6 +5470,320 @@ SelectionDone(Widget w GCC_UNUSED,
     TRACE(("SelectionDone\n"));
 }
 
+/*
+ * Selections too large for a single request are owned incrementally, so that
+ * the text is converted and sent in segments as the requestor reads them,
+ * rather than converting all of it up front and writing it as one property.
+ *
+ * Each transfer remembers the selection buffer it started with; if the
+ * selection changes while a transfer is in progress, the transfer ends.
+ */
+typedef int (*TextListConverter) (Display *,
+				  char **, int,
+				  XICCEncodingStyle,
+				  XTextProperty *);
+
+typedef struct SelectionTransfer {
+    XtRequestId id;
+    SelectedCells *scp;
+    Char *data;			/* the selection when the transfer began */
+    unsigned long data_length;
+    unsigned long offset;	/* how much of it has been sent */
+    Atom type;
+    int format;
+    XtPointer value;		/* the segment most recently returned */
+    Bool finished;
+    struct SelectionTransfer *next;
+} SelectionTransfer;
+
+static SelectionTransfer *selection_transfers;
+
+#define SelectionIncrLimit(dpy) \
+	((unsigned long) (4 * XMaxRequestSize(dpy) - 32))
+
+static SelectionTransfer *
+FindSelectionTransfer(XtRequestId id)
+{
+    SelectionTransfer *tp;
+
+    for (tp = selection_transfers; tp != NULL; tp = tp->next) {
+	if (tp->id == id)
+	    break;
+    }
+    return tp;
+}
+
+static void
+FreeSelectionTransfer(XtRequestId id)
+{
+    SelectionTransfer **tpp;
+
+    for (tpp = &selection_transfers; *tpp != NULL; tpp = &(*tpp)->next) {
+	SelectionTransfer *tp = *tpp;
+	if (tp->id == id) {
+	    TRACE(("FreeSelectionTransfer %p sent %lu of %lu\n",
+		   (void *) id, tp->offset, tp->data_length));
+	    *tpp = tp->next;
+	    XtFree((char *) tp->value);
+	    free(tp);
+	    break;
+	}
+    }
+}
+
+/*
+ * Only STRING and UTF8_STRING are sent in segments; the other text targets
+ * are stateful (COMPOUND_TEXT), or depend on the locale's encoding.
+ */
+static Bool
+SegmentedTarget(XtermWidget xw,
+		Atom target,
+		TextListConverter * converter,
+		XICCEncodingStyle * style)
+{
+    TScreen *screen = TScreenOf(xw);
+    Bool result = False;
+
+    *converter = NULL;
+#if OPT_WIDE_CHARS
+    if (screen->wide_chars) {
+	Display *dpy = screen->display;
+
+	if (target == XA_STRING) {
+	    *converter = Xutf8TextListToTextProperty;
+	    *style = XStringStyle;
+	    result = True;
+	} else if (target == XA_UTF8_STRING(dpy)) {
+	    *converter = Xutf8TextListToTextProperty;
+	    *style = XUTF8StringStyle;
+	    result = True;
+	}
+    } else
+#endif
+    if (target == XA_STRING) {
+	result = True;		/* raw eight-bit data, as ConvertSelection */
+    }
+    return result;
+}
+
+/*
+ * Return the length of the next segment of the selection, at most size bytes,
+ * without splitting a UTF-8 sequence between segments.
+ */
+static unsigned long
+SegmentLength(XtermWidget xw, SelectionTransfer *tp, unsigned long size)
+{
+    unsigned long want = Min(size, tp->data_length - tp->offset);
+
+#if OPT_WIDE_CHARS
+    if (TScreenOf(xw)->wide_chars) {
+	unsigned long limit = want;
+	while (want > 1
+	       && tp->offset + want < tp->data_length
+	       && (tp->data[tp->offset + want] & 0xc0) == 0x80
+	       && limit - want < 4) {
+	    --want;
+	}
+    }
+#else
+    (void) xw;
+#endif
+    return want;
+}
+
+static Bool
+ConvertSegment(Widget w,
+	       SelectionTransfer *tp,
+	       unsigned long want,
+	       TextListConverter converter,
+	       XICCEncodingStyle style,
+	       Atom *type,
+	       XtPointer *value,
+	       unsigned long *length,
+	       int *format)
+{
+    *value = NULL;
+    *length = 0;
+    if (converter == NULL) {
+	if ((*value = XtMalloc((Cardinal) want)) != NULL) {
+	    memcpy(*value, tp->data + tp->offset, (size_t) want);
+	    *type = XA_STRING;
+	    *length = want;
+	    *format = 8;
+	}
+    } else {
+	Char *chunk = (Char *) malloc((size_t) want + 1);
+	if (chunk != NULL) {
+	    SelectedCells part;
+
+	    memset(&part, 0, sizeof(part));
+	    memcpy(chunk, tp->data + tp->offset, (size_t) want);
+	    chunk[want] = '\0';
+	    part.data_buffer = chunk;
+	    part.data_length = (size_t) want;
+	    part.data_limit = (size_t) want + 1;
+	    (void) _ConvertSelectionHelper(w, &part,
+					   type, value, length, format,
+					   converter, style);
+	    free(chunk);
+	}
+    }
+    return (*value != NULL);
+}
+
+/*
+ * Convert the next segment of the selection.  A segment must be larger than
+ * max_length for the Intrinsics to start an INCR transfer; when the data is
+ * used up, a segment of length zero ends the transfer.
+ */
+static Boolean
+ConvertSelectionIncr(Widget w,
+		     Atom *selection,
+		     Atom *target,
+		     Atom *type,
+		     XtPointer *value,
+		     unsigned long *length,
+		     int *format,
+		     unsigned long *max_length,
+		     XtPointer client_data GCC_UNUSED,
+		     XtRequestId *receiver_id)
+{
+    XtermWidget xw;
+    SelectionTransfer *tp;
+    TextListConverter converter;
+    XICCEncodingStyle style = XStringStyle;
+    unsigned long limit;
+    unsigned long want;
+
+    if ((xw = getXtermWidget(w)) == NULL)
+	return False;
+
+    *value = NULL;
+    *length = 0;
+
+    if ((tp = FindSelectionTransfer(*receiver_id)) == NULL) {
+	SelectedCells *scp = SelectionToCells(xw, *selection);
+
+	if (scp->data_buffer == NULL)
+	    return False;
+	if ((tp = TypeCalloc(SelectionTransfer)) == NULL)
+	    return False;
+	tp->id = *receiver_id;
+	tp->scp = scp;
+	tp->data = scp->data_buffer;
+	tp->data_length = scp->data_length;
+	tp->next = selection_transfers;
+	selection_transfers = tp;
+
+	TRACE(("ConvertSelectionIncr %s -> %s, %lu bytes\n",
+	       TraceAtomName(XtDisplay(w), *selection),
+	       visibleSelectionTarget(XtDisplay(w), *target),
+	       tp->data_length));
+
+	if (!SegmentedTarget(xw, *target, &converter, &style)) {
+	    /* convert the whole value, and end on the next call */
+	    if (!ConvertSelection(w, selection, target,
+				  type, value, length, format)) {
+		FreeSelectionTransfer(*receiver_id);
+		return False;
+	    }
+	    tp->value = *value;
+	    tp->type = *type;
+	    tp->format = *format;
+	    tp->finished = True;
+	    return True;
+	}
+    } else {
+	XtFree((char *) tp->value);
+	tp->value = NULL;
+	if (tp->scp->data_buffer != tp->data
+	    || tp->scp->data_length != tp->data_length) {
+	    TRACE(("...selection changed, ending transfer\n"));
+	    tp->finished = True;
+	}
+    }
+
+    if (tp->finished || tp->offset >= tp->data_length) {
+	tp->finished = True;
+	*type = tp->type;
+	*format = tp->format;
+	return True;
+    }
+
+    (void) SegmentedTarget(xw, *target, &converter, &style);
+
+    limit = (*max_length != 0) ? *max_length : 65536;
+    want = SegmentLength(xw, tp, 2 * limit);
+    if (!ConvertSegment(w, tp, want, converter, style,
+			type, value, length, format)) {
+	FreeSelectionTransfer(*receiver_id);
+	return False;
+    }
+
+    /*
+     * Converting UTF-8 to STRING shrinks it.  If the first segment shrinks
+     * to max_length or less, the Intrinsics would send it as the whole
+     * selection; convert more of the data until the result really is too
+     * large, or all of the data fits.
+     */
+    while (tp->offset == 0
+	   && converter != NULL
+	   && *length <= limit
+	   && want < tp->data_length) {
+	unsigned long more = SegmentLength(xw, tp, 2 * want);
+
+	if (more <= want)
+	    break;
+	XtFree((char *) *value);
+	want = more;
+	if (!ConvertSegment(w, tp, want, converter, style,
+			    type, value, length, format)) {
+	    FreeSelectionTransfer(*receiver_id);
+	    return False;
+	}
+	TRACE(("...first segment converted to %lu bytes from %lu\n",
+	       *length, want));
+    }
+
+    tp->offset += want;
+    tp->value = *value;
+    tp->type = *type;
+    tp->format = *format;
+    TRACE(("...segment of %lu bytes, %lu of %lu sent\n",
+	   *length, tp->offset, tp->data_length));
+    return True;
+}
+
+static void
+LoseSelectionIncr(Widget w, Atom *selection, XtPointer client_data GCC_UNUSED)
+{
+    LoseSelection(w, selection);
+}
+
+/* ARGSUSED */
+static void
+SelectionDoneIncr(Widget w GCC_UNUSED,
+		  Atom *selection GCC_UNUSED,
+		  Atom *target GCC_UNUSED,
+		  XtRequestId *receiver_id,
+		  XtPointer client_data GCC_UNUSED)
+{
+    TRACE(("SelectionDoneIncr\n"));
+    FreeSelectionTransfer(*receiver_id);
+}
+
+/* ARGSUSED */
+static void
+CancelSelectionIncr(Widget w GCC_UNUSED,
+		    Atom *selection GCC_UNUSED,
+		    Atom *target GCC_UNUSED,
+		    XtRequestId *receiver_id,
+		    XtPointer client_data GCC_UNUSED)
+{
+    TRACE(("CancelSelectionIncr\n"));
+    FreeSelectionTransfer(*receiver_id);
+}
+
 static void
 _OwnSelection(XtermWidget xw,
 	      String *selections,
@@ -5050,8 +5812,7 @@ _OwnSelection(XtermWidget xw,
     for (i = 0; i < count; i++) {
 	int cutbuffer = CutBuffer(atoms[i]);
 	if (cutbuffer >= 0) {
-	    unsigned long limit =
-	    (unsigned long) (4 * XMaxRequestSize(dpy) - 32);
+	    unsigned long limit = SelectionIncrLimit(dpy);
 	    scp = &(screen->selected_cells[CutBufferToCode(cutbuffer)]);
 	    if (scp->data_length > limit) {
 		TRACE(("selection too big (%lu bytes), not storing in CUT_BUFFER%d\n",
@@ -5077,6 +5838,8 @@ _OwnSelection(XtermWidget xw,
 	    }
 	} else {
 	    int which = AtomToSelection(dpy, atoms[i]);
+	    Bool owned = False;
+
 	    if (keepClipboard(dpy, atoms[i])) {
 		Char *buf;
 		SelectedCells *tcp = &(screen->clipboard_data);
@@ -5100,17 +5863,40 @@ _OwnSelection(XtermWidget xw,
 		XtDisownSelection((Widget) xw,
 				  atoms[i],
 				  screen->selection_time);
+	    } else if (!screen->replyToEmacs
+		       && atoms[i] != 0
+		       && scp->data_length > SelectionIncrLimit(dpy)) {
+		TRACE(("XtOwnSelectionIncremental(%s, @%ld)\n",
+		       TraceAtomName(screen->display, atoms[i]),
+		       (long) screen->selection_time));
+		owned =
+		    XtOwnSelectionIncremental((Widget) xw, atoms[i],
+					      screen->selection_time,
+					      ConvertSelectionIncr,
+					      LoseSelectionIncr,
+					      SelectionDoneIncr,
+					      CancelSelectionIncr,
+					      (XtPointer) 0);
 	    } else if (!screen->replyToEmacs && atoms[i] != 0) {
 		TRACE(("XtOwnSelection(%s, @%ld)\n",
 		       TraceAtomName(screen->display, atoms[i]),
 		       (long) screen->selection_time));
-		have_selection |=
+		owned =
 		    XtOwnSelection((Widget) xw, atoms[i],
 				   screen->selection_time,
 				   ConvertSelection,
 				   LoseSelection,
 				   SelectionDone);
 	    }
+	    have_selection |= owned;
+#ifdef OPT_LUA_SCRIPTING
+	    if (owned && lua_xterm_has_listeners()) {
+		lua_xterm_emit("selection_own", "sS",
+			       selections[i],
+			       (const char *) scp->data_buffer,
+			       (size_t) scp->data_length);
+	    }
+#endif
 	}
 	TRACE(("... _OwnSelection used length %lu value %s\n",
 	       (unsigned long) scp->data_length,
@@ -5184,6 +5970,16 @@ UnhiliteSelection(XtermWidget xw)
     }
 }
 
+/*
+ * Highlight cells which are not selected, e.g., a search match.  The range
+ * is cleared by the next selection, or by UnhiliteSelection().
+ */
+void
+xtermHiliteRange(XtermWidget xw, const CELL *first, const CELL *last)
+{
+    TrackText(xw, first, last);
+}
+
 /* returns number of chars in line from scol to ecol out */
 /* ARGSUSED */
 static int
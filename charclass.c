@@ -78,6 +78,21 @@ static struct classentry {
     int last;
 } *classtab;
 
+/*
+ * CharacterClass() is called for each cell as a selection is extended, which
+ * for the interval list means a scan of its whole length.  Flatten the list
+ * for the BMP into a byte per character, indexing the (few) distinct class
+ * values.  Characters past the BMP, or any if there are too many distinct
+ * classes, fall back to the interval list.
+ */
+#define CLASSMAP_SIZE	0x10000
+#define CLASSMAP_IDENT	255	/* not a class: the character is its own */
+
+static Char *classmap;
+static int classvals[CLASSMAP_IDENT];
+static int classmap_state;	/* 0=stale, 1=built, -1=unusable */
+static unsigned long classtab_changes;
+
 #ifdef TEST_DRIVER
 static int opt_all;
 static int opt_check;
@@ -152,14 +167,65 @@ init_classtab(void)
     return;
 }
 
+static Boolean
+build_classmap(void)
+{
+    int nvals = 0;
+    int i;
+
+    if (classmap == NULL
+	&& (classmap = TypeMallocN(Char, CLASSMAP_SIZE)) == NULL)
+	return False;
+
+    /* apply the intervals in order, so the last match wins */
+    memset(classmap, CLASSMAP_IDENT, (size_t) CLASSMAP_SIZE);
+    for (i = classtab[0].first; i <= classtab[0].last; i++) {
+	int lo = Max(classtab[i].first, 0);
+	int hi = Min(classtab[i].last, CLASSMAP_SIZE - 1);
+	int code;
+
+	if (lo > hi)
+	    continue;
+	if (classtab[i].cclass < 0) {
+	    code = CLASSMAP_IDENT;
+	} else {
+	    for (code = 0; code < nvals; ++code) {
+		if (classvals[code] == classtab[i].cclass)
+		    break;
+	    }
+	    if (code == nvals) {
+		if (nvals >= CLASSMAP_IDENT)
+		    return False;
+		classvals[nvals++] = classtab[i].cclass;
+	    }
+	}
+	memset(classmap + lo, code, (size_t) (hi + 1 - lo));
+    }
+    TRACE(("build_classmap: %d classes\n", nvals));
+    return True;
+}
+
 int
 CharacterClass(int c)
 {
     int i, cclass = IDENT;
 
-    for (i = classtab[0].first; i <= classtab[0].last; i++)
-	if (classtab[i].first <= c && classtab[i].last >= c)
+    if (c >= 0 && c < CLASSMAP_SIZE) {
+	if (classmap_state == 0)
+	    classmap_state = build_classmap() ? 1 : -1;
+	if (classmap_state > 0) {
+	    int code = classmap[c];
+	    return (code == CLASSMAP_IDENT) ? c : classvals[code];
+	}
+    }
+
+    /* the last match wins, so search from the end */
+    for (i = classtab[0].last; i >= classtab[0].first; i--) {
+	if (classtab[i].first <= c && classtab[i].last >= c) {
 	    cclass = classtab[i].cclass;
+	    break;
+	}
+    }
 
     if (cclass < 0)
 	cclass = c;
@@ -247,9 +313,21 @@ SetCharacterClassRange(int low, int high, int value)
     classtab[classtab[0].last].last = high;
     classtab[classtab[0].last].cclass = value;
 
+    classmap_state = 0;
+    classtab_changes++;
     return 0;
 }
 
+/*
+ * Callers which cache classes compare this count to discard them when the
+ * table changes.
+ */
+unsigned long
+CharacterClassChanges(void)
+{
+    return classtab_changes;
+}
+
 void
 report_wide_char_class(void)
 {
@@ -281,6 +359,8 @@ void
 noleaks_CharacterClass(void)
 {
     FreeAndNull(classtab);
+    FreeAndNull(classmap);
+    classmap_state = 0;
 }
 #endif
 #endif /* OPT_WIDE_CHARS */
@@ -55,6 +55,7 @@ extern void init_classtab(void);
 
 extern int SetCharacterClassRange(int low, int high, int value);
 extern int CharacterClass(int c);
+extern unsigned long CharacterClassChanges(void);
 
 #if OPT_REPORT_CCLASS
 extern void report_wide_char_class(void);
@@ -228,6 +228,7 @@ static XtActionsRec actionsList[] = {
     { "allow-bold-fonts",	HandleAllowBoldFonts },
     { "allow-send-events",	HandleAllowSends },
     { "bell",			HandleBell },
+    { "cancel-paste",		HandleCancelPaste },
     { "clear-saved-lines",	HandleClearSavedLines },
     { "copy-selection",		HandleCopySelection },
     { "create-menu",		HandleCreateMenu },
@@ -246,12 +247,17 @@ static XtActionsRec actionsList[] = {
     { "popup-menu",		HandlePopupMenu },
     { "print",			HandlePrintScreen },
     { "print-everything",	HandlePrintEverything },
+    { "print-lines",		HandlePrintLines },
     { "print-redir",		HandlePrintControlMode },
     { "quit",			HandleQuit },
     { "redraw",			HandleRedraw },
     { "scroll-back",		HandleScrollBack },
     { "scroll-forw",		HandleScrollForward },
     { "scroll-to",		HandleScrollTo },
+    { "search",			HandleSearch },
+    { "search-cancel",		HandleSearchCancel },
+    { "search-next",		HandleSearchNext },
+    { "search-prev",		HandleSearchPrev },
     { "secure",			HandleSecure },
     { "select-cursor-end",	HandleKeyboardSelectEnd },
     { "select-cursor-extend",   HandleKeyboardSelectExtend },
@@ -460,17 +466,20 @@ static XtResource xterm_resources[] =
     Bres(XtNpopOnBell, XtCPopOnBell, screen.poponbell, False),
     Bres(XtNpreferLatin1, XtCPreferLatin1, screen.prefer_latin1, True),
     Bres(XtNprintRawChars, XtCPrintRawChars, screen.print_rawchars, False),
+    Bres(XtNprinterAsync, XtCPrinterAsync, SPS.printer_async, True),
     Bres(XtNprinterAutoClose, XtCPrinterAutoClose, SPS.printer_autoclose, False),
     Bres(XtNprinterExtent, XtCPrinterExtent, SPS.printer_extent, False),
     Bres(XtNprinterFormFeed, XtCPrinterFormFeed, SPS.printer_formfeed, False),
     Bres(XtNprinterNewLine, XtCPrinterNewLine, SPS.printer_newline, True),
     Bres(XtNquietGrab, XtCQuietGrab, screen.quiet_grab, False),
+    Bres(XtNreflowLines, XtCReflowLines, screen.reflow_lines, True),
     Bres(XtNresizeByPixel, XtCResizeByPixel, misc.resizeByPixel, False),
     Bres(XtNreverseVideo, XtCReverseVideo, misc.re_verse, False),
     Bres(XtNreverseWrap, XtCReverseWrap, misc.reverseWrap, False),
     Bres(XtNscrollBar, XtCScrollBar, misc.scrollbar, False),
     Bres(XtNscrollKey, XtCScrollCond, screen.scrollkey, False),
     Bres(XtNscrollTtyOutput, XtCScrollCond, screen.scrollttyoutput, True),
+    Bres(XtNsearchIndex, XtCSearchIndex, screen.search_index, False),
     Bres(XtNselectToClipboard, XtCSelectToClipboard,
 	 screen.selectToClipboard, False),
     Bres(XtNsignalInhibit, XtCSignalInhibit, misc.signalInhibit, False),
@@ -494,6 +503,7 @@ static XtResource xterm_resources[] =
     Ires(XtNpointerMode, XtCPointerMode, screen.pointer_mode, DEF_POINTER_MODE),
     Ires(XtNprinterControlMode, XtCPrinterControlMode,
 	 SPS.printer_controlmode, 0),
+    Ires(XtNresizeDelay, XtCResizeDelay, screen.resize_delay, 25),
     Ires(XtNtitleModes, XtCTitleModes, screen.title_modes, DEF_TITLE_MODES),
     Ires(XtNnextEventDelay, XtCNextEventDelay, screen.nextEventDelay, 1),
     Ires(XtNvisualBellDelay, XtCVisualBellDelay, screen.visualBellDelay, 100),
@@ -501,6 +511,12 @@ static XtResource xterm_resources[] =
     Ires(XtNscrollBarBorder, XtCScrollBarBorder, screen.scrollBarBorder, 1),
     Ires(XtNscrollLines, XtCScrollLines, screen.scrolllines, DEF_SCROLL_LINES),
 
+#if OPT_SNAPSHOT
+    Bres(XtNrestoreSnapshot, XtCRestoreSnapshot, screen.snapshot_restore, False),
+    Ires(XtNsnapshotInterval, XtCSnapshotInterval, screen.snapshot_interval, 10),
+    Sres(XtNsnapshotFile, XtCSnapshotFile, screen.snapshot_file, NULL),
+#endif
+
     Sres(XtNinitialFont, XtCInitialFont, screen.initial_font, NULL),
     Sres(XtNfont1, XtCFont1, screen.MenuFontName(fontMenu_font1), NULL),
     Sres(XtNfont2, XtCFont2, screen.MenuFontName(fontMenu_font2), NULL),
@@ -551,9 +567,12 @@ static XtResource xterm_resources[] =
     Sres(XtNpointerShape, XtCCursor, screen.pointer_shape, "xterm"),
 
 #ifdef ALLOWLOGGING
+    Bres(XtNlogAsync, XtCLogAsync, screen.log_async, True),
     Bres(XtNlogInhibit, XtCLogInhibit, misc.logInhibit, False),
     Bres(XtNlogging, XtCLogging, misc.log_on, False),
+    Ires(XtNlogBufferSize, XtCLogBufferSize, screen.log_buffer_size, 1024),
     Sres(XtNlogFile, XtCLogfile, screen.logfile, NULL),
+    Sres(XtNlogFormat, XtCLogFormat, screen.log_format_s, "raw"),
 #endif
 
 #ifndef NO_ACTIVE_ICON
@@ -735,6 +754,8 @@ static XtResource xterm_resources[] =
 
 #if OPT_GRAPHICS
     Sres(XtNdecGraphicsID, XtCDecGraphicsID, screen.graph_termid, DFT_DECID),
+    Ires(XtNmaxGraphicMemory, XtCMaxGraphicMemory,
+	 screen.graphics_max_memory, 65536),
     Sres(XtNmaxGraphicSize, XtCMaxGraphicSize, screen.graphics_max_size,
 	 "1000x1000"),
 #endif
@@ -2615,7 +2636,8 @@ find_SL_MODE(XtermWidget xw)
 		if (!strncmp(found, "%{unixtime%}", length)) {
 		    if (result == SLnone)
 			result = SLclock;
-		} else if (!strncmp(found, "%{position%}", length)) {
+		} else if (!strncmp(found, "%{position%}", length)
+			   || !strncmp(found, "%{paste%}", length)) {
 		    result = SLcoords;
 		}
 		parse = found + length - 1;
@@ -2773,6 +2795,12 @@ show_indicator_status(XtPointer closure, XtIntervalId * id GCC_UNUSED)
 			    screen->status_data[0].row + 1,
 			    screen->status_data[0].col + 1);
 		    StatusPutChars(xw, buffer, -1);
+		} else if (!strncmp(found, "%{paste%}", length)) {
+		    int percent = xtermPasteProgress();
+		    if (percent >= 0) {
+			sprintf(buffer, "paste %d%%", percent);
+			StatusPutChars(xw, buffer, -1);
+		    }
 		} else {
 		    StatusPutChars(xw, found, (int) length);
 		}
@@ -2988,6 +3016,12 @@ update_status_line(XtermWidget xw, int new_active, int new_type)
 	}
     }
   finish:
+#ifdef OPT_LUA_SCRIPTING
+    if (lua_xterm_has_hook(LUA_HOOK_STATUS_UPDATE))
+	lua_xterm_call_hook(LUA_HOOK_STATUS_UPDATE,
+			    screen->status_type,
+			    screen->status_active);
+#endif
     TRACE_SL("update_status_line (done)");
     return;
 }
@@ -3073,6 +3107,7 @@ doparsing(XtermWidget xw, unsigned c, struct ParseState *sp)
 	return True;
     }
     sp->check_recur++;
+    screen->cell_writes++;
 
     do {
 #if OPT_WIDE_CHARS
@@ -3388,8 +3423,29 @@ doparsing(XtermWidget xw, unsigned c, struct ParseState *sp)
 #if OPT_SIXEL_GRAPHICS
 	    else if (sp->string_args == sa_SIXEL) {
 		/* avoid adding the string-terminator */
-		if (sos_table[CharOf(c)] == CASE_IGNORE)
+		if (sos_table[CharOf(c)] == CASE_IGNORE) {
+		    Char *next;
+
 		    parse_sixel_char(AsciiOf(c));
+
+		    /* decode the rest of the data in the buffer in one call */
+#if OPT_WIDE_CHARS
+		    if (VTbuffer->utf_size == 0)
+#endif
+		    {
+			next = VTbuffer->next;
+			while (next < VTbuffer->last
+			       && *next < 0x80
+			       && sos_table[*next] == CASE_IGNORE) {
+			    ++next;
+			}
+			if (next != VTbuffer->next) {
+			    parse_sixel_chars((const char *) VTbuffer->next,
+					      (size_t) (next - VTbuffer->next));
+			    VTbuffer->next = next;
+			}
+		    }
+		}
 	    }
 #endif
 	    else if (sp->string_skip) {
@@ -6489,6 +6545,8 @@ void
 v_write(int f, const Char *data, size_t len)
 {
     TRACE2(("v_write(%d:%s)\n", len, visibleChars(data, len)));
+    if (len > 0)
+	xtermPasteInterrupt(term);
     if (v_bufstr == NULL) {
 	if (len > 0) {
 	    v_buffer = (Char *) XtMalloc((Cardinal) len);
@@ -6797,7 +6855,7 @@ in_put(XtermWidget xw)
 	if (screen->eventMode != NORMAL)
 	    FD_CLR(screen->respond, &select_mask);
 
-	if (v_bufptr > v_bufstr) {
+	if (v_bufptr > v_bufstr || xtermPastePending()) {
 	    XFD_COPYSET(&pty_mask, &write_mask);
 	} else
 	    FD_ZERO(&write_mask);
@@ -6831,6 +6889,10 @@ in_put(XtermWidget xw)
 		ImproveTimeout(50000L);
 		time_select = 1;
 	    }
+	    if (screen->resize_timer != 0) {
+		ImproveTimeout((long) screen->resize_delay * 1000L);
+		time_select = 1;
+	    }
 #if OPT_BLINK_CURS
 	    if ((screen->blink_timer != 0 &&
 		 ((screen->select & FOCUS) || screen->always_highlight)) ||
@@ -6866,6 +6928,9 @@ in_put(XtermWidget xw)
 	/* if there is room to write more data to the pty, go write more */
 	if (FD_ISSET(screen->respond, &write_mask)) {
 	    v_write(screen->respond, (Char *) 0, (size_t) 0);	/* flush buffer */
+	    /* the pty took everything so far: feed it more of a paste */
+	    if (v_bufptr == v_bufstr && xtermPastePending())
+		xtermPasteContinue(xw);
 	}
 
 	/* if there are X events already in our queue, it
@@ -9634,12 +9699,43 @@ VTNonMaskableEvent(Widget w GCC_UNUSED,
     }
 }
 
+/*
+ * Interactive resizing by the window manager sends a stream of configure
+ * events.  Wait for them to settle before resizing (and reflowing) the
+ * screen, and then use the final size.
+ */
+static void
+VTResizeTimeout(XtPointer closure, XtIntervalId * id GCC_UNUSED)
+{
+    XtermWidget xw = (XtermWidget) closure;
+    TScreen *screen = TScreenOf(xw);
+
+    screen->resize_timer = 0;
+    if (XtIsRealized((Widget) xw)) {
+	TRACE(("VTResizeTimeout %dx%d\n", xw->core.height, xw->core.width));
+	ScreenResize(xw, xw->core.width, xw->core.height, &xw->flags);
+    }
+}
+
 static void
 VTResize(Widget w)
 {
     if (XtIsRealized(w)) {
 	XtermWidget xw = (XtermWidget) w;
-	ScreenResize(xw, xw->core.width, xw->core.height, &xw->flags);
+	TScreen *screen = TScreenOf(xw);
+
+	if (screen->resize_timer) {
+	    XtRemoveTimeOut(screen->resize_timer);
+	    screen->resize_timer = 0;
+	}
+	if (screen->resize_delay > 0 && screen->is_running) {
+	    screen->resize_timer =
+		XtAppAddTimeOut(app_con,
+				(unsigned long) screen->resize_delay,
+				VTResizeTimeout, xw);
+	} else {
+	    ScreenResize(xw, xw->core.width, xw->core.height, &xw->flags);
+	}
     }
 }
 
@@ -10826,9 +10922,12 @@ VTInitialize(Widget wrequest,
 
     init_Mres(screen.delete_is_del);
 #ifdef ALLOWLOGGING
+    init_Bres(screen.log_async);
     init_Bres(misc.logInhibit);
     init_Bres(misc.log_on);
+    init_Ires(screen.log_buffer_size);
     init_Sres(screen.logfile);
+    init_Sres(screen.log_format_s);
 #endif
     init_Bres(screen.bellIsUrgent);
     init_Bres(screen.bellOnReset);
@@ -10838,9 +10937,17 @@ VTInitialize(Widget wrequest,
     init_Ires(screen.savelines);
     init_Ires(screen.scrollBarBorder);
     init_Ires(screen.scrolllines);
+#if OPT_SNAPSHOT
+    init_Bres(screen.snapshot_restore);
+    init_Ires(screen.snapshot_interval);
+    init_Sres(screen.snapshot_file);
+#endif
     init_Bres(screen.alternateScroll);
     init_Bres(screen.scrollttyoutput);
     init_Bres(screen.scrollkey);
+    init_Bres(screen.search_index);
+    init_Bres(screen.reflow_lines);
+    init_Ires(screen.resize_delay);
 
     init_Dres(screen.scale_height);
     if (screen->scale_height < MIN_SCALE_HEIGHT)
@@ -10971,6 +11078,7 @@ VTInitialize(Widget wrequest,
 
     wnew->SPS.printer_checked = False;
     init_Sres(SPS.printer_command);
+    init_Bres(SPS.printer_async);
     init_Bres(SPS.printer_autoclose);
     init_Bres(SPS.printer_extent);
     init_Bres(SPS.printer_formfeed);
@@ -11688,6 +11796,7 @@ VTInitialize(Widget wrequest,
 	       (int) screen->graphics_regis_def_high));
 # endif
 
+	init_Ires(screen.graphics_max_memory);
 	init_Sres(screen.graphics_max_size);
 	screen->graphics_max_high = 1000;
 	screen->graphics_max_wide = 1000;
@@ -106,3 +106,6 @@
 #define	ERROR_SCALLOC	90	/* Alloc: calloc() failed on base */
 #define	ERROR_SCALLOC2	91	/* Alloc: calloc() failed on rows */
 #define	ERROR_SAVE_PTR	102	/* ScrnPointers: malloc/realloc() failed */
+
+/* search.c */
+#define	ERROR_SRMALLOC	110	/* buildLine: realloc() failed */
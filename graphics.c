@@ -171,17 +171,165 @@ static ColorRegister gc_color;
 static ColorRegister null_color =
 {-1, -1, -1};
 
+/*
+ * find_color_register() keeps an index of the last set of registers it was
+ * given, as a grid of cells COLOR_GRID_STEP wide along each channel.  Any
+ * change to a set of registers bumps color_serial, making the index stale.
+ */
+#define COLOR_GRID_STEP  8
+#define COLOR_GRID_CELLS (CHANNEL_MAX / COLOR_GRID_STEP + 1)
+#define COLOR_GRID_TOTAL (COLOR_GRID_CELLS * COLOR_GRID_CELLS * COLOR_GRID_CELLS)
+
+static unsigned color_serial;
+
+static struct {
+    ColorRegister const *registers;
+    unsigned serial;
+    unsigned first[COLOR_GRID_TOTAL + 1];	/* cell's offset in members[] */
+    RegisterNum members[MAX_COLOR_REGISTERS];	/* ascending in each cell */
+} color_grid;
+
 static ColorRegister *
 allocRegisters(void)
 {
+    color_serial++;
     return TypeCallocN(ColorRegister, MAX_COLOR_REGISTERS);
 }
 
+/*
+ * Forget the server-side copy of a graphic, e.g., because it was modified.
+ */
+static void
+drop_graphic_pixmap(Graphic *graphic)
+{
+    if (graphic->xw != NULL) {
+	Display *display = TScreenOf(graphic->xw)->display;
+
+	if (graphic->pixmap != None)
+	    XFreePixmap(display, graphic->pixmap);
+	if (graphic->mask != None)
+	    XFreePixmap(display, graphic->mask);
+    }
+    graphic->pixmap = None;
+    graphic->mask = None;
+}
+
+/*
+ * A graphic's pixels are allocated to fit the image as it grows, rounding
+ * each side up to a power of two (up to the maximum size).  The buffers of
+ * graphics which are reset or discarded are pooled by size for reuse.  The
+ * maxGraphicMemory resource bounds the total, by freeing pooled buffers and
+ * then discarding the least-recently shown graphics which are off-screen.
+ */
+#define MIN_PIXELS_SIDE 64
+#define POOL_CLASSES    32	/* by log2 of the number of cells */
+#define POOL_DEPTH      2
+
+typedef struct {
+    RegisterNum *buffer;
+    size_t cells;
+} PooledPixels;
+
+static struct {
+    PooledPixels entry[POOL_DEPTH];
+    unsigned count;
+} pixel_pool[POOL_CLASSES];
+
+static GraphicsStats graphics_stats;
+static unsigned long graphics_clock;
+
+static Boolean graphic_in_view(Graphic *graphic);
+
+#define BufferBytes(cells) ((unsigned long) (cells) * sizeof(RegisterNum))
+#define PixelCells(graphic) \
+	((size_t) (graphic)->pixels_wide * (size_t) (graphic)->pixels_high)
+#define TouchGraphic(graphic) (graphic)->last_used = ++graphics_clock
+
+static unsigned
+pool_class(size_t cells)
+{
+    unsigned result = 0;
+
+    while (result + 1 < POOL_CLASSES && ((size_t) 1 << result) < cells)
+	++result;
+    return result;
+}
+
+static RegisterNum *
+pool_take(size_t cells)
+{
+    unsigned const n = pool_class(cells);
+    RegisterNum *result = NULL;
+    unsigned k;
+
+    for (k = 0; k < pixel_pool[n].count; ++k) {
+	if (pixel_pool[n].entry[k].cells >= cells) {
+	    result = pixel_pool[n].entry[k].buffer;
+	    graphics_stats.bytes_pooled -= BufferBytes(pixel_pool[n].entry[k].cells);
+	    pixel_pool[n].entry[k] = pixel_pool[n].entry[--pixel_pool[n].count];
+	    graphics_stats.reuses++;
+	    break;
+	}
+    }
+    if (result == NULL && (result = TypeMallocN(RegisterNum, cells)) != NULL)
+	graphics_stats.allocations++;
+    return result;
+}
+
+static void
+pool_give(RegisterNum *buffer, size_t cells)
+{
+    if (buffer != NULL) {
+	unsigned const n = pool_class(cells);
+
+	if (pixel_pool[n].count < POOL_DEPTH) {
+	    pixel_pool[n].entry[pixel_pool[n].count].buffer = buffer;
+	    pixel_pool[n].entry[pixel_pool[n].count].cells = cells;
+	    pixel_pool[n].count++;
+	    graphics_stats.bytes_pooled += BufferBytes(cells);
+	} else {
+	    free(buffer);
+	}
+    }
+}
+
+/*
+ * Free the largest pooled buffer, returning false if the pool is empty.
+ */
+static Boolean
+pool_trim(void)
+{
+    unsigned n = POOL_CLASSES;
+
+    while (n-- != 0) {
+	if (pixel_pool[n].count != 0) {
+	    PooledPixels *last = &pixel_pool[n].entry[--pixel_pool[n].count];
+	    graphics_stats.bytes_pooled -= BufferBytes(last->cells);
+	    free(last->buffer);
+	    return True;
+	}
+    }
+    return False;
+}
+
+static void
+release_pixels(Graphic *graphic)
+{
+    if (graphic->pixels != NULL) {
+	graphics_stats.bytes_used -= BufferBytes(PixelCells(graphic));
+	pool_give(graphic->pixels, PixelCells(graphic));
+	graphic->pixels = NULL;
+    }
+    graphic->pixels_wide = 0;
+    graphic->pixels_high = 0;
+}
+
 static Graphic *
 freeGraphic(Graphic *obj)
 {
     if (obj) {
-	free(obj->pixels);
+	drop_graphic_pixmap(obj);
+	release_pixels(obj);
 	free(obj->private_color_registers);
 	free(obj);
     }
@@ -195,10 +343,7 @@ allocGraphic(int max_w, int max_h)
     if (result) {
 	result->max_width = max_w;
 	result->max_height = max_h;
-	if (!(result->pixels = TypeCallocN(RegisterNum,
-					     (size_t) max_w * (size_t) max_h))) {
-	    result = freeGraphic(result);
-	} else if (!(result->private_color_registers = allocRegisters())) {
+	if (!(result->private_color_registers = allocRegisters())) {
 	    result = freeGraphic(result);
 	}
     }
@@ -245,6 +390,164 @@ deactivateSlot(unsigned n)
     }
 }
 
+/*
+ * Find the active graphic which was least recently shown, which is neither
+ * the one given nor on-screen.  Hidden graphics are ReGIS pages, which ReGIS
+ * may still be drawing on or may show again, so they are kept.
+ */
+static Graphic *
+least_recent_graphic(Graphic *except, unsigned *slot)
+{
+    Graphic *result = NULL;
+    unsigned ii;
+
+    FOR_EACH_SLOT(ii) {
+	Graphic *graphic;
+
+	if (!(graphic = getActiveSlot(ii)))
+	    continue;
+	if (graphic == except
+	    || graphic->hidden
+	    || graphic_in_view(graphic))
+	    continue;
+	if (!result || graphic->last_used < result->last_used) {
+	    result = graphic;
+	    *slot = ii;
+	}
+    }
+    return result;
+}
+
+/*
+ * Discard an off-screen graphic's image, keeping the slot since ReGIS may
+ * still refer to it.
+ */
+static void
+evict_graphic(Graphic *graphic, unsigned slot)
+{
+    TRACE(("evicting graphic index %u id %u (%dx%d)\n",
+	   slot, graphic->id,
+	   graphic->pixels_wide, graphic->pixels_high));
+    (void) slot;
+    drop_graphic_pixmap(graphic);
+    release_pixels(graphic);
+    graphic->actual_width = 0;
+    graphic->actual_height = 0;
+    graphic->valid = False;
+    graphics_stats.evictions++;
+}
+
+/*
+ * Free pooled buffers, then discard off-screen graphics, until the given
+ * number of bytes can be allocated within the budget.  What is on-screen is
+ * kept even if that exceeds the budget.
+ */
+static void
+make_room(Graphic *graphic, unsigned long bytes)
+{
+    unsigned long const limit = graphics_stats.bytes_limit;
+
+    while (limit != 0
+	   && (graphics_stats.bytes_used
+	       + graphics_stats.bytes_pooled
+	       + bytes) > limit) {
+	Graphic *victim;
+	unsigned slot = 0;
+
+	if (pool_trim())
+	    continue;
+	if ((victim = least_recent_graphic(graphic, &slot)) == NULL)
+	    break;
+	evict_graphic(victim, slot);
+    }
+}
+
+static int
+pixels_side(int want, int limit)
+{
+    int result = MIN_PIXELS_SIDE;
+
+    while (result < want)
+	result <<= 1;
+    return Min(result, limit);
+}
+
+/*
+ * Ensure that the graphic's pixels are allocated for an image of the given
+ * size.  The pixels are not moved unless the image grows past the current
+ * allocation; new pixels are holes.
+ */
+Boolean
+reserve_graphic(Graphic *graphic, int width, int height)
+{
+    RegisterNum *pixels;
+    size_t cells;
+    int wide, high;
+    int r;
+
+    width = Min(width, graphic->max_width);
+    height = Min(height, graphic->max_height);
+    if (width <= graphic->pixels_wide && height <= graphic->pixels_high)
+	return True;
+
+    wide = Max(graphic->pixels_wide, pixels_side(width, graphic->max_width));
+    high = Max(graphic->pixels_high, pixels_side(height, graphic->max_height));
+    cells = (size_t) wide * (size_t) high;
+
+    if (graphic->xw != NULL) {
+	graphics_stats.bytes_limit =
+	    (unsigned long) Max(TScreenOf(graphic->xw)->graphics_max_memory, 0)
+	    * 1024UL;
+    }
+    make_room(graphic, BufferBytes(cells) - BufferBytes(PixelCells(graphic)));
+
+    if ((pixels = pool_take(cells)) == NULL) {
+	TRACE(("unable to allocate %dx%d pixels for graphic %u\n",
+	       wide, high, graphic->id));
+	return False;
+    }
+    memset(pixels, COLOR_HOLE & 0xff, cells * sizeof(RegisterNum));
+    for (r = 0; r < graphic->pixels_high; ++r) {
+	memcpy(pixels + (r * wide),
+	       graphic->pixels + (r * graphic->pixels_wide),
+	       (size_t) graphic->pixels_wide * sizeof(RegisterNum));
+    }
+    release_pixels(graphic);
+
+    graphic->pixels = pixels;
+    graphic->pixels_wide = wide;
+    graphic->pixels_high = high;
+    graphics_stats.bytes_used += BufferBytes(cells);
+
+    TRACE(("graphic %u pixels now %dx%d: %lu bytes used, %lu pooled\n",
+	   graphic->id, wide, high,
+	   graphics_stats.bytes_used,
+	   graphics_stats.bytes_pooled));
+    return True;
+}
+
+/*
+ * Set the size of the image, limited to what can be allocated.
+ */
+void
+resize_graphic(Graphic *graphic, int actual_width, int actual_height)
+{
+    if (!reserve_graphic(graphic, actual_width, actual_height)) {
+	actual_width = Min(actual_width, graphic->pixels_wide);
+	actual_height = Min(actual_height, graphic->pixels_high);
+    }
+    graphic->actual_width = Min(actual_width, graphic->max_width);
+    graphic->actual_height = Min(actual_height, graphic->max_height);
+}
+
+void
+get_graphics_stats(TScreen const *screen, GraphicsStats *stats)
+{
+    *stats = graphics_stats;
+    stats->bytes_limit = (unsigned long) Max(screen->graphics_max_memory, 0)
+	* 1024UL;
+}
+
 extern RegisterNum
 read_pixel(Graphic *graphic, int x, int y)
 {
@@ -252,13 +555,13 @@ read_pixel(Graphic *graphic, int x, int y)
 	     (x) < (graphic)->actual_width &&
 	     (y) >= 0 &&
 	     (y) < (graphic)->actual_height)
-	    ? (graphic)->pixels[(y) * (graphic)->max_width + (x)]
+	    ? (graphic)->pixels[(y) * (graphic)->pixels_wide + (x)]
 	    : (RegisterNum) COLOR_HOLE);
 }
 
 #define _draw_pixel(G, X, Y, C) \
     do { \
-        unsigned _cell = (unsigned)((Y) * (G)->max_width + (X)); \
+        unsigned _cell = (unsigned)((Y) * (G)->pixels_wide + (X)); \
         SetSpixel(G, _cell, (RegisterNum) (C)); \
     } while (0)
 
@@ -318,9 +621,11 @@ draw_solid_rectangle(Graphic *graphic, int x1, int y1, int x2, int y2, unsigned
 
     if (color < MAX_COLOR_REGISTERS)
 	graphic->color_registers_used[color] = True;
-    for (y = y1; y <= y2; y++)
+    for (y = y1; y <= y2; y++) {
+	RegisterNum *row = graphic->pixels + (y * graphic->pixels_wide);
 	for (x = x1; x <= x2; x++)
-	    _draw_pixel(graphic, x, y, color);
+	    row[x] = (RegisterNum) color;
+    }
 }
 
 void
@@ -371,10 +676,10 @@ copy_overlapping_area(Graphic *graphic, int src_ul_x, int src_ul_y,
 		color = (RegisterNum) default_color;
 	    else
 		color = graphic->pixels[(unsigned) (src_y *
-						    graphic->max_width) +
+						    graphic->pixels_wide) +
 					(unsigned) src_x];
 
-	    cell = (int) ((unsigned) (dst_y * graphic->max_width) +
+	    cell = (int) ((unsigned) (dst_y * graphic->pixels_wide) +
 			  (unsigned) dst_x);
 	    SetSpixel(graphic, cell, color);
 	}
@@ -390,6 +695,7 @@ do { \
     reg->g = (short) pg; \
     reg->b = (short) pb; \
     } \
+    color_serial++; \
 } while (0)
 
 /* Graphics which don't use private colors will act as if they are using a
@@ -415,7 +721,7 @@ set_shared_color_register(unsigned color, int r, int g, int b)
 	if (graphic->private_colors)
 	    continue;
 
-	if (graphic->color_registers_used[ii]) {
+	if (graphic->color_registers_used[color]) {
 	    graphic->dirty = True;
 	}
     }
@@ -464,28 +770,121 @@ update_color_register(Graphic *graphic,
 
 #define SQUARE(X) ( (X) * (X) )
 
+static int
+color_grid_cell(int value)
+{
+    int result = value / COLOR_GRID_STEP;
+
+    if (value < 0)
+	result = 0;
+    else if (result >= COLOR_GRID_CELLS)
+	result = COLOR_GRID_CELLS - 1;
+    return result;
+}
+
+#define ColorGridIndex(r, g, b) \
+	(unsigned) (((r) * COLOR_GRID_CELLS + (g)) * COLOR_GRID_CELLS + (b))
+
+#define ColorGridOf(reg) \
+	ColorGridIndex(color_grid_cell((reg)->r), \
+		       color_grid_cell((reg)->g), \
+		       color_grid_cell((reg)->b))
+
+static void
+build_color_grid(ColorRegister const *color_registers)
+{
+    unsigned i;
+    unsigned cell;
+
+    memset(color_grid.first, 0, sizeof(color_grid.first));
+    for (i = 0U; i < MAX_COLOR_REGISTERS; i++) {
+	color_grid.first[ColorGridOf(&color_registers[i]) + 1]++;
+    }
+    for (cell = 0; cell < COLOR_GRID_TOTAL; cell++) {
+	color_grid.first[cell + 1] += color_grid.first[cell];
+    }
+    for (i = 0U; i < MAX_COLOR_REGISTERS; i++) {
+	cell = ColorGridOf(&color_registers[i]);
+	color_grid.members[color_grid.first[cell]++] = (RegisterNum) i;
+    }
+    /* the fill loop left each cell's offset at the start of the next one */
+    for (cell = COLOR_GRID_TOTAL; cell != 0; cell--) {
+	color_grid.first[cell] = color_grid.first[cell - 1];
+    }
+    color_grid.first[0] = 0;
+
+    color_grid.registers = color_registers;
+    color_grid.serial = color_serial;
+}
+
 RegisterNum
 find_color_register(ColorRegister const *color_registers, int r, int g, int b)
 {
-    unsigned i;
+    int const cr = color_grid_cell(r);
+    int const cg = color_grid_cell(g);
+    int const cb = color_grid_cell(b);
     unsigned closest_index;
     unsigned closest_distance;
+    int k;
 
     /* I have no idea what algorithm DEC used for this.
      * The documentation warns that it is unpredictable, especially with values
      * far away from any allocated color so it is probably a very simple
      * heuristic rather than something fancy like finding the minimum distance
      * in a linear perceptive color space.
+     *
+     * This finds the lowest-numbered register with the least weighted
+     * distance, searching the grid outward from the requested color's cell.
+     * A register k cells away differs by at least (k - 1) * COLOR_GRID_STEP + 1
+     * in some channel, which bounds its distance from below.
      */
+    if (color_grid.registers != color_registers
+	|| color_grid.serial != color_serial) {
+	build_color_grid(color_registers);
+    }
+
     closest_index = MAX_COLOR_REGISTERS;
     closest_distance = 0U;
-    for (i = 0U; i < MAX_COLOR_REGISTERS; i++) {
-	unsigned d = (unsigned) (SQUARE(2 * (color_registers[i].r - r)) +
-				 SQUARE(3 * (color_registers[i].g - g)) +
-				 SQUARE(1 * (color_registers[i].b - b)));
-	if (closest_index == MAX_COLOR_REGISTERS || d < closest_distance) {
-	    closest_index = i;
-	    closest_distance = d;
+    for (k = 0; k < COLOR_GRID_CELLS; k++) {
+	int ir, ig, ib;
+
+	if (closest_index != MAX_COLOR_REGISTERS && k > 0) {
+	    unsigned bound = (unsigned) ((k - 1) * COLOR_GRID_STEP + 1);
+	    if (bound * bound > closest_distance)
+		break;
+	}
+
+	for (ir = Max(cr - k, 0); ir <= Min(cr + k, COLOR_GRID_CELLS - 1); ir++) {
+	    for (ig = Max(cg - k, 0); ig <= Min(cg + k, COLOR_GRID_CELLS - 1); ig++) {
+		int step = 1;
+
+		/* inside the shell, only the two faces along blue are needed */
+		if (abs(ir - cr) != k && abs(ig - cg) != k)
+		    step = (k > 0) ? (2 * k) : 1;
+
+		for (ib = cb - k; ib <= cb + k; ib += step) {
+		    unsigned cell;
+		    unsigned n;
+
+		    if (ib < 0 || ib >= COLOR_GRID_CELLS)
+			continue;
+		    cell = ColorGridIndex(ir, ig, ib);
+		    for (n = color_grid.first[cell];
+			 n < color_grid.first[cell + 1];
+			 n++) {
+			unsigned i = color_grid.members[n];
+			unsigned d = (unsigned) (SQUARE(2 * (color_registers[i].r - r)) +
+						 SQUARE(3 * (color_registers[i].g - g)) +
+						 SQUARE(1 * (color_registers[i].b - b)));
+			if (closest_index == MAX_COLOR_REGISTERS
+			    || d < closest_distance
+			    || (d == closest_distance && i < closest_index)) {
+			    closest_index = i;
+			    closest_distance = d;
+			}
+		    }
+		}
+	    }
 	}
     }
 
@@ -510,6 +909,7 @@ copy_color_registers(Graphic *target, Graphic *source)
     memcpy(target->private_color_registers,
 	   source->color_registers,
 	   sizeof(ColorRegister) * MAX_COLOR_REGISTERS);
+    color_serial++;
 }
 #endif
 
@@ -522,6 +922,7 @@ init_color_registers(TScreen const *screen, ColorRegister *color_registers)
     memset(color_registers,
 	   0,
 	   sizeof(ColorRegister) * MAX_COLOR_REGISTERS);
+    color_serial++;
 
     /*
      * default color registers:
@@ -680,14 +1081,14 @@ init_graphic(TScreen *screen,
 	     unsigned num_color_registers)
 {
     int private_colors = screen->privatecolorregisters;
-    const unsigned max_pixels = (unsigned) (graphic->max_width *
-					    graphic->max_height);
 
-    TRACE(("init_graphic %u pixels at %d,%d\n", max_pixels, charrow, charcol));
+    TRACE(("init_graphic at %d,%d\n", charrow, charcol));
 
     graphic->hidden = False;
     graphic->dirty = True;
-    memset(graphic->pixels, COLOR_HOLE & 0xff, max_pixels * sizeof(RegisterNum));
+    drop_graphic_pixmap(graphic);
+    release_pixels(graphic);
+    TouchGraphic(graphic);
     memset(graphic->color_registers_used, False, sizeof(graphic->color_registers_used));
 
     /*
@@ -778,7 +1179,13 @@ get_new_graphic(XtermWidget xw, int charrow, int charcol, unsigned type)
 	}
     }
 
-    /* if none are free, recycle the graphic scrolled back the farthest */
+    /* if none are free, recycle the least-recently shown off-screen graphic */
+    if (!graphic && (graphic = least_recent_graphic(NULL, &ii)) != NULL) {
+	TRACE(("recycling off-screen graphic index %u as id %u\n",
+	       ii, next_graphic_id));
+    }
+
+    /* ...or the graphic scrolled back the farthest */
     if (!graphic) {
 	int min_charrow = 0;
 	Graphic *min_graphic = NULL;
@@ -851,8 +1258,7 @@ get_new_or_matching_graphic(XtermWidget xw,
 
     /* if no match get a new graphic */
     if ((graphic = get_new_graphic(xw, charrow, charcol, type)) != NULL) {
-	graphic->actual_width = actual_width;
-	graphic->actual_height = actual_height;
+	resize_graphic(graphic, actual_width, actual_height);
 	TRACE(("no match; created graphic at %d,%d %dx%d bufferid=%d type=%u\n",
 	       graphic->charrow, graphic->charcol,
 	       graphic->actual_width, graphic->actual_height,
@@ -946,7 +1352,7 @@ refresh_graphic(TScreen const *screen,
     int const graph_y = graphic->charrow * FontHeight(screen);
     int const graph_w = graphic->actual_width;
     int const graph_h = graphic->actual_height;
-    int const mw = graphic->max_width;
+    int const mw = graphic->pixels_wide;
 
     int r, c;
     int pmy;
@@ -1189,7 +1595,7 @@ dump_graphic(Graphic const *graphic)
     TRACE(("graphic pixels:\n"));
     for (r = 0; r < graphic->actual_height; r++) {
 	for (c = 0; c < graphic->actual_width; c++) {
-	    color = graphic->pixels[r * graphic->max_width + c];
+	    color = graphic->pixels[r * graphic->pixels_wide + c];
 	    if (color == COLOR_HOLE) {
 		TRACE(("?"));
 	    } else {
@@ -1230,6 +1636,7 @@ erase_graphic(Graphic *graphic, int x, int y, int w, int h)
 
     int r;
     int rbase = 0;
+    Boolean changed = False;
 
     TRACE(("erasing graphic %d,%d %dx%d\n", x, y, w, h));
 
@@ -1241,14 +1648,19 @@ erase_graphic(Graphic *graphic, int x, int y, int w, int h)
 	    for (c = 0; c < graphic->actual_width; c++) {
 		if (cbase >= c_min
 		    && cbase <= c_max) {
-		    const int cell = r * graphic->max_width + c;
-		    ClrSpixel(graphic, cell);
+		    const int cell = r * graphic->pixels_wide + c;
+		    if (graphic->pixels[cell] != COLOR_HOLE) {
+			ClrSpixel(graphic, cell);
+			changed = True;
+		    }
 		}
 		cbase += pw;
 	    }
 	}
 	rbase += ph;
     }
+    if (changed)
+	drop_graphic_pixmap(graphic);
 }
 
 static int
@@ -1403,6 +1815,78 @@ typedef struct {
     int y_max;
 } ClipLimits;
 
+/*
+ * Clip the area of a graphic to the part of the screen it may be shown on.
+ */
+static void
+visible_graphic_area(TScreen *screen,
+		     Graphic *graphic,
+		     int *draw_x,
+		     int *draw_y,
+		     int *draw_w,
+		     int *draw_h)
+{
+    int const scroll_y = screen->topline * FontHeight(screen);
+    int const area_w = Width(screen) * FontWidth(screen);
+
+    *draw_x = graphic->charcol * FontWidth(screen);
+    *draw_y = graphic->charrow * FontHeight(screen);
+    *draw_w = graphic->actual_width * graphic->pixw;
+    *draw_h = graphic->actual_height * graphic->pixh;
+
+    if (screen->whichBuf != 0) {
+	if (graphic->bufferid != 0) {
+	    /* clip to alt buffer */
+	    clip_area(draw_x, draw_y, draw_w, draw_h,
+		      0, 0, area_w, Height(screen) * FontHeight(screen));
+	} else {
+	    /* clip to scrollback area */
+	    clip_area(draw_x, draw_y, draw_w, draw_h,
+		      0, scroll_y, area_w, -scroll_y);
+	}
+    } else {
+	/* clip to scrollback + normal area */
+	clip_area(draw_x, draw_y, draw_w, draw_h,
+		  0, scroll_y,
+		  area_w, -scroll_y + Height(screen) * FontHeight(screen));
+    }
+}
+
+/*
+ * Check if any part of a graphic is in the window, i.e., not scrolled off.
+ * A graphic on the screen which is not shown, e.g., the normal screen while
+ * the alternate screen is shown, is checked against that screen's rows, as
+ * it will be in view when that screen is shown again.
+ */
+static Boolean
+graphic_in_view(Graphic *graphic)
+{
+    TScreen *screen;
+    int draw_x, draw_y, draw_w, draw_h;
+
+    if (graphic->xw == NULL || graphic->hidden)
+	return False;
+    screen = TScreenOf(graphic->xw);
+    visible_graphic_area(screen, graphic,
+			 &draw_x, &draw_y, &draw_w, &draw_h);
+    clip_area(&draw_x, &draw_y, &draw_w, &draw_h,
+	      0, screen->topline * FontHeight(screen),
+	      Width(screen) * FontWidth(screen),
+	      Height(screen) * FontHeight(screen));
+    if ((draw_w <= 0 || draw_h <= 0)
+	&& graphic->bufferid != screen->whichBuf) {
+	draw_x = graphic->charcol * FontWidth(screen);
+	draw_y = graphic->charrow * FontHeight(screen);
+	draw_w = graphic->actual_width * graphic->pixw;
+	draw_h = graphic->actual_height * graphic->pixh;
+	clip_area(&draw_x, &draw_y, &draw_w, &draw_h,
+		  0, 0,
+		  Width(screen) * FontWidth(screen),
+		  Height(screen) * FontHeight(screen));
+    }
+    return (draw_w > 0 && draw_h > 0);
+}
+
 static Boolean
 RefreshClipped(TScreen *screen,
 	       int leftcol,
@@ -1422,50 +1906,16 @@ RefreshClipped(TScreen *screen,
     ClipLimits my_limits;
     unsigned jj;
 
-    int const altarea_x = 0;
-    int const altarea_y = 0;
-    int const altarea_w = Width(screen) * FontWidth(screen);
-    int const altarea_h = Height(screen) * FontHeight(screen);
-
-    int const scrollarea_x = 0;
-    int const scrollarea_y = scroll_y;
-    int const scrollarea_w = Width(screen) * FontWidth(screen);
-    int const scrollarea_h = -scroll_y;
-
-    int const mainarea_x = 0;
-    int const mainarea_y = scroll_y;
-    int const mainarea_w = Width(screen) * FontWidth(screen);
-    int const mainarea_h = -scroll_y + Height(screen) * FontHeight(screen);
-
     my_limits.x_min = refresh_x + refresh_w;
     my_limits.x_max = refresh_x - 1;
     my_limits.y_min = refresh_y + refresh_h;
     my_limits.y_max = refresh_y - 1;
     for (jj = 0; jj < active_count; ++jj) {
 	Graphic *graphic = ordered_graphics[jj];
-	int draw_x = graphic->charcol * FontWidth(screen);
-	int draw_y = graphic->charrow * FontHeight(screen);
-	int draw_w = graphic->actual_width;
-	int draw_h = graphic->actual_height;
-
-	if (screen->whichBuf != 0) {
-	    if (graphic->bufferid != 0) {
-		/* clip to alt buffer */
-		clip_area(&draw_x, &draw_y, &draw_w, &draw_h,
-			  altarea_x, altarea_y, altarea_w, altarea_h);
-	    } else {
-		/* clip to scrollback area */
-		clip_area(&draw_x, &draw_y, &draw_w, &draw_h,
-			  scrollarea_x, scrollarea_y,
-			  scrollarea_w, scrollarea_h);
-	    }
-	} else {
-	    /* clip to scrollback + normal area */
-	    clip_area(&draw_x, &draw_y, &draw_w, &draw_h,
-		      mainarea_x, mainarea_y,
-		      mainarea_w, mainarea_h);
-	}
+	int draw_x, draw_y, draw_w, draw_h;
 
+	visible_graphic_area(screen, graphic,
+			     &draw_x, &draw_y, &draw_w, &draw_h);
 	clip_area(&draw_x, &draw_y, &draw_w, &draw_h,
 		  refresh_x, refresh_y, refresh_w, refresh_h);
 
@@ -1476,6 +1926,7 @@ RefreshClipped(TScreen *screen,
 	       draw_x, draw_y, draw_w, draw_h));
 
 	if (draw_w > 0 && draw_h > 0) {
+	    TouchGraphic(graphic);
 	    refresh_graphic(screen, graphic, buffer,
 			    refresh_x, refresh_y,
 			    refresh_w, refresh_h,
@@ -1490,6 +1941,8 @@ RefreshClipped(TScreen *screen,
 	    if (draw_y + draw_h - 1 > my_limits.y_max)
 		my_limits.y_max = draw_y + draw_h - 1;
 	}
+	if (graphic->dirty)
+	    drop_graphic_pixmap(graphic);
 	graphic->dirty = False;
     }
 
@@ -1541,6 +1994,235 @@ FindGraphicHoles(int refresh_x,
     return (non_holes != 0);
 }
 
+/*
+ * Store a pixel value in an image's byte order, for images whose pixels are
+ * a whole number of bytes.
+ */
+static void
+encode_pixel(XImage const *image, int bytes, Pixel pix, unsigned char *target)
+{
+    int n;
+
+    for (n = 0; n < bytes; ++n) {
+	int shift = 8 * ((image->byte_order == LSBFirst)
+			 ? n
+			 : (bytes - 1 - n));
+	target[n] = (unsigned char) (pix >> shift);
+    }
+}
+
+/*
+ * Render the whole graphic, scaled, into a pixmap on the server using a
+ * single XPutImage, so that refreshing it is a copy on the server.  If there
+ * are holes, a bitmap of the other pixels is kept to use as a clip-mask.
+ */
+static Boolean
+build_graphic_pixmap(XtermWidget xw, Graphic *graphic)
+{
+    static Pixel lookup[MAX_COLOR_REGISTERS];
+    static unsigned char encoded[MAX_COLOR_REGISTERS][sizeof(Pixel)];
+    static Boolean known[MAX_COLOR_REGISTERS];
+
+    TScreen *const screen = TScreenOf(xw);
+    Display *const display = screen->display;
+    Drawable const drawable = VDrawable(screen);
+    int const pw = graphic->pixw;
+    int const ph = graphic->pixh;
+    int const image_w = graphic->actual_width * pw;
+    int const image_h = graphic->actual_height * ph;
+    size_t const mask_line = (size_t) (image_w + 7) / 8;
+    XImage *image;
+    char *mask_bits;
+    size_t image_line;
+    Boolean holes = False;
+    int bytes;
+    int r, c, k;
+
+    drop_graphic_pixmap(graphic);
+    if (image_w <= 0 || image_h <= 0)
+	return False;
+
+    image = XCreateImage(display, xw->visInfo->visual,
+			 (unsigned) xw->visInfo->depth,
+			 ZPixmap, 0, NULL,
+			 (unsigned) image_w, (unsigned) image_h,
+			 (int) (sizeof(int) * 8U), 0);
+    if (!image) {
+	TRACE(("unable to allocate XImage for graphic %u\n", graphic->id));
+	return False;
+    }
+    image_line = (size_t) image->bytes_per_line;
+    image->data = TypeCallocN(char, image_line * (size_t) image_h);
+    mask_bits = TypeCallocN(char, mask_line * (size_t) image_h);
+    if (image->data == NULL || mask_bits == NULL) {
+	TRACE(("unable to allocate %dx%d image for graphic %u\n",
+	       image_w, image_h, graphic->id));
+	free(mask_bits);
+	XDestroyImage(image);
+	return False;
+    }
+
+    bytes = (((image->bits_per_pixel % 8) == 0
+	      && image->bits_per_pixel <= (int) (8 * sizeof(Pixel)))
+	     ? (image->bits_per_pixel / 8)
+	     : 0);
+    memset(known, 0, sizeof(known));
+
+    for (r = 0; r < graphic->actual_height; r++) {
+	RegisterNum const *source = graphic->pixels + (r * graphic->pixels_wide);
+	char *line = image->data + ((size_t) (r * ph) * image_line);
+	char *mask = mask_bits + ((size_t) (r * ph) * mask_line);
+
+	for (c = 0; c < graphic->actual_width; c++) {
+	    RegisterNum const regnum = source[c];
+	    int const x = c * pw;
+
+	    if (regnum == COLOR_HOLE) {
+		holes = True;
+		continue;
+	    }
+	    if (!known[regnum]) {
+		lookup[regnum] =
+		    color_register_to_xpixel(&graphic->color_registers[regnum],
+					     xw);
+		if (bytes)
+		    encode_pixel(image, bytes, lookup[regnum], encoded[regnum]);
+		known[regnum] = True;
+	    }
+	    for (k = x; k < x + pw; ++k) {
+		mask[k >> 3] = (char) (mask[k >> 3] | (1 << (k & 7)));
+		if (bytes) {
+		    memcpy(line + (k * bytes), encoded[regnum], (size_t) bytes);
+		} else {
+		    XPutPixel(image, k, r * ph, lookup[regnum]);
+		}
+	    }
+	}
+	for (k = 1; k < ph; ++k) {
+	    memcpy(line + ((size_t) k * image_line), line, image_line);
+	    memcpy(mask + ((size_t) k * mask_line), mask, mask_line);
+	}
+    }
+
+    graphic->pixmap = XCreatePixmap(display, drawable,
+				    (unsigned) image_w, (unsigned) image_h,
+				    (unsigned) xw->visInfo->depth);
+    if (graphic->pixmap != None) {
+	XPutImage(display, graphic->pixmap, graphics_gc, image,
+		  0, 0, 0, 0,
+		  (unsigned) image_w, (unsigned) image_h);
+	if (holes) {
+	    graphic->mask = XCreateBitmapFromData(display, drawable, mask_bits,
+						  (unsigned) image_w,
+						  (unsigned) image_h);
+	    if (graphic->mask == None)
+		drop_graphic_pixmap(graphic);
+	}
+    }
+    graphic->pixmap_w = image_w;
+    graphic->pixmap_h = image_h;
+
+    TRACE(("built %dx%d pixmap for graphic %u%s\n",
+	   image_w, image_h, graphic->id,
+	   holes ? " with mask" : ""));
+
+    free(mask_bits);
+    XDestroyImage(image);
+    return (graphic->pixmap != None);
+}
+
+#define PixmapIsCurrent(graphic) \
+	((graphic)->pixmap != None \
+	 && !(graphic)->dirty \
+	 && (graphic)->pixmap_w == (graphic)->actual_width * (graphic)->pixw \
+	 && (graphic)->pixmap_h == (graphic)->actual_height * (graphic)->pixh)
+
+/*
+ * Refresh the graphics by copying from their server-side pixmaps, building
+ * those as needed.  A graphic which is being modified while only part of it
+ * is refreshed (e.g., incremental sixel display) is not worth building; in
+ * that case, return false to use the pixel-by-pixel refresh.
+ */
+static Boolean
+RefreshCached(XtermWidget xw,
+	      int leftcol,
+	      int toprow,
+	      int ncols,
+	      int nrows,
+	      Graphic *ordered_graphics[MAX_GRAPHICS],
+	      unsigned active_count)
+{
+    TScreen *const screen = TScreenOf(xw);
+    Display *const display = screen->display;
+    Window const drawable = VDrawable(screen);
+    int const scroll_y = screen->topline * FontHeight(screen);
+    int const refresh_x = leftcol * FontWidth(screen);
+    int const refresh_y = toprow * FontHeight(screen) + scroll_y;
+    int const refresh_w = ncols * FontWidth(screen);
+    int const refresh_h = nrows * FontHeight(screen);
+    unsigned jj;
+
+    for (jj = 0; jj < active_count; ++jj) {
+	Graphic *graphic = ordered_graphics[jj];
+	int draw_x, draw_y, draw_w, draw_h;
+	int full_w, full_h;
+
+	if (PixmapIsCurrent(graphic))
+	    continue;
+
+	visible_graphic_area(screen, graphic,
+			     &draw_x, &draw_y, &draw_w, &draw_h);
+	full_w = draw_w;
+	full_h = draw_h;
+	clip_area(&draw_x, &draw_y, &draw_w, &draw_h,
+		  refresh_x, refresh_y, refresh_w, refresh_h);
+	if (draw_w <= 0 || draw_h <= 0)
+	    continue;
+	if (draw_w != full_w || draw_h != full_h)
+	    return False;
+	if (!build_graphic_pixmap(xw, graphic))
+	    return False;
+    }
+
+    for (jj = 0; jj < active_count; ++jj) {
+	Graphic *graphic = ordered_graphics[jj];
+	int const graph_x = graphic->charcol * FontWidth(screen);
+	int const graph_y = graphic->charrow * FontHeight(screen);
+	int draw_x, draw_y, draw_w, draw_h;
+
+	visible_graphic_area(screen, graphic,
+			     &draw_x, &draw_y, &draw_w, &draw_h);
+	clip_area(&draw_x, &draw_y, &draw_w, &draw_h,
+		  refresh_x, refresh_y, refresh_w, refresh_h);
+	if (draw_w <= 0 || draw_h <= 0 || graphic->pixmap == None) {
+	    if (graphic->dirty)
+		drop_graphic_pixmap(graphic);
+	    graphic->dirty = False;
+	    continue;
+	}
+
+	TouchGraphic(graphic);
+	if (graphic->mask != None) {
+	    XSetClipMask(display, graphics_gc, graphic->mask);
+	    XSetClipOrigin(display, graphics_gc,
+			   OriginX(screen) + graph_x,
+			   (OriginY(screen) - scroll_y) + graph_y);
+	}
+	XCopyArea(display, graphic->pixmap, drawable, graphics_gc,
+		  draw_x - graph_x, draw_y - graph_y,
+		  (unsigned) draw_w, (unsigned) draw_h,
+		  OriginX(screen) + draw_x,
+		  (OriginY(screen) - scroll_y) + draw_y);
+	if (graphic->mask != None) {
+	    XSetClipMask(display, graphics_gc, None);
+	}
+	graphic->dirty = False;
+    }
+
+    XFlush(display);
+    return True;
+}
+
 /* the coordinates are relative to the screen */
 static void
 refresh_graphics(XtermWidget xw,
@@ -1587,6 +2269,10 @@ refresh_graphics(XtermWidget xw,
     if (valid_graphics < 0)
 	return;
 
+    if (RefreshCached(xw, leftcol, toprow, ncols, nrows,
+		      ordered_graphics, active_count))
+	return;
+
     if ((buffer = AllocGraphicsBuffer(screen, ncols, nrows)) == NULL)
 	return;
 
@@ -1874,7 +2560,12 @@ reset_displayed_graphics(TScreen const *screen)
     if (used_graphics) {
 	unsigned ii;
 
-	TRACE(("resetting all graphics\n"));
+	TRACE(("resetting all graphics: %lu bytes used, %lu pooled, %lu allocations, %lu reuses, %lu evictions\n",
+	       graphics_stats.bytes_used,
+	       graphics_stats.bytes_pooled,
+	       graphics_stats.allocations,
+	       graphics_stats.reuses,
+	       graphics_stats.evictions));
 	FOR_EACH_SLOT(ii) {
 	    deactivateSlot(ii);
 	}
@@ -1893,6 +2584,9 @@ noleaks_graphics(Display *dpy)
     FOR_EACH_SLOT(ii) {
 	deactivateSlot(ii);
     }
+    while (pool_trim()) {
+	/* EMPTY */ ;
+    }
     if (valid_graphics > 0)
 	XFreeGC(dpy, graphics_gc);
 }
@@ -70,6 +70,8 @@ typedef struct {
     XtermWidget xw;
     int max_width;              /* largest image which can be stored */
     int max_height;             /* largest image which can be stored */
+    int pixels_wide;            /* allocated size of pixels, its stride */
+    int pixels_high;            /* allocated size of pixels */
     unsigned valid_registers;   /* for wrap-around behavior */
     int actual_width;           /* size of image before scaling */
     int actual_height;          /* size of image before scaling */
@@ -81,13 +83,30 @@ typedef struct {
     int bufferid;               /* which screen buffer the graphic is associated with */
     unsigned type;              /* type of graphic 0==sixel, 1...NUM_REGIS_PAGES==ReGIS page */
     unsigned id;                /* sequential id used for preserving layering */
+    unsigned long last_used;    /* when last created or shown, for eviction */
+    Pixmap pixmap;              /* server-side copy of the scaled image */
+    Pixmap mask;                /* its non-hole pixels, if there are holes */
+    int pixmap_w;               /* size of the server-side copy */
+    int pixmap_h;               /* size of the server-side copy */
     Boolean valid;              /* if the graphic has been initialized */
     Boolean dirty;              /* if the graphic needs to be redrawn */
     Boolean hidden;             /* if the graphic should not be displayed */
 } Graphic;
 
+typedef struct {
+    unsigned long bytes_used;   /* pixel buffers held by graphics */
+    unsigned long bytes_pooled; /* pixel buffers kept for reuse */
+    unsigned long bytes_limit;  /* maxGraphicMemory, or zero */
+    unsigned long allocations;  /* pixel buffers allocated */
+    unsigned long reuses;       /* pixel buffers taken from the pool */
+    unsigned long evictions;    /* off-screen graphics discarded */
+} GraphicsStats;
+
 extern Graphic *get_new_graphic(XtermWidget /* xw */, int /* charrow */, int /* charcol */, unsigned /* type */);
 extern Graphic *get_new_or_matching_graphic(XtermWidget /* xw */, int /* charrow */, int /* charcol */, int /* actual_width */, int /* actual_height */, unsigned /* type */);
+extern Boolean reserve_graphic(Graphic */* graphic */, int /* width */, int /* height */);
+extern void resize_graphic(Graphic */* graphic */, int /* actual_width */, int /* actual_height */);
+extern void get_graphics_stats(TScreen const */* screen */, GraphicsStats */* stats */);
 extern RegisterNum read_pixel(Graphic */* graphic */, int /* x */, int /* y */);
 extern void draw_solid_pixel(Graphic */* graphic */, int /* x */, int /* y */, unsigned /* color */);
 extern void draw_solid_rectangle(Graphic */* graphic */, int /* x1 */, int /* y1 */, int /* x2 */, int /* y2 */, unsigned /* color */);
@@ -113,6 +132,9 @@ extern void noleaks_graphics(Display */* dpy */);
 
 #define get_new_graphic(xw, charrow, charcol, type) /* nothing */
 #define get_new_or_matching_graphic(xw, charrow, charcol, actual_width, actual_height, type) /* nothing */
+#define reserve_graphic(graphic, width, height) /* nothing */
+#define resize_graphic(graphic, actual_width, actual_height) /* nothing */
+#define get_graphics_stats(screen, stats) /* nothing */
 #define read_pixel(graphic, x, y) /* nothing */
 #define draw_solid_pixel(graphic, x, y, color) /* nothing */
 #define draw_solid_rectangle(graphic, x1, y1, x2, y2, color) /* nothing */
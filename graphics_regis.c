@@ -310,12 +310,21 @@ isqrt(double d)
     return (int) dl;
 }
 
-static void
-draw_regis_pixel(RegisGraphicsContext *context, int x, int y,
-		 unsigned value)
+/*
+ * How a pattern bit is written:  not at all, as a color, or by complementing
+ * the existing pixel.
+ */
+#define REGIS_WRITE_NONE       0
+#define REGIS_WRITE_COLOR      1
+#define REGIS_WRITE_COMPLEMENT 2
+
+static int
+regis_write_color(RegisGraphicsContext const *context, unsigned value,
+		  unsigned *color)
 {
-    unsigned color = 0;
+    int result = REGIS_WRITE_COLOR;
 
+    *color = 0;
     switch (context->temporary_write_controls.write_style) {
     case WRITE_STYLE_OVERLAY:
 	/*
@@ -323,13 +332,11 @@ draw_regis_pixel(RegisGraphicsContext *context, int x, int y,
 	 * don't change when pattern is 0.
 	 */
 	if (!value) {
-	    return;
-	}
-
-	if (context->temporary_write_controls.invert_pattern) {
-	    color = context->background;
+	    result = REGIS_WRITE_NONE;
+	} else if (context->temporary_write_controls.invert_pattern) {
+	    *color = context->background;
 	} else {
-	    color = context->temporary_write_controls.foreground;
+	    *color = context->temporary_write_controls.foreground;
 	}
 	break;
 
@@ -348,7 +355,7 @@ draw_regis_pixel(RegisGraphicsContext *context, int x, int y,
 		fg = context->temporary_write_controls.foreground;
 		bg = context->background;
 	    }
-	    color = value ? fg : bg;
+	    *color = value ? fg : bg;
 	}
 	break;
 
@@ -357,25 +364,37 @@ draw_regis_pixel(RegisGraphicsContext *context, int x, int y,
 	 * Update pixels with background when pattern is 1,
 	 * don't change when pattern is 0.
 	 */
-	if (!value) {
-	    return;
-	}
-
-	color = READ_PIXEL(context, x, y);
-	if (color == COLOR_HOLE)
-	    color = context->background;
-	color = color ^ context->all_planes;
+	result = (value
+		  ? REGIS_WRITE_COMPLEMENT
+		  : REGIS_WRITE_NONE);
 	break;
 
     case WRITE_STYLE_ERASE:
 	/* Update pixels to foreground. */
 	if (context->temporary_write_controls.invert_pattern) {
-	    color = context->temporary_write_controls.foreground;
+	    *color = context->temporary_write_controls.foreground;
 	} else {
-	    color = context->background;
+	    *color = context->background;
 	}
 	break;
     }
+    return result;
+}
+
+/*
+ * Combine the color to be written with the existing pixel, if the write
+ * depends on it.
+ */
+static unsigned
+merge_regis_color(RegisGraphicsContext *context, int x, int y,
+		  int how, unsigned color)
+{
+    if (how == REGIS_WRITE_COMPLEMENT) {
+	color = READ_PIXEL(context, x, y);
+	if (color == COLOR_HOLE)
+	    color = context->background;
+	color = color ^ context->all_planes;
+    }
 
     if (context->temporary_write_controls.plane_mask != context->all_planes) {
 	unsigned old_color = READ_PIXEL(context, x, y);
@@ -384,8 +403,67 @@ draw_regis_pixel(RegisGraphicsContext *context, int x, int y,
 	color = (color & context->temporary_write_controls.plane_mask) |
 	    (old_color & ~context->temporary_write_controls.plane_mask);
     }
+    return color;
+}
 
-    DRAW_PIXEL(context, x, y, color);
+static void
+draw_regis_pixel(RegisGraphicsContext *context, int x, int y,
+		 unsigned value)
+{
+    unsigned color;
+    int how = regis_write_color(context, value, &color);
+
+    if (how != REGIS_WRITE_NONE) {
+	DRAW_PIXEL(context, x, y, merge_regis_color(context, x, y, how, color));
+    }
+}
+
+/*
+ * Limit a horizontal span to the destination graphic, returning false if
+ * nothing is left.
+ */
+static Boolean
+clip_regis_span(RegisGraphicsContext const *context, int *x1, int *x2, int y)
+{
+    Graphic const *graphic = context->destination_graphic;
+
+    if (*x1 > *x2) {
+	int tmp;
+	EXCHANGE(*x1, *x2, tmp);
+    }
+    if (y < 0 || y >= graphic->actual_height)
+	return False;
+    if (*x1 < 0)
+	*x1 = 0;
+    if (*x2 >= graphic->actual_width)
+	*x2 = graphic->actual_width - 1;
+    return (*x1 <= *x2);
+}
+
+/*
+ * Draw a horizontal span of pixels which all have the same pattern value.
+ * Unless the write depends on the existing pixels, this is a single color.
+ */
+static void
+draw_regis_span(RegisGraphicsContext *context, int x1, int x2, int y,
+		unsigned value)
+{
+    unsigned color;
+    int how = regis_write_color(context, value, &color);
+    int x;
+
+    if (how == REGIS_WRITE_NONE || !clip_regis_span(context, &x1, &x2, y))
+	return;
+
+    if (how == REGIS_WRITE_COLOR &&
+	context->temporary_write_controls.plane_mask == context->all_planes) {
+	draw_solid_rectangle(context->destination_graphic, x1, y, x2, y, color);
+	return;
+    }
+
+    for (x = x1; x <= x2; x++) {
+	DRAW_PIXEL(context, x, y, merge_regis_color(context, x, y, how, color));
+    }
 }
 
 static void
@@ -395,15 +473,10 @@ shade_pattern_to_pixel(RegisGraphicsContext *context, unsigned dim, int ref,
     unsigned value;
 
     if (dim == WRITE_SHADING_REF_X) {
-	int delta = x > ref ? 1 : -1;
-	int curr_x;
-
 	context->pattern_bit = 1U << (((unsigned) y) & 7U);
-	for (curr_x = ref; curr_x != x + delta; curr_x += delta) {
-	    value = context->temporary_write_controls.pattern &
-		context->pattern_bit;
-	    draw_regis_pixel(context, curr_x, y, value);
-	}
+	value = context->temporary_write_controls.pattern &
+	    context->pattern_bit;
+	draw_regis_span(context, ref, x, y, value);
     } else if (dim == WRITE_SHADING_REF_Y) {
 	int delta = y > ref ? 1 : -1;
 	int curr_y;
@@ -443,42 +516,60 @@ get_shade_character_pixel(Char const *pixels, unsigned w, unsigned h,
     return 0U;
 }
 
-static void
-shade_char_to_pixel(RegisGraphicsContext *context, Char const *pixels,
-		    unsigned w, unsigned h, unsigned dim, int ref, int x, int y)
+static unsigned
+get_shade_character_scale(RegisGraphicsContext const *context,
+			  unsigned w, unsigned h, unsigned *smaxf)
 {
     unsigned xmaxf = context->current_text_controls->character_unit_cell_w;
     unsigned ymaxf = context->current_text_controls->character_unit_cell_h;
-    unsigned smaxf;
     unsigned s;
-    unsigned scale;
-    unsigned value;
 
     if (xmaxf > ymaxf) {
-	smaxf = ymaxf;
+	*smaxf = ymaxf;
 	s = h;
     } else {
-	smaxf = xmaxf;
+	*smaxf = xmaxf;
 	s = w;
     }
-    scale = (s << SCALE_FIXED_POINT) / smaxf;
+    return (s << SCALE_FIXED_POINT) / *smaxf;
+}
 
-    if (dim == WRITE_SHADING_REF_X) {
-	int delta = x > ref ? 1 : -1;
-	int curr_x;
+/*
+ * Shade a horizontal span with the tiled character.
+ */
+static void
+shade_char_span(RegisGraphicsContext *context, Char const *pixels,
+		unsigned w, unsigned h, int x1, int x2, int y)
+{
+    unsigned smaxf;
+    unsigned scale = get_shade_character_scale(context, w, h, &smaxf);
+    int x;
 
-	for (curr_x = ref; curr_x != x + delta; curr_x += delta) {
-	    value = get_shade_character_pixel(pixels, w, h, smaxf, scale, 0,
-					      curr_x, y);
-	    draw_regis_pixel(context, curr_x, y, value);
-	}
+    if (!clip_regis_span(context, &x1, &x2, y))
+	return;
+
+    for (x = x1; x <= x2; x++) {
+	draw_regis_pixel(context, x, y,
+			 get_shade_character_pixel(pixels, w, h, smaxf,
+						   scale, 0, x, y));
+    }
+}
+
+static void
+shade_char_to_pixel(RegisGraphicsContext *context, Char const *pixels,
+		    unsigned w, unsigned h, unsigned dim, int ref, int x, int y)
+{
+    if (dim == WRITE_SHADING_REF_X) {
+	shade_char_span(context, pixels, w, h, ref, x, y);
     } else if (dim == WRITE_SHADING_REF_Y) {
+	unsigned smaxf;
+	unsigned scale = get_shade_character_scale(context, w, h, &smaxf);
 	int delta = y > ref ? 1 : -1;
 	int curr_y;
 
 	for (curr_y = ref; curr_y != y + delta; curr_y += delta) {
-	    value = get_shade_character_pixel(pixels, w, h, smaxf, scale, 0, x,
-					      curr_y);
+	    unsigned value = get_shade_character_pixel(pixels, w, h, smaxf,
+						       scale, 0, x, curr_y);
 	    draw_regis_pixel(context, x, curr_y, value);
 	}
     } else {
@@ -486,21 +577,47 @@ shade_char_to_pixel(RegisGraphicsContext *context, Char const *pixels,
     }
 }
 
+/*
+ * Step the line pattern over the given number of pixels.
+ */
 static void
-draw_patterned_pixel(RegisGraphicsContext *context, int x, int y)
+advance_pattern(RegisGraphicsContext *context, int count)
 {
-    if (context->pattern_count >=
-	context->temporary_write_controls.pattern_multiplier) {
-	context->pattern_count = 0U;
-	context->pattern_bit = ROT_LEFT(context->pattern_bit);
+    while (count-- > 0) {
+	if (context->pattern_count >=
+	    context->temporary_write_controls.pattern_multiplier) {
+	    context->pattern_count = 0U;
+	    context->pattern_bit = ROT_LEFT(context->pattern_bit);
+	}
+	context->pattern_count++;
     }
-    context->pattern_count++;
+}
 
+static void
+draw_patterned_pixel(RegisGraphicsContext *context, int x, int y)
+{
+    advance_pattern(context, 1);
     draw_regis_pixel(context, x, y,
 		     context->temporary_write_controls.pattern &
 		     context->pattern_bit);
 }
 
+/*
+ * With a solid pattern, each pixel of a line is written the same way, so a
+ * run of pixels on one row can be written as a span.
+ */
+#define SolidPattern(context) \
+	(!(context)->fill_mode && \
+	 !(context)->temporary_write_controls.shading_enabled && \
+	 ((context)->temporary_write_controls.pattern & 0xffU) == 0xffU)
+
+static void
+draw_patterned_span(RegisGraphicsContext *context, int x1, int x2, int y)
+{
+    advance_pattern(context, x2 - x1 + 1);
+    draw_regis_span(context, x1, x2, y, 1U);
+}
+
 static void
 shade_to_pixel(RegisGraphicsContext *context, unsigned dim, int ref,
 	       int x, int y)
@@ -570,64 +687,85 @@ sort_points(void const *l, void const *r)
     return 0;
 }
 
+/*
+ * Draw one span of a filled polygon, with the pattern chosen by the row (as
+ * for X-axis shading), or if a character bitmap is given, tiling that.
+ */
 static void
-draw_shaded_polygon(RegisGraphicsContext *context)
+fill_regis_span(RegisGraphicsContext *context, Char const *pixels,
+		unsigned w, unsigned h, int x1, int x2, int y)
 {
+    if (pixels != NULL) {
+	shade_char_span(context, pixels, w, h, x1, x2, y);
+    } else {
+	shade_pattern_to_pixel(context, WRITE_SHADING_REF_X, x1, x2, y);
+    }
+}
+
+/*
+ * Fill the polygon whose outline pixels were saved in fill mode.  Sorted by
+ * row, the outline gives the spans of each row:  starting inside, a gap
+ * between outline pixels toggles inside/outside.  The spans of a row are
+ * merged, so that each pixel is written once, and drawn a span at a time.
+ *
+ * FIXME: This is using pixels to represent lines which loses information
+ * about exact slope and how many lines are present which causes misbehavior
+ * with some inputs (especially complex polygons).  The pixels are not saved
+ * in the order of the path (line and curve endpoints may be swapped), so
+ * they cannot simply be used as the polygon's vertices.
+ */
+static void
+fill_regis_polygon(RegisGraphicsContext *context, Char const *pixels,
+		   unsigned w, unsigned h)
+{
+    RegisPoint const *const points = context->fill_points;
+    unsigned const count = context->fill_point_count;
     unsigned p;
     int old_x, old_y;
     int inside;
-    Char pixels[MAX_GLYPH_PIXELS];
-    unsigned w = 1, h = 1;
-
-    char ch = context->temporary_write_controls.shading_character;
-    unsigned xmaxf = context->current_text_controls->character_unit_cell_w;
-    unsigned ymaxf = context->current_text_controls->character_unit_cell_h;
-
-    get_bitmap_of_character(context, ch, xmaxf, ymaxf, pixels, &w, &h,
-			    MAX_GLYPH_PIXELS);
-    if (w < 1U || h < 1U) {
-	return;
-    }
+    int span_x1 = 0, span_x2 = 0;
+    Boolean have_span = False;
 
-    qsort(context->fill_points, (size_t) context->fill_point_count,
+    qsort(context->fill_points, (size_t) count,
 	  sizeof(context->fill_points[0]), sort_points);
 
+#define AddFillSpan(x1, x2) \
+    do { \
+	if (have_span && (x1) <= span_x2 + 1) { \
+	    if ((x2) > span_x2) \
+		span_x2 = (x2); \
+	} else { \
+	    if (have_span) \
+		fill_regis_span(context, pixels, w, h, span_x1, span_x2, old_y); \
+	    span_x1 = (x1); \
+	    span_x2 = (x2); \
+	    have_span = True; \
+	} \
+    } while (0)
+
     old_x = DUMMY_STACK_X;
     old_y = DUMMY_STACK_Y;
     inside = 0;
-    for (p = 0U; p < context->fill_point_count; p++) {
-	int new_x = context->fill_points[p].x;
-	int new_y = context->fill_points[p].y;
+    for (p = 0U; p <= count; p++) {
+	int new_x = (p < count) ? points[p].x : DUMMY_STACK_X;
+	int new_y = (p < count) ? points[p].y : DUMMY_STACK_Y;
 
-	/*
-	 * FIXME: This is using pixels to represent lines which loses
-	 * information about exact slope and how many lines are present which
-	 * causes misbehavior with some inputs (especially complex polygons).
-	 * It also takes more room than remembering vertices, but I'd rather
-	 * not have to implement line segments for arcs.  Maybe store a count
-	 * at each vertex instead (doesn't fix the slope problem).
-	 */
-	/*
-	 * FIXME: Change this to only draw inside of polygons, and round
-	 * points in a uniform direction to avoid overlapping drawing.  As an
-	 * option we could continue to support drawing the outline.
-	 */
-	if (new_y != old_y) {
+	if (p == count || new_y != old_y) {
 	    if (inside) {
 		/*
 		 * Just draw the vertical line when there is not a matching
 		 * edge on the right side.
 		 */
-		shade_char_to_pixel(context, pixels, w, h,
-				    WRITE_SHADING_REF_X,
-				    old_x, old_x, old_y);
+		AddFillSpan(old_x, old_x);
+	    }
+	    if (have_span) {
+		fill_regis_span(context, pixels, w, h, span_x1, span_x2, old_y);
+		have_span = False;
 	    }
 	    inside = 1;
 	} else {
 	    if (inside) {
-		shade_char_to_pixel(context, pixels, w, h,
-				    WRITE_SHADING_REF_X,
-				    old_x, new_x, new_y);
+		AddFillSpan(old_x, new_x);
 	    }
 	    if (new_x > old_x + 1) {
 		inside = !inside;
@@ -637,65 +775,34 @@ draw_shaded_polygon(RegisGraphicsContext *context)
 	old_x = new_x;
 	old_y = new_y;
     }
+#undef AddFillSpan
 
     context->destination_graphic->dirty = True;
 }
 
 static void
-draw_filled_polygon(RegisGraphicsContext *context)
+draw_shaded_polygon(RegisGraphicsContext *context)
 {
-    unsigned p;
-    int old_x, old_y;
-    int inside;
-
-    qsort(context->fill_points, (size_t) context->fill_point_count,
-	  sizeof(context->fill_points[0]), sort_points);
-
-    old_x = DUMMY_STACK_X;
-    old_y = DUMMY_STACK_Y;
-    inside = 0;
-    for (p = 0U; p < context->fill_point_count; p++) {
-	int new_x = context->fill_points[p].x;
-	int new_y = context->fill_points[p].y;
+    Char pixels[MAX_GLYPH_PIXELS];
+    unsigned w = 1, h = 1;
 
-	/*
-	 * FIXME: This is using pixels to represent lines which loses
-	 * information about exact slope and how many lines are present which
-	 * causes misbehavior with some inputs (especially complex polygons).
-	 * It also takes more room than remembering vertices, but I'd rather
-	 * not have to implement line segments for arcs.  Maybe store a count
-	 * at each vertex instead (doesn't fix the slope problem).
-	 */
-	/*
-	 * FIXME: Change this to only draw inside of polygons, and round
-	 * points in a uniform direction to avoid overlapping drawing.  As an
-	 * option we could continue to support drawing the outline.
-	 */
-	if (new_y != old_y) {
-	    if (inside) {
-		/*
-		 * Just draw the vertical line when there is not a matching
-		 * edge on the right side.
-		 */
-		shade_pattern_to_pixel(context, WRITE_SHADING_REF_X,
-				       old_x, old_x, old_y);
-	    }
-	    inside = 1;
-	} else {
-	    if (inside) {
-		shade_pattern_to_pixel(context, WRITE_SHADING_REF_X,
-				       old_x, new_x, new_y);
-	    }
-	    if (new_x > old_x + 1) {
-		inside = !inside;
-	    }
-	}
+    char ch = context->temporary_write_controls.shading_character;
+    unsigned xmaxf = context->current_text_controls->character_unit_cell_w;
+    unsigned ymaxf = context->current_text_controls->character_unit_cell_h;
 
-	old_x = new_x;
-	old_y = new_y;
+    get_bitmap_of_character(context, ch, xmaxf, ymaxf, pixels, &w, &h,
+			    MAX_GLYPH_PIXELS);
+    if (w < 1U || h < 1U) {
+	return;
     }
 
-    context->destination_graphic->dirty = True;
+    fill_regis_polygon(context, pixels, w, h);
+}
+
+static void
+draw_filled_polygon(RegisGraphicsContext *context)
+{
+    fill_regis_polygon(context, NULL, 0U, 0U);
 }
 
 static void
@@ -710,6 +817,9 @@ draw_patterned_line(RegisGraphicsContext *context, int x1, int y1,
     dy = abs(y1 - y2);
 
     if (dx > dy) {
+	Boolean solid = SolidPattern(context);
+	int run_x;
+
 	if (x1 > x2) {
 	    int tmp;
 	    EXCHANGE(x1, x2, tmp);
@@ -724,14 +834,22 @@ draw_patterned_line(RegisGraphicsContext *context, int x1, int y1,
 
 	diff = 0;
 	y = y1;
+	run_x = x1;
 	for (x = x1; x <= x2; x++) {
 	    if (diff >= dx) {
 		diff -= dx;
+		if (solid && x > run_x) {
+		    draw_patterned_span(context, run_x, x - 1, y);
+		    run_x = x;
+		}
 		y += dir;
 	    }
 	    diff += dy;
-	    draw_or_save_patterned_pixel(context, x, y);
+	    if (!solid)
+		draw_or_save_patterned_pixel(context, x, y);
 	}
+	if (solid)
+	    draw_patterned_span(context, run_x, x2, y);
     } else {
 	if (y1 > y2) {
 	    int tmp;
@@ -6022,8 +6140,7 @@ parse_regis_option(RegisParseState *state, RegisGraphicsContext *context)
 		    context->y_div = lry - uly;
 		    context->width = width;
 		    context->height = height;
-		    context->destination_graphic->actual_width = width;
-		    context->destination_graphic->actual_height = height;
+		    resize_graphic(context->destination_graphic, width, height);
 		    context->destination_graphic->dirty = True;
 
 		    TRACE(("conversion factors: off=%+d,%+d div=%+d,%+d width=%d, height=%d\n",
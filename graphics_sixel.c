@@ -142,7 +142,7 @@ init_sixel_background(Graphic *graphic, SixelContext const *context)
     target = source;
     length = (size_t) graphic->actual_width * sizeof(*target);
     for (r = 1; r < graphic->actual_height; r++) {
-	target += graphic->max_width;
+	target += graphic->pixels_wide;
 	memcpy(target, source, length);
     }
     graphic->color_registers_used[context->background] = True;
@@ -152,20 +152,28 @@ init_sixel_background(Graphic *graphic, SixelContext const *context)
 	((context)->col >= 0 && \
 	 (context)->col < (graphic)->max_width)
 
-static Boolean
-set_sixel(Graphic *graphic, SixelContext const *context, int sixel)
+/*
+ * Draw a sixel repeated over "count" columns, as a span on each of the six
+ * rows of the band.  Returns the number of columns drawn, which is less than
+ * the count if the band runs past the right edge.  If it runs past the
+ * bottom, only the first column is drawn (as far as it fits), and zero is
+ * returned to stop the caller.
+ */
+static int
+set_sixels(Graphic *graphic, SixelContext const *context, int sixel, int count)
 {
     const int mh = graphic->max_height;
     const int mw = graphic->max_width;
     const RegisterNum color = context->current_register;
+    const int col = context->col;
+    int rows = Min(6, mh - context->row);
     int pix;
-    int pix_row = context->row;
-    int pix_col = context->col + (pix_row * mw);
 
-    TRACE2(("drawing sixel at pos=%d,%d color=%hu (hole=%d, [%d,%d,%d])\n",
+    TRACE2(("drawing sixel at pos=%d,%d color=%hu count=%d (hole=%d, [%d,%d,%d])\n",
 	    context->col,
 	    context->row,
 	    color,
+	    count,
 	    color == COLOR_HOLE,
 	    ((color != COLOR_HOLE)
 	     ? (unsigned) graphic->color_registers[color].r : 0U),
@@ -173,24 +181,41 @@ set_sixel(Graphic *graphic, SixelContext const *context, int sixel)
 	     ? (unsigned) graphic->color_registers[color].g : 0U),
 	    ((color != COLOR_HOLE)
 	     ? (unsigned) graphic->color_registers[color].b : 0U)));
-    for (pix = 0; pix < 6; pix++, pix_row++, pix_col += mw) {
-	if (pix_row >= 0 &&
-	    pix_row < mh) {
-	    if (sixel & (1 << pix)) {
-		if (context->col >= graphic->actual_width) {
-		    graphic->actual_width = context->col + 1;
-		}
-		if (pix_row >= graphic->actual_height) {
-		    graphic->actual_height = pix_row + 1;
-		}
-		SetSpixel(graphic, pix_col, color);
+
+    if (count > mw - col)
+	count = mw - col;
+    if (context->row < 0)
+	rows = 0;
+    if (rows < 6) {
+	TRACE(("sixel pixel %d out of bounds\n", Max(rows, 0)));
+	count = Min(count, 1);
+    }
+    if (count > 0
+	&& (sixel & ((1 << Max(rows, 0)) - 1)) != 0
+	&& !reserve_graphic(graphic, col + count, context->row + rows)) {
+	return 0;
+    }
+
+    for (pix = 0; pix < rows && count > 0; pix++) {
+	if (sixel & (1 << pix)) {
+	    const int pix_row = context->row + pix;
+	    RegisterNum *target = (graphic->pixels
+				   + (pix_row * graphic->pixels_wide)
+				   + col);
+	    int n;
+
+	    for (n = 0; n < count; ++n) {
+		target[n] = color;
+	    }
+	    if (col + count > graphic->actual_width) {
+		graphic->actual_width = col + count;
+	    }
+	    if (pix_row >= graphic->actual_height) {
+		graphic->actual_height = pix_row + 1;
 	    }
-	} else {
-	    TRACE(("sixel pixel %d out of bounds\n", pix));
-	    return False;
 	}
     }
-    return True;
+    return (rows < 6) ? 0 : Max(count, 0);
 }
 
 static void
@@ -571,14 +596,9 @@ parse_sixel_char(char cp)
 		s_graphic->valid = True;
 	    }
 	    if (sixel) {
-		int i;
-		for (i = 0; i < s_accumulator; i++) {
-		    if (ValidColumn(s_graphic, &s_context) &&
-			set_sixel(s_graphic, &s_context, sixel)) {
-			s_context.col++;
-		    } else {
-			break;
-		    }
+		if (ValidColumn(s_graphic, &s_context)) {
+		    s_context.col += set_sixels(s_graphic, &s_context,
+						sixel, s_accumulator);
 		}
 	    } else {
 		s_context.col += s_accumulator;
@@ -669,12 +689,9 @@ parse_sixel_char(char cp)
 	s_raster_state = s_NOTRASTER;
 
 	/* FIXME: Declared size should clear & scroll rectangle when no raster attributes */
-	if (s_context.declared_width > s_graphic->actual_width) {
-	    s_graphic->actual_width = s_context.declared_width;
-	}
-	if (s_context.declared_height > s_graphic->actual_height) {
-	    s_graphic->actual_height = s_context.declared_height;
-	}
+	resize_graphic(s_graphic,
+		       Max(s_context.declared_width, s_graphic->actual_width),
+		       Max(s_context.declared_height, s_graphic->actual_height));
 
 	/* FALLTHRU TO PROCESS cp */
     }
@@ -822,7 +839,7 @@ parse_sixel_char(char cp)
 	}
 	if (sixel) {
 	    if (!ValidColumn(s_graphic, &s_context) ||
-		!set_sixel(s_graphic, &s_context, sixel)) {
+		!set_sixels(s_graphic, &s_context, sixel, 1)) {
 		return;
 	    }
 	}
@@ -886,6 +903,67 @@ parse_sixel_char(char cp)
     }
 }
 
+#define IsSixel(cp) ((cp) >= 0x3f && (cp) <= 0x7e)
+
+/*
+ * Decode a run of sixel data at once.  Sixels and repeated sixels, which are
+ * nearly all of an image, are drawn here; anything else goes through
+ * parse_sixel_char(), as do incremental displays.
+ */
+void
+parse_sixel_chars(const char *data, size_t len)
+{
+    const char *last = data + len;
+
+    while (data < last) {
+	const char *next = data + 1;
+	int cp = CharOf(*data);
+	int count = 1;
+
+	if (s_screen->incremental_graphics
+	    || s_repeating
+	    || s_color_state != s_NOTCOLORING
+	    || s_raster_state != s_NOTRASTER) {
+	    parse_sixel_char(*data++);
+	    continue;
+	}
+
+	if (cp == '!') {
+	    /* handle a repeat here only if it is complete in the buffer */
+	    count = 0;
+	    while (next < last && isdigit(CharOf(*next))) {
+		if (count < MaxSParm)
+		    count = (count * 10) + (*next - '0');
+		++next;
+	    }
+	    if (next == last || !IsSixel(CharOf(*next))) {
+		parse_sixel_char(*data++);
+		continue;
+	    }
+	    cp = CharOf(*next++);
+	    TRACE(("sixel repeat operator: sixel=%d (%c), count=%d\n",
+		   cp - 0x3f, (char) cp, count));
+	    if (count <= 0)
+		count = 1;
+	    s_accumulator = -1;
+	} else if (!IsSixel(cp)) {
+	    parse_sixel_char(*data++);
+	    continue;
+	}
+	data = next;
+
+	if (!s_graphic->valid) {
+	    init_sixel_background(s_graphic, &s_context);
+	    s_graphic->valid = True;
+	}
+	if (cp == 0x3f) {
+	    s_context.col += count;
+	} else if (ValidColumn(s_graphic, &s_context)) {
+	    s_context.col += set_sixels(s_graphic, &s_context, cp - 0x3f, count);
+	}
+    }
+}
+
 /* Just like finished_parsing, but called from charproc.c */
 void
 parse_sixel_finished(void)
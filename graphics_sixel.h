@@ -40,6 +40,7 @@
 #if OPT_SIXEL_GRAPHICS
 extern void parse_sixel_init(XtermWidget /* xw */, ANSI * /* params */);
 extern void parse_sixel_char(char /* cp */);
+extern void parse_sixel_chars(const char * /* data */, size_t /* len */);
 extern void parse_sixel_finished(void);
 #endif
 
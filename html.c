@@ -32,6 +32,7 @@
 
 #include <xterm.h>
 #include <version.h>
+#include <xstrings.h>
 
 #define MakeDim(color) \
 	color = (unsigned short) ((2 * (unsigned) color) / 3)
@@ -41,26 +42,370 @@
 	((double)c.green / 655.35), \
 	((double)c.blue  / 655.35)
 
+#define DUMP_BUFSIZE (1024 * 1024)
+
 static void dumpHtmlHeader(XtermWidget xw, FILE *fp);
 static void dumpHtmlScreen(XtermWidget xw, FILE *fp);
 static void dumpHtmlLine(XtermWidget xw, int row, FILE *fp);
 static void dumpHtmlFooter(XtermWidget, FILE *fp);
 static void writeStyle(XtermWidget, FILE *fp);
 
+static int first_row;
+static int last_row;
+
+/*
+ * The colors used in a dump are collected into a table before writing it, so
+ * that the stylesheet can give each one a class, rather than repeating the
+ * color in every element.
+ */
+typedef struct {
+    unsigned short red, green, blue;
+} DumpRGB;
+
+static DumpRGB *dump_colors;
+static int dump_count;
+static int dump_limit;
+static int *dump_hash;		/* indices+1 into dump_colors, 0 if unused */
+static unsigned dump_hash_size;
+static Boolean dump_failed;	/* a color could not be added to the table */
+
+#define DumpHashOf(c) \
+	((((unsigned) (c).red * 31u) ^ ((unsigned) (c).green * 17u) ^ (unsigned) (c).blue) * 2654435761u)
+
+/* QueryOneColor may ask the server, so remember the last few answers */
+#define PIXEL_CACHE 64
+static XColor pixel_cache[PIXEL_CACHE];
+static Boolean pixel_valid[PIXEL_CACHE];
+
+static char *dump_buffer;
+
+/*
+ * Return the index of the given color in the table, adding it if needed, or
+ * -1 if there is no memory to add it.
+ */
+static int
+dumpColorIndex(XColor *c)
+{
+    unsigned n;
+
+    if ((unsigned) dump_count * 2 >= dump_hash_size) {
+	unsigned size = dump_hash_size ? dump_hash_size * 2 : 256;
+	int *hash = TypeCallocN(int, size);
+	int k;
+
+	if (hash == NULL) {
+	    dump_failed = True;
+	    return -1;
+	}
+	free(dump_hash);
+	dump_hash = hash;
+	dump_hash_size = size;
+	for (k = 0; k < dump_count; ++k) {
+	    n = DumpHashOf(dump_colors[k]) & (size - 1);
+	    while (dump_hash[n] != 0)
+		n = (n + 1) & (size - 1);
+	    dump_hash[n] = k + 1;
+	}
+    }
+
+    n = DumpHashOf(*c) & (dump_hash_size - 1);
+    while (dump_hash[n] != 0) {
+	DumpRGB *p = &dump_colors[dump_hash[n] - 1];
+	if (p->red == c->red && p->green == c->green && p->blue == c->blue)
+	    return dump_hash[n] - 1;
+	n = (n + 1) & (dump_hash_size - 1);
+    }
+
+    if (dump_count >= dump_limit) {
+	int limit = dump_limit ? dump_limit * 2 : 64;
+	DumpRGB *grown = TypeRealloc(DumpRGB, (size_t) limit, dump_colors);
+
+	if (grown == NULL) {
+	    dump_failed = True;
+	    return -1;
+	}
+	dump_colors = grown;
+	dump_limit = limit;
+    }
+    dump_colors[dump_count].red = c->red;
+    dump_colors[dump_count].green = c->green;
+    dump_colors[dump_count].blue = c->blue;
+    dump_hash[n] = ++dump_count;
+    return dump_count - 1;
+}
+
+static void
+cachedColor(XtermWidget xw, XColor *c)
+{
+    unsigned n = (unsigned) (c->pixel % PIXEL_CACHE);
+
+    if (pixel_valid[n] && pixel_cache[n].pixel == c->pixel) {
+	*c = pixel_cache[n];
+    } else {
+	(void) QueryOneColor(xw, c);
+	pixel_cache[n] = *c;
+	pixel_valid[n] = True;
+    }
+}
+
+/*
+ * Return the index of a pixel's color in the table.
+ */
+int
+xtermDumpPixelColor(XtermWidget xw, Pixel p)
+{
+    XColor c;
+
+    c.pixel = p;
+    cachedColor(xw, &c);
+    return dumpColorIndex(&c);
+}
+
+/*
+ * Compute the colors and attributes with which a cell is shown.
+ */
+void
+xtermDumpStyle(XtermWidget xw, LineData *ld, int col, DumpStyle *style)
+{
+    TScreen *s = TScreenOf(xw);
+    IAttr attribs = ld->attribs[col];
+    XColor fgcolor, bgcolor;
+
+    fgcolor.pixel = xw->old_foreground;
+    bgcolor.pixel = xw->old_background;
+#if OPT_ISO_COLORS
+    if (attribs & FG_COLOR) {
+	Pixel fg = extract_fg(xw, ld->color[col], attribs);
+#if OPT_DIRECT_COLOR
+	if (attribs & ATR_DIRECT_FG)
+	    fgcolor.pixel = fg;
+	else
+#endif
+	    fgcolor.pixel = s->Acolors[fg].value;
+    }
+    if (attribs & BG_COLOR) {
+	Pixel bg = extract_bg(xw, ld->color[col], attribs);
+#if OPT_DIRECT_COLOR
+	if (attribs & ATR_DIRECT_BG)
+	    bgcolor.pixel = bg;
+	else
+#endif
+	    bgcolor.pixel = s->Acolors[bg].value;
+    }
+#else
+    (void) s;
+#endif
+
+    cachedColor(xw, &fgcolor);
+    cachedColor(xw, &bgcolor);
+
+    if (attribs & BLINK) {
+	/* White on red. */
+	fgcolor.red = fgcolor.green = fgcolor.blue = MAX_U_COLOR;
+	bgcolor.red = MAX_U_COLOR;
+	bgcolor.green = bgcolor.blue = 0u;
+    }
+#if OPT_WIDE_ATTRS
+    if (attribs & ATR_FAINT) {
+	MakeDim(fgcolor.red);
+	MakeDim(fgcolor.green);
+	MakeDim(fgcolor.blue);
+    }
+#endif
+    if (attribs & INVERSE) {
+	XColor tmp = fgcolor;
+	fgcolor = bgcolor;
+	bgcolor = tmp;
+    }
+
+    style->flags = (unsigned) (attribs & (BOLD | UNDERLINE));
+#if OPT_WIDE_ATTRS
+    style->flags |= (unsigned) (attribs & (ATR_ITALIC
+					   | ATR_STRIKEOUT
+					   | ATR_DBL_UNDER));
+#endif
+    style->fg = dumpColorIndex(&fgcolor);
+    style->bg = dumpColorIndex(&bgcolor);
+}
+
+/*
+ * Return true if the cell has the same colors and attributes as the one
+ * before it, so that the style need not be recomputed.
+ */
+Boolean
+xtermDumpSameCell(LineData *ld, int col)
+{
+#if OPT_ISO_COLORS
+    if (!isSameCColor(ld->color[col], ld->color[col - 1]))
+	return False;
+#endif
+    return (ld->attribs[col] == ld->attribs[col - 1]);
+}
+
+/*
+ * Collect the colors used by a range of rows, returning false if they could
+ * not all be added to the table.
+ */
+Boolean
+xtermDumpColors(XtermWidget xw, int first, int last)
+{
+    TScreen *s = TScreenOf(xw);
+    int row;
+
+    memset(pixel_valid, 0, sizeof(pixel_valid));
+    dump_count = 0;
+    dump_failed = False;
+    if (dump_hash != NULL)
+	memset(dump_hash, 0, sizeof(int) * dump_hash_size);
+
+    for (row = first; row <= last; ++row) {
+	LineData *ld = getLineData(s, row);
+	DumpStyle style;
+	int col;
+
+	if (ld == NULL)
+	    continue;
+	for (col = 0; col < MaxCols(s); ++col) {
+	    if (col == 0 || !xtermDumpSameCell(ld, col))
+		xtermDumpStyle(xw, ld, col, &style);
+	}
+	if (dump_failed)
+	    break;
+	if ((row & 63) == 0)
+	    xevents(xw);
+    }
+    TRACE(("xtermDumpColors %d..%d: %d colors%s\n", first, last, dump_count,
+	   dump_failed ? " (out of memory)" : ""));
+    return !dump_failed;
+}
+
+/*
+ * Return the color for the given index, as a CSS rgb() value.
+ */
+char *
+xtermDumpCSSColor(int color)
+{
+    static char rgb[sizeof "rgb(100.00%, 100.00%, 100.00%)"];
+    DumpRGB c = dump_colors[color];
+
+    sprintf(rgb, "rgb(%.2f%%, %.2f%%, %.2f%%)", RGBPCT(c));
+    return rgb;
+}
+
+int
+xtermDumpColorCount(void)
+{
+    return dump_count;
+}
+
+#ifdef NO_LEAKS
+void
+noleaks_html(void)
+{
+    FreeAndNull(dump_colors);
+    dump_count = 0;
+    dump_limit = 0;
+    FreeAndNull(dump_hash);
+    dump_hash_size = 0;
+}
+#endif
+
+/*
+ * Limit the range of rows to those which exist.  Rows are numbered from the
+ * top of the screen (ignoring any scrolling back), with negative numbers for
+ * the saved lines.
+ */
 void
-xtermDumpHtml(XtermWidget xw)
+xtermDumpLimits(XtermWidget xw, int *first, int *last)
+{
+    TScreen *s = TScreenOf(xw);
+    int lowest = s->whichBuf ? 0 : -s->savedlines;
+
+    if (*first < lowest)
+	*first = lowest;
+    if (*last > s->max_row)
+	*last = s->max_row;
+}
+
+/*
+ * Parse the parameters of the dump actions:  none for the screen, "all" for
+ * the saved lines as well, or a pair of row numbers.
+ */
+Boolean
+xtermDumpRange(XtermWidget xw, String *params, Cardinal count, int *first, int *last)
+{
+    TScreen *s = TScreenOf(xw);
+    Boolean result = True;
+
+    if (count == 0) {
+	*first = ROW2INX(s, s->top_marg);
+	*last = ROW2INX(s, s->bot_marg);
+    } else if (count == 1 && !x_strcasecmp(params[0], "all")) {
+	*first = -s->savedlines;
+	*last = s->max_row;
+    } else if (count == 2) {
+	char *next;
+
+	*first = (int) strtol(params[0], &next, 10);
+	if (next == params[0] || *next != '\0')
+	    result = False;
+	*last = (int) strtol(params[1], &next, 10);
+	if (next == params[1] || *next != '\0')
+	    result = False;
+    } else {
+	result = False;
+    }
+    if (result) {
+	xtermDumpLimits(xw, first, last);
+	result = (*first <= *last);
+    }
+    return result;
+}
+
+/*
+ * Open a dump file, with a buffer large enough that writing many thousands
+ * of rows does not make many thousands of system calls.
+ */
+FILE *
+xtermOpenDump(XtermWidget xw, const char *suffix)
+{
+    FILE *fp = create_printfile(xw, suffix);
+
+    if (fp != NULL
+	&& dump_buffer == NULL
+	&& (dump_buffer = malloc((size_t) DUMP_BUFSIZE)) != NULL) {
+	if (setvbuf(fp, dump_buffer, _IOFBF, (size_t) DUMP_BUFSIZE) != 0)
+	    FreeAndNull(dump_buffer);
+    }
+    return fp;
+}
+
+void
+xtermCloseDump(FILE *fp)
+{
+    fclose(fp);
+    FreeAndNull(dump_buffer);
+}
+
+void
+xtermDumpHtml(XtermWidget xw, int first, int last)
 {
     char *saveLocale;
     FILE *fp;
 
-    TRACE(("xtermDumpHtml...\n"));
+    TRACE(("xtermDumpHtml %d..%d\n", first, last));
+    xtermDumpLimits(xw, &first, &last);
+    if (first > last)
+	return;
+    first_row = first;
+    last_row = last;
     saveLocale = xtermSetLocale(LC_NUMERIC, "C");
-    fp = create_printfile(xw, ".xhtml");
-    if (fp != NULL) {
+    if (xtermDumpColors(xw, first, last)
+	&& (fp = xtermOpenDump(xw, ".xhtml")) != NULL) {
 	dumpHtmlHeader(xw, fp);
 	dumpHtmlScreen(xw, fp);
 	dumpHtmlFooter(xw, fp);
-	fclose(fp);
+	xtermCloseDump(fp);
     }
     xtermResetLocale(LC_NUMERIC, saveLocale);
     TRACE(("...xtermDumpHtml done\n"));
@@ -90,6 +435,7 @@ static void
 writeStyle(XtermWidget xw, FILE *fp)
 {
     TScreen *s = TScreenOf(xw);
+    int n;
 
     fputs("  <style type='text/css'>\n", fp);
     fputs("  body, pre { margin: 0 }\n", fp);
@@ -106,6 +452,10 @@ writeStyle(XtermWidget xw, FILE *fp)
     fputs("  .it { font-style: italic }\n", fp);
     fputs("  .st { text-decoration: line-through }\n", fp);
     fputs("  .lu { text-decoration: line-through underline }\n", fp);
+    for (n = 0; n < xtermDumpColorCount(); ++n) {
+	fprintf(fp, "  .f%d { color: %s }\n", n, xtermDumpCSSColor(n));
+	fprintf(fp, "  .b%d { background: %s }\n", n, xtermDumpCSSColor(n));
+    }
     fputs("  </style>\n", fp);
     xevents(xw);
 }
@@ -113,11 +463,12 @@ writeStyle(XtermWidget xw, FILE *fp)
 static void
 dumpHtmlScreen(XtermWidget xw, FILE *fp)
 {
-    TScreen *s = TScreenOf(xw);
     int row;
 
-    for (row = s->top_marg; row <= s->bot_marg; ++row) {
+    for (row = first_row; row <= last_row; ++row) {
 	dumpHtmlLine(xw, row, fp);
+	if ((row & 63) == 0)
+	    xevents(xw);
     }
 }
 
@@ -131,115 +482,65 @@ dumpHtmlScreen(XtermWidget xw, FILE *fp)
  *           [contains(concat(' ', @class, ' '), ' ul ')]
  *       The ev and od (for even and odd rows) values
  *       avoid empty values when going back to old fg/bg.
+ *
+ *       Each span covers a run of cells which look the same, even if
+ *       their attributes differ in ways which are not shown.
  */
 static void
 dumpHtmlLine(XtermWidget xw, int row, FILE *fp)
 {
     TScreen *s = TScreenOf(xw);
-    char attrs[2][sizeof
-		  "<span class=' ev ul bd it st du ' style='color: rgb(100.00%, 100.00%, 100.00%); background: rgb(100.00%, 100.00%, 100.00%)'>"];
-    int attr_index = 0;
-    char *attr = &attrs[attr_index][0];
-    int inx = ROW2INX(s, row);
-    LineData *ld = getLineData(s, inx);
+    LineData *ld = getLineData(s, row);
+    DumpStyle style;
+    DumpStyle shown;
     int col;
 
     if (ld == NULL)
 	return;
 
+    memset(&style, 0, sizeof(style));
+    memset(&shown, 0, sizeof(shown));
     for (col = 0; col < MaxCols(s); col++) {
-	XColor fgcolor, bgcolor;
 	IChar chr = ld->charData[col];
-	int slen = 0;
 
-	fgcolor.pixel = xw->old_foreground;
-	bgcolor.pixel = xw->old_background;
-#if OPT_ISO_COLORS
-	if (ld->attribs[col] & FG_COLOR) {
-	    Pixel fg = extract_fg(xw, ld->color[col], ld->attribs[col]);
-#if OPT_DIRECT_COLOR
-	    if (ld->attribs[col] & ATR_DIRECT_FG)
-		fgcolor.pixel = fg;
-	    else
-#endif
-		fgcolor.pixel = s->Acolors[fg].value;
-	}
-	if (ld->attribs[col] & BG_COLOR) {
-	    Pixel bg = extract_bg(xw, ld->color[col], ld->attribs[col]);
-#if OPT_DIRECT_COLOR
-	    if (ld->attribs[col] & ATR_DIRECT_BG)
-		bgcolor.pixel = bg;
-	    else
-#endif
-		bgcolor.pixel = s->Acolors[bg].value;
-	}
-#endif
+	if (col == 0 || !xtermDumpSameCell(ld, col))
+	    xtermDumpStyle(xw, ld, col, &style);
 
-	(void) QueryOneColor(xw, &fgcolor);
-	(void) QueryOneColor(xw, &bgcolor);
-	xevents(xw);
+	if (col == 0
+	    || style.flags != shown.flags
+	    || style.fg != shown.fg
+	    || style.bg != shown.bg) {
+	    if (col != 0)
+		fputs("</span>", fp);
+	    shown = style;
 
-	if (ld->attribs[col] & BLINK) {
-	    /* White on red. */
-	    fgcolor.red = fgcolor.green = fgcolor.blue = MAX_U_COLOR;
-	    bgcolor.red = MAX_U_COLOR;
-	    bgcolor.green = bgcolor.blue = 0u;
-	}
+	    fprintf(fp, "<span class=' %s", (INX2ROW(s, row) & 1) ? "ev" : "od");
+	    if (style.flags & BOLD)
+		fputs(" bd", fp);
 #if OPT_WIDE_ATTRS
-	if (ld->attribs[col] & ATR_FAINT) {
-	    MakeDim(fgcolor.red);
-	    MakeDim(fgcolor.green);
-	    MakeDim(fgcolor.blue);
-	}
-#endif
-	if (ld->attribs[col] & INVERSE) {
-	    XColor tmp = fgcolor;
-	    fgcolor = bgcolor;
-	    bgcolor = tmp;
-	}
+	    /*
+	     * Handle multiple text-decoration properties.
+	     * Treat ATR_DBL_UNDER the same as UNDERLINE since there is no
+	     * official proper CSS 2.2 way to use double underlining. (E.g.
+	     * using border-bottom does not work for successive lines and
+	     * "text-decoration: underline double" is a browser extension).
+	     */
+	    if ((style.flags & (UNDERLINE | ATR_DBL_UNDER)) &&
+		(style.flags & ATR_STRIKEOUT))
+		fputs(" lu", fp);
+	    else if (style.flags & (UNDERLINE | ATR_DBL_UNDER))
+		fputs(" ul", fp);
+	    else if (style.flags & ATR_STRIKEOUT)
+		fputs(" st", fp);
 
-	slen = sprintf(attr + slen, "<span class=' %s",
-		       ((row % 2) ? "ev" : "od"));
-	if (ld->attribs[col] & BOLD)
-	    slen += sprintf(attr + slen, " bd");
-#if OPT_WIDE_ATTRS
-	/*
-	 * Handle multiple text-decoration properties.
-	 * Treat ATR_DBL_UNDER the same as UNDERLINE since there is no
-	 * official proper CSS 2.2 way to use double underlining. (E.g.
-	 * using border-bottom does not work for successive lines and
-	 * "text-decoration: underline double" is a browser extension).
-	 */
-	if ((ld->attribs[col] & (UNDERLINE | ATR_DBL_UNDER)) &&
-	    (ld->attribs[col] & ATR_STRIKEOUT))
-	    slen += sprintf(attr + slen, " lu");
-	else if (ld->attribs[col] & (UNDERLINE | ATR_DBL_UNDER))
-	    slen += sprintf(attr + slen, " ul");
-	else if (ld->attribs[col] & ATR_STRIKEOUT)
-	    slen += sprintf(attr + slen, " st");
-
-	if (ld->attribs[col] & ATR_ITALIC)
-	    slen += sprintf(attr + slen, " it");
+	    if (style.flags & ATR_ITALIC)
+		fputs(" it", fp);
 #else
-	if (ld->attribs[col] & UNDERLINE)
-	    slen += sprintf(attr + slen, " ul");
+	    if (style.flags & UNDERLINE)
+		fputs(" ul", fp);
 #endif
-	slen += sprintf(attr + slen,
-			" ' style='color: rgb(%.2f%%, %.2f%%, %.2f%%);",
-			RGBPCT(fgcolor));
-	(void) sprintf(attr + slen,
-		       " background: rgb(%.2f%%, %.2f%%, %.2f%%)'>", RGBPCT(bgcolor));
-	if (col == 0) {
-	    fputs(attr, fp);
-	    attr = &attrs[attr_index ^= 1][0];
-	} else {
-	    if (strcmp(&attrs[0][0], &attrs[1][0])) {
-		fputs("</span>", fp);
-		fputs(attr, fp);
-		attr = &attrs[attr_index ^= 1][0];
-	    }
+	    fprintf(fp, " f%d b%d '>", style.fg, style.bg);
 	}
-
 #if OPT_WIDE_CHARS
 	if (chr > 127) {
 	    /* Ignore hidden characters. */
@@ -269,10 +570,8 @@ dumpHtmlLine(XtermWidget xw, int row, FILE *fp)
 	    default:
 		fputc((int) chr, fp);
 	    }
-	xevents(xw);
     }
-    fprintf(fp, "</span>\n");
-    xevents(xw);
+    fputs("</span>\n", fp);
 }
 
 static void
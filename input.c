@@ -1044,7 +1044,7 @@ Input(XtermWidget xw,
     }
     
     /* Call key press hook - if it handles the event, return early */
-    if (lua_xterm_is_enabled()) {
+    if (lua_xterm_has_hook(LUA_HOOK_KEY_PRESS)) {
         if (lua_xterm_call_hook(LUA_HOOK_KEY_PRESS, (int)kd.keysym, (int)evt_state)) {
             return;
         }
@@ -42,16 +42,68 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#define USE_INOTIFY 1
+#endif
+
 LuaContext *lua_ctx = NULL;
 
 static void lua_xterm_sandbox(lua_State *L);
 static int lua_xterm_panic(lua_State *L);
 static void lua_xterm_draw_command_line(void);
 static void lua_xterm_setup_trex_paths(lua_State *L);
+static void lua_xterm_watch_searchers(lua_State *L);
+static void lua_xterm_start_watching(void);
+static void lua_xterm_stop_watching(void);
+static void lua_xterm_forget_modules(void);
+static void lua_xterm_reload_modules(void);
+
+/*
+ * Create a Lua state with the standard libraries, trex's search paths and
+ * the xterm libraries.
+ */
+static lua_State *
+lua_xterm_new_state(void)
+{
+    lua_State *L = luaL_newstate();
+
+    if (L == NULL) {
+        return NULL;
+    }
+
+    /* Set panic function */
+    lua_atpanic(L, lua_xterm_panic);
+
+    /* Open standard libraries */
+    luaL_openlibs(L);
+
+    /* Set up trex runtime paths before sandbox */
+    lua_xterm_setup_trex_paths(L);
+    lua_xterm_cache_searchers(L);
+    lua_xterm_watch_searchers(L);
+
+    /* Apply sandbox restrictions */
+    lua_xterm_sandbox(L);
+
+    /* Register xterm-specific libraries */
+    luaopen_xterm_terminal(L);
+    luaopen_xterm_config(L);
+    luaopen_xterm_menu(L);
+    luaopen_xterm_events(L);
+    luaopen_xterm_utils(L);
+    luaopen_xterm_hooks(L);
+    luaopen_xterm_screen(L);
+    luaopen_xterm_search(L);
+
+    return L;
+}
 
 int
 lua_xterm_init(void)
 {
+    struct timeval started, finished;
+
     if (lua_ctx != NULL) {
         return 1; /* Already initialized */
     }
@@ -62,37 +114,11 @@ lua_xterm_init(void)
         return 0;
     }
 
-    lua_ctx->L = luaL_newstate();
-    if (lua_ctx->L == NULL) {
-        lua_xterm_error("Failed to create Lua state");
-        free(lua_ctx);
-        lua_ctx = NULL;
-        return 0;
-    }
-
-    /* Set panic function */
-    lua_atpanic(lua_ctx->L, lua_xterm_panic);
-
-    /* Open standard libraries */
-    luaL_openlibs(lua_ctx->L);
-
-    /* Set up trex runtime paths before sandbox */
-    lua_xterm_setup_trex_paths(lua_ctx->L);
-    
-    /* Apply sandbox restrictions */
-    lua_xterm_sandbox(lua_ctx->L);
-
-    /* Register xterm-specific libraries */
-    luaopen_xterm_terminal(lua_ctx->L);
-    luaopen_xterm_config(lua_ctx->L);
-    luaopen_xterm_menu(lua_ctx->L);
-    luaopen_xterm_events(lua_ctx->L);
-    luaopen_xterm_utils(lua_ctx->L);
-    luaopen_xterm_hooks(lua_ctx->L);
+    X_GETTIMEOFDAY(&started);
 
     /* Set default values */
     lua_ctx->enabled = True;
-    lua_ctx->debug = False;
+    lua_ctx->debug = (getenv("TREX_LUA_DEBUG") != NULL);
     lua_ctx->script_dir = x_strdup(LUA_SCRIPT_DIR_DEFAULT);
     lua_ctx->init_script = x_strdup(LUA_INIT_SCRIPT);
     lua_ctx->error_count = 0;
@@ -102,11 +128,28 @@ lua_xterm_init(void)
     lua_ctx->command_buffer = NULL;
     lua_ctx->command_length = 0;
     lua_ctx->command_capacity = 0;
+    lua_ctx->modules = NULL;
+    lua_ctx->loading = NULL;
+    lua_ctx->watch_fd = -1;
 
     lua_xterm_debug("Lua scripting initialized");
 
-    /* Load initial script if it exists */
+    /* Watch the modules which are loaded from here on */
+    lua_xterm_start_watching();
+
+    /* Create the Lua state and load initial script if it exists */
     lua_xterm_reload_scripts();
+    if (lua_ctx->L == NULL) {
+        lua_xterm_cleanup();
+        return 0;
+    }
+
+    X_GETTIMEOFDAY(&finished);
+    lua_xterm_debug("Startup took %.3f msecs (bytecode cache: %u hits, %u misses)",
+                    ((double) (finished.tv_sec - started.tv_sec) * 1000.0)
+                    + ((double) (finished.tv_usec - started.tv_usec) / 1000.0),
+                    lua_xterm_cache_hits(),
+                    lua_xterm_cache_misses());
 
     return 1;
 }
@@ -114,12 +157,16 @@ lua_xterm_init(void)
 void
 lua_xterm_cleanup(void)
 {
-    if (lua_ctx == NULL || !lua_ctx->initialized) {
+    if (lua_ctx == NULL) {
         return;
     }
 
     lua_xterm_debug("Cleaning up Lua scripting");
 
+    lua_xterm_stop_watching();
+    lua_xterm_clear_hooks();
+    lua_xterm_forget_modules();
+
     if (lua_ctx->L) {
         lua_close(lua_ctx->L);
         lua_ctx->L = NULL;
@@ -178,7 +225,7 @@ lua_xterm_load_script(const char *filename)
     }
 
     /* Load and execute script */
-    result = luaL_loadfile(lua_ctx->L, script_path);
+    result = lua_xterm_cache_loadfile(lua_ctx->L, script_path);
     if (result != LUA_OK) {
         lua_xterm_error("Failed to load script %s: %s", 
                        script_path, lua_tostring(lua_ctx->L, -1));
@@ -214,34 +261,23 @@ lua_xterm_reload_scripts(void)
     /* Clear existing hooks */
     lua_xterm_clear_hooks();
 
+    /* Every module is loaded again into the new state */
+    lua_xterm_forget_modules();
+
     /* Reset Lua state */
-    lua_close(lua_ctx->L);
-    lua_ctx->L = luaL_newstate();
+    if (lua_ctx->L != NULL) {
+        lua_close(lua_ctx->L);
+    }
+    lua_ctx->L = lua_xterm_new_state();
     if (lua_ctx->L == NULL) {
-        lua_xterm_error("Failed to recreate Lua state");
+        lua_xterm_error("Failed to create Lua state");
         return 0;
     }
 
-    lua_atpanic(lua_ctx->L, lua_xterm_panic);
-    luaL_openlibs(lua_ctx->L);
-    
-    /* Set up trex runtime paths before sandbox */
-    lua_xterm_setup_trex_paths(lua_ctx->L);
-    
-    lua_xterm_sandbox(lua_ctx->L);
-
-    /* Re-register libraries */
-    luaopen_xterm_terminal(lua_ctx->L);
-    luaopen_xterm_config(lua_ctx->L);
-    luaopen_xterm_menu(lua_ctx->L);
-    luaopen_xterm_events(lua_ctx->L);
-    luaopen_xterm_utils(lua_ctx->L);
-    luaopen_xterm_hooks(lua_ctx->L);
-
     /* Load trex_init module using standard require */
     lua_getglobal(lua_ctx->L, "require");
     if (lua_isfunction(lua_ctx->L, -1)) {
-        lua_pushstring(lua_ctx->L, "trex_init");
+        lua_pushstring(lua_ctx->L, LUA_INIT_MODULE);
         result = lua_xterm_safe_call(lua_ctx->L, 1, 0);
         if (result != LUA_OK) {
             lua_xterm_error("Failed to load trex_init module: %s", lua_tostring(lua_ctx->L, -1));
@@ -482,31 +518,385 @@ lua_xterm_process_events(void)
     lua_xterm_check_reload();
 }
 
+/*
+ * Without inotify, look for modules whose modification time has changed.
+ * With it, changes are reported as they happen and there is nothing to do.
+ */
 void
 lua_xterm_check_reload(void)
 {
-    static time_t last_check = 0;
-    time_t now = time(NULL);
-    char *init_path;
+    LuaModule *module;
     struct stat st;
+    Boolean changed = False;
 
-    /* Check only once per second */
-    if (now - last_check < 1) {
+    if (!lua_xterm_is_enabled() || lua_ctx->watch_fd >= 0) {
         return;
     }
-    last_check = now;
 
-    if (!lua_xterm_is_enabled()) {
+    for (module = lua_ctx->modules; module != NULL; module = module->next) {
+        if (stat(module->path, &st) == 0 && st.st_mtime != module->mtime) {
+            lua_xterm_debug("Module %s changed", module->name);
+            module->dirty = True;
+            changed = True;
+        }
+    }
+
+    if (changed) {
+        lua_xterm_reload_modules();
+    }
+}
+
+/* Module tracking and reloading */
+
+static LuaModule *
+lua_xterm_find_module(const char *name)
+{
+    LuaModule *module;
+
+    for (module = lua_ctx->modules; module != NULL; module = module->next) {
+        if (strcmp(module->name, name) == 0) {
+            break;
+        }
+    }
+    return module;
+}
+
+static void
+lua_xterm_watch_module(LuaModule *module)
+{
+#ifdef USE_INOTIFY
+    char *dir;
+    char *slash;
+
+    if (lua_ctx->watch_fd < 0) {
         return;
     }
 
-    init_path = lua_xterm_get_script_path(lua_ctx->init_script);
-    if (init_path != NULL && stat(init_path, &st) == 0) {
-        if (st.st_mtime > lua_ctx->last_reload) {
+    /*
+     * Watch the directory rather than the file: editors which save by
+     * renaming a new file into place would leave a file watch behind.
+     */
+    dir = x_strdup(module->path);
+    if (dir == NULL) {
+        return;
+    }
+    slash = strrchr(dir, '/');
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else if (slash == dir) {
+        slash[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+
+    module->wd = inotify_add_watch(lua_ctx->watch_fd, dir,
+                                   IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (module->wd < 0) {
+        lua_xterm_debug("Cannot watch %s: %s", dir, strerror(errno));
+    }
+    free(dir);
+#else
+    (void) module;
+#endif
+}
+
+/*
+ * Record a module found by one of the package searchers, or update the
+ * record if it is being loaded again.
+ */
+static LuaModule *
+lua_xterm_add_module(const char *name, const char *path)
+{
+    LuaModule *module;
+    struct stat st;
+
+    module = lua_xterm_find_module(name);
+    if (module == NULL) {
+        module = (LuaModule *) calloc(1, sizeof(LuaModule));
+        if (module == NULL) {
+            return NULL;
+        }
+        module->name = x_strdup(name);
+        module->wd = -1;
+        module->next = lua_ctx->modules;
+        lua_ctx->modules = module;
+    }
+
+    if (module->path == NULL || strcmp(module->path, path) != 0) {
+        free(module->path);
+        module->path = x_strdup(path);
+        lua_xterm_watch_module(module);
+    }
+    module->mtime = (stat(path, &st) == 0) ? st.st_mtime : 0;
+    module->dirty = False;
+
+    lua_xterm_debug("Tracking module %s from %s", name, path);
+    return module;
+}
+
+static void
+lua_xterm_forget_modules(void)
+{
+    LuaModule *module, *next;
+
+    for (module = lua_ctx->modules; module != NULL; module = next) {
+        next = module->next;
+        free(module->name);
+        free(module->path);
+        free(module);
+    }
+    lua_ctx->modules = NULL;
+    lua_ctx->loading = NULL;
+}
+
+/*
+ * Reload the modules which have changed.  Each one is dropped from
+ * package.loaded, along with the hooks and listeners it registered, and
+ * required again.
+ * A change to the top-level module reloads everything.
+ */
+static void
+lua_xterm_reload_modules(void)
+{
+    lua_State *L = lua_ctx->L;
+    LuaModule *module;
+
+    for (module = lua_ctx->modules; module != NULL; module = module->next) {
+        if (module->dirty && strcmp(module->name, LUA_INIT_MODULE) == 0) {
             lua_xterm_debug("Script file changed, reloading");
             lua_xterm_reload_scripts();
+            return;
+        }
+    }
+
+    for (module = lua_ctx->modules; module != NULL; module = module->next) {
+        if (!module->dirty) {
+            continue;
+        }
+        module->dirty = False;
+        lua_xterm_debug("Reloading module %s", module->name);
+
+        lua_xterm_clear_module_hooks(module->name);
+        lua_xterm_clear_module_listeners(L, module->name);
+
+        lua_getglobal(L, "package");
+        lua_getfield(L, -1, "loaded");
+        if (lua_istable(L, -1)) {
+            lua_pushnil(L);
+            lua_setfield(L, -2, module->name);
+        }
+        lua_pop(L, 2);
+
+        lua_getglobal(L, "require");
+        lua_pushstring(L, module->name);
+        lua_xterm_safe_call(L, 1, 0);
+    }
+    lua_ctx->last_reload = time(NULL);
+}
+
+/*
+ * Run a module's chunk, noting which module is loading so that the hooks it
+ * registers can be dropped when it is reloaded.
+ */
+static int
+lua_xterm_module_loader(lua_State *L)
+{
+    LuaModule *module = (LuaModule *) lua_touserdata(L, lua_upvalueindex(2));
+    LuaModule *saved = lua_ctx->loading;
+    int nargs = lua_gettop(L);
+    int status;
+
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+
+    lua_ctx->loading = module;
+    status = lua_pcall(L, nargs, LUA_MULTRET, 0);
+    lua_ctx->loading = saved;
+
+    if (status != LUA_OK) {
+        return lua_error(L);
+    }
+    return lua_gettop(L);
+}
+
+/*
+ * Wraps one of the package searchers.  When it finds a Lua file, record the
+ * file and hand back a loader which tracks the module.
+ */
+static int
+lua_xterm_module_searcher(lua_State *L)
+{
+    const char *name = luaL_checkstring(L, 1);
+
+    lua_settop(L, 1);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_pushvalue(L, 1);
+    lua_call(L, 1, 2);
+
+    if (lua_isfunction(L, -2) && lua_type(L, -1) == LUA_TSTRING) {
+        const char *path = lua_tostring(L, -1);
+        size_t len = strlen(path);
+        LuaModule *module;
+
+        if (len > 4
+            && strcmp(path + len - 4, ".lua") == 0
+            && (module = lua_xterm_add_module(name, path)) != NULL) {
+            lua_pushvalue(L, -2);
+            lua_pushlightuserdata(L, module);
+            lua_pushcclosure(L, lua_xterm_module_loader, 2);
+            lua_replace(L, -3);
+        }
+    }
+    return 2;
+}
+
+static void
+lua_xterm_watch_searchers(lua_State *L)
+{
+    lua_Integer n, i;
+
+    lua_getglobal(L, "package");
+    if (lua_istable(L, -1)) {
+        lua_getfield(L, -1, "searchers");
+        if (!lua_istable(L, -1)) {
+            /* Lua 5.1 */
+            lua_pop(L, 1);
+            lua_getfield(L, -1, "loaders");
+        }
+        if (lua_istable(L, -1)) {
+            n = (lua_Integer) lua_rawlen(L, -1);
+            for (i = 1; i <= n; ++i) {
+                lua_rawgeti(L, -1, i);
+                lua_pushcclosure(L, lua_xterm_module_searcher, 1);
+                lua_rawseti(L, -2, i);
+            }
+        }
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+}
+
+/* File watching */
+
+static void lua_xterm_reload_timer(XtPointer closure, XtIntervalId * id);
+
+static void
+lua_xterm_schedule_reload(unsigned long delay)
+{
+    if (lua_ctx->reload_timer) {
+        XtRemoveTimeOut(lua_ctx->reload_timer);
+    }
+    lua_ctx->reload_timer = XtAppAddTimeOut(app_con, delay,
+                                            lua_xterm_reload_timer, NULL);
+}
+
+static void
+lua_xterm_reload_timer(XtPointer closure GCC_UNUSED, XtIntervalId * id GCC_UNUSED)
+{
+    lua_ctx->reload_timer = 0;
+
+    if (lua_ctx->watch_fd >= 0) {
+        if (lua_xterm_is_enabled()) {
+            lua_xterm_reload_modules();
+        }
+    } else {
+        lua_xterm_check_reload();
+        lua_xterm_schedule_reload(LUA_RELOAD_POLL);
+    }
+}
+
+#ifdef USE_INOTIFY
+static Boolean
+lua_xterm_mark_changed(int wd, const char *name)
+{
+    LuaModule *module;
+    Boolean changed = False;
+
+    for (module = lua_ctx->modules; module != NULL; module = module->next) {
+        const char *base;
+
+        if (wd >= 0 && module->wd != wd) {
+            continue;
+        }
+        base = strrchr(module->path, '/');
+        base = (base != NULL) ? base + 1 : module->path;
+        if (name == NULL || strcmp(base, name) == 0) {
+            lua_xterm_debug("Module %s changed", module->name);
+            module->dirty = True;
+            changed = True;
+        }
+    }
+    return changed;
+}
+
+/*
+ * Read the pending inotify events, and (re)start the timer which reloads the
+ * changed modules once the burst of events from an editor's save is over.
+ */
+static void
+lua_xterm_watch_input(XtPointer closure GCC_UNUSED,
+                      int *source,
+                      XtInputId * id GCC_UNUSED)
+{
+    union {
+        struct inotify_event event;
+        char data[4096];
+    } buffer;
+    ssize_t got;
+    Boolean changed = False;
+
+    while ((got = read(*source, buffer.data, sizeof(buffer.data))) > 0) {
+        char *next = buffer.data;
+
+        while (next < buffer.data + got) {
+            struct inotify_event *event = (struct inotify_event *) (void *) next;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                changed |= lua_xterm_mark_changed(-1, NULL);
+            } else if (event->len != 0) {
+                changed |= lua_xterm_mark_changed(event->wd, event->name);
+            }
+            next += sizeof(struct inotify_event) + event->len;
         }
-        free(init_path);
+    }
+
+    if (changed) {
+        lua_xterm_schedule_reload(LUA_RELOAD_DELAY);
+    }
+}
+#endif /* USE_INOTIFY */
+
+static void
+lua_xterm_start_watching(void)
+{
+#ifdef USE_INOTIFY
+    lua_ctx->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (lua_ctx->watch_fd >= 0) {
+        lua_ctx->watch_input = XtAppAddInput(app_con,
+                                             lua_ctx->watch_fd,
+                                             (XtPointer) XtInputReadMask,
+                                             lua_xterm_watch_input,
+                                             NULL);
+        lua_xterm_debug("Watching Lua modules with inotify");
+        return;
+    }
+    lua_xterm_debug("inotify is not available: %s", strerror(errno));
+#endif
+    /* fall back to checking modification times */
+    lua_xterm_schedule_reload(LUA_RELOAD_POLL);
+}
+
+static void
+lua_xterm_stop_watching(void)
+{
+    if (lua_ctx->reload_timer) {
+        XtRemoveTimeOut(lua_ctx->reload_timer);
+        lua_ctx->reload_timer = 0;
+    }
+    if (lua_ctx->watch_fd >= 0) {
+        XtRemoveInput(lua_ctx->watch_input);
+        close(lua_ctx->watch_fd);
+        lua_ctx->watch_fd = -1;
     }
 }
 
@@ -546,7 +936,9 @@ lua_xterm_enter_command_mode(void)
     lua_xterm_draw_command_line();
     
     /* Call command mode hook if registered */
-    lua_xterm_call_hook(LUA_HOOK_COMMAND_MODE, "s", "enter");
+    if (lua_xterm_has_hook(LUA_HOOK_COMMAND_MODE)) {
+        lua_xterm_call_hook(LUA_HOOK_COMMAND_MODE, "s", "enter");
+    }
     
     lua_xterm_debug("Entered Lua command mode");
 }
@@ -585,7 +977,9 @@ lua_xterm_exit_command_mode(void)
     lua_xterm_command_mode_clear();
     
     /* Call command mode hook if registered */
-    lua_xterm_call_hook(LUA_HOOK_COMMAND_MODE, "s", "exit");
+    if (lua_xterm_has_hook(LUA_HOOK_COMMAND_MODE)) {
+        lua_xterm_call_hook(LUA_HOOK_COMMAND_MODE, "s", "exit");
+    }
     
     lua_xterm_debug("Exited Lua command mode");
 }
@@ -785,8 +1179,10 @@ lua_xterm_command_mode_display(void)
     lua_xterm_draw_command_line();
     
     /* Call display hook if registered */
-    lua_xterm_call_hook(LUA_HOOK_COMMAND_MODE, "ss", "display", 
-                        lua_ctx->command_buffer ? lua_ctx->command_buffer : "");
+    if (lua_xterm_has_hook(LUA_HOOK_COMMAND_MODE)) {
+        lua_xterm_call_hook(LUA_HOOK_COMMAND_MODE, "ss", "display",
+                            lua_ctx->command_buffer ? lua_ctx->command_buffer : "");
+    }
 }
 
 
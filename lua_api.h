@@ -44,7 +44,10 @@
 
 #define LUA_SCRIPT_DIR_DEFAULT "runtime"
 #define LUA_INIT_SCRIPT "trex.lua"
+#define LUA_INIT_MODULE "trex_init"
 #define LUA_MAX_SCRIPT_SIZE (1024 * 1024)  /* 1MB max script size */
+#define LUA_RELOAD_DELAY 200   /* msecs to let a burst of file changes settle */
+#define LUA_RELOAD_POLL 1000   /* msecs between mtime checks without inotify */
 
 typedef enum {
     LUA_HOOK_CHAR_PRE,
@@ -65,6 +68,16 @@ typedef enum {
     LUA_HOOK_COUNT
 } LuaHookType;
 
+/* A Lua module loaded through package.searchers, watched for changes */
+typedef struct LuaModule {
+    char *name;
+    char *path;
+    time_t mtime;
+    int wd;                     /* inotify watch on the module's directory */
+    Boolean dirty;
+    struct LuaModule *next;
+} LuaModule;
+
 typedef struct {
     lua_State *L;
     int initialized;
@@ -78,11 +91,17 @@ typedef struct {
     char *command_buffer;
     size_t command_length;
     size_t command_capacity;
+    LuaModule *modules;         /* files loaded through package.searchers */
+    LuaModule *loading;         /* module whose chunk is running, if any */
+    int watch_fd;               /* inotify descriptor, or -1 */
+    XtInputId watch_input;
+    XtIntervalId reload_timer;
 } LuaContext;
 
 typedef struct LuaHook {
     int hook_type;
     int ref;
+    char *owner;                /* module which registered the hook */
     struct LuaHook *next;
 } LuaHook;
 
@@ -101,12 +120,27 @@ int lua_xterm_register_hook(LuaHookType type, int ref);
 void lua_xterm_unregister_hook(LuaHookType type, int ref);
 Boolean lua_xterm_call_hook(LuaHookType type, ...);
 void lua_xterm_clear_hooks(void);
+void lua_xterm_clear_module_hooks(const char *owner);
+
+/*
+ * Bit n of lua_hook_mask is set while any hook of type n is registered, so
+ * that hot paths can skip lua_xterm_call_hook() with a single test.
+ */
+extern unsigned lua_hook_mask;
+#define LUA_HOOK_BIT(type) (1U << (type))
+#define lua_xterm_has_hook(type) ((lua_hook_mask & LUA_HOOK_BIT(type)) != 0)
 
 /* Error handling */
 void lua_xterm_error(const char *format, ...);
 void lua_xterm_debug(const char *format, ...);
 int lua_xterm_safe_call(lua_State *L, int nargs, int nresults);
 
+/* Bytecode cache */
+int lua_xterm_cache_loadfile(lua_State *L, const char *path);
+void lua_xterm_cache_searchers(lua_State *L);
+unsigned lua_xterm_cache_hits(void);
+unsigned lua_xterm_cache_misses(void);
+
 /* Utility functions */
 char *lua_xterm_get_script_path(const char *filename);
 char *lua_xterm_get_cwd_script_path(const char *filename);
@@ -122,6 +156,8 @@ int luaopen_xterm_menu(lua_State *L);
 int luaopen_xterm_events(lua_State *L);
 int luaopen_xterm_utils(lua_State *L);
 int luaopen_xterm_hooks(lua_State *L);
+int luaopen_xterm_screen(lua_State *L);
+int luaopen_xterm_search(lua_State *L);
 
 /* Terminal manipulation from Lua */
 int lua_terminal_write(lua_State *L);
@@ -134,6 +170,18 @@ int lua_terminal_goto(lua_State *L);
 int lua_terminal_save_cursor(lua_State *L);
 int lua_terminal_restore_cursor(lua_State *L);
 
+/* Screen and scrollback views from Lua */
+int lua_screen_size(lua_State *L);
+int lua_screen_saved(lua_State *L);
+int lua_screen_cursor(lua_State *L);
+int lua_screen_line(lua_State *L);
+int lua_screen_text(lua_State *L);
+int lua_screen_range(lua_State *L);
+int lua_screen_lines(lua_State *L);
+int lua_screen_graphics(lua_State *L);
+CLineData *lua_screen_line_data(TScreen *screen, int row);
+Boolean lua_screen_add_text(luaL_Buffer *buffer, TScreen *screen, int row, int first, int last);
+
 /* Configuration access from Lua */
 int lua_config_get(lua_State *L);
 int lua_config_set(lua_State *L);
@@ -158,8 +206,16 @@ int lua_hooks_clear(lua_State *L);
 
 /* Event handling from Lua */
 int lua_events_on(lua_State *L);
+int lua_events_once(lua_State *L);
 int lua_events_off(lua_State *L);
 int lua_events_emit(lua_State *L);
+int lua_events_count(lua_State *L);
+
+/* Event publishing from C; check lua_xterm_has_listeners() first */
+extern int lua_event_listeners;
+#define lua_xterm_has_listeners() (lua_event_listeners != 0)
+void lua_xterm_clear_module_listeners(lua_State *L, const char *owner);
+Boolean lua_xterm_emit(const char *event_name, const char *format, ...);
 
 /* Resource management */
 void lua_xterm_set_script_dir(const char *dir);
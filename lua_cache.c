@@ -0,0 +1,439 @@
+/* $XTermId: lua_cache.c,v 1.1 2025/06/21 00:00:00 claude Exp $ */
+
+/*
+ * Copyright 2025 by Claude (Anthropic)
+ *
+ *                         All Rights Reserved
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE ABOVE LISTED COPYRIGHT HOLDER(S) BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Bytecode cache for Lua scripts.
+ *
+ * Compiled chunks are saved with lua_dump() under $XDG_CACHE_HOME/trex (or
+ * ~/.cache/trex), one file per script, named by a hash of the script's path.
+ * Each cache file starts with a header holding the Lua version and the
+ * script's path, size and a hash of its text; if any of those no longer
+ * match, the script is compiled from source again and the cache rewritten.
+ */
+
+#include <xterm.h>
+
+#ifdef OPT_LUA_SCRIPTING
+
+#include <lua_api.h>
+#include <xstrings.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define LUA_CACHE_MAGIC "TREXLC2"
+
+typedef struct {
+    char magic[8];
+    int version;
+    int path_len;
+    long long size;
+    unsigned long long hash;    /* of the script's text */
+} LuaCacheHeader;
+
+typedef struct {
+    char *data;
+    size_t used;
+    size_t size;
+} LuaCacheBuffer;
+
+static char *cache_dir = NULL;
+static Boolean cache_failed = False;
+static unsigned cache_hits = 0;
+static unsigned cache_misses = 0;
+
+static int
+lua_cache_mkdir(const char *path)
+{
+    struct stat st;
+
+    if (stat(path, &st) == 0) {
+        return S_ISDIR(st.st_mode);
+    }
+    return (mkdir(path, 0700) == 0);
+}
+
+/*
+ * Find (and create if needed) the cache directory, once.
+ */
+static const char *
+lua_cache_dir(void)
+{
+    const char *xdg;
+    char *home = NULL;
+    char *base;
+    size_t len;
+
+    if (cache_dir != NULL || cache_failed) {
+        return cache_dir;
+    }
+
+    xdg = getenv("XDG_CACHE_HOME");
+    if (xdg != NULL && *xdg == '/') {
+        base = x_strdup(xdg);
+    } else {
+        home = lua_xterm_get_home_dir();
+        if (home == NULL) {
+            cache_failed = True;
+            return NULL;
+        }
+        len = strlen(home) + sizeof("/.cache");
+        base = (char *) malloc(len);
+        if (base != NULL) {
+            snprintf(base, len, "%s/.cache", home);
+        }
+        free(home);
+    }
+
+    if (base != NULL && lua_cache_mkdir(base)) {
+        len = strlen(base) + sizeof("/trex");
+        cache_dir = (char *) malloc(len);
+        if (cache_dir != NULL) {
+            snprintf(cache_dir, len, "%s/trex", base);
+            if (!lua_cache_mkdir(cache_dir)) {
+                free(cache_dir);
+                cache_dir = NULL;
+            }
+        }
+    }
+    free(base);
+
+    if (cache_dir == NULL) {
+        lua_xterm_debug("Bytecode cache disabled: no cache directory");
+        cache_failed = True;
+    }
+    return cache_dir;
+}
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+/*
+ * The cache file for a script is named by a 64-bit FNV-1a hash of its path.
+ */
+static char *
+lua_cache_file(const char *path)
+{
+    const char *dir = lua_cache_dir();
+    unsigned long long hash = FNV_OFFSET;
+    const char *s;
+    char *result;
+    size_t len;
+
+    if (dir == NULL) {
+        return NULL;
+    }
+    for (s = path; *s != '\0'; ++s) {
+        hash ^= (unsigned char) *s;
+        hash *= FNV_PRIME;
+    }
+
+    len = strlen(dir) + 24;
+    result = (char *) malloc(len);
+    if (result != NULL) {
+        snprintf(result, len, "%s/%016llx.luac", dir, hash);
+    }
+    return result;
+}
+
+/*
+ * A cached chunk is used only if the script's text is unchanged.  The
+ * modification time is not enough: it counts whole seconds, and a script can
+ * be saved more than once in a second when it is reloaded as it changes.
+ */
+static Boolean
+lua_cache_source_hash(const char *path, unsigned long long *result)
+{
+    unsigned long long hash = FNV_OFFSET;
+    char buffer[BUFSIZ];
+    size_t got, n;
+    FILE *fp;
+    Boolean ok;
+
+    if ((fp = fopen(path, "rb")) == NULL) {
+        return False;
+    }
+    while ((got = fread(buffer, (size_t) 1, sizeof(buffer), fp)) != 0) {
+        for (n = 0; n < got; ++n) {
+            hash ^= (unsigned char) buffer[n];
+            hash *= FNV_PRIME;
+        }
+    }
+    ok = !ferror(fp);
+    fclose(fp);
+    *result = hash;
+    return ok;
+}
+
+static void
+lua_cache_header(LuaCacheHeader *header,
+                 const char *path,
+                 const struct stat *st,
+                 unsigned long long hash)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, LUA_CACHE_MAGIC, sizeof(LUA_CACHE_MAGIC));
+    header->version = LUA_VERSION_NUM;
+    header->path_len = (int) strlen(path);
+    header->size = (long long) st->st_size;
+    header->hash = hash;
+}
+
+/*
+ * Load a script's chunk from the cache, if it is there and up to date.
+ */
+static int
+lua_cache_read(lua_State *L,
+               const char *cache,
+               const char *path,
+               const struct stat *st,
+               unsigned long long hash)
+{
+    LuaCacheHeader expect, header;
+    struct stat cst;
+    FILE *fp;
+    char *data = NULL;
+    char *chunkname = NULL;
+    size_t length;
+    int status = LUA_ERRFILE;
+
+    if (stat(cache, &cst) != 0
+        || (fp = fopen(cache, "rb")) == NULL) {
+        return status;
+    }
+
+    lua_cache_header(&expect, path, st, hash);
+    if (fread(&header, sizeof(header), (size_t) 1, fp) == 1
+        && memcmp(&header, &expect, sizeof(header)) == 0
+        && (size_t) cst.st_size > sizeof(header) + (size_t) header.path_len) {
+        length = (size_t) cst.st_size - sizeof(header);
+        data = (char *) malloc(length);
+        chunkname = (char *) malloc((size_t) header.path_len + 2);
+        if (data != NULL
+            && chunkname != NULL
+            && fread(data, (size_t) 1, length, fp) == length
+            && memcmp(data, path, (size_t) header.path_len) == 0) {
+            sprintf(chunkname, "@%s", path);
+            status = luaL_loadbufferx(L,
+                                      data + header.path_len,
+                                      length - (size_t) header.path_len,
+                                      chunkname,
+                                      "b");
+            if (status != LUA_OK) {
+                lua_xterm_debug("Discarding cached chunk for %s: %s",
+                                path, lua_tostring(L, -1));
+                lua_pop(L, 1);
+            }
+        }
+    }
+
+    free(data);
+    free(chunkname);
+    fclose(fp);
+    return status;
+}
+
+static int
+lua_cache_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+    LuaCacheBuffer *buffer = (LuaCacheBuffer *) ud;
+
+    (void) L;
+    if (buffer->used + sz > buffer->size) {
+        size_t want = (buffer->size + sz) * 2;
+        char *data = (char *) realloc(buffer->data, want);
+        if (data == NULL) {
+            return 1;
+        }
+        buffer->data = data;
+        buffer->size = want;
+    }
+    memcpy(buffer->data + buffer->used, p, sz);
+    buffer->used += sz;
+    return 0;
+}
+
+/*
+ * Save the compiled chunk on top of the stack.  The file is written under a
+ * temporary name and renamed, so that another trex starting at the same
+ * time never reads a partial file.
+ */
+static void
+lua_cache_write(lua_State *L,
+                const char *cache,
+                const char *path,
+                const struct stat *st,
+                unsigned long long hash)
+{
+    LuaCacheHeader header;
+    LuaCacheBuffer buffer;
+    char *temp;
+    size_t len;
+    FILE *fp;
+    int status;
+
+    memset(&buffer, 0, sizeof(buffer));
+#if LUA_VERSION_NUM >= 503
+    status = lua_dump(L, lua_cache_writer, &buffer, 0);
+#else
+    status = lua_dump(L, lua_cache_writer, &buffer);
+#endif
+    if (status != 0 || buffer.used == 0) {
+        free(buffer.data);
+        return;
+    }
+
+    len = strlen(cache) + 32;
+    temp = (char *) malloc(len);
+    if (temp != NULL) {
+        snprintf(temp, len, "%s.%ld", cache, (long) getpid());
+        if ((fp = fopen(temp, "wb")) != NULL) {
+            lua_cache_header(&header, path, st, hash);
+            if (fwrite(&header, sizeof(header), (size_t) 1, fp) == 1
+                && fwrite(path, (size_t) 1, (size_t) header.path_len, fp)
+                == (size_t) header.path_len
+                && fwrite(buffer.data, (size_t) 1, buffer.used, fp) == buffer.used
+                && fclose(fp) == 0) {
+                if (rename(temp, cache) != 0) {
+                    unlink(temp);
+                }
+            } else {
+                unlink(temp);
+            }
+        }
+        free(temp);
+    }
+    free(buffer.data);
+}
+
+/*
+ * A replacement for luaL_loadfile(), which uses the cached bytecode when it
+ * is up to date, and otherwise compiles the script and caches the result.
+ */
+int
+lua_xterm_cache_loadfile(lua_State *L, const char *path)
+{
+    struct stat st;
+    unsigned long long hash;
+    char *cache;
+    int status;
+
+    /*
+     * The text is hashed before it is compiled: if it changes in between,
+     * the stale hash only makes the next load miss the cache.
+     */
+    if (stat(path, &st) != 0
+        || !S_ISREG(st.st_mode)
+        || !lua_cache_source_hash(path, &hash)
+        || (cache = lua_cache_file(path)) == NULL) {
+        return luaL_loadfile(L, path);
+    }
+
+    if (lua_cache_read(L, cache, path, &st, hash) == LUA_OK) {
+        ++cache_hits;
+        lua_xterm_debug("Loaded %s from bytecode cache", path);
+    } else {
+        ++cache_misses;
+        status = luaL_loadfile(L, path);
+        if (status != LUA_OK) {
+            free(cache);
+            return status;
+        }
+        lua_cache_write(L, cache, path, &st, hash);
+    }
+    free(cache);
+    return LUA_OK;
+}
+
+/*
+ * Searcher for Lua modules, in place of the standard one: find the file on
+ * package.path and load it through the cache.
+ */
+static int
+lua_cache_searcher(lua_State *L)
+{
+    const char *name = luaL_checkstring(L, 1);
+    const char *path;
+
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "searchpath");
+    lua_pushvalue(L, 1);
+    lua_getfield(L, -3, "path");
+    lua_call(L, 2, 2);
+    if (lua_isnil(L, -2)) {
+        return 1;               /* the list of files which were tried */
+    }
+    lua_pop(L, 1);
+
+    path = lua_tostring(L, -1);
+    if (lua_xterm_cache_loadfile(L, path) != LUA_OK) {
+        return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+                          name, path, lua_tostring(L, -1));
+    }
+    lua_pushstring(L, path);
+    return 2;
+}
+
+/*
+ * Replace the standard Lua searcher (the second entry of package.searchers)
+ * with the caching one.  Lua 5.1 has no package.searchpath, and keeps its
+ * own searcher.
+ */
+void
+lua_xterm_cache_searchers(lua_State *L)
+{
+    lua_getglobal(L, "package");
+    if (lua_istable(L, -1)) {
+        lua_getfield(L, -1, "searchpath");
+        if (lua_isfunction(L, -1)) {
+            lua_getfield(L, -2, "searchers");
+            if (lua_istable(L, -1) && lua_rawlen(L, -1) >= 2) {
+                lua_pushcfunction(L, lua_cache_searcher);
+                lua_rawseti(L, -2, 2);
+            }
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+}
+
+unsigned
+lua_xterm_cache_hits(void)
+{
+    return cache_hits;
+}
+
+unsigned
+lua_xterm_cache_misses(void)
+{
+    return cache_misses;
+}
+
+#endif /* OPT_LUA_SCRIPTING */
@@ -30,10 +30,13 @@
 #ifdef OPT_LUA_SCRIPTING
 
 #include <lua_api.h>
+#include <xstrings.h>
 #include <stdarg.h>
 
 static LuaHook *hook_lists[LUA_HOOK_COUNT] = { NULL };
 
+unsigned lua_hook_mask = 0;
+
 static const char *hook_names[LUA_HOOK_COUNT] = {
     "char_pre",
     "char_post", 
@@ -54,6 +57,24 @@ static const char *hook_names[LUA_HOOK_COUNT] = {
 
 static LuaHookType lua_hook_name_to_type(const char *name);
 
+static void
+lua_hook_update_mask(int type)
+{
+    if (hook_lists[type] != NULL) {
+        lua_hook_mask |= LUA_HOOK_BIT(type);
+    } else {
+        lua_hook_mask &= ~LUA_HOOK_BIT(type);
+    }
+}
+
+static void
+lua_hook_free(lua_State *L, LuaHook *hook)
+{
+    luaL_unref(L, LUA_REGISTRYINDEX, hook->ref);
+    free(hook->owner);
+    free(hook);
+}
+
 int
 lua_xterm_register_hook(LuaHookType type, int ref)
 {
@@ -70,8 +91,12 @@ lua_xterm_register_hook(LuaHookType type, int ref)
 
     hook->hook_type = type;
     hook->ref = ref;
+    hook->owner = (lua_ctx != NULL && lua_ctx->loading != NULL)
+        ? x_strdup(lua_ctx->loading->name)
+        : NULL;
     hook->next = hook_lists[type];
     hook_lists[type] = hook;
+    lua_hook_update_mask(type);
 
     lua_xterm_debug("Registered hook for %s", hook_names[type]);
     return 1;
@@ -91,8 +116,8 @@ lua_xterm_unregister_hook(LuaHookType type, int ref)
         hook = *current;
         if (hook->ref == ref) {
             *current = hook->next;
-            luaL_unref(lua_ctx->L, LUA_REGISTRYINDEX, ref);
-            free(hook);
+            lua_hook_free(lua_ctx->L, hook);
+            lua_hook_update_mask(type);
             lua_xterm_debug("Unregistered hook for %s", hook_names[type]);
             return;
         }
@@ -160,19 +185,36 @@ lua_xterm_call_hook(LuaHookType type, ...)
         case LUA_HOOK_MOUSE_PRESS:
         case LUA_HOOK_MOUSE_RELEASE:
         case LUA_HOOK_MOUSE_MOTION:
-            int_arg = va_arg(args_copy, int);  /* button */
-            int_arg = va_arg(args_copy, int);  /* x */
-            int_arg = va_arg(args_copy, int);  /* y */
-            lua_pushinteger(lua_ctx->L, int_arg);
-            argc = 1;
-            break;
+            {
+                int button = va_arg(args_copy, int);
+                int col = va_arg(args_copy, int);
+                int row = va_arg(args_copy, int);
+                lua_pushinteger(lua_ctx->L, button);
+                lua_pushinteger(lua_ctx->L, col);
+                lua_pushinteger(lua_ctx->L, row);
+                argc = 3;
+                break;
+            }
 
         case LUA_HOOK_RESIZE:
-            int_arg = va_arg(args_copy, int);  /* width */
-            int_arg = va_arg(args_copy, int);  /* height */
-            lua_pushinteger(lua_ctx->L, int_arg);
-            argc = 1;
-            break;
+            {
+                int rows = va_arg(args_copy, int);
+                int cols = va_arg(args_copy, int);
+                lua_pushinteger(lua_ctx->L, rows);
+                lua_pushinteger(lua_ctx->L, cols);
+                argc = 2;
+                break;
+            }
+
+        case LUA_HOOK_STATUS_UPDATE:
+            {
+                int status_type = va_arg(args_copy, int);
+                int active = va_arg(args_copy, int);
+                lua_pushinteger(lua_ctx->L, status_type);
+                lua_pushboolean(lua_ctx->L, active);
+                argc = 2;
+                break;
+            }
 
         case LUA_HOOK_MENU_ACTION:
             str_arg = va_arg(args_copy, const char *);  /* action */
@@ -190,7 +232,10 @@ lua_xterm_call_hook(LuaHookType type, ...)
         /* Call the Lua function */
         if (lua_xterm_safe_call(lua_ctx->L, argc, 1) == LUA_OK) {
             /* Check return value for some hooks */
-            if (type == LUA_HOOK_KEY_PRESS || type == LUA_HOOK_KEY_RELEASE) {
+            if (type == LUA_HOOK_KEY_PRESS || type == LUA_HOOK_KEY_RELEASE
+                || type == LUA_HOOK_MOUSE_PRESS
+                || type == LUA_HOOK_MOUSE_RELEASE
+                || type == LUA_HOOK_MOUSE_MOTION) {
                 if (lua_isboolean(lua_ctx->L, -1) && lua_toboolean(lua_ctx->L, -1)) {
                     /* Hook handled the event, stop processing */
                     lua_pop(lua_ctx->L, 1);
@@ -222,16 +267,47 @@ lua_xterm_clear_hooks(void)
         hook = hook_lists[i];
         while (hook != NULL) {
             next = hook->next;
-            luaL_unref(lua_ctx->L, LUA_REGISTRYINDEX, hook->ref);
-            free(hook);
+            lua_hook_free(lua_ctx->L, hook);
             hook = next;
         }
         hook_lists[i] = NULL;
     }
+    lua_hook_mask = 0;
 
     lua_xterm_debug("Cleared all hooks");
 }
 
+/*
+ * Drop the hooks which a module registered while it was loading, so that
+ * reloading the module does not leave its old callbacks behind.
+ */
+void
+lua_xterm_clear_module_hooks(const char *owner)
+{
+    int i;
+    LuaHook **current, *hook;
+
+    if (lua_ctx == NULL || owner == NULL) {
+        return;
+    }
+
+    for (i = 0; i < LUA_HOOK_COUNT; i++) {
+        current = &hook_lists[i];
+        while (*current != NULL) {
+            hook = *current;
+            if (hook->owner != NULL && strcmp(hook->owner, owner) == 0) {
+                *current = hook->next;
+                lua_hook_free(lua_ctx->L, hook);
+            } else {
+                current = &hook->next;
+            }
+        }
+        lua_hook_update_mask(i);
+    }
+
+    lua_xterm_debug("Cleared hooks of module %s", owner);
+}
+
 /* Lua API functions */
 
 int
@@ -287,11 +363,11 @@ lua_hooks_unregister(lua_State *L)
     hook = hook_lists[hook_type];
     while (hook != NULL) {
         next = hook->next;
-        luaL_unref(L, LUA_REGISTRYINDEX, hook->ref);
-        free(hook);
+        lua_hook_free(L, hook);
         hook = next;
     }
     hook_lists[hook_type] = NULL;
+    lua_hook_update_mask(hook_type);
 
     return 0;
 }
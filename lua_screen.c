@@ -0,0 +1,665 @@
+/* $XTermId: lua_screen.c,v 1.1 2025/06/21 00:00:00 claude Exp $ */
+
+/*
+ * Copyright 2025 by Claude (Anthropic)
+ *
+ *                         All Rights Reserved
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE ABOVE LISTED COPYRIGHT HOLDER(S) BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Read-only views of the screen and scrollback for Lua.
+ *
+ * Rows use xterm's internal numbering: 0 is the top of the live screen,
+ * max_row the bottom, and negative rows reach back into the scrollback
+ * (-1 being the most recently saved line).  Columns are 0-based.
+ *
+ * Views only record coordinates.  Every access goes back to getLineData(),
+ * so nothing is copied until a script asks for text, and a view which has
+ * scrolled out of range simply reads as empty.
+ */
+
+#include <xterm.h>
+
+#ifdef OPT_LUA_SCRIPTING
+
+#include <lua_api.h>
+#include <data.h>
+#include <fontutils.h>
+
+#if OPT_GRAPHICS
+#include <graphics.h>
+#endif
+
+#define LUA_SCREEN_LINE  "xterm.screen.line"
+#define LUA_SCREEN_RANGE "xterm.screen.range"
+
+typedef struct {
+    int row;
+} LuaLineView;
+
+typedef struct {
+    int top;
+    int left;
+    int bottom;
+    int right;
+} LuaRangeView;
+
+static TScreen *
+lua_screen_current(void)
+{
+    return (term != NULL) ? TScreenOf(term) : NULL;
+}
+
+static int
+lua_screen_first_row(TScreen *screen)
+{
+    return -screen->savedlines;
+}
+
+/*
+ * Return the line for a row, or NULL if the row is outside the screen and
+ * the scrollback which is currently available.
+ */
+CLineData *
+lua_screen_line_data(TScreen *screen, int row)
+{
+    if (screen == NULL
+        || row < lua_screen_first_row(screen)
+        || row > screen->max_row) {
+        return NULL;
+    }
+    return getLineData(screen, row);
+}
+
+/*
+ * Find the column just past the last non-blank cell of the line, limited to
+ * the given column.
+ */
+static int
+lua_screen_text_end(TScreen *screen, CLineData *ld, int limit)
+{
+    int col = Min(limit, (int) ld->lineSize);
+
+    (void) screen;
+    while (col > 0) {
+        IChar ch = ld->charData[col - 1];
+        if (ch != 0 && ch != ' ' && !(ld->attribs[col - 1] & INVISIBLE)) {
+            break;
+        }
+#if OPT_WIDE_CHARS
+        if (ld->combSize != 0 && ld->combData[0][col - 1] != 0) {
+            break;
+        }
+#endif
+        --col;
+    }
+    return col;
+}
+
+static void
+lua_screen_add_code(luaL_Buffer *buffer, TScreen *screen, unsigned ch)
+{
+    Char utf8[8];
+    Char *last = convertCellToUTF8(screen, utf8, ch);
+
+    luaL_addlstring(buffer, (const char *) utf8, (size_t) (last - utf8));
+}
+
+/*
+ * Append one cell, with its combining characters, as UTF-8.
+ */
+static void
+lua_screen_add_cell(luaL_Buffer *buffer, TScreen *screen, CLineData *ld, int col)
+{
+    if (ld->attribs[col] & INVISIBLE) {
+        luaL_addchar(buffer, ' ');
+        return;
+    }
+#if OPT_WIDE_CHARS
+    if (ld->charData[col] == HIDDEN_CHAR) {
+        return;
+    }
+#endif
+    lua_screen_add_code(buffer, screen, ld->charData[col]);
+#if OPT_WIDE_CHARS
+    {
+        size_t off;
+        int base = col;
+
+        /* combining marks of a wide character live on its right half */
+        if (col + 1 < (int) ld->lineSize && ld->charData[col + 1] == HIDDEN_CHAR) {
+            base = col + 1;
+        }
+        for_each_combData(off, ld) {
+            unsigned ch = ld->combData[off][base];
+            if (ch == 0) {
+                break;
+            }
+            lua_screen_add_code(buffer, screen, ch);
+        }
+    }
+#endif
+}
+
+/*
+ * Append the text of columns [first, last] of a row, without trailing
+ * blanks.  Returns false if the row is not available.
+ */
+Boolean
+lua_screen_add_text(luaL_Buffer *buffer, TScreen *screen, int row, int first, int last)
+{
+    CLineData *ld = lua_screen_line_data(screen, row);
+    int col, end;
+
+    if (ld == NULL) {
+        return False;
+    }
+    if (first < 0) {
+        first = 0;
+    }
+    end = lua_screen_text_end(screen, ld, last + 1);
+    for (col = first; col < end; ++col) {
+        lua_screen_add_cell(buffer, screen, ld, col);
+    }
+    return True;
+}
+
+static void
+lua_screen_push_attrs(lua_State *L, CLineData *ld, int col)
+{
+    unsigned flags = ld->attribs[col];
+
+    lua_createtable(L, 0, 8);
+
+#define SET_ATTR(name, mask) \
+    if (flags & (mask)) { \
+        lua_pushboolean(L, 1); \
+        lua_setfield(L, -2, name); \
+    }
+    SET_ATTR("bold", BOLD);
+    SET_ATTR("underline", UNDERLINE);
+    SET_ATTR("blink", BLINK);
+    SET_ATTR("inverse", INVERSE);
+    SET_ATTR("invisible", INVISIBLE);
+    SET_ATTR("protected", PROTECTED);
+#if OPT_WIDE_ATTRS
+    SET_ATTR("faint", ATR_FAINT);
+    SET_ATTR("italic", ATR_ITALIC);
+    SET_ATTR("strikeout", ATR_STRIKEOUT);
+    SET_ATTR("double_underline", ATR_DBL_UNDER);
+#endif
+#undef SET_ATTR
+
+#if OPT_ISO_COLORS
+    if (flags & FG_COLOR) {
+        lua_pushinteger(L, (lua_Integer) GetCellColorFG(ld->color[col]));
+        lua_setfield(L, -2, "fg");
+        if (hasDirectFG(flags)) {
+            lua_pushboolean(L, 1);
+            lua_setfield(L, -2, "fg_direct");
+        }
+    }
+    if (flags & BG_COLOR) {
+        lua_pushinteger(L, (lua_Integer) GetCellColorBG(ld->color[col]));
+        lua_setfield(L, -2, "bg");
+        if (hasDirectBG(flags)) {
+            lua_pushboolean(L, 1);
+            lua_setfield(L, -2, "bg_direct");
+        }
+    }
+#endif
+}
+
+static LuaLineView *
+lua_screen_push_line(lua_State *L, int row)
+{
+    LuaLineView *view = (LuaLineView *) lua_newuserdata(L, sizeof(LuaLineView));
+
+    view->row = row;
+    luaL_setmetatable(L, LUA_SCREEN_LINE);
+    return view;
+}
+
+/* Line views */
+
+static int
+lua_screen_line_text(lua_State *L)
+{
+    LuaLineView *view = (LuaLineView *) luaL_checkudata(L, 1, LUA_SCREEN_LINE);
+    TScreen *screen = lua_screen_current();
+    int first = (int) luaL_optinteger(L, 2, 0);
+    int last = (int) luaL_optinteger(L, 3, (screen != NULL) ? screen->max_col : 0);
+    luaL_Buffer buffer;
+
+    luaL_buffinit(L, &buffer);
+    lua_screen_add_text(&buffer, screen, view->row, first, last);
+    luaL_pushresult(&buffer);
+    return 1;
+}
+
+static int
+lua_screen_line_char(lua_State *L)
+{
+    LuaLineView *view = (LuaLineView *) luaL_checkudata(L, 1, LUA_SCREEN_LINE);
+    int col = (int) luaL_checkinteger(L, 2);
+    TScreen *screen = lua_screen_current();
+    CLineData *ld = lua_screen_line_data(screen, view->row);
+    luaL_Buffer buffer;
+
+    if (ld == NULL || col < 0 || col >= (int) ld->lineSize) {
+        lua_pushnil(L);
+        return 1;
+    }
+    luaL_buffinit(L, &buffer);
+    lua_screen_add_cell(&buffer, screen, ld, col);
+    luaL_pushresult(&buffer);
+    return 1;
+}
+
+static int
+lua_screen_line_attrs(lua_State *L)
+{
+    LuaLineView *view = (LuaLineView *) luaL_checkudata(L, 1, LUA_SCREEN_LINE);
+    int col = (int) luaL_checkinteger(L, 2);
+    CLineData *ld = lua_screen_line_data(lua_screen_current(), view->row);
+
+    if (ld == NULL || col < 0 || col >= (int) ld->lineSize) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_screen_push_attrs(L, ld, col);
+    return 1;
+}
+
+static int
+lua_screen_line_wrapped(lua_State *L)
+{
+    LuaLineView *view = (LuaLineView *) luaL_checkudata(L, 1, LUA_SCREEN_LINE);
+    CLineData *ld = lua_screen_line_data(lua_screen_current(), view->row);
+
+    lua_pushboolean(L, ld != NULL && LineTstWrapped(ld));
+    return 1;
+}
+
+static int
+lua_screen_line_row(lua_State *L)
+{
+    LuaLineView *view = (LuaLineView *) luaL_checkudata(L, 1, LUA_SCREEN_LINE);
+
+    lua_pushinteger(L, view->row);
+    return 1;
+}
+
+static int
+lua_screen_line_len(lua_State *L)
+{
+    LuaLineView *view = (LuaLineView *) luaL_checkudata(L, 1, LUA_SCREEN_LINE);
+    CLineData *ld = lua_screen_line_data(lua_screen_current(), view->row);
+
+    lua_pushinteger(L, (ld != NULL) ? ld->lineSize : 0);
+    return 1;
+}
+
+static int
+lua_screen_line_tostring(lua_State *L)
+{
+    lua_settop(L, 1);
+    return lua_screen_line_text(L);
+}
+
+/* Range views */
+
+static int
+lua_screen_range_text(lua_State *L)
+{
+    LuaRangeView *view = (LuaRangeView *) luaL_checkudata(L, 1, LUA_SCREEN_RANGE);
+    TScreen *screen = lua_screen_current();
+    luaL_Buffer buffer;
+    int row;
+
+    luaL_buffinit(L, &buffer);
+    for (row = view->top; row <= view->bottom; ++row) {
+        CLineData *ld = lua_screen_line_data(screen, row);
+        int first = (row == view->top) ? view->left : 0;
+        int last = (row == view->bottom) ? view->right : screen->max_col;
+
+        if (ld == NULL) {
+            continue;
+        }
+        lua_screen_add_text(&buffer, screen, row, first, last);
+        /* soft-wrapped lines join up with the next one */
+        if (row < view->bottom && !LineTstWrapped(ld)) {
+            luaL_addchar(&buffer, '\n');
+        }
+    }
+    luaL_pushresult(&buffer);
+    return 1;
+}
+
+static int
+lua_screen_range_step(lua_State *L)
+{
+    LuaRangeView *view = (LuaRangeView *) lua_touserdata(L, lua_upvalueindex(1));
+    int row = (int) lua_tointeger(L, lua_upvalueindex(2));
+    TScreen *screen = lua_screen_current();
+    luaL_Buffer buffer;
+
+    if (screen == NULL || row > view->bottom || row > screen->max_row) {
+        return 0;
+    }
+    if (row < lua_screen_first_row(screen)) {
+        row = lua_screen_first_row(screen);
+    }
+    lua_pushinteger(L, row + 1);
+    lua_replace(L, lua_upvalueindex(2));
+
+    lua_pushinteger(L, row);
+    luaL_buffinit(L, &buffer);
+    lua_screen_add_text(&buffer, screen, row,
+                        (row == view->top) ? view->left : 0,
+                        (row == view->bottom) ? view->right : screen->max_col);
+    luaL_pushresult(&buffer);
+    return 2;
+}
+
+/*
+ * for row, text in range:lines() do ... end
+ */
+static int
+lua_screen_range_lines(lua_State *L)
+{
+    LuaRangeView *view = (LuaRangeView *) luaL_checkudata(L, 1, LUA_SCREEN_RANGE);
+
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, view->top);
+    lua_pushcclosure(L, lua_screen_range_step, 2);
+    return 1;
+}
+
+static int
+lua_screen_range_len(lua_State *L)
+{
+    LuaRangeView *view = (LuaRangeView *) luaL_checkudata(L, 1, LUA_SCREEN_RANGE);
+
+    lua_pushinteger(L, view->bottom - view->top + 1);
+    return 1;
+}
+
+static int
+lua_screen_range_bounds(lua_State *L)
+{
+    LuaRangeView *view = (LuaRangeView *) luaL_checkudata(L, 1, LUA_SCREEN_RANGE);
+
+    lua_pushinteger(L, view->top);
+    lua_pushinteger(L, view->left);
+    lua_pushinteger(L, view->bottom);
+    lua_pushinteger(L, view->right);
+    return 4;
+}
+
+static int
+lua_screen_range_tostring(lua_State *L)
+{
+    lua_settop(L, 1);
+    return lua_screen_range_text(L);
+}
+
+/* xterm.screen functions */
+
+int
+lua_screen_size(lua_State *L)
+{
+    TScreen *screen = lua_screen_current();
+
+    if (screen == NULL) {
+        return 0;
+    }
+    lua_pushinteger(L, MaxRows(screen));
+    lua_pushinteger(L, MaxCols(screen));
+    return 2;
+}
+
+int
+lua_screen_saved(lua_State *L)
+{
+    TScreen *screen = lua_screen_current();
+
+    lua_pushinteger(L, (screen != NULL) ? screen->savedlines : 0);
+    return 1;
+}
+
+int
+lua_screen_cursor(lua_State *L)
+{
+    TScreen *screen = lua_screen_current();
+
+    if (screen == NULL) {
+        return 0;
+    }
+    lua_pushinteger(L, screen->cur_row);
+    lua_pushinteger(L, screen->cur_col);
+    return 2;
+}
+
+int
+lua_screen_line(lua_State *L)
+{
+    int row = (int) luaL_checkinteger(L, 1);
+
+    if (lua_screen_line_data(lua_screen_current(), row) == NULL) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_screen_push_line(L, row);
+    return 1;
+}
+
+int
+lua_screen_text(lua_State *L)
+{
+    TScreen *screen = lua_screen_current();
+    int row = (int) luaL_checkinteger(L, 1);
+    int first = (int) luaL_optinteger(L, 2, 0);
+    int last = (int) luaL_optinteger(L, 3, (screen != NULL) ? screen->max_col : 0);
+    luaL_Buffer buffer;
+
+    if (lua_screen_line_data(screen, row) == NULL) {
+        lua_pushnil(L);
+        return 1;
+    }
+    luaL_buffinit(L, &buffer);
+    lua_screen_add_text(&buffer, screen, row, first, last);
+    luaL_pushresult(&buffer);
+    return 1;
+}
+
+/*
+ * xterm.screen.range(top, left, bottom, right)
+ */
+int
+lua_screen_range(lua_State *L)
+{
+    TScreen *screen = lua_screen_current();
+    LuaRangeView *view;
+    int top = (int) luaL_checkinteger(L, 1);
+    int left = (int) luaL_optinteger(L, 2, 0);
+    int bottom = (int) luaL_optinteger(L, 3, top);
+    int right = (int) luaL_optinteger(L, 4, (screen != NULL) ? screen->max_col : 0);
+
+    luaL_argcheck(L, bottom >= top, 3, "bottom row is above top row");
+
+    view = (LuaRangeView *) lua_newuserdata(L, sizeof(LuaRangeView));
+    view->top = top;
+    view->left = left;
+    view->bottom = bottom;
+    view->right = right;
+    luaL_setmetatable(L, LUA_SCREEN_RANGE);
+    return 1;
+}
+
+static int
+lua_screen_lines_step(lua_State *L)
+{
+    LuaLineView *view = (LuaLineView *) lua_touserdata(L, lua_upvalueindex(1));
+    int last = (int) lua_tointeger(L, lua_upvalueindex(2));
+    TScreen *screen = lua_screen_current();
+
+    if (screen == NULL) {
+        return 0;
+    }
+    if (view->row < lua_screen_first_row(screen)) {
+        view->row = lua_screen_first_row(screen);
+    }
+    if (view->row > last || view->row > screen->max_row) {
+        return 0;
+    }
+    lua_pushinteger(L, view->row);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    ++(view->row);
+    return 2;
+}
+
+/*
+ * for row, line in xterm.screen.lines(first, last) do ... end
+ *
+ * The same line view is handed out on each step and moved along, so a scan
+ * of the whole history allocates nothing per row.  Scripts which want to
+ * keep a line should call xterm.screen.line(row).
+ */
+int
+lua_screen_lines(lua_State *L)
+{
+    TScreen *screen = lua_screen_current();
+    int first = (int) luaL_optinteger(L, 1, 0);
+    int last = (int) luaL_optinteger(L, 2, (screen != NULL) ? screen->max_row : -1);
+
+    lua_screen_push_line(L, first);
+    lua_pushinteger(L, last);
+    lua_pushcclosure(L, lua_screen_lines_step, 2);
+    return 1;
+}
+
+/*
+ * Counters for the memory used by sixel and ReGIS graphics, or nil if
+ * graphics are not supported.
+ */
+int
+lua_screen_graphics(lua_State *L)
+{
+#if OPT_GRAPHICS
+    TScreen *screen = lua_screen_current();
+    GraphicsStats stats;
+
+    if (screen == NULL) {
+        return 0;
+    }
+    get_graphics_stats(screen, &stats);
+    lua_createtable(L, 0, 6);
+    lua_pushinteger(L, (lua_Integer) stats.bytes_used);
+    lua_setfield(L, -2, "bytes_used");
+    lua_pushinteger(L, (lua_Integer) stats.bytes_pooled);
+    lua_setfield(L, -2, "bytes_pooled");
+    lua_pushinteger(L, (lua_Integer) stats.bytes_limit);
+    lua_setfield(L, -2, "bytes_limit");
+    lua_pushinteger(L, (lua_Integer) stats.allocations);
+    lua_setfield(L, -2, "allocations");
+    lua_pushinteger(L, (lua_Integer) stats.reuses);
+    lua_setfield(L, -2, "reuses");
+    lua_pushinteger(L, (lua_Integer) stats.evictions);
+    lua_setfield(L, -2, "evictions");
+    return 1;
+#else
+    (void) L;
+    return 0;
+#endif
+}
+
+/* Library registration */
+
+int
+luaopen_xterm_screen(lua_State *L)
+{
+    static const luaL_Reg screen_funcs[] = {
+        {"size", lua_screen_size},
+        {"saved", lua_screen_saved},
+        {"cursor", lua_screen_cursor},
+        {"line", lua_screen_line},
+        {"text", lua_screen_text},
+        {"range", lua_screen_range},
+        {"lines", lua_screen_lines},
+        {"graphics", lua_screen_graphics},
+        {NULL, NULL}
+    };
+    static const luaL_Reg line_methods[] = {
+        {"text", lua_screen_line_text},
+        {"char", lua_screen_line_char},
+        {"attrs", lua_screen_line_attrs},
+        {"wrapped", lua_screen_line_wrapped},
+        {"row", lua_screen_line_row},
+        {NULL, NULL}
+    };
+    static const luaL_Reg range_methods[] = {
+        {"text", lua_screen_range_text},
+        {"lines", lua_screen_range_lines},
+        {"bounds", lua_screen_range_bounds},
+        {NULL, NULL}
+    };
+
+    /* Metatables for the view types */
+    if (luaL_newmetatable(L, LUA_SCREEN_LINE)) {
+        luaL_newlib(L, line_methods);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, lua_screen_line_len);
+        lua_setfield(L, -2, "__len");
+        lua_pushcfunction(L, lua_screen_line_tostring);
+        lua_setfield(L, -2, "__tostring");
+    }
+    lua_pop(L, 1);
+
+    if (luaL_newmetatable(L, LUA_SCREEN_RANGE)) {
+        luaL_newlib(L, range_methods);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, lua_screen_range_len);
+        lua_setfield(L, -2, "__len");
+        lua_pushcfunction(L, lua_screen_range_tostring);
+        lua_setfield(L, -2, "__tostring");
+    }
+    lua_pop(L, 1);
+
+    /* Create xterm table if it doesn't exist */
+    lua_getglobal(L, "xterm");
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_setglobal(L, "xterm");
+        lua_getglobal(L, "xterm");
+    }
+
+    /* Create screen subtable */
+    luaL_newlib(L, screen_funcs);
+    lua_setfield(L, -2, "screen");
+
+    lua_pop(L, 1);  /* Pop xterm table */
+    return 0;
+}
+
+#endif /* OPT_LUA_SCRIPTING */
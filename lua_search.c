@@ -0,0 +1,270 @@
+/* $XTermId: lua_search.c,v 1.1 2025/06/21 00:00:00 claude Exp $ */
+
+/*
+ * Copyright 2025 by Claude (Anthropic)
+ *
+ *                         All Rights Reserved
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE ABOVE LISTED COPYRIGHT HOLDER(S) BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Text search from Lua.
+ *
+ * xterm.search(pattern [, opts]) scans the screen and scrollback at once and
+ * returns the matches, using the same row numbering as xterm.screen.  The
+ * fields of xterm.search (start, next, prev, cancel, status) drive the
+ * interactive search, which is the one bound to the search() actions.
+ */
+
+#include <xterm.h>
+
+#ifdef OPT_LUA_SCRIPTING
+
+#include <lua_api.h>
+#include <data.h>
+#include <search.h>
+
+#define LUA_SEARCH_CHUNK 1024	/* rows per pass of a backward search */
+
+typedef struct {
+    lua_State *L;
+    int count;
+    int limit;
+} LuaSearchResult;
+
+static Bool
+lua_search_add(const SearchMatch *match, void *closure)
+{
+    LuaSearchResult *result = (LuaSearchResult *) closure;
+    lua_State *L = result->L;
+
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, match->start_row);
+    lua_setfield(L, -2, "row");
+    lua_pushinteger(L, match->start_col);
+    lua_setfield(L, -2, "col");
+    lua_pushinteger(L, match->end_row);
+    lua_setfield(L, -2, "end_row");
+    lua_pushinteger(L, match->end_col);
+    lua_setfield(L, -2, "end_col");
+    lua_rawseti(L, -2, ++(result->count));
+
+    return (Bool) (result->limit <= 0 || result->count < result->limit);
+}
+
+/*
+ * Reverse entries first..last of the table on top of the stack.
+ */
+static void
+lua_search_reverse(lua_State *L, int first, int last)
+{
+    while (first < last) {
+        lua_rawgeti(L, -1, first);
+        lua_rawgeti(L, -2, last);
+        lua_rawseti(L, -3, first);
+        lua_rawseti(L, -2, last);
+        ++first;
+        --last;
+    }
+}
+
+/*
+ * Read the options table at the given index.
+ */
+static unsigned
+lua_search_flags(lua_State *L, int index, int *limit)
+{
+    unsigned flags = 0;
+
+    *limit = 0;
+    if (lua_istable(L, index)) {
+        lua_getfield(L, index, "backward");
+        if (lua_toboolean(L, -1))
+            flags |= SEARCH_BACKWARD;
+        lua_getfield(L, index, "icase");
+        if (lua_toboolean(L, -1))
+            flags |= SEARCH_ICASE;
+        lua_getfield(L, index, "regex");
+        if (lua_toboolean(L, -1))
+            flags |= SEARCH_REGEX;
+        lua_getfield(L, index, "limit");
+        *limit = (int) luaL_optinteger(L, -1, 0);
+        lua_pop(L, 4);
+    } else if (!lua_isnoneornil(L, index)) {
+        luaL_argerror(L, index, "table expected");
+    }
+    return flags;
+}
+
+/*
+ * xterm.search(pattern [, opts]) returns a list of matches, each a table
+ * { row, col, end_row, end_col } with end_col exclusive.  Matches are listed
+ * top to bottom, or bottom to top if opts.backward is set, so that with
+ * opts.limit the most recent ones are found first.
+ */
+static int
+lua_search_call(lua_State *L)
+{
+    const char *pattern = luaL_checkstring(L, 2);
+    TScreen *screen = (term != NULL) ? TScreenOf(term) : NULL;
+    LuaSearchResult result;
+    SearchPattern *compiled;
+    char *errmsg = NULL;
+    unsigned flags;
+    int limit;
+
+    flags = lua_search_flags(L, 3, &limit);
+    if ((compiled = xtermSearchCompile(pattern, flags, &errmsg)) == NULL) {
+        lua_pushnil(L);
+        lua_pushstring(L, errmsg ? errmsg : "bad pattern");
+        free(errmsg);
+        return 2;
+    }
+
+    lua_newtable(L);
+    result.L = L;
+    result.count = 0;
+    result.limit = limit;
+    if (screen != NULL) {
+        if (flags & SEARCH_BACKWARD) {
+            int bottom = screen->max_row;
+
+            /* scan upward a chunk at a time, so a limit can stop early */
+            while (bottom >= -screen->savedlines
+                   && (limit <= 0 || result.count < limit)) {
+                int top = bottom - LUA_SEARCH_CHUNK + 1;
+                int before = result.count;
+
+                result.limit = 0;
+                xtermSearchRows(screen, compiled, top, bottom,
+                                lua_search_add, &result);
+                lua_search_reverse(L, before + 1, result.count);
+                bottom = top - 1;
+            }
+            while (limit > 0 && result.count > limit) {
+                lua_pushnil(L);
+                lua_rawseti(L, -2, result.count--);
+            }
+        } else {
+            xtermSearchRows(screen, compiled,
+                            -screen->savedlines, screen->max_row,
+                            lua_search_add, &result);
+        }
+    }
+    xtermSearchFree(compiled);
+    return 1;
+}
+
+/* xterm.search.start(pattern [, opts]) */
+static int
+lua_search_start(lua_State *L)
+{
+    const char *pattern = luaL_checkstring(L, 1);
+    int limit;
+    unsigned flags = lua_search_flags(L, 2, &limit);
+
+    if (term != NULL) {
+        xtermSearchStart(term, pattern, flags);
+    }
+    return 0;
+}
+
+static int
+lua_search_next(lua_State *L)
+{
+    lua_pushboolean(L, term != NULL && xtermSearchNext(term, False));
+    return 1;
+}
+
+static int
+lua_search_prev(lua_State *L)
+{
+    lua_pushboolean(L, term != NULL && xtermSearchNext(term, True));
+    return 1;
+}
+
+static int
+lua_search_cancel(lua_State *L)
+{
+    (void) L;
+    if (term != NULL) {
+        xtermSearchCancel(term);
+    }
+    return 0;
+}
+
+/*
+ * Returns the number of matches found so far, the index (1-based) of the
+ * one shown or nil, and whether the search has finished.
+ */
+static int
+lua_search_status(lua_State *L)
+{
+    int current;
+    Bool done;
+    int count = xtermSearchStatus(&current, &done);
+
+    lua_pushinteger(L, count);
+    if (current >= 0 && count > 0) {
+        lua_pushinteger(L, current + 1);
+    } else {
+        lua_pushnil(L);
+    }
+    lua_pushboolean(L, done);
+    return 3;
+}
+
+/* Library registration */
+
+int
+luaopen_xterm_search(lua_State *L)
+{
+    static const luaL_Reg search_funcs[] = {
+        {"start", lua_search_start},
+        {"next", lua_search_next},
+        {"prev", lua_search_prev},
+        {"cancel", lua_search_cancel},
+        {"status", lua_search_status},
+        {NULL, NULL}
+    };
+
+    /* Create xterm table if it doesn't exist */
+    lua_getglobal(L, "xterm");
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_setglobal(L, "xterm");
+        lua_getglobal(L, "xterm");
+    }
+
+    /* Create search subtable, which is also callable */
+    luaL_newlib(L, search_funcs);
+    lua_createtable(L, 0, 1);
+    lua_pushcfunction(L, lua_search_call);
+    lua_setfield(L, -2, "__call");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, -2, "search");
+
+    lua_pop(L, 1);  /* Pop xterm table */
+    return 0;
+}
+
+#endif /* OPT_LUA_SCRIPTING */
@@ -30,6 +30,7 @@
 #ifdef OPT_LUA_SCRIPTING
 
 #include <lua_api.h>
+#include <stdarg.h>
 #include <time.h>
 
 /* Utility functions for Lua */
@@ -152,52 +153,294 @@ lua_utils_system(lua_State *L)
 
 /* Events system */
 
-static int event_refs[32];  /* Simple event storage */
-static int event_count = 0;
+/*
+ * Listeners live in a registry table mapping each event name to an array of
+ * entries { fn = function, priority = number, once = boolean }, kept sorted
+ * by descending priority.  Looking up an event is a single table access,
+ * and lua_event_listeners counts every listener so that C code can skip
+ * emitting entirely when nobody is subscribed.
+ */
+#define LUA_EVENTS_KEY "xterm.events"
+
+int lua_event_listeners = 0;
+
+/* Push the list of listeners for an event, creating it if asked */
+static Boolean
+lua_events_get_list(lua_State *L, const char *event_name, Boolean create)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_EVENTS_KEY);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        return False;
+    }
+    lua_getfield(L, -1, event_name);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        if (!create) {
+            lua_pop(L, 1);
+            return False;
+        }
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -3, event_name);
+    }
+    lua_remove(L, -2);
+    return True;
+}
+
+/* Remove the n'th entry from the list on top of the stack */
+static void
+lua_events_remove_at(lua_State *L, lua_Integer n)
+{
+    lua_Integer last = (lua_Integer) lua_rawlen(L, -1);
+
+    /* mark it, in case an emit is still holding the entry */
+    lua_rawgeti(L, -1, n);
+    lua_pushboolean(L, 0);
+    lua_setfield(L, -2, "fn");
+    lua_pop(L, 1);
+
+    for (; n < last; ++n) {
+        lua_rawgeti(L, -1, n + 1);
+        lua_rawseti(L, -2, n);
+    }
+    lua_pushnil(L);
+    lua_rawseti(L, -2, last);
+    --lua_event_listeners;
+}
+
+/*
+ * Call the listeners of an event with the nargs values on top of the stack,
+ * which are popped.  Listeners are called from a snapshot of the list, so
+ * they may subscribe or unsubscribe freely.  A listener which returns true
+ * stops the event from reaching those after it.
+ */
+static Boolean
+lua_events_dispatch(lua_State *L, const char *event_name, int nargs)
+{
+    int base = lua_gettop(L) - nargs;
+    Boolean handled = False;
+    lua_Integer n, i, j;
+
+    if (!lua_events_get_list(L, event_name, False)) {
+        lua_settop(L, base);
+        return False;
+    }
+
+    n = (lua_Integer) lua_rawlen(L, -1);
+    lua_createtable(L, (int) n, 0);
+    for (i = 1; i <= n; ++i) {
+        lua_rawgeti(L, -2, i);
+        lua_rawseti(L, -2, i);
+    }
+
+    for (i = 1; i <= n && !handled; ++i) {
+        lua_rawgeti(L, -1, i);             /* entry */
+        lua_getfield(L, -1, "fn");
+        if (!lua_isfunction(L, -1)) {
+            lua_pop(L, 2);
+            continue;
+        }
+        lua_getfield(L, -2, "once");
+        if (lua_toboolean(L, -1)) {
+            for (j = (lua_Integer) lua_rawlen(L, -5); j > 0; --j) {
+                lua_rawgeti(L, -5, j);
+                if (lua_rawequal(L, -1, -4)) {
+                    lua_pop(L, 1);
+                    lua_pushvalue(L, -5);
+                    lua_events_remove_at(L, j);
+                    lua_pop(L, 1);
+                    break;
+                }
+                lua_pop(L, 1);
+            }
+        }
+        lua_pop(L, 1);
 
+        for (j = 1; j <= nargs; ++j) {
+            lua_pushvalue(L, base + (int) j);
+        }
+        if (lua_xterm_safe_call(L, nargs, 1) == LUA_OK) {
+            handled = (Boolean) (lua_isboolean(L, -1) && lua_toboolean(L, -1));
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);                     /* entry */
+    }
+
+    lua_settop(L, base);
+    return handled;
+}
+
+static void
+lua_events_add(lua_State *L, const char *event_name, int fn, lua_Integer priority, Boolean once)
+{
+    lua_Integer n, pos;
+
+    lua_events_get_list(L, event_name, True);
+
+    /* after every listener with the same or a higher priority */
+    n = (lua_Integer) lua_rawlen(L, -1);
+    for (pos = n + 1; pos > 1; --pos) {
+        lua_Integer other;
+        lua_rawgeti(L, -1, pos - 1);
+        lua_getfield(L, -1, "priority");
+        other = lua_tointeger(L, -1);
+        lua_pop(L, 2);
+        if (other >= priority) {
+            break;
+        }
+        lua_rawgeti(L, -1, pos - 1);
+        lua_rawseti(L, -2, pos);
+    }
+
+    lua_createtable(L, 0, 4);
+    lua_pushvalue(L, fn);
+    lua_setfield(L, -2, "fn");
+    lua_pushinteger(L, priority);
+    lua_setfield(L, -2, "priority");
+    lua_pushboolean(L, once);
+    lua_setfield(L, -2, "once");
+    if (lua_ctx != NULL && lua_ctx->loading != NULL) {
+        lua_pushstring(L, lua_ctx->loading->name);
+        lua_setfield(L, -2, "owner");
+    }
+    lua_rawseti(L, -2, pos);
+
+    lua_pop(L, 1);
+    ++lua_event_listeners;
+}
+
+/*
+ * Drop the listeners which a module added while it was loading, so that
+ * reloading the module does not add them a second time.
+ */
+void
+lua_xterm_clear_module_listeners(lua_State *L, const char *owner)
+{
+    lua_Integer n;
+
+    if (L == NULL || owner == NULL) {
+        return;
+    }
+
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_EVENTS_KEY);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        return;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0) {
+        if (lua_istable(L, -1)) {
+            for (n = (lua_Integer) lua_rawlen(L, -1); n > 0; --n) {
+                Boolean mine;
+
+                lua_rawgeti(L, -1, n);
+                lua_getfield(L, -1, "owner");
+                mine = (Boolean) (lua_type(L, -1) == LUA_TSTRING
+                                  && strcmp(lua_tostring(L, -1), owner) == 0);
+                lua_pop(L, 2);
+                if (mine) {
+                    lua_events_remove_at(L, n);
+                }
+            }
+        }
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    lua_xterm_debug("Cleared listeners of module %s", owner);
+}
+
+/*
+ * xterm.events.on(event_name, function [, priority | { priority =, once = }])
+ */
 int
 lua_events_on(lua_State *L)
 {
     const char *event_name;
-    int ref;
-
-    if (lua_gettop(L) != 2) {
-        return luaL_error(L, "Usage: xterm.events.on(event_name, function)");
-    }
+    lua_Integer priority = 0;
+    Boolean once = False;
 
     event_name = luaL_checkstring(L, 1);
     luaL_checktype(L, 2, LUA_TFUNCTION);
 
-    /* Store function reference */
-    lua_pushvalue(L, 2);
-    ref = luaL_ref(L, LUA_REGISTRYINDEX);
-
-    if (event_count < 32) {
-        event_refs[event_count++] = ref;
-        lua_xterm_debug("Registered event handler for %s", event_name);
+    if (lua_istable(L, 3)) {
+        lua_getfield(L, 3, "priority");
+        priority = luaL_optinteger(L, -1, 0);
+        lua_getfield(L, 3, "once");
+        once = (Boolean) lua_toboolean(L, -1);
+        lua_pop(L, 2);
     } else {
-        luaL_unref(L, LUA_REGISTRYINDEX, ref);
-        return luaL_error(L, "Too many event handlers");
+        priority = luaL_optinteger(L, 3, 0);
     }
 
-    return 0;
+    lua_events_add(L, event_name, 2, priority, once);
+    lua_xterm_debug("Registered event handler for %s", event_name);
+
+    /* the function is the handle for off() */
+    lua_pushvalue(L, 2);
+    return 1;
 }
 
+/*
+ * xterm.events.once(event_name, function [, priority])
+ */
+int
+lua_events_once(lua_State *L)
+{
+    const char *event_name;
+    lua_Integer priority;
+
+    event_name = luaL_checkstring(L, 1);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    priority = luaL_optinteger(L, 3, 0);
+
+    lua_events_add(L, event_name, 2, priority, True);
+    lua_xterm_debug("Registered one-shot event handler for %s", event_name);
+
+    lua_pushvalue(L, 2);
+    return 1;
+}
+
+/*
+ * xterm.events.off(event_name [, function])
+ */
 int
 lua_events_off(lua_State *L)
 {
     const char *event_name;
+    Boolean all;
+    lua_Integer n;
 
-    if (lua_gettop(L) != 1) {
-        return luaL_error(L, "Usage: xterm.events.off(event_name)");
+    event_name = luaL_checkstring(L, 1);
+    all = lua_isnoneornil(L, 2);
+    if (!all) {
+        luaL_checktype(L, 2, LUA_TFUNCTION);
     }
 
-    event_name = luaL_checkstring(L, 1);
+    if (lua_events_get_list(L, event_name, False)) {
+        for (n = (lua_Integer) lua_rawlen(L, -1); n > 0; --n) {
+            Boolean match = all;
+            if (!match) {
+                lua_rawgeti(L, -1, n);
+                lua_getfield(L, -1, "fn");
+                match = (Boolean) lua_rawequal(L, -1, 2);
+                lua_pop(L, 2);
+            }
+            if (match) {
+                lua_events_remove_at(L, n);
+            }
+        }
+        lua_pop(L, 1);
+    }
     lua_xterm_debug("Unregistered event handler for %s", event_name);
 
     return 0;
 }
 
+/*
+ * xterm.events.emit(event_name, ...) returns true if a listener handled it
+ */
 int
 lua_events_emit(lua_State *L)
 {
@@ -210,7 +453,87 @@ lua_events_emit(lua_State *L)
     event_name = luaL_checkstring(L, 1);
     lua_xterm_debug("Event emitted: %s", event_name);
 
-    return 0;
+    lua_pushboolean(L, lua_events_dispatch(L, event_name, lua_gettop(L) - 1));
+    return 1;
+}
+
+/*
+ * xterm.events.count(event_name) returns the number of listeners
+ */
+int
+lua_events_count(lua_State *L)
+{
+    const char *event_name = luaL_checkstring(L, 1);
+
+    if (lua_events_get_list(L, event_name, False)) {
+        lua_pushinteger(L, (lua_Integer) lua_rawlen(L, -1));
+    } else {
+        lua_pushinteger(L, 0);
+    }
+    return 1;
+}
+
+/*
+ * Publish an event from C.  The format gives the type of each argument:
+ * 's' string, 'S' counted string (const char *, size_t), 'i' int,
+ * 'b' boolean (int) and 'n' double.  Callers check
+ * lua_xterm_has_listeners() first, so this costs nothing while no script
+ * is listening.
+ */
+Boolean
+lua_xterm_emit(const char *event_name, const char *format, ...)
+{
+    lua_State *L;
+    va_list args;
+    int nargs = 0;
+    int top;
+    Boolean handled;
+
+    if (lua_event_listeners == 0 || !lua_xterm_is_enabled()) {
+        return False;
+    }
+
+    L = lua_ctx->L;
+    top = lua_gettop(L);
+    if (!lua_checkstack(L, (int) strlen(format) + 8)) {
+        return False;
+    }
+
+    va_start(args, format);
+    for (; *format != '\0'; ++format, ++nargs) {
+        switch (*format) {
+        case 's':
+            {
+                const char *value = va_arg(args, const char *);
+                lua_pushstring(L, value ? value : "");
+            }
+            break;
+        case 'S':
+            {
+                const char *value = va_arg(args, const char *);
+                size_t length = va_arg(args, size_t);
+                lua_pushlstring(L, value ? value : "", value ? length : 0);
+            }
+            break;
+        case 'i':
+            lua_pushinteger(L, va_arg(args, int));
+            break;
+        case 'b':
+            lua_pushboolean(L, va_arg(args, int));
+            break;
+        case 'n':
+            lua_pushnumber(L, va_arg(args, double));
+            break;
+        default:
+            lua_pushnil(L);
+            break;
+        }
+    }
+    va_end(args);
+
+    handled = lua_events_dispatch(L, event_name, nargs);
+    lua_settop(L, top);
+    return handled;
 }
 
 /* Command mode functions */
@@ -275,11 +598,18 @@ luaopen_xterm_events(lua_State *L)
 {
     static const luaL_Reg events_funcs[] = {
         {"on", lua_events_on},
+        {"once", lua_events_once},
         {"off", lua_events_off},
         {"emit", lua_events_emit},
+        {"count", lua_events_count},
         {NULL, NULL}
     };
 
+    /* A new state starts with no listeners */
+    lua_newtable(L);
+    lua_setfield(L, LUA_REGISTRYINDEX, LUA_EVENTS_KEY);
+    lua_event_listeners = 0;
+
     /* Create xterm table if it doesn't exist */
     lua_getglobal(L, "xterm");
     if (lua_isnil(L, -1)) {
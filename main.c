@@ -1098,6 +1098,9 @@ OPTS("-report-fonts",	NO_ARG(XtNreportFonts),			"on"),
 #if OPT_XRES_QUERY
 OPTS("-report-xres",	NO_ARG(XtNreportXRes),			"on"),
 #endif
+#if OPT_SNAPSHOT
+OPTS("-restore",	NO_ARG(XtNrestoreSnapshot),		"on"),
+#endif
 #ifdef SCROLLBAR_RIGHT
 OPTS("-leftbar",	NO_ARG(XtNrightScrollBar),		"off"),
 OPTS("-rightbar",	NO_ARG(XtNrightScrollBar),		"on"),
@@ -1112,6 +1115,9 @@ OPTS("+si",		NO_ARG(XtNscrollTtyOutput),		"on"),
 OPTS("-sk",		NO_ARG(XtNscrollKey),			"on"),
 OPTS("+sk",		NO_ARG(XtNscrollKey),			"off"),
 OPTS("-sl",		MY_ARG(XtNsaveLines),			NULL),
+#if OPT_SNAPSHOT
+OPTS("-snapshot",	MY_ARG(XtNsnapshotFile),		NULL),
+#endif
 #if OPT_SUNPC_KBD
 OPTS("-sp",		NO_ARG(XtNsunKeyboard),			"on"),
 OPTS("+sp",		NO_ARG(XtNsunKeyboard),			"off"),
@@ -1305,6 +1311,9 @@ static OptionHelp xtermOptions[] = {
 #if OPT_XRES_QUERY
 { "-report-xres",          "report X resources for VT100 widget" },
 #endif
+#if OPT_SNAPSHOT
+{ "-restore",              "restore the session saved in the snapshot file" },
+#endif
 #ifdef SCROLLBAR_RIGHT
 { "-rightbar",             "force scrollbar right (default left)" },
 { "-leftbar",              "force scrollbar left" },
@@ -1315,6 +1324,9 @@ static OptionHelp xtermOptions[] = {
 { "-/+si",                 "turn on/off scroll-on-tty-output inhibit" },
 { "-/+sk",                 "turn on/off scroll-on-keypress" },
 { "-sl number",            "number of scrolled lines to save" },
+#if OPT_SNAPSHOT
+{ "-snapshot filename",    "save the screen and saved lines in this file" },
+#endif
 #if OPT_SUNPC_KBD
 { "-/+sp",                 "turn on/off Sun/PC Function/Keypad mapping" },
 #endif
@@ -2977,7 +2989,9 @@ main(int argc, char *argv[]ENVP_ARG)
     if (!lua_xterm_init()) {
         fprintf(stderr, "Warning: Failed to initialize Lua scripting\n");
     } else {
-        lua_xterm_call_hook(LUA_HOOK_STARTUP);
+        if (lua_xterm_has_hook(LUA_HOOK_STARTUP))
+            lua_xterm_call_hook(LUA_HOOK_STARTUP);
+        lua_xterm_emit("startup", "");
     }
 #endif
 
@@ -3064,6 +3078,7 @@ main(int argc, char *argv[]ENVP_ARG)
 #endif
 
     initPtyData(&VTbuffer);
+    xtermRestoreSnapshot(term);
 #ifdef ALLOWLOGGING
     if (term->misc.log_on) {
 	StartLog(term);
@@ -5581,7 +5596,9 @@ Exit(int n)
 
 #ifdef OPT_LUA_SCRIPTING
     /* Clean up Lua scripting */
-    lua_xterm_call_hook(LUA_HOOK_SHUTDOWN);
+    if (lua_xterm_has_hook(LUA_HOOK_SHUTDOWN))
+        lua_xterm_call_hook(LUA_HOOK_SHUTDOWN);
+    lua_xterm_emit("shutdown", "");
     lua_xterm_cleanup();
 #endif
 
@@ -5726,6 +5743,7 @@ Exit(int n)
      * grabbing it, and *then* having us release ownership....
      */
     close(screen->respond);	/* close explicitly to avoid race with slave side */
+    xtermSaveSnapshot(xw);
 #ifdef ALLOWLOGGING
     if (screen->logging)
 	CloseLog(xw);
@@ -5744,8 +5762,13 @@ Exit(int n)
 	    TRACE(("destroyed top-level widget\n"));
 	}
 	sortedOpts(NULL, NULL, 0);
+	noleaks_button();
 	noleaks_charproc();
 	noleaks_ptydata();
+	noleaks_search();
+#if OPT_SCREEN_DUMPS
+	noleaks_html();
+#endif
 #if OPT_GRAPHICS
 	noleaks_graphics(dpy);
 #endif
@@ -1193,7 +1193,10 @@ do_dump_html(Widget gw GCC_UNUSED,
 	     XtPointer closure GCC_UNUSED,
 	     XtPointer data GCC_UNUSED)
 {
-    xtermDumpHtml(term);
+    int first, last;
+
+    if (xtermDumpRange(term, NULL, 0, &first, &last))
+	xtermDumpHtml(term, first, last);
 }
 
 static void
@@ -1201,7 +1204,10 @@ do_dump_svg(Widget gw GCC_UNUSED,
 	    XtPointer closure GCC_UNUSED,
 	    XtPointer data GCC_UNUSED)
 {
-    xtermDumpSvg(term);
+    int first, last;
+
+    if (xtermDumpRange(term, NULL, 0, &first, &last))
+	xtermDumpSvg(term, first, last);
 }
 #endif
 
@@ -2158,6 +2164,16 @@ HandlePrintEverything(Widget w GCC_UNUSED,
     xtermPrintEverything(term, getPrinterFlags(term, params, param_count));
 }
 
+/* ARGSUSED */
+void
+HandlePrintLines(Widget w GCC_UNUSED,
+		 XEvent *event GCC_UNUSED,
+		 String *params,
+		 Cardinal *param_count)
+{
+    xtermPrintLines(term, params, param_count);
+}
+
 /* ARGSUSED */
 void
 HandlePrintControlMode(Widget w,
@@ -2831,19 +2847,29 @@ HandleUTF8Title(Widget w,
 void
 HandleDumpHtml(Widget w GCC_UNUSED,
 	       XEvent *event GCC_UNUSED,
-	       String *params GCC_UNUSED,
-	       Cardinal *param_count GCC_UNUSED)
+	       String *params,
+	       Cardinal *param_count)
 {
-    xtermDumpHtml(term);
+    int first, last;
+
+    if (xtermDumpRange(term, params, *param_count, &first, &last))
+	xtermDumpHtml(term, first, last);
+    else
+	Bell(term, XkbBI_MinorError, 0);
 }
 
 void
 HandleDumpSvg(Widget w GCC_UNUSED,
 	      XEvent *event GCC_UNUSED,
-	      String *params GCC_UNUSED,
-	      Cardinal *param_count GCC_UNUSED)
+	      String *params,
+	      Cardinal *param_count)
 {
-    xtermDumpSvg(term);
+    int first, last;
+
+    if (xtermDumpRange(term, params, *param_count, &first, &last))
+	xtermDumpSvg(term, first, last);
+    else
+	Bell(term, XkbBI_MinorError, 0);
 }
 #endif
 
@@ -93,6 +93,7 @@ extern void HandlePopupMenu        PROTO_XT_ACTIONS_ARGS;
 extern void HandlePrintControlMode PROTO_XT_ACTIONS_ARGS;
 extern void HandlePrintEverything  PROTO_XT_ACTIONS_ARGS;
 extern void HandlePrintImmediate   PROTO_XT_ACTIONS_ARGS;
+extern void HandlePrintLines       PROTO_XT_ACTIONS_ARGS;
 extern void HandlePrintOnError     PROTO_XT_ACTIONS_ARGS;
 extern void HandlePrintScreen      PROTO_XT_ACTIONS_ARGS;
 extern void HandleRedraw           PROTO_XT_ACTIONS_ARGS;
@@ -97,6 +97,10 @@
 #include <graphics_regis.h>
 #include <graphics_sixel.h>
 
+#ifdef OPT_LUA_SCRIPTING
+#include <lua_api.h>
+#endif
+
 #include <assert.h>
 
 #ifdef HAVE_MKSTEMP
@@ -1285,6 +1289,10 @@ HandleFocusChange(Widget w GCC_UNUSED,
 		      ? INWINDOW
 		      : FOCUS));
 	SendFocusButton(xw, event);
+#ifdef OPT_LUA_SCRIPTING
+	if (lua_xterm_has_hook(LUA_HOOK_FOCUS_IN))
+	    lua_xterm_call_hook(LUA_HOOK_FOCUS_IN);
+#endif
     } else {
 #if OPT_FOCUS_EVENT
 	if (event->type == FocusOut) {
@@ -1300,6 +1308,10 @@ HandleFocusChange(Widget w GCC_UNUSED,
 			   ((event->detail == NotifyPointer)
 			    ? INWINDOW
 			    : FOCUS));
+#ifdef OPT_LUA_SCRIPTING
+	    if (lua_xterm_has_hook(LUA_HOOK_FOCUS_OUT))
+		lua_xterm_call_hook(LUA_HOOK_FOCUS_OUT);
+#endif
 	}
 	if (screen->grabbedKbd && (event->mode == NotifyUngrab)) {
 	    Bell(xw, XkbBI_Info, 100);
@@ -1427,6 +1439,11 @@ Bell(XtermWidget xw, int which, int percent)
 	xtermBell(xw, which, percent);
     }
 
+#ifdef OPT_LUA_SCRIPTING
+    if (lua_xterm_has_listeners())
+	lua_xterm_emit("bell", "ii", which, percent);
+#endif
+
     if (screen->poponbell)
 	XRaiseWindow(screen->display, VShellWindow(xw));
 
@@ -1648,27 +1665,331 @@ dabbrev_prev_word(XtermWidget xw, CELL *cell, LineData **ld)
     return result;
 }
 
+/*
+ * Words which have scrolled into the saved lines are kept in a dictionary,
+ * so that expanding a word does not walk back through the whole scrollback
+ * for each candidate.  The visible screen can still change, and is read
+ * directly; the saved lines cannot, and are tokenized once as they arrive.
+ * The dictionary is started by the first expansion, so that a session which
+ * never uses dabbrev-expand does not pay for it as lines scroll (or for
+ * decoding restored lines).
+ *
+ * Dictionary words are ranked by the line they were last seen on, and a
+ * word which is seen often is treated as if it had been seen a little more
+ * recently than it was.
+ */
+#define DABBREV_WORDS	8192	/* most words kept in the dictionary */
+#define DABBREV_CANDIDATES 256	/* most expansions offered for one word */
+#define DABBREV_BOOST	32	/* lines of recency for each repetition */
+#define DABBREV_REPEATS	16	/* ...up to this many repetitions */
+
+typedef struct {
+    char *word;
+    unsigned hash;
+    unsigned count;		/* number of times it was seen */
+    long seen;			/* saved line (see saved_total) last seen on */
+} DabbrevWord;
+
+typedef struct {
+    DabbrevWord *words;
+    unsigned count;
+    int *table;			/* open hash table of indices into words[] */
+    unsigned table_size;	/* a power of two */
+    Boolean started;		/* set by the first dabbrev-expand */
+    long upto;			/* saved lines below this were tokenized */
+    char partial[MAX_DABBREV];	/* a word which wraps onto the next line */
+    size_t partial_len;
+} DabbrevDict;
+
+static DabbrevDict dabbrev_dict;
+
+static unsigned
+dabbrev_hash(const char *word, size_t len)
+{
+    unsigned result = 2166136261U;
+    size_t n;
+
+    for (n = 0; n < len; ++n) {
+	result ^= CharOf(word[n]);
+	result *= 16777619U;
+    }
+    return result;
+}
+
+static void
+dabbrev_rehash(DabbrevDict *dict)
+{
+    unsigned mask;
+    unsigned n;
+
+    if (dict->table_size < 2 * DABBREV_WORDS) {
+	dict->table_size = 2 * DABBREV_WORDS;
+	free(dict->table);
+	if ((dict->table = TypeMallocN(int, dict->table_size)) == NULL) {
+	    dict->table_size = 0;
+	    return;
+	}
+    }
+    mask = dict->table_size - 1;
+    for (n = 0; n < dict->table_size; ++n)
+	dict->table[n] = -1;
+    for (n = 0; n < dict->count; ++n) {
+	unsigned slot = dict->words[n].hash & mask;
+	while (dict->table[slot] >= 0)
+	    slot = (slot + 1) & mask;
+	dict->table[slot] = (int) n;
+    }
+}
+
+static int
+dabbrev_newest(const void *a, const void *b)
+{
+    const DabbrevWord *p = (const DabbrevWord *) a;
+    const DabbrevWord *q = (const DabbrevWord *) b;
+
+    return (p->seen < q->seen) ? 1 : ((p->seen > q->seen) ? -1 : 0);
+}
+
+/*
+ * Forget the least recently seen quarter of the words.
+ */
+static void
+dabbrev_prune(DabbrevDict *dict)
+{
+    unsigned keep = (DABBREV_WORDS * 3) / 4;
+    unsigned n;
+
+    qsort(dict->words, (size_t) dict->count, sizeof(DabbrevWord), dabbrev_newest);
+    for (n = keep; n < dict->count; ++n)
+	free(dict->words[n].word);
+    dict->count = keep;
+    dabbrev_rehash(dict);
+}
+
+static void
+dabbrev_add_word(DabbrevDict *dict, const char *word, size_t len, long seen)
+{
+    unsigned hash = dabbrev_hash(word, len);
+    unsigned mask;
+    unsigned slot;
+    DabbrevWord *entry;
+
+    if (dict->words == NULL) {
+	if ((dict->words = TypeCallocN(DabbrevWord, DABBREV_WORDS)) == NULL)
+	    return;
+	dabbrev_rehash(dict);
+    }
+    if (dict->table == NULL)
+	return;
+
+    mask = dict->table_size - 1;
+    for (slot = hash & mask; dict->table[slot] >= 0; slot = (slot + 1) & mask) {
+	entry = &dict->words[dict->table[slot]];
+	if (entry->hash == hash
+	    && !strncmp(entry->word, word, len)
+	    && entry->word[len] == '\0') {
+	    entry->count++;
+	    entry->seen = seen;
+	    return;
+	}
+    }
+
+    if (dict->count >= DABBREV_WORDS) {
+	dabbrev_prune(dict);
+	for (slot = hash & mask; dict->table[slot] >= 0; slot = (slot + 1) & mask) {
+	    ;
+	}
+    }
+    entry = &dict->words[dict->count];
+    if ((entry->word = malloc(len + 1)) == NULL)
+	return;
+    memcpy(entry->word, word, len);
+    entry->word[len] = '\0';
+    entry->hash = hash;
+    entry->count = 1;
+    entry->seen = seen;
+    dict->table[slot] = (int) dict->count++;
+}
+
+/*
+ * Tokenize the saved lines which have arrived since the last call.  Like
+ * dabbrev_prev_char(), a word continues across a wrapped line, and only its
+ * last MAX_DABBREV - 1 characters are kept.
+ *
+ * This is called from addScrollback(), before the row it allocates is
+ * filled, so only the lines before saved_total are complete.  It does
+ * nothing until dabbrev_collect() has started the dictionary; the first
+ * call from there tokenizes the saved lines which are still available.
+ */
+void
+xtermDabbrevLines(TScreen *screen)
+{
+    DabbrevDict *dict = &dabbrev_dict;
+    long valid = Min(screen->saved_fifo, (long) screen->savelines);
+    long oldest = screen->saved_total - valid;
+
+    if (!dict->started)
+	return;
+    if (dict->upto < oldest || dict->upto > screen->saved_total) {
+	dict->upto = Max(oldest, Min(dict->upto, screen->saved_total));
+	dict->partial_len = 0;
+    }
+    while (dict->upto < screen->saved_total) {
+	int row = (int) (dict->upto - screen->saved_total);
+	LineData *ld = getLineData(screen, row);
+	int limit;
+	int col;
+
+	if (ld == NULL || ld->charData == NULL) {
+	    dict->upto++;
+	    continue;
+	}
+	limit = Min((int) ld->lineSize, MaxCols(screen));
+	for (col = 0; col < limit; ++col) {
+	    int c = (int) ld->charData[col];
+
+	    if (IS_WORD_CONSTITUENT(c)) {
+		if (dict->partial_len + 1 >= MAX_DABBREV) {
+		    memmove(dict->partial, dict->partial + 1, --(dict->partial_len));
+		}
+		dict->partial[dict->partial_len++] = (char) c;
+	    } else if (dict->partial_len != 0) {
+		dabbrev_add_word(dict, dict->partial, dict->partial_len, dict->upto);
+		dict->partial_len = 0;
+	    }
+	}
+	if (!LineTstWrapped(ld) && dict->partial_len != 0) {
+	    dabbrev_add_word(dict, dict->partial, dict->partial_len, dict->upto);
+	    dict->partial_len = 0;
+	}
+	dict->upto++;
+    }
+}
+
+typedef struct {
+    char **words;
+    unsigned count;
+    unsigned next;		/* the next one to offer */
+} DabbrevCandidates;
+
+static void
+dabbrev_offer(DabbrevCandidates *list, const char *hint, const char *word)
+{
+    size_t hint_len = strlen(hint);
+    unsigned n;
+
+    if (list->count >= DABBREV_CANDIDATES
+	|| strncmp(hint, word, hint_len)	/* empty hint matches everything */
+	|| strlen(word) <= hint_len)	/* trivial expansion disallowed */
+	return;
+    for (n = 0; n < list->count; ++n) {
+	if (!strcmp(list->words[n], word))
+	    return;
+    }
+    if ((list->words[list->count] = x_strdup(word)) != NULL)
+	list->count++;
+}
+
+static long dabbrev_rank_now;
+
+static long
+dabbrev_rank(const DabbrevWord *entry)
+{
+    return (entry->seen
+	    + (long) Min(entry->count - 1, (unsigned) DABBREV_REPEATS) * DABBREV_BOOST
+	    - dabbrev_rank_now);
+}
+
+static int
+dabbrev_ranked(const void *a, const void *b)
+{
+    long p = dabbrev_rank(*(const DabbrevWord * const *) a);
+    long q = dabbrev_rank(*(const DabbrevWord * const *) b);
+
+    return (p < q) ? 1 : ((p > q) ? -1 : 0);
+}
+
+/*
+ * Collect the expansions of the hint: first the words on the visible screen,
+ * walking back from the hint as before, then the words from the saved lines
+ * in order of rank.
+ */
+static void
+dabbrev_collect(XtermWidget xw, CELL *cell, const char *hint, DabbrevCandidates *list)
+{
+    TScreen *screen = TScreenOf(xw);
+    DabbrevDict *dict = &dabbrev_dict;
+    DabbrevWord **ranked;
+    size_t hint_len = strlen(hint);
+    long oldest = screen->saved_total - screen->savedlines;
+    unsigned count = 0;
+    unsigned n;
+    LineData *ld;
+    char *word;
+
+    while (cell->row >= 0
+	   && (word = dabbrev_prev_word(xw, cell, &ld)) != NULL) {
+	dabbrev_offer(list, hint, word);
+    }
+
+    if (screen->savelines != 0) {
+	dict->started = True;
+	xtermDabbrevLines(screen);
+    }
+    if (dict->count == 0
+	|| (ranked = TypeMallocN(DabbrevWord *, dict->count)) == NULL)
+	return;
+    for (n = 0; n < dict->count; ++n) {
+	DabbrevWord *entry = &dict->words[n];
+	if (entry->seen >= oldest
+	    && !strncmp(hint, entry->word, hint_len)) {
+	    ranked[count++] = entry;
+	}
+    }
+    dabbrev_rank_now = screen->saved_total;
+    qsort(ranked, (size_t) count, sizeof(DabbrevWord *), dabbrev_ranked);
+    for (n = 0; n < count && list->count < DABBREV_CANDIDATES; ++n) {
+	dabbrev_offer(list, hint, ranked[n]->word);
+    }
+    free(ranked);
+    TRACE(("dabbrev_collect \"%s\": %u candidates\n", hint, list->count));
+}
+
+static void
+dabbrev_forget(DabbrevCandidates *list)
+{
+    while (list->count != 0) {
+	free(list->words[--(list->count)]);
+    }
+    list->next = 0;
+}
+
 static int
 dabbrev_expand(XtermWidget xw)
 {
     TScreen *screen = TScreenOf(xw);
     int pty = screen->respond;	/* file descriptor of pty */
 
-    static CELL cell;
     static char *dabbrev_hint = NULL, *lastexpansion = NULL;
-    static unsigned int expansions;
+    static char *candidate_list[DABBREV_CANDIDATES];
+    static DabbrevCandidates candidates =
+    {
+	candidate_list, 0, 0
+    };
 
     char *expansion;
     size_t hint_len;
     int result = 0;
-    LineData *ld;
 
     if (!screen->dabbrev_working) {	/* initialize */
-	expansions = 0;
+	CELL cell;
+	LineData *ld;
+
 	cell.col = screen->cur_col;
 	cell.row = screen->cur_row;
 
 	free(dabbrev_hint);
+	dabbrev_forget(&candidates);
 
 	if ((dabbrev_hint = dabbrev_prev_word(xw, &cell, &ld)) != NULL) {
 
@@ -1680,6 +2001,7 @@ dabbrev_expand(XtermWidget xw)
 		if ((dabbrev_hint = strdup(dabbrev_hint)) != NULL) {
 		    screen->dabbrev_working = True;
 		    /* we are in the middle of dabbrev process */
+		    dabbrev_collect(xw, &cell, dabbrev_hint, &candidates);
 		}
 	    } else {
 		return result;
@@ -1698,21 +2020,11 @@ dabbrev_expand(XtermWidget xw)
 	return result;
 
     hint_len = strlen(dabbrev_hint);
-    for (;;) {
-	if ((expansion = dabbrev_prev_word(xw, &cell, &ld)) == NULL) {
-	    if (expansions >= 2) {
-		expansions = 0;
-		cell.col = screen->cur_col;
-		cell.row = screen->cur_row;
-		continue;
-	    }
-	    break;
-	}
-	if (!strncmp(dabbrev_hint, expansion, hint_len) &&	/* empty hint matches everything */
-	    strlen(expansion) > hint_len &&	/* trivial expansion disallowed */
-	    strcmp(expansion, lastexpansion))	/* different from previous */
-	    break;
-    }
+    if (candidates.next >= candidates.count && candidates.count >= 2)
+	candidates.next = 0;	/* start over */
+    expansion = ((candidates.next < candidates.count)
+		 ? candidates.words[candidates.next++]
+		 : NULL);
 
     if (expansion != NULL) {
 	Char *copybuffer;
@@ -1734,7 +2046,6 @@ dabbrev_expand(XtermWidget xw)
 
 	    if ((lastexpansion = strdup(expansion)) != NULL) {
 		result = 1;
-		expansions++;
 	    }
 	}
     }
@@ -2319,7 +2630,34 @@ xtermResetIds(TScreen *screen)
  * arbitrary data to an arbitrary file.  So it is disabled by default.
  */
 
-#ifdef ALLOWLOGFILEEXEC
+/*
+ * Data which the log has not yet accepted waits in a ring buffer, bounded by
+ * the logBufferSize resource.  A plain file is written by a child process, so
+ * that a slow disk delays only that process:  xterm feeds it through a pipe
+ * which never blocks, and drops whole chunks rather than wait when the ring
+ * is full.
+ */
+typedef enum {
+    lfRaw = 0,
+    lfAsciicast
+} LogFormat;
+
+static struct {
+    Char *data;
+    size_t size;		/* allocated size of the ring */
+    size_t head;		/* offset of the oldest byte */
+    size_t used;		/* bytes not yet written */
+    unsigned long dropped;	/* bytes discarded for lack of room */
+    Boolean nonblocking;	/* logfd is a pipe we must not wait for */
+    LogFormat format;
+    struct timeval started;	/* origin for asciicast timestamps */
+    Char partial[4];		/* incomplete UTF-8 at the end of a chunk */
+    size_t partial_len;
+    XtIntervalId timer;		/* pending LogRingTimer(), if any */
+} log_ring;
+
+#define LOG_DRAIN_MSECS	20	/* how often to retry a backlogged pipe */
+
 static void
 handle_SIGPIPE(int sig GCC_UNUSED)
 {
@@ -2334,6 +2672,8 @@ handle_SIGPIPE(int sig GCC_UNUSED)
 	CloseLog(xw);
 }
 
+#ifdef ALLOWLOGFILEEXEC
+
 /*
  * Open a command to pipe log data to it.
  * Warning, enabling this "feature" allows arbitrary programs
@@ -2462,6 +2802,307 @@ GenerateLogPath(void)
     return (log_default);
 }
 
+/*
+ * Fork a process which copies the pipe to the log file, returning the pipe
+ * for xterm to write.  If that fails, xterm writes the file itself.
+ */
+static int
+StartLogWriter(TScreen *screen, int fd)
+{
+    int pid;
+    int p[2];
+
+    if (pipe(p) < 0) {
+	xtermPerror("Can't make a pipe connection\n");
+	return fd;
+    } else if ((pid = fork()) < 0) {
+	xtermPerror("Can't fork...\n");
+	close(p[0]);
+	close(p[1]);
+	return fd;
+    }
+    if (pid == 0) {		/* child */
+	static Char buffer[65536];
+	ssize_t got;
+	long maxfd = sysconf(_SC_OPEN_MAX);
+	int n;
+
+	/* keep only the pipe, the log file and the standard streams */
+	if (maxfd < 0)
+	    maxfd = 256;
+	for (n = 3; n < maxfd; ++n) {
+	    if (n != p[0] && n != fd)
+		close(n);
+	}
+
+	signal(SIGHUP, SIG_IGN);
+	signal(SIGINT, SIG_IGN);
+	signal(SIGQUIT, SIG_IGN);
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGCHLD, SIG_DFL);
+
+	/*
+	 * Whatever accumulated in the pipe while the last write was in
+	 * progress is written as one batch.  The pipe reaches end-of-file when
+	 * xterm closes the log, or exits.
+	 */
+	while ((got = read(p[0], buffer, sizeof(buffer))) != 0) {
+	    ssize_t done = 0;
+
+	    if (got < 0) {
+		if (errno == EINTR)
+		    continue;
+		break;
+	    }
+	    while (done < got) {
+		ssize_t rc = write(fd, buffer + done, (size_t) (got - done));
+		if (rc < 0) {
+		    if (errno == EINTR)
+			continue;
+		    _exit(ERROR_LOGEXEC);
+		}
+		done += rc;
+	    }
+	}
+	close(fd);
+	_exit(0);
+    }
+    close(p[0]);
+    close(fd);
+    signal(SIGPIPE, handle_SIGPIPE);
+    return p[1];
+}
+
+/*
+ * Write as much of the ring as the log will take without waiting.
+ */
+static void
+LogRingDrain(TScreen *screen)
+{
+    while (log_ring.used != 0) {
+	size_t len = log_ring.size - log_ring.head;
+	ssize_t rc;
+
+	if (len > log_ring.used)
+	    len = log_ring.used;
+	if ((rc = write(screen->logfd, log_ring.data + log_ring.head, len)) <= 0)
+	    break;
+	log_ring.head = (log_ring.head + (size_t) rc) % log_ring.size;
+	log_ring.used -= (size_t) rc;
+    }
+    if (log_ring.used == 0)
+	log_ring.head = 0;
+}
+
+/*
+ * Keep draining the ring while the pipe is backlogged, rather than waiting
+ * for more output to flush it.
+ */
+static void
+LogRingTimer(XtPointer closure, XtIntervalId * id GCC_UNUSED)
+{
+    TScreen *screen = TScreenOf((XtermWidget) closure);
+
+    log_ring.timer = 0;
+    if (screen->logging && log_ring.used != 0) {
+	LogRingDrain(screen);
+	if (log_ring.used != 0) {
+	    log_ring.timer = XtAppAddTimeOut(app_con, LOG_DRAIN_MSECS,
+					     LogRingTimer, closure);
+	}
+    }
+}
+
+static void
+LogRingWait(void)
+{
+    if (log_ring.used != 0 && log_ring.timer == 0) {
+	log_ring.timer = XtAppAddTimeOut(app_con, LOG_DRAIN_MSECS,
+					 LogRingTimer, (XtPointer) term);
+    }
+}
+
+/*
+ * Log a chunk of data, either completely or (if the ring has no room for what
+ * the pipe will not take) not at all, so an asciicast event is never split.
+ */
+static void
+LogRingPut(TScreen *screen, const Char *data, size_t len)
+{
+    size_t tail;
+
+    if (len == 0)
+	return;
+    if (!log_ring.nonblocking) {
+	IGNORE_RC(write(screen->logfd, data, len));
+	return;
+    }
+
+    LogRingDrain(screen);
+    if (log_ring.used + len > log_ring.size) {
+	log_ring.dropped += len;
+	TRACE(("LogRingPut dropped %lu bytes (%lu total)\n",
+	       (unsigned long) len, log_ring.dropped));
+	return;
+    }
+    if (log_ring.used == 0) {
+	ssize_t rc = write(screen->logfd, data, len);
+	if (rc > 0) {
+	    data += rc;
+	    len -= (size_t) rc;
+	}
+    }
+    tail = (log_ring.head + log_ring.used) % log_ring.size;
+    while (len != 0) {
+	size_t part = log_ring.size - tail;
+
+	if (part > len)
+	    part = len;
+	memcpy(log_ring.data + tail, data, part);
+	log_ring.used += part;
+	data += part;
+	len -= part;
+	tail = 0;
+    }
+    LogRingWait();
+}
+
+/*
+ * Return the length of the UTF-8 sequence at data, zero if it is incomplete,
+ * or -1 if it is not valid.
+ */
+static int
+LogUtf8Length(const Char *data, size_t len)
+{
+    int need;
+    int n;
+
+    if (data[0] >= 0xc2 && data[0] <= 0xdf)
+	need = 2;
+    else if (data[0] >= 0xe0 && data[0] <= 0xef)
+	need = 3;
+    else if (data[0] >= 0xf0 && data[0] <= 0xf4)
+	need = 4;
+    else
+	return -1;
+    for (n = 1; n < need; ++n) {
+	if ((size_t) n >= len)
+	    return 0;
+	if ((data[n] & 0xc0) != 0x80)
+	    return -1;
+    }
+    return need;
+}
+
+/*
+ * Format a chunk of output as an asciicast v2 event, i.e., a JSON array of
+ * the elapsed time, "o" and the text.
+ */
+static void
+LogAsciicast(TScreen *screen, const Char *data, size_t len)
+{
+    static char *event;
+    static size_t event_size;
+    Char *text;
+    size_t have;
+    size_t n;
+    size_t out;
+    size_t start;
+    size_t need;
+    struct timeval now;
+    long secs;
+    long usecs;
+
+    /* stitch a sequence split by the previous chunk to this one */
+    have = log_ring.partial_len + len;
+    text = malloc(have);
+    if (text == NULL)
+	return;
+    memcpy(text, log_ring.partial, log_ring.partial_len);
+    memcpy(text + log_ring.partial_len, data, len);
+    log_ring.partial_len = 0;
+
+    need = 40 + (6 * have);
+    if (need > event_size) {
+	char *grown = realloc(event, need);
+	if (grown == NULL) {
+	    free(text);
+	    return;
+	}
+	event = grown;
+	event_size = need;
+    }
+
+    X_GETTIMEOFDAY(&now);
+    /* printf's %f would use the locale's decimal point, which JSON does not */
+    secs = (long) (now.tv_sec - log_ring.started.tv_sec);
+    usecs = (long) (now.tv_usec - log_ring.started.tv_usec);
+    if (usecs < 0) {
+	usecs += 1000000L;
+	--secs;
+    }
+    start = out = (size_t) sprintf(event, "[%ld.%06ld, \"o\", \"", secs, usecs);
+
+    for (n = 0; n < have; ++n) {
+	Char ch = text[n];
+	int length;
+
+	if (ch >= 0x80) {
+	    if ((length = LogUtf8Length(text + n, have - n)) == 0) {
+		log_ring.partial_len = have - n;
+		memcpy(log_ring.partial, text + n, log_ring.partial_len);
+		break;
+	    } else if (length > 0) {
+		memcpy(event + out, text + n, (size_t) length);
+		out += (size_t) length;
+		n += (size_t) (length - 1);
+		continue;
+	    }
+	}
+	switch (ch) {
+	case '"':
+	case '\\':
+	    event[out++] = '\\';
+	    event[out++] = (char) ch;
+	    break;
+	case '\b':
+	    event[out++] = '\\';
+	    event[out++] = 'b';
+	    break;
+	case '\f':
+	    event[out++] = '\\';
+	    event[out++] = 'f';
+	    break;
+	case '\n':
+	    event[out++] = '\\';
+	    event[out++] = 'n';
+	    break;
+	case '\r':
+	    event[out++] = '\\';
+	    event[out++] = 'r';
+	    break;
+	case '\t':
+	    event[out++] = '\\';
+	    event[out++] = 't';
+	    break;
+	default:
+	    /* other controls, and bytes which are not UTF-8, as Latin-1 */
+	    if (ch < 0x20 || ch >= 0x7f) {
+		out += (size_t) sprintf(event + out, "\\u%04x", ch);
+	    } else {
+		event[out++] = (char) ch;
+	    }
+	    break;
+	}
+    }
+    free(text);
+
+    if (out > start) {
+	out += (size_t) sprintf(event + out, "\"]\n");
+	LogRingPut(screen, (Char *) event, out);
+    }
+}
+
 void
 StartLog(XtermWidget xw)
 {
@@ -2494,7 +3135,46 @@ StartLog(XtermWidget xw)
 					   screen->logfile,
 					   True)) < 0)
 	    return;
+	if (screen->log_async)
+	    screen->logfd = StartLogWriter(screen, screen->logfd);
+    }
+
+    memset(&log_ring, 0, sizeof(log_ring));
+    log_ring.format = (!x_strcasecmp(screen->log_format_s, "asciicast")
+		       ? lfAsciicast
+		       : lfRaw);
+    if (screen->logfd != STDOUT_FILENO) {
+	struct stat sb;
+
+	if (fstat(screen->logfd, &sb) == 0 && S_ISFIFO(sb.st_mode)) {
+	    log_ring.size = (size_t) Max(screen->log_buffer_size, 4) * 1024;
+	    if ((log_ring.data = malloc(log_ring.size)) != NULL) {
+		int mode = fcntl(screen->logfd, F_GETFL, 0);
+		if (mode >= 0
+		    && fcntl(screen->logfd, F_SETFL, mode | O_NONBLOCK) == 0) {
+		    log_ring.nonblocking = True;
+		}
+		(void) fcntl(screen->logfd, F_SETFD, 1);
+	    }
+	}
     }
+    TRACE(("StartLog %s format %s, %s\n",
+	   screen->logfile,
+	   log_ring.format == lfAsciicast ? "asciicast" : "raw",
+	   log_ring.nonblocking ? "buffered" : "direct"));
+
+    if (log_ring.format == lfAsciicast) {
+	char header[120];
+
+	X_GETTIMEOFDAY(&log_ring.started);
+	sprintf(header,
+		"{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %ld}\n",
+		MaxCols(screen),
+		MaxRows(screen),
+		(long) log_ring.started.tv_sec);
+	LogRingPut(screen, (Char *) header, strlen(header));
+    }
+
     screen->logstart = VTbuffer->next;
     screen->logging = True;
     update_logging();
@@ -2508,7 +3188,24 @@ CloseLog(XtermWidget xw)
     if (!screen->logging || (screen->inhibit & I_LOG))
 	return;
     FlushLog(xw);
+    if (log_ring.timer) {
+	XtRemoveTimeOut(log_ring.timer);
+	log_ring.timer = 0;
+    }
+    if (log_ring.used != 0) {
+	/* the user asked to stop, so it is fine to wait for the backlog */
+	int mode = fcntl(screen->logfd, F_GETFL, 0);
+	if (mode >= 0)
+	    (void) fcntl(screen->logfd, F_SETFL, mode & ~O_NONBLOCK);
+	LogRingDrain(screen);
+    }
+    if (log_ring.dropped != 0) {
+	xtermWarning("log %s lost %lu bytes while the writer was behind\n",
+		     screen->logfile, log_ring.dropped);
+    }
     close(screen->logfd);
+    FreeAndNull(log_ring.data);
+    log_ring.nonblocking = False;
     screen->logging = False;
     update_logging();
 }
@@ -2525,7 +3222,12 @@ FlushLog(XtermWidget xw)
 	cp = VTbuffer->next;
 	if (screen->logstart != NULL
 	    && (i = (size_t) (cp - screen->logstart)) > 0) {
-	    IGNORE_RC(write(screen->logfd, screen->logstart, i));
+	    if (log_ring.format == lfAsciicast)
+		LogAsciicast(screen, screen->logstart, i);
+	    else
+		LogRingPut(screen, screen->logstart, i);
+	} else if (log_ring.used != 0) {
+	    LogRingDrain(screen);
 	}
 	screen->logstart = VTbuffer->next;
     }
@@ -3310,8 +4012,13 @@ xtermFormatSGR(XtermWidget xw, char *target, unsigned attr, int fg, int bg)
 }
 
 #if OPT_PASTE64
+/*
+ * The whole OSC string has been accumulated by the parser, so the payload is
+ * decoded in one call per target.  'end' is the end of the string.
+ */
 static void
-ManipulateSelectionData(XtermWidget xw, TScreen *screen, char *buf, int final)
+ManipulateSelectionData(XtermWidget xw, TScreen *screen, char *buf,
+			const char *end, int final)
 {
 #define PDATA(a,b) { a, #b }
     static struct {
@@ -3393,20 +4100,16 @@ ManipulateSelectionData(XtermWidget xw, TScreen *screen, char *buf, int final)
 	    }
 	} else {
 	    if (AllowWindowOps(xw, ewSetSelection)) {
-		char *old = buf;
+		size_t len = (size_t) (end - buf);
 
-		TRACE(("Setting selection(%s) with %s\n", select_code, buf));
+		TRACE(("Setting selection(%s) with %lu bytes\n",
+		       select_code, (unsigned long) len));
 		screen->selection_time =
 		    XtLastTimestampProcessed(TScreenOf(xw)->display);
 
 		for (j = 0; j < num_targets; ++j) {
-		    buf = old;
 		    ClearSelectionBuffer(screen, select_args[j]);
-		    while (*buf != '\0') {
-			AppendToSelectionBuffer(screen,
-						CharOf(*buf++),
-						select_args[j]);
-		    }
+		    AppendToSelectionBuffer(screen, buf, len, select_args[j]);
 		}
 		CompleteSelection(xw, select_args, num_targets);
 	    }
@@ -4123,6 +4826,11 @@ do_osc(XtermWidget xw, Char *oscbuf, size_t len, int final)
 	return;
     }
 
+#ifdef OPT_LUA_SCRIPTING
+    if (lua_xterm_has_listeners())
+	lua_xterm_emit("osc", "is", mode, buf);
+#endif
+
     switch (mode) {
     case OSC_IconBoth:		/* new icon name and title */
 	ChangeIconName(xw, buf);
@@ -4284,7 +4992,7 @@ do_osc(XtermWidget xw, Char *oscbuf, size_t len, int final)
 
 #if OPT_PASTE64
     case OSC_SelectionData:
-	ManipulateSelectionData(xw, screen, buf, final);
+	ManipulateSelectionData(xw, screen, buf, (char *) oscbuf + len, final);
 	break;
 #endif
 
@@ -6303,6 +7011,10 @@ void
 ChangeTitle(XtermWidget xw, char *name)
 {
     ChangeGroup(xw, XtNtitle, name);
+#ifdef OPT_LUA_SCRIPTING
+    if (lua_xterm_has_listeners())
+	lua_xterm_emit("title", "s", name);
+#endif
 }
 
 #define Strlen(s) strlen((const char *)(s))
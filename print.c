@@ -55,6 +55,8 @@
 
 #define SPS PrinterOf(screen)
 
+#define PRINT_BUFSIZE	65536
+
 static void charToPrinter(XtermWidget /* xw */ ,
 			  unsigned /* chr */ );
 static void printLine(XtermWidget /* xw */ ,
@@ -69,6 +71,7 @@ static void send_SGR(XtermWidget /* xw */ ,
 		     unsigned /* bg */ );
 static void stringToPrinter(XtermWidget /* xw */ ,
 			    const char * /*str */ );
+static void openPrinter(XtermWidget /* xw */ );
 
 #if OPT_PRINT_GRAPHICS
 static void setGraphicsPrintToHost(XtermWidget /* xw */ ,
@@ -85,6 +88,7 @@ closePrinter(XtermWidget xw)
 	if (SPS.toFile) {
 	    fclose(SPS.fp);
 	    SPS.fp = NULL;
+	    FreeAndNull(SPS.buffer);
 	} else if (xtermHasPrinter(xw) != 0) {
 
 	    DEBUG_MSG("closePrinter\n");
@@ -95,12 +99,87 @@ closePrinter(XtermWidget xw)
 	    }
 	    SPS.fp = NULL;
 	    SPS.isOpen = False;
+	    FreeAndNull(SPS.buffer);
 	    TRACE(("closed printer\n"));
 	    DEBUG_MSG("...closePrinter (done)\n");
 	}
     }
 }
 
+/*
+ * Send what is buffered for the printer, e.g., at the end of a job which
+ * leaves the printer open.
+ */
+static void
+flushPrinter(XtermWidget xw)
+{
+    TScreen *screen = TScreenOf(xw);
+
+    if (SPS.fp != NULL)
+	fflush(SPS.fp);
+}
+
+/*
+ * Printing the whole history a line at a time makes a system call per line.
+ * Give the printer a buffer large enough to write it in a few large chunks.
+ */
+static void
+bufferPrinter(XtermWidget xw)
+{
+    TScreen *screen = TScreenOf(xw);
+
+    if (SPS.fp != NULL
+	&& SPS.buffer == NULL
+	&& (SPS.buffer = malloc((size_t) PRINT_BUFSIZE)) != NULL) {
+	if (setvbuf(SPS.fp, SPS.buffer, _IOFBF, (size_t) PRINT_BUFSIZE) != 0)
+	    FreeAndNull(SPS.buffer);
+    }
+}
+
+/*
+ * A job which opens and closes the printer by itself can be written by a
+ * copy of xterm, so that a long history or a slow printer does not stop
+ * xterm from reading the pty.  The copy has its own snapshot of the saved
+ * lines, and only writes to the printer.
+ *
+ * Returns zero in the copy, which must call finishPrintJob, a positive value
+ * in xterm once the copy is started, or -1 if the job should be printed here.
+ */
+static int
+startPrintJob(XtermWidget xw)
+{
+    TScreen *screen = TScreenOf(xw);
+    int result = -1;
+
+    if (SPS.printer_async && !SPS.isOpen) {
+	openPrinter(xw);
+	if (SPS.fp != NULL) {
+	    pid_t pid = fork();
+
+	    if (pid == 0) {
+		TRACE_CLOSE();
+		close(screen->respond);
+		close(ConnectionNumber(screen->display));
+		result = 0;
+	    } else if (pid > 0) {
+		TRACE(("started print job %d\n", (int) pid));
+		result = 1;
+	    }
+	}
+    }
+    return result;
+}
+
+static void
+finishPrintJob(XtermWidget xw)
+{
+    TScreen *screen = TScreenOf(xw);
+
+    if (SPS.fp != NULL)
+	fclose(SPS.fp);
+    _exit(0);
+}
+
 static void
 printCursorLine(XtermWidget xw)
 {
@@ -108,6 +187,7 @@ printCursorLine(XtermWidget xw)
 
     TRACE(("printCursorLine\n"));
     printLine(xw, screen->cur_row, '\n', getPrinterFlags(xw, NULL, NULL));
+    flushPrinter(xw);
 }
 
 /*
@@ -151,13 +231,14 @@ printLine(XtermWidget xw, int row, unsigned chr, PrinterFlags *p)
 	int col;
 	int cs = CSET_IN;
 	int last_cs = CSET_IN;
+	IAttr attr = 0;
 
 	if (p->print_attributes) {
 	    send_CharSet(xw, ld);
 	    send_SGR(xw, 0, NO_COLOR, NO_COLOR);
 	}
+	/* send SGR once per run of cells with the same attributes */
 	for (col = 0; col < last; col++) {
-	    IAttr attr = 0;
 	    unsigned ch = ld->charData[col];
 #if OPT_PRINT_COLORS
 	    if (screen->colorMode) {
@@ -275,6 +356,8 @@ xtermPrintScreen(XtermWidget xw, Bool use_DECPEX, PrinterFlags *p)
 
 	if (!was_open || SPS.printer_autoclose) {
 	    closePrinter(xw);
+	} else {
+	    flushPrinter(xw);
 	}
     } else {
 	Bell(xw, XkbBI_MinorError, 0);
@@ -299,46 +382,159 @@ xtermPrintEverything(XtermWidget xw, PrinterFlags *p)
     TScreen *screen = TScreenOf(xw);
     Boolean was_open = SPS.isOpen;
     int save_which = screen->whichBuf;
+    int job;
 
     DEBUG_MSG("xtermPrintEverything\n");
 
-    if (p->print_everything) {
-	int done_which = 0;
+    if ((job = startPrintJob(xw)) <= 0) {
+	if (p->print_everything) {
+	    int done_which = 0;
 
-	if (p->print_everything & 8) {
-	    printLines(xw, -screen->savedlines, -(screen->topline + 1), p);
-	}
-	if (p->print_everything & 4) {
-	    SwitchBufPtrs(xw, 1);
-	    done_which |= 2;
-	    printLines(xw, 0, screen->max_row, p);
-	    SwitchBufPtrs(xw, save_which);
-	}
-	if (p->print_everything & 2) {
-	    SwitchBufPtrs(xw, 0);
-	    done_which |= 1;
-	    printLines(xw, 0, screen->max_row, p);
-	    SwitchBufPtrs(xw, save_which);
-	}
-	if (p->print_everything & 1) {
-	    if (!(done_which & (1 << screen->whichBuf))) {
+	    if (p->print_everything & 8) {
+		printLines(xw, -screen->savedlines, -(screen->topline + 1), p);
+	    }
+	    if (p->print_everything & 4) {
+		SwitchBufPtrs(xw, 1);
+		done_which |= 2;
 		printLines(xw, 0, screen->max_row, p);
+		SwitchBufPtrs(xw, save_which);
 	    }
+	    if (p->print_everything & 2) {
+		SwitchBufPtrs(xw, 0);
+		done_which |= 1;
+		printLines(xw, 0, screen->max_row, p);
+		SwitchBufPtrs(xw, save_which);
+	    }
+	    if (p->print_everything & 1) {
+		if (!(done_which & (1 << screen->whichBuf))) {
+		    printLines(xw, 0, screen->max_row, p);
+		}
+	    }
+	} else {
+	    int top = 0;
+	    int bot = screen->max_row;
+	    if (!screen->whichBuf) {
+		top = -screen->savedlines - screen->topline;
+		bot -= screen->topline;
+	    }
+	    printLines(xw, top, bot, p);
 	}
-    } else {
-	int top = 0;
-	int bot = screen->max_row;
-	if (!screen->whichBuf) {
-	    top = -screen->savedlines - screen->topline;
-	    bot -= screen->topline;
-	}
-	printLines(xw, top, bot, p);
+	if (p->printer_formfeed)
+	    charToPrinter(xw, '\f');
+	if (job == 0)
+	    finishPrintJob(xw);
     }
-    if (p->printer_formfeed)
-	charToPrinter(xw, '\f');
 
     if (!was_open || SPS.printer_autoclose) {
 	closePrinter(xw);
+    } else {
+	flushPrinter(xw);
+    }
+}
+
+static Boolean
+rowNumber(String param, int *value)
+{
+    char *next;
+
+    *value = (int) strtol(param, &next, 10);
+    return (next != param && *next == '\0');
+}
+
+/*
+ * Print a range of rows, e.g., part of the saved lines, for the print-lines
+ * action.  The parameters may give
+ *	nothing, for the visible screen,
+ *	"all", for the saved lines as well as the screen,
+ *	a pair of row numbers, counting saved lines as negative,
+ *	">file" or "|command" to send the rows there rather than to the
+ *	printerCommand, and
+ *	any of the flags which are allowed for the print action.
+ */
+void
+xtermPrintLines(XtermWidget xw, String *params, Cardinal *param_count)
+{
+    TScreen *screen = TScreenOf(xw);
+    PrinterState save_state = screen->printer_state;
+    String target = NULL;
+    Boolean all = False;
+    Cardinal nrows = 0;
+    Cardinal n;
+    Boolean ok = True;
+    int rows[2];
+    int first = 0;
+    int last = screen->max_row;
+    int lowest = screen->whichBuf ? 0 : -screen->savedlines;
+
+    for (n = 0; n < *param_count; ++n) {
+	String param = params[n];
+	int value;
+
+	if (*param == '>' || *param == '|') {
+	    target = param;
+	} else if (!x_strcasecmp(param, "all")) {
+	    all = True;
+	} else if (rowNumber(param, &value)) {
+	    if (nrows < 2)
+		rows[nrows] = value;
+	    ++nrows;
+	}
+    }
+
+    if (all) {
+	first = lowest;
+	ok = (nrows == 0);
+    } else if (nrows == 2) {
+	first = rows[0];
+	last = rows[1];
+    } else if (nrows != 0) {
+	ok = False;
+    }
+    if (first < lowest)
+	first = lowest;
+    if (last > screen->max_row)
+	last = screen->max_row;
+    if (target != NULL && IsEmpty(target + 1))
+	ok = False;
+
+    TRACE(("xtermPrintLines %d..%d to %s\n", first, last, NonNull(target)));
+    if (ok && first <= last) {
+	PrinterFlags *p = getPrinterFlags(xw, params, param_count);
+	mode_t save_umask = 0;
+	Boolean was_open;
+	int job;
+
+	if (target != NULL) {
+	    save_umask = umask(0177);
+	    SPS.fp = NULL;
+	    SPS.isOpen = False;
+	    SPS.buffer = NULL;
+	    SPS.toFile = (*target == '>');
+	    SPS.printer_checked = False;
+	    SPS.printer_command = target + 1;
+	    SPS.printer_autoclose = True;
+	}
+	was_open = SPS.isOpen;
+
+	if ((job = startPrintJob(xw)) <= 0) {
+	    printLines(xw, INX2ROW(screen, first), INX2ROW(screen, last), p);
+	    if (p->printer_formfeed)
+		charToPrinter(xw, '\f');
+	    if (job == 0)
+		finishPrintJob(xw);
+	}
+
+	if (!was_open || SPS.printer_autoclose) {
+	    closePrinter(xw);
+	} else {
+	    flushPrinter(xw);
+	}
+	if (target != NULL) {
+	    umask(save_umask);
+	    screen->printer_state = save_state;
+	}
+    } else {
+	Bell(xw, XkbBI_MinorError, 0);
     }
 }
 
@@ -391,26 +587,14 @@ send_SGR(XtermWidget xw, unsigned attr, unsigned fg, unsigned bg)
 }
 
 /*
- * This implementation only knows how to write to a pipe.
+ * Open the printer, i.e., the file or the pipe to a subprocess which runs the
+ * printer command.
  */
 static void
-charToPrinter(XtermWidget xw, unsigned chr)
+openPrinter(XtermWidget xw)
 {
     TScreen *screen = TScreenOf(xw);
 
-    if (!screen->print_rawchars) {
-#if OPT_WIDE_CHARS
-	if (screen->wide_chars && screen->utf8_mode) {
-	    if (chr == UCS_REPL) {
-		stringToPrinter(xw, screen->default_string);
-		return;
-	    }
-	}
-#endif
-	if (is_NON_CHAR(chr))
-	    return;
-    }
-
     if (!SPS.isOpen && (SPS.toFile || xtermHasPrinter(xw))) {
 	switch (SPS.toFile) {
 	    /*
@@ -427,7 +611,7 @@ charToPrinter(XtermWidget xw, unsigned chr)
 		    SysError(ERROR_FORK);
 
 		if (my_pid == 0) {
-		    DEBUG_MSG("charToPrinter: subprocess for printer\n");
+		    DEBUG_MSG("openPrinter: subprocess for printer\n");
 		    TRACE_CLOSE();
 		    close(my_pipe[1]);	/* printer is silent */
 		    close(screen->respond);
@@ -446,44 +630,48 @@ charToPrinter(XtermWidget xw, unsigned chr)
 
 		    SPS.fp = popen(SPS.printer_command, "w");
 		    if (SPS.fp != NULL) {
-			FILE *input;
-			DEBUG_MSG("charToPrinter: opened pipe to printer\n");
-			if ((input = fdopen(my_pipe[0], "r")) != NULL) {
-			    clearerr(input);
+			char *input = malloc((size_t) PRINT_BUFSIZE);
 
+			DEBUG_MSG("openPrinter: opened pipe to printer\n");
+			if (input != NULL) {
 			    for (;;) {
-				int c;
-
-				if (ferror(input)) {
-				    DEBUG_MSG("charToPrinter: break on ferror\n");
+				ssize_t got = read(my_pipe[0],
+						   input,
+						   (size_t) PRINT_BUFSIZE);
+
+				if (got < 0 && errno == EINTR) {
+				    continue;
+				} else if (got < 0) {
+				    DEBUG_MSG("openPrinter: break on error\n");
 				    break;
-				} else if (feof(input)) {
-				    DEBUG_MSG("charToPrinter: break on feof\n");
+				} else if (got == 0) {
+				    DEBUG_MSG("openPrinter: break on EOF\n");
 				    break;
-				} else if ((c = fgetc(input)) == EOF) {
-				    DEBUG_MSG("charToPrinter: break on EOF\n");
+				}
+				/* pass along whatever we have, in one chunk */
+				if (fwrite(input, sizeof(char), (size_t) got,
+					   SPS.fp) != (size_t) got
+				    || fflush(SPS.fp) != 0) {
+				    DEBUG_MSG("openPrinter: break on ferror\n");
 				    break;
 				}
-				fputc(c, SPS.fp);
-				if (isForm(c))
-				    fflush(SPS.fp);
 			    }
+			    free(input);
 			}
-			DEBUG_MSG("charToPrinter: calling pclose\n");
+			DEBUG_MSG("openPrinter: calling pclose\n");
 			pclose(SPS.fp);
-			if (input)
-			    fclose(input);
 		    }
+		    close(my_pipe[0]);
 		    exit(0);
 		} else {
 		    close(my_pipe[0]);	/* won't read from printer */
 		    if ((SPS.fp = fdopen(my_pipe[1], "w")) != NULL) {
-			DEBUG_MSG("charToPrinter: opened printer in parent\n");
+			DEBUG_MSG("openPrinter: opened printer in parent\n");
 			TRACE(("opened printer from pid %d/%d\n",
 			       (int) getpid(), (int) my_pid));
 		    } else {
 			TRACE(("failed to open printer:%s\n", strerror(errno)));
-			DEBUG_MSG("charToPrinter: could not open in parent\n");
+			DEBUG_MSG("openPrinter: could not open in parent\n");
 		    }
 		}
 	    }
@@ -493,8 +681,38 @@ charToPrinter(XtermWidget xw, unsigned chr)
 	    SPS.fp = fopen(SPS.printer_command, "w");
 	    break;
 	}
+	bufferPrinter(xw);
 	SPS.isOpen = True;
     }
+}
+
+/*
+ * This implementation only knows how to write to a pipe.
+ *
+ * Output is buffered, and flushed at the end of each page or job.  In printer
+ * controller mode, the host expects each line to be printed as it is sent.
+ */
+static void
+charToPrinter(XtermWidget xw, unsigned chr)
+{
+    TScreen *screen = TScreenOf(xw);
+
+    if (!screen->print_rawchars) {
+#if OPT_WIDE_CHARS
+	if (screen->wide_chars && screen->utf8_mode) {
+	    if (chr == UCS_REPL) {
+		stringToPrinter(xw, screen->default_string);
+		return;
+	    }
+	}
+#endif
+	if (is_NON_CHAR(chr))
+	    return;
+    }
+
+    if (!SPS.isOpen)
+	openPrinter(xw);
+
     if (SPS.fp != NULL) {
 #if OPT_WIDE_CHARS
 	if (chr > 127) {
@@ -503,8 +721,9 @@ charToPrinter(XtermWidget xw, unsigned chr)
 	    fputs((char *) temp, SPS.fp);
 	} else
 #endif
-	    fputc((int) chr, SPS.fp);
-	if (isForm(chr))
+	    putc((int) chr, SPS.fp);
+	if (chr == '\f'
+	    || (SPS.printer_controlmode == 2 && isForm(chr)))
 	    fflush(SPS.fp);
     }
 }
@@ -568,10 +787,17 @@ xtermMediaControl(XtermWidget xw, int param, int private_seq)
 	    break;
 #if OPT_SCREEN_DUMPS
 	case 10:
-	    xtermDumpHtml(xw);
-	    break;
 	case 11:
-	    xtermDumpSvg(xw);
+	    {
+		int first, last;
+
+		if (xtermDumpRange(xw, NULL, 0, &first, &last)) {
+		    if (param == 10)
+			xtermDumpHtml(xw, first, last);
+		    else
+			xtermDumpSvg(xw, first, last);
+		}
+	    }
 	    break;
 #endif
 	}
@@ -653,6 +879,8 @@ xtermPrinterControl(XtermWidget xw, int chr)
 		if (SPS.printer_autoclose
 		    && SPS.printer_controlmode == 0)
 		    closePrinter(xw);
+		else
+		    flushPrinter(xw);
 		length = 0;
 		return 0;
 	    } else if (len > length
@@ -813,6 +1041,7 @@ xtermPrintImmediately(XtermWidget xw, String filename, int opts, int attrs)
 	timestamp_filename(my_filename, filename);
 	SPS.fp = NULL;
 	SPS.isOpen = False;
+	SPS.buffer = NULL;
 	SPS.toFile = True;
 	SPS.printer_command = my_filename;
 	SPS.printer_autoclose = True;
@@ -850,6 +1079,8 @@ xtermPrintOnXError(XtermWidget xw, int n)
 	}
 
 	if (printIt) {
+	    /* xterm is exiting, so finish the job before it does */
+	    PrinterOf(TScreenOf(xw)).printer_async = False;
 	    xtermPrintImmediately(xw,
 				  resource.printFileOnXError,
 				  resource.printOptsOnXError,
@@ -35,6 +35,7 @@
 #if OPT_WIDE_CHARS
 #include <menu.h>
 #include <wcwidth.h>
+#include <fontutils.h>
 #endif
 
 #ifdef TEST_DRIVER
@@ -620,6 +621,38 @@ writePtyData(int f, IChar *d, size_t len)
 }
 #endif /* OPT_WIDE_CHARS */
 
+/*
+ * Convert the character 'ch' of a screen cell to UTF-8, storing the result
+ * in the target 'lp', which must have room for 8 bytes, and returning a
+ * pointer past it.  An empty cell is a space, and DEC graphics characters are
+ * mapped to Unicode.  Without wide characters, controls are shown as '?'.
+ */
+Char *
+convertCellToUTF8(TScreen *screen, Char *lp, unsigned ch)
+{
+    (void) screen;
+    if (ch == 0) {
+	ch = ' ';
+    }
+#if OPT_WIDE_CHARS
+    if (ch < ' ') {
+	ch = dec2ucs(screen, ch);
+    }
+    lp = convertToUTF8(lp, ch);
+#else
+    if (ch < ' ' || ch == 0x7f) {
+	ch = '?';
+    }
+    if (ch < 0x80) {
+	*lp++ = (Char) ch;
+    } else {
+	*lp++ = (Char) (0xc0 | (ch >> 6));
+	*lp++ = (Char) (0x80 | (ch & 0x3f));
+    }
+#endif
+    return lp;
+}
+
 #ifdef NO_LEAKS
 void
 noleaks_ptydata(void)
@@ -677,6 +710,13 @@ mk_wcwidth_init(int mode)
     (void) mode;
 }
 
+unsigned
+dec2ucs(TScreen *screen, unsigned ch)
+{
+    (void) screen;
+    return ch;
+}
+
 void
 update_font_utf8_mode(void)
 {
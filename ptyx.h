@@ -779,6 +779,10 @@ typedef enum {
 #define OPT_SHIFT_FONTS 1 /* true if xterm interprets fontsize-shifting */
 #endif
 
+#ifndef OPT_SNAPSHOT
+#define OPT_SNAPSHOT	1 /* true if xterm can save and restore sessions */
+#endif
+
 #ifndef OPT_STATUS_LINE
 #define OPT_STATUS_LINE	0 /* true if xterm supports status-line controls */
 #endif
@@ -2231,12 +2235,23 @@ typedef struct {
 	int	print_everything;	/* 0=all, 1=dft, 2=alt, 3=saved */
 } PrinterFlags;
 
+#if OPT_SCREEN_DUMPS
+/* the look of a cell in a screen dump, set in xtermDumpStyle */
+typedef struct {
+	unsigned	flags;		/* BOLD, UNDERLINE, etc.	*/
+	int		fg;		/* index in the dump's colors	*/
+	int		bg;
+} DumpStyle;
+#endif
+
 typedef struct {
 	FILE *	fp;			/* output file/pipe used	*/
+	char *	buffer;			/* stdio buffer for fp		*/
 	Boolean isOpen;			/* output was opened/tried	*/
 	Boolean toFile;			/* true when directly to file	*/
 	Boolean printer_checked;	/* printer_command is checked	*/
 	String	printer_command;	/* pipe/shell command string	*/
+	Boolean printer_async;		/* print jobs from a subprocess	*/
 	Boolean printer_autoclose;	/* close printer when offline	*/
 	Boolean printer_extent;		/* print complete page		*/
 	Boolean printer_formfeed;	/* print formfeed per function	*/
@@ -2569,7 +2584,6 @@ typedef struct {
 	 */
 	unsigned	base64_accu;
 	unsigned	base64_count;
-	unsigned	base64_pad;
 #endif
 #if OPT_PASTE64 || OPT_READLINE
 	unsigned	paste_brackets;
@@ -2651,6 +2665,9 @@ typedef struct {
 	int		logfd;		/* file descriptor of log	*/
 	char		*logfile;	/* log file name		*/
 	Char		*logstart;	/* current start of log buffer	*/
+	Boolean		log_async;	/* write files from a child	*/
+	int		log_buffer_size; /* kilobytes for log backlog	*/
+	char		*log_format_s;	/* "raw" or "asciicast"		*/
 #endif
 	int		inhibit;	/* flags for inhibiting changes	*/
 
@@ -2758,8 +2775,14 @@ typedef struct {
 	 */
 	int		topline;	/* line number of top, <= 0	*/
 	long		saved_fifo;     /* number of lines that've ever been saved */
+	long		saved_total;	/* like saved_fifo, but never wraps */
 	int		savedlines;     /* number of lines that've been saved */
 	int		savelines;	/* number of lines off top to save */
+#if OPT_SNAPSHOT
+	char		*snapshot_file;	/* where to save the session	*/
+	int		snapshot_interval; /* seconds between snapshots	*/
+	Boolean		snapshot_restore; /* load the snapshot at startup */
+#endif
 	int		scroll_amt;	/* amount to scroll		*/
 	int		refresh_amt;	/* amount to refresh		*/
 	/*
@@ -2794,6 +2817,10 @@ typedef struct {
 	Boolean		alternateScroll; /* scroll-actions become keys */
 	Boolean		scrollttyoutput; /* scroll to bottom on tty output */
 	Boolean		scrollkey;	/* scroll to bottom on key	*/
+	Boolean		search_index;	/* keep a trigram index of saved lines */
+	Boolean		reflow_lines;	/* rewrap wrapped lines on resize */
+	int		resize_delay;	/* msecs to wait for the final size */
+	XtIntervalId	resize_timer;	/* timer-id for a pending resize */
 	Boolean		cursor_moved;	/* scrolling makes cursor move	*/
 
 	Boolean		do_wrap;	/* true if cursor in last column
@@ -2874,6 +2901,7 @@ typedef struct {
 	String		graphics_max_size;	/* given a size in pixels */
 	Dimension	graphics_max_wide;	/* ...corresponding width */
 	Dimension	graphics_max_high;	/* ...and height          */
+	int		graphics_max_memory;	/* kilobytes for pixels   */
 #endif
 
 #if OPT_SCROLL_LOCK
@@ -3021,6 +3049,7 @@ typedef struct {
 	int		startHCoord, endHCoord;
 	int		firstValidRow;	/* Valid rows for selection clipping */
 	int		lastValidRow;	/* " " */
+	unsigned long	cell_writes;	/* bumped when cells may change */
 
 #if OPT_BLOCK_SELECT
 	int		lastSelectWasBlock;
@@ -34,7 +34,8 @@ local function load_user_scripts()
   if file then
     file:close()
     utils.log("Loading user init script: " .. init_script)
-    local success, err = pcall(dofile, init_script)
+    -- require (rather than dofile) lets trex watch and reload it
+    local success, err = pcall(require, "init")
     if not success then
       utils.log("Error loading " .. init_script .. ": " .. tostring(err))
     else
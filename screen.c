@@ -73,6 +73,10 @@
 
 #include <graphics.h>
 
+#ifdef OPT_LUA_SCRIPTING
+#include <lua_api.h>
+#endif
+
 #define inSaveBuf(screen, buf, inx) \
 	((buf) == (screen)->saveBuf_index && \
 	 ((inx) < (screen)->savelines || (screen)->savelines == 0))
@@ -2083,6 +2087,240 @@ allocLineData(TScreen *screen, LineData *source)
 #undef ALLOC_IT
 #endif /* OPT_STATUS_LINE */
 
+/*
+ * Return the number of cells up to and including the last one drawn.
+ */
+static int
+usedCells(CLineData *ld)
+{
+    int col = (int) ld->lineSize;
+
+    while (col > 0 && !(ld->attribs[col - 1] & CHARDRAWN))
+	--col;
+    return col;
+}
+
+#define CopyLineCells(name) \
+	memcpy(dst->name + dcol, src->name + scol, \
+	       (size_t) count * sizeof(dst->name[0]))
+
+static void
+copyLineCells(LineData *dst, int dcol, CLineData *src, int scol, int count)
+{
+    CopyLineCells(attribs);
+    CopyLineCells(charData);
+#if OPT_ISO_COLORS
+    CopyLineCells(color);
+#endif
+#if OPT_DEC_RECTOPS
+    CopyLineCells(charSeen);
+    CopyLineCells(charSets);
+#endif
+#if OPT_WIDE_CHARS
+    {
+	size_t off;
+
+	for (off = 0; off < dst->combSize; ++off) {
+	    if (off < src->combSize) {
+		CopyLineCells(combData[off]);
+	    } else {
+		memset(dst->combData[off] + dcol, 0,
+		       (size_t) count * sizeof(dst->combData[off][0]));
+	    }
+	}
+    }
+#endif
+}
+
+#undef CopyLineCells
+
+/*
+ * Rewrap the rows first..last of the edit buffer, which form one logical line
+ * (all but the last are marked wrapped), to the given number of columns.  The
+ * result starts on row "out" of the target buffer.  If the cursor is on one
+ * of the rows, update its position.  Returns the number of rows needed; with
+ * a null target, that is all this does.
+ */
+static int
+reflowLine(TScreen *screen,
+	   ScrnBuf target,
+	   int out,
+	   int first,
+	   int last,
+	   int cols,
+	   int *cur_row,
+	   int *cur_col)
+{
+    int drow = 0;
+    int dcol = 0;
+    int need = 1;
+    int row;
+
+    for (row = first; row <= last; ++row) {
+	CLineData *src = getLineData(screen, row);
+	int used = usedCells(src);
+	int scol = 0;
+	Bool found = (row != screen->cur_row);
+
+	while (scol < used) {
+	    int span;
+
+	    if (dcol >= cols) {
+		if (target != NULL) {
+		    LineData *dst = (LineData *) scrnHeadAddr(screen, target,
+							      (unsigned) (out + drow));
+		    LineSetWrapped(dst);
+		}
+		++drow;
+		dcol = 0;
+	    }
+	    span = Min(used - scol, cols - dcol);
+#if OPT_WIDE_CHARS
+	    /* do not split a double-width character across rows */
+	    if (scol + span < used
+		&& src->charData[scol + span] == HIDDEN_CHAR
+		&& (span > 1 || dcol > 0)) {
+		if (--span == 0) {
+		    dcol = cols;
+		    continue;
+		}
+	    }
+#endif
+	    if (!found
+		&& screen->cur_col >= scol
+		&& screen->cur_col < scol + span) {
+		*cur_row = out + drow;
+		*cur_col = dcol + (screen->cur_col - scol);
+		found = True;
+	    }
+	    if (target != NULL) {
+		LineData *dst = (LineData *) scrnHeadAddr(screen, target,
+							  (unsigned) (out + drow));
+		copyLineCells(dst, dcol, src, scol, span);
+		if (LineTstBlinked(src))
+		    LineSetBlinked(dst);
+	    }
+	    scol += span;
+	    dcol += span;
+	}
+
+	if (!found) {
+	    /* the cursor is past the text on its row */
+	    int col = dcol + (screen->cur_col - used);
+
+	    *cur_row = out + drow + (col / cols);
+	    *cur_col = col % cols;
+	    need = Max(need, drow + (col / cols) + 1);
+	}
+    }
+    return Max(need, drow + 1);
+}
+
+/*
+ * Rewrap the text on the visible screen to a new width, keeping its height,
+ * and set the new width.  Lines which are pushed off the top go into the
+ * scrollback.  The scrollback itself is left alone; its lines are shown at the
+ * width they were saved with.
+ *
+ * Returns false if the screen cannot be reflowed, e.g., because it has
+ * double-size lines, leaving the caller to truncate or extend the rows.
+ */
+static Bool
+reflowEditBuf(XtermWidget xw, int cols)
+{
+    TScreen *screen = TScreenOf(xw);
+    int rows = MaxRows(screen);
+    int last = screen->max_row;
+    int cur_row = 0;
+    int cur_col = 0;
+    int total;
+    int overflow;
+    int row;
+    int n;
+    ScrnBuf head;
+    Char *data;
+
+    while (last > screen->cur_row && usedCells(getLineData(screen, last)) == 0)
+	--last;
+
+#if OPT_DEC_CHRSET
+    for (row = 0; row <= last; ++row) {
+	if (CSET_DOUBLE(GetLineDblCS(getLineData(screen, row))))
+	    return False;
+    }
+#endif
+
+    TRACE(("reflowEditBuf %dx%d -> %dx%d\n", rows, MaxCols(screen), rows, cols));
+
+    /* count the rows needed at the new width */
+    for (row = 0, total = 0; row <= last;) {
+	int next = row;
+
+	while (next < last && LineTstWrapped(getLineData(screen, next)))
+	    ++next;
+	total += reflowLine(screen, NULL, total, row, next, cols,
+			    &cur_row, &cur_col);
+	row = next + 1;
+    }
+
+    n = Max(total, rows);
+    head = allocScrnHead(screen, (unsigned) n);
+    data = allocScrnData(screen, (unsigned) n, (unsigned) cols, False);
+    setupLineData(screen, head, data, (unsigned) n, (unsigned) cols, False);
+
+    for (row = 0, total = 0; row <= last;) {
+	int next = row;
+
+	while (next < last && LineTstWrapped(getLineData(screen, next)))
+	    ++next;
+	total += reflowLine(screen, head, total, row, next, cols,
+			    &cur_row, &cur_col);
+	row = next + 1;
+    }
+
+    /* scroll off as much as fits, but keep the cursor on the screen */
+    overflow = Min(n - rows, cur_row);
+    TRACE(("...reflowed %d rows, %d scrolled off\n", total, overflow));
+
+    ScrnDisownSelection(xw);
+    (void) Reallocate(xw,
+		      &screen->editBuf_index[0],
+		      &screen->editBuf_data[0],
+		      (unsigned) rows,
+		      (unsigned) cols,
+		      (unsigned) rows);
+    screen->visbuf = VisBuf(screen);
+    set_max_col(screen, cols - 1);
+
+    for (row = 0; row < overflow; ++row) {
+	LineData *dst = addScrollback(screen);
+
+	if (dst != NULL) {
+	    copyLineData(dst, (LineData *) scrnHeadAddr(screen, head,
+							(unsigned) row));
+	    if (screen->savedlines < screen->savelines)
+		screen->savedlines++;
+	}
+    }
+    for (row = 0; row < rows; ++row) {
+	LineData *dst = getLineData(screen, row);
+	int from = row + overflow;
+
+	if (from < n) {
+	    copyLineData(dst, (LineData *) scrnHeadAddr(screen, head,
+							(unsigned) from));
+	}
+    }
+
+    set_cur_row(screen, Min(cur_row - overflow, screen->max_row));
+    set_cur_col(screen, Min(cur_col, screen->max_col));
+    screen->do_wrap = False;
+
+    free(data);
+    free(head);
+    return True;
+}
+
 /*
   Resizes screen:
   1. If new window would have fractional characters, sets window size so as to
@@ -2193,10 +2431,23 @@ ScreenResize(XtermWidget xw,
 	TRACE(("...ScreenResize chars %dx%d delta %dx%d\n",
 	       rows, cols, delta_rows, delta_cols));
 
+	screen->cell_writes++;
+
 	if (screen->is_running) {
 	    if (screen->cursor_state)
 		HideCursor(xw);
 
+	    /*
+	     * Rewrap the normal screen's text to the new width first.  What is
+	     * left is a change of rows, which the rest of this handles.
+	     */
+	    if (MaxCols(screen) != cols
+		&& screen->reflow_lines
+		&& screen->whichBuf == 0
+		&& screen->editBuf_index[0] != NULL) {
+		(void) reflowEditBuf(xw, cols);
+	    }
+
 	    /*
 	     * The non-visible buffer is simple, since we will not copy data
 	     * to/from the saved-lines.  Do that first.
@@ -2420,6 +2671,13 @@ ScreenResize(XtermWidget xw,
 #else
     TRACE(("ScreenResize cannot do anything to pty\n"));
 #endif /* TTYSIZE_STRUCT */
+
+#ifdef OPT_LUA_SCRIPTING
+    if (lua_xterm_has_hook(LUA_HOOK_RESIZE))
+	lua_xterm_call_hook(LUA_HOOK_RESIZE, rows, cols);
+    if (lua_xterm_has_listeners())
+	lua_xterm_emit("resize", "ii", rows, cols);
+#endif
     return;
 }
 
@@ -2541,6 +2799,25 @@ validRect(XtermWidget xw, XTermRect *target)
     return result;
 }
 
+/*
+ * The rectangle operations work on a span of columns of each row.  Fill
+ * arrays whose elements are wider than a byte by doubling the filled part.
+ */
+static void
+fillSpan(void *target, const void *value, size_t size, size_t count)
+{
+    char *t = (char *) target;
+    size_t have;
+
+    if (count == 0)
+	return;
+    memcpy(t, value, size);
+    for (have = 1; have < count; have *= 2) {
+	size_t more = Min(have, count - have);
+	memcpy(t + (have * size), t, more * size);
+    }
+}
+
 /*
  * Fills a rectangle with the given 8-bit character and video-attributes.
  * Colors and double-size attribute are unmodified.
@@ -2569,11 +2846,13 @@ ScrnFillRectangle(XtermWidget xw,
 	int numcols = (right - left) + 1;
 	int numrows = (bottom - top) + 1;
 	unsigned attrs = flags;
+	IAttr fill_attrs;
 	int row, col;
 	int b_left = 0;
 	int b_right = 0;
-
-	(void) numcols;
+#if OPT_ISO_COLORS
+	CellColor fill_color = xtermColorPair(xw);
+#endif
 
 	if (charset != nrc_ASCII) {
 	    xw->work.write_text = &actual;
@@ -2583,6 +2862,7 @@ ScrnFillRectangle(XtermWidget xw,
 
 	attrs &= ATTRIBUTES;
 	attrs |= CHARDRAWN;
+	fill_attrs = (IAttr) attrs;
 	for (row = bottom; row >= top; row--) {
 	    ld = getLineData(screen, row);
 
@@ -2608,28 +2888,29 @@ ScrnFillRectangle(XtermWidget xw,
 	    /*
 	     * Fill attributes, preserving colors.
 	     */
-	    for (col = left; col <= right; ++col) {
-		unsigned temp = ld->attribs[col];
-
-		if (!keepColors) {
-		    UIntClr(temp, (FG_COLOR | BG_COLOR));
+	    if (keepColors) {
+		for (col = left; col <= right; ++col) {
+		    ld->attribs[col] = (IAttr) (attrs
+						| (ld->attribs[col]
+						   & (FG_COLOR | BG_COLOR)));
 		}
-		temp = attrs | (temp & (FG_COLOR | BG_COLOR)) | CHARDRAWN;
-		ld->attribs[col] = (IAttr) temp;
-		if_OPT_ISO_COLORS(screen, {
-		    if (attrs & (FG_COLOR | BG_COLOR)) {
-			ld->color[col] = xtermColorPair(xw);
-		    }
-		});
+	    } else {
+		fillSpan(ld->attribs + left, &fill_attrs,
+			 sizeof(fill_attrs), (size_t) numcols);
 	    }
+	    if_OPT_ISO_COLORS(screen, {
+		if (attrs & (FG_COLOR | BG_COLOR)) {
+		    fillSpan(ld->color + left, &fill_color,
+			     sizeof(fill_color), (size_t) numcols);
+		}
+	    });
 
-	    for (col = left; col <= right; ++col) {
-		ld->charData[col] = actual;
+	    fillSpan(ld->charData + left, &actual,
+		     sizeof(actual), (size_t) numcols);
 #if OPT_DEC_RECTOPS
-		ld->charSeen[col] = (Char) value;
-		ld->charSets[col] = charset;
+	    memset(ld->charSeen + left, value, (size_t) numcols);
+	    memset(ld->charSets + left, charset, (size_t) numcols);
 #endif
-	    }
 
 	    if_OPT_WIDE_CHARS(screen, {
 		size_t off;
@@ -2654,6 +2935,161 @@ ScrnFillRectangle(XtermWidget xw,
 }
 
 #if OPT_DEC_RECTOPS
+/*
+ * A copy of the cells of a rectangle, with each field of LineData in its own
+ * array, so that each row of the rectangle is copied with memcpy.
+ */
+typedef struct {
+    Cardinal wide;
+    Cardinal high;
+    size_t combSize;
+    CharData *charData;
+#if OPT_WIDE_CHARS
+    CharData *combData;		/* combSize planes of wide * high cells */
+#endif
+#if OPT_ISO_COLORS
+    CellColor *color;
+#endif
+    IAttr *attribs;
+    Char *charSeen;
+    Char *charSets;
+} RectCells;
+
+#define RectSpan(rc, field, at) ((rc)->field + (at))
+#define RectComb(rc, off, at) ((rc)->combData + ((off) * (rc)->wide * (rc)->high) + (at))
+
+static void
+blankRectCell(RectCells *rc, size_t at)
+{
+    size_t off;
+
+    rc->charData[at] = ' ';
+    rc->charSeen[at] = ' ';
+    rc->charSets[at] = 0;
+#if OPT_WIDE_CHARS
+    for (off = 0; off < rc->combSize; ++off) {
+	*RectComb(rc, off, at) = 0;
+    }
+#else
+    (void) off;
+#endif
+}
+
+static Bool
+saveRectCells(TScreen *screen, RectCells *rc, XTermRect *source)
+{
+    size_t size;
+    size_t each;
+    Char *data;
+    Cardinal j;
+    int left = source->left - 1;
+
+    rc->high = (Cardinal) (source->bottom - source->top) + 1;
+    rc->wide = (Cardinal) (source->right - source->left) + 1;
+    rc->combSize = 0;
+#if OPT_WIDE_CHARS
+    if (screen->wide_chars)
+	rc->combSize = (size_t) screen->max_combining;
+#endif
+    size = (size_t) rc->high * (size_t) rc->wide;
+    each = ((1 + rc->combSize) * sizeof(CharData)
+#if OPT_ISO_COLORS
+	    + sizeof(CellColor)
+#endif
+	    + sizeof(IAttr)
+	    + 2);
+
+    /* largest types first, to keep each array aligned */
+    if ((data = (Char *) calloc(size, each)) == NULL)
+	return False;
+    rc->charData = (CharData *) (void *) data;
+    data += size * sizeof(CharData);
+#if OPT_WIDE_CHARS
+    rc->combData = (CharData *) (void *) data;
+    data += size * rc->combSize * sizeof(CharData);
+#endif
+#if OPT_ISO_COLORS
+    rc->color = (CellColor *) (void *) data;
+    data += size * sizeof(CellColor);
+#endif
+    rc->attribs = (IAttr *) (void *) data;
+    data += size * sizeof(IAttr);
+    rc->charSeen = data;
+    data += size;
+    rc->charSets = data;
+
+    for (j = 0; j < rc->high; ++j) {
+	LineData *ld = getLineData(screen, source->top - 1 + (int) j);
+	size_t at = (size_t) j * rc->wide;
+
+	if (ld == NULL)
+	    continue;
+	TRACE2(("ROW %d\n", source->top + (int) j));
+	memcpy(RectSpan(rc, charData, at), ld->charData + left,
+	       rc->wide * sizeof(CharData));
+	memcpy(RectSpan(rc, attribs, at), ld->attribs + left,
+	       rc->wide * sizeof(IAttr));
+	if_OPT_ISO_COLORS(screen, {
+	    memcpy(RectSpan(rc, color, at), ld->color + left,
+		   rc->wide * sizeof(CellColor));
+	});
+	memcpy(RectSpan(rc, charSeen, at), ld->charSeen + left, rc->wide);
+	memcpy(RectSpan(rc, charSets, at), ld->charSets + left, rc->wide);
+	if_OPT_WIDE_CHARS(screen, {
+	    size_t off;
+	    size_t last = at + rc->wide - 1;
+
+	    for (off = 0; off < rc->combSize && off < ld->combSize; ++off) {
+		memcpy(RectComb(rc, off, at), ld->combData[off] + left,
+		       rc->wide * sizeof(CharData));
+	    }
+
+	    /* do not copy half of a wide character */
+	    if (rc->charData[at] == HIDDEN_CHAR) {
+		blankRectCell(rc, at);
+	    }
+	    if (rc->charData[last] != HIDDEN_CHAR
+		&& WideCells(rc->charData[last]) > 1) {
+		blankRectCell(rc, last);
+	    }
+	});
+    }
+    return True;
+}
+
+/*
+ * Copy the first 'count' cells of row 'j' of the saved cells to the line,
+ * starting at column 'col'.
+ */
+static void
+restoreRectCells(TScreen *screen, RectCells *rc, Cardinal j, LineData *ld, int col, Cardinal count)
+{
+    size_t at = (size_t) j * rc->wide;
+
+    memcpy(ld->charData + col, RectSpan(rc, charData, at),
+	   count * sizeof(CharData));
+    memcpy(ld->attribs + col, RectSpan(rc, attribs, at),
+	   count * sizeof(IAttr));
+    if_OPT_ISO_COLORS(screen, {
+	memcpy(ld->color + col, RectSpan(rc, color, at),
+	       count * sizeof(CellColor));
+    });
+    memcpy(ld->charSeen + col, RectSpan(rc, charSeen, at), (size_t) count);
+    memcpy(ld->charSets + col, RectSpan(rc, charSets, at), (size_t) count);
+    if_OPT_WIDE_CHARS(screen, {
+	size_t off;
+
+	for (off = 0; off < ld->combSize; ++off) {
+	    if (off < rc->combSize) {
+		memcpy(ld->combData[off] + col, RectComb(rc, off, at),
+		       count * sizeof(CharData));
+	    } else {
+		memset(ld->combData[off] + col, 0, count * sizeof(CharData));
+	    }
+	}
+    });
+}
+
 /*
  * Copies the source rectangle to the target location, including video
  * attributes.
@@ -2681,65 +3117,47 @@ ScrnCopyRectangle(XtermWidget xw, XTermRect *source, int nparam, int *params)
 		       params,
 		       &target);
 	if (validRect(xw, &target)) {
-	    Cardinal high = (Cardinal) (source->bottom - source->top) + 1;
-	    Cardinal wide = (Cardinal) (source->right - source->left) + 1;
-	    Cardinal size = (high * wide);
-	    int row, col;
-	    Cardinal j, k;
-	    LineData *ld;
+	    RectCells cells;
+	    int row;
 	    int b_left = 0;
 	    int b_right = 0;
 
-	    CellData *cells = newCellData(xw, size);
+	    if (saveRectCells(screen, &cells, source)) {
+		int left = target.left - 1;
+		int right;
 
-	    if (cells != NULL) {
+		TRACE(("OK - make copy %dx%d\n", cells.high, cells.wide));
+		target.bottom = target.top + (int) (cells.high - 1);
+		target.right = target.left + (int) (cells.wide - 1);
+		right = Min(target.right - 1, getMaxCol(screen));
 
-		TRACE(("OK - make copy %dx%d\n", high, wide));
-		target.bottom = target.top + (int) (high - 1);
-		target.right = target.left + (int) (wide - 1);
+		for (row = target.top - 1; row < target.bottom; ++row) {
+		    LineData *ld = getLineData(screen, row);
+		    Cardinal j = (Cardinal) (row - (target.top - 1));
+		    int drawn;
+		    int col;
 
-		for (row = source->top - 1; row < source->bottom; ++row) {
-		    ld = getLineData(screen, row);
 		    if (ld == NULL)
 			continue;
-		    j = (Cardinal) (row - (source->top - 1));
+		    drawn = Min(target.right - 1, (int) ld->lineSize - 1);
 		    TRACE2(("ROW %d\n", row + 1));
-		    for (col = source->left - 1; col < source->right; ++col) {
-			k = (Cardinal) (col - (source->left - 1));
-			saveCellData(screen, cells,
-				     (j * wide) + k,
-				     ld, source, col);
+		    if (row >= getMinRow(screen)
+			&& row <= getMaxRow(screen)
+			&& right >= left) {
+			if_OPT_WIDE_CHARS(screen, {
+			    if (left > 0 && ld->charData[left] == HIDDEN_CHAR) {
+				b_left = 1;
+				Clear1Cell(ld, left - 1);
+			    }
+			    if (right == target.right - 1
+				&& ld->charData[right] == HIDDEN_CHAR) {
+				b_right = 1;
+			    }
+			});
+			restoreRectCells(screen, &cells, j, ld, left,
+					 (Cardinal) (right + 1 - left));
 		    }
-		}
-		for (row = target.top - 1; row < target.bottom; ++row) {
-		    ld = getLineData(screen, row);
-		    if (ld == NULL)
-			continue;
-		    j = (Cardinal) (row - (target.top - 1));
-		    TRACE2(("ROW %d\n", row + 1));
-		    for (col = target.left - 1; col < target.right; ++col) {
-			k = (Cardinal) (col - (target.left - 1));
-			if (row >= getMinRow(screen)
-			    && row <= getMaxRow(screen)
-			    && col >= getMinCol(screen)
-			    && col <= getMaxCol(screen)
-			    && (j < high)
-			    && (k < wide)) {
-			    if_OPT_WIDE_CHARS(screen, {
-				if (ld->charData[col] == HIDDEN_CHAR
-				    && (col + 1) == target.left) {
-				    b_left = 1;
-				    Clear1Cell(ld, col - 1);
-				}
-				if ((col + 1) == target.right
-				    && ld->charData[col] == HIDDEN_CHAR) {
-				    b_right = 1;
-				}
-			    });
-			    restoreCellData(screen, cells,
-					    (j * wide) + k,
-					    ld, &target, col);
-			}
+		    for (col = left; col <= drawn; ++col) {
 			ld->attribs[col] |= CHARDRAWN;
 		    }
 #if OPT_BLINK_TEXT
@@ -2750,7 +3168,7 @@ ScrnCopyRectangle(XtermWidget xw, XTermRect *source, int nparam, int *params)
 		    }
 #endif
 		}
-		free(cells);
+		free(cells.charData);
 
 		ScrnUpdate(xw,
 			   (target.top - 1),
@@ -2981,6 +3399,7 @@ ScrnWipeRectangle(XtermWidget xw,
 	int row, col;
 	int b_left = 0;
 	int b_right = 0;
+	CharData blank = ' ';
 
 	for (row = top; row <= bottom; ++row) {
 	    LineData *ld;
@@ -3006,10 +3425,24 @@ ScrnWipeRectangle(XtermWidget xw,
 		}
 	    });
 
+	    /* clear each span of unprotected cells */
 	    for (col = left; col <= right; ++col) {
-		if (!IsProtected(ld, col)) {
-		    ld->attribs[col] |= CHARDRAWN;
-		    Clear1Cell(ld, col);
+		int first = col;
+		size_t count;
+
+		while (col <= right && !IsProtected(ld, col)) {
+		    ld->attribs[col++] |= CHARDRAWN;
+		}
+		if ((count = (size_t) (col - first)) != 0) {
+		    fillSpan(ld->charData + first, &blank, sizeof(blank), count);
+		    if_OPT_WIDE_CHARS(screen, {
+			size_t off;
+			for_each_combData(off, ld) {
+			    memset(ld->combData[off] + first,
+				   0,
+				   count * sizeof(CharData));
+			}
+		    });
 		}
 	    }
 	}
@@ -3026,6 +3459,115 @@ ScrnWipeRectangle(XtermWidget xw,
     }
 }
 
+/*
+ * Add the cells [left..right] of a line to the DECRQCRA checksum.  The mode
+ * is tested once per span, and plain ASCII is summed without the lookup in
+ * xtermCharSetDec().
+ */
+static void
+checksumSpan(XtermWidget xw,
+	     LineData *ld,
+	     int left,
+	     int right,
+	     int mode,
+	     int *total,
+	     int *trimmed,
+	     int *embedded,
+	     Boolean *first)
+{
+    TScreen *screen = TScreenOf(xw);
+    Boolean blanks = (mode & (csNOTRIM | csDRAWN)) != 0;
+    Boolean decoded = !(mode & csBYTE);
+    Boolean weighted = !(mode & csATTRIBS);
+    Boolean notrim = (mode & csNOTRIM) != 0;
+    int sum = *total;
+    int col;
+
+    for (col = left; col <= right; ++col) {
+	IAttr attr = ld->attribs[col];
+	int ch;
+
+	if (!(attr & CHARDRAWN)) {
+	    if (!blanks)
+		continue;
+	    ch = ' ';
+	} else if (decoded) {
+	    ch = ld->charSeen[col];
+	    if (ld->charSets[col] != nrc_ASCII || ch < 0x20 || ch >= 0x7f) {
+		ch = xtermCharSetDec(xw,
+				     ld->charSeen[col],
+				     ld->charSets[col]);
+	    }
+	} else {
+	    ch = (int) ld->charData[col];
+	    if_OPT_WIDE_CHARS(screen, {
+		if (ld->charSets[col] == nrc_DEC_Spec_Graphic) {
+		    ch = (int) dec2ucs(screen, (unsigned) ch);
+		}
+		if (is_UCS_SPECIAL(ch))
+		    continue;
+	    });
+	}
+	if (weighted) {
+#if OPT_ISO_COLORS && OPT_VT525_COLORS
+	    if (screen->terminal_id == 525) {
+		CellColor fg_bg = ld->color[col];
+		int fg = (int) extract_fg(xw, fg_bg, attr);
+		int bg = (int) extract_bg(xw, fg_bg, attr);
+		Boolean dft_bg = (bg < 0);
+		Boolean dft_fg = (fg < 0);
+
+		if (dft_bg)
+		    bg = screen->assigned_bg;
+		if (bg >= 0 && bg < 16)
+		    ch += bg;
+
+		if (dft_fg)
+		    fg = screen->assigned_fg;
+		if (fg >= 0 && fg < 16)
+		    ch += (fg << 4);
+
+		/* special case to match VT525 behavior */
+		if (dft_bg && !dft_fg && (attr & BOLD))
+		    ch -= 0x80;
+	    }
+#endif
+	    if (attr & PROTECTED)
+		ch += 0x4;
+#if OPT_WIDE_ATTRS
+	    if (attr & INVISIBLE)
+		ch += 0x8;
+#endif
+	    if (attr & UNDERLINE)
+		ch += 0x10;
+	    if (attr & INVERSE)
+		ch += 0x20;
+	    if (attr & BLINK)
+		ch += 0x40;
+	    if (attr & BOLD)
+		ch += 0x80;
+	}
+	if (*first || (ch != ' ') || (attr & DRAWX_MASK)) {
+	    *trimmed += ch + *embedded;
+	    *embedded = 0;
+	} else if (notrim) {
+	    *embedded += ch;
+	}
+	sum += ch;
+	if_OPT_WIDE_CHARS(screen, {
+	    /* FIXME - not counted if trimming blanks */
+	    if (decoded) {
+		size_t off;
+		for_each_combData(off, ld) {
+		    sum += (int) ld->combData[off][col];
+		}
+	    }
+	});
+	*first = notrim;
+    }
+    *total = sum;
+}
+
 /*
  * Compute a checksum, ignoring the page number (since we have only one page).
  */
@@ -3058,95 +3600,21 @@ xtermCheckRect(XtermWidget xw,
     if (validRect(xw, &target)) {
 	int top = target.top - 1;
 	int bottom = target.bottom - 1;
-	int row, col;
+	int row;
 	Boolean first = True;
 	int embedded = 0;
 
 	for (row = top; row <= bottom; ++row) {
 	    int left = (target.left - 1);
 	    int right = (target.right - 1);
-	    int ch;
 
 	    ld = getLineData(screen, row);
 	    if (ld == NULL)
 		continue;
-	    for (col = left; col <= right && col < (int) ld->lineSize; ++col) {
-		if (!(ld->attribs[col] & CHARDRAWN)) {
-		    if (!(mode & (csNOTRIM | csDRAWN)))
-			continue;
-		    ch = ' ';
-		} else if (!(mode & csBYTE)) {
-		    ch = xtermCharSetDec(xw,
-					 ld->charSeen[col],
-					 ld->charSets[col]);
-		} else {
-		    ch = (int) ld->charData[col];
-		    if_OPT_WIDE_CHARS(screen, {
-			if (ld->charSets[col] == nrc_DEC_Spec_Graphic) {
-			    ch = (int) dec2ucs(screen, (unsigned) ch);
-			}
-			if (is_UCS_SPECIAL(ch))
-			    continue;
-		    });
-		}
-		if (!(mode & csATTRIBS)) {
-#if OPT_ISO_COLORS && OPT_VT525_COLORS
-		    if (screen->terminal_id == 525) {
-			IAttr flags = ld->attribs[col];
-			CellColor fg_bg = ld->color[col];
-			int fg = (int) extract_fg(xw, fg_bg, flags);
-			int bg = (int) extract_bg(xw, fg_bg, flags);
-			Boolean dft_bg = (bg < 0);
-			Boolean dft_fg = (fg < 0);
-
-			if (dft_bg)
-			    bg = screen->assigned_bg;
-			if (bg >= 0 && bg < 16)
-			    ch += bg;
-
-			if (dft_fg)
-			    fg = screen->assigned_fg;
-			if (fg >= 0 && fg < 16)
-			    ch += (fg << 4);
-
-			/* special case to match VT525 behavior */
-			if (dft_bg && !dft_fg && (ld->attribs[col] & BOLD))
-			    ch -= 0x80;
-		    }
-#endif
-		    if (ld->attribs[col] & PROTECTED)
-			ch += 0x4;
-#if OPT_WIDE_ATTRS
-		    if (ld->attribs[col] & INVISIBLE)
-			ch += 0x8;
-#endif
-		    if (ld->attribs[col] & UNDERLINE)
-			ch += 0x10;
-		    if (ld->attribs[col] & INVERSE)
-			ch += 0x20;
-		    if (ld->attribs[col] & BLINK)
-			ch += 0x40;
-		    if (ld->attribs[col] & BOLD)
-			ch += 0x80;
-		}
-		if (first || (ch != ' ') || (ld->attribs[col] & DRAWX_MASK)) {
-		    trimmed += ch + embedded;
-		    embedded = 0;
-		} else if ((mode & csNOTRIM)) {
-		    embedded += ch;
-		}
-		total += ch;
-		if_OPT_WIDE_CHARS(screen, {
-		    /* FIXME - not counted if trimming blanks */
-		    if (!(mode & csBYTE)) {
-			size_t off;
-			for_each_combData(off, ld) {
-			    total += (int) ld->combData[off][col];
-			}
-		    }
-		});
-		first = ((mode & csNOTRIM) != 0) ? True : False;
-	    }
+	    if (right >= (int) ld->lineSize)
+		right = (int) ld->lineSize - 1;
+	    checksumSpan(xw, ld, left, right, mode,
+			 &total, &trimmed, &embedded, &first);
 	    if (!(mode & csNOTRIM)) {
 		embedded = 0;
 		first = False;
@@ -31,6 +31,16 @@
  */
 
 #include <xterm.h>
+#include <data.h>
+#include <xstrings.h>
+
+#if OPT_SNAPSHOT
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+static void snapLoadLine(TScreen *screen, ScrnBuf where, int row);
+#endif
 
 #define REAL_ROW(screen, row) ((row) + (screen)->saved_fifo)
 #define ROW2FIFO(screen, row) \
@@ -50,6 +60,10 @@ getScrollback(TScreen *screen, int row)
 	unsigned which = ROW2FIFO(screen, row);
 	ScrnBuf where = scrnHeadAddr(screen, screen->saveBuf_index, which);
 	result = (LineData *) where;
+#if OPT_SNAPSHOT
+	if (result->attribs == NULL)
+	    snapLoadLine(screen, where, row);
+#endif
     }
 
     TRACE(("getScrollback %d -> %d -> %p\n",
@@ -73,6 +87,13 @@ addScrollback(TScreen *screen)
 
 	TRACE(("addScrollback %lu\n", screen->saved_fifo));
 
+	/* index the lines saved so far, before the oldest is discarded */
+	if (screen->search_index)
+	    xtermSearchIndexLines(screen);
+#if OPT_DABBREV
+	xtermDabbrevLines(screen);
+#endif
+
 	/* first, see which index we'll use */
 	which = (unsigned) (screen->saved_fifo % screen->savelines);
 	where = scrnHeadAddr(screen, screen->saveBuf_index, which);
@@ -104,6 +125,7 @@ addScrollback(TScreen *screen)
 	       which, (void *) where, block));
 
 	screen->saved_fifo++;
+	screen->saved_total++;
     }
     return (LineData *) where;
 }
@@ -124,4 +146,708 @@ deleteScrollback(TScreen *screen)
 	FreeAndNull(prior->attribs);
     }
     screen->saved_fifo--;
+    screen->saved_total--;
+    screen->cell_writes++;
+    if (screen->search_index)
+	xtermSearchIndexReset();
+}
+
+#if OPT_SNAPSHOT
+/*
+ * A session snapshot is kept in three files named from the snapshotFile
+ * resource:
+ *
+ *	name		the saved lines, one record per line, appended as lines
+ *			are saved
+ *	name.idx	the offset of each record in that file
+ *	name.scr	a header (cursor, modes and counts), followed by records
+ *			for the rows of the screen, rewritten on each snapshot
+ *
+ * A record is a SnapLine, its attribute runs and its characters, stored
+ * with a variable-length encoding like UTF-8.  Trailing blank cells are not
+ * stored.  Combining characters and character sets are not saved.
+ *
+ * Restoring maps the record and index files, and reads only the screen.  The
+ * saved lines are decoded by getScrollback when they are first used, so that
+ * restoring takes the same time however many lines were saved.
+ */
+#define SNAP_MAGIC "TREXSS1"
+
+typedef struct {
+    char magic[8];
+    unsigned short sizes[4];	/* layout of the records */
+    int rows;			/* screen rows which follow the header */
+    int cur_row;
+    int cur_col;
+    unsigned flags;		/* xw->flags */
+    unsigned keyboard;		/* xw->keyboard.flags */
+    long lines;			/* saved lines which may be restored */
+    long records;		/* records in the record file */
+} SnapHeader;
+
+typedef struct {
+    unsigned short width;	/* lineSize of the line */
+    unsigned short cells;	/* cells stored, after trimming blanks */
+    unsigned short flags;	/* line flags, e.g., LINEWRAPPED */
+    unsigned short runs;	/* count of SnapRun items which follow */
+    unsigned bytes;		/* size of the encoded characters */
+} SnapLine;
+
+typedef struct {
+    unsigned short count;
+    IAttr attribs;
+#if OPT_ISO_COLORS
+    CellColor color;
+#endif
+} SnapRun;
+
+typedef long long SnapOffset;
+
+static struct {
+    /* writing */
+    FILE *data;
+    FILE *index;
+    SnapOffset size;		/* bytes written to the record file */
+    long records;		/* records written to the record file */
+    long upto;			/* saved lines (see saved_total) written */
+    unsigned long writes;	/* screen->cell_writes when last saved */
+    XtIntervalId timer;
+    Char *buffer;		/* encoding workspace */
+    size_t length;
+    /* restoring */
+    Char *map;			/* the record file when restored */
+    size_t map_size;
+    SnapOffset *offsets;	/* the index file when restored */
+    size_t offsets_size;
+    long first;			/* record of the first restored line */
+    long restored;		/* count of restored lines */
+} snap;
+
+static char *
+snapName(TScreen *screen, const char *suffix)
+{
+    static char *result;
+
+    free(result);
+    if ((result = malloc(strlen(screen->snapshot_file) + strlen(suffix) + 1))
+	!= NULL) {
+	sprintf(result, "%s%s", screen->snapshot_file, suffix);
+    }
+    return result;
+}
+
+static void
+snapSizes(unsigned short *sizes)
+{
+    sizes[0] = (unsigned short) sizeof(SnapHeader);
+    sizes[1] = (unsigned short) sizeof(SnapLine);
+    sizes[2] = (unsigned short) sizeof(SnapRun);
+    sizes[3] = (unsigned short) sizeof(CharData);
+}
+
+static Char *
+snapReserve(size_t need)
+{
+    if (need > snap.length) {
+	size_t length = need + need / 2 + 256;
+	Char *buffer = realloc(snap.buffer, length);
+
+	if (buffer == NULL)
+	    return NULL;
+	snap.buffer = buffer;
+	snap.length = length;
+    }
+    return snap.buffer;
+}
+
+static Char *
+snapPutChar(Char *target, unsigned ch)
+{
+    if (ch < 0x80) {
+	*target++ = (Char) ch;
+    } else {
+	int more = (ch < 0x800 ? 1
+		    : ch < 0x10000 ? 2
+		    : ch < 0x200000 ? 3
+		    : ch < 0x4000000 ? 4
+		    : 5);
+	int shift = 6 * more;
+
+	*target++ = (Char) (((0xff << (7 - more)) & 0xff) | (ch >> shift));
+	while (shift != 0) {
+	    shift -= 6;
+	    *target++ = (Char) (0x80 | ((ch >> shift) & 0x3f));
+	}
+    }
+    return target;
+}
+
+/*
+ * Encode a line into the workspace, returning its length.
+ */
+static size_t
+snapEncode(LineData *ld)
+{
+    SnapLine head;
+    SnapRun run;
+    unsigned cells;
+    unsigned col;
+    size_t used;
+    size_t text;
+    Char *buffer;
+
+    if (ld == NULL)
+	return 0;
+    cells = ld->lineSize;
+    while (cells != 0
+	   && ld->charData[cells - 1] == 0
+	   && ld->attribs[cells - 1] == 0) {
+	--cells;
+    }
+
+    /* room for the worst case, one run and six bytes per cell */
+    if ((buffer = snapReserve(sizeof(head)
+			      + (cells * (sizeof(run) + 6)))) == NULL)
+	return 0;
+
+    memset(&head, 0, sizeof(head));
+    head.width = (unsigned short) ld->lineSize;
+    head.cells = (unsigned short) cells;
+    head.flags = (unsigned short) GetLineFlags(ld);
+    used = sizeof(head);
+
+    memset(&run, 0, sizeof(run));
+    for (col = 0; col < cells; ++col) {
+	if (run.count != 0
+	    && run.attribs == ld->attribs[col]
+#if OPT_ISO_COLORS
+	    && isSameCColor(run.color, ld->color[col])
+#endif
+	    ) {
+	    ++run.count;
+	    continue;
+	}
+	if (run.count != 0) {
+	    memcpy(buffer + used, &run, sizeof(run));
+	    used += sizeof(run);
+	    ++head.runs;
+	}
+	run.count = 1;
+	run.attribs = ld->attribs[col];
+#if OPT_ISO_COLORS
+	run.color = ld->color[col];
+#endif
+    }
+    if (run.count != 0) {
+	memcpy(buffer + used, &run, sizeof(run));
+	used += sizeof(run);
+	++head.runs;
+    }
+
+    text = used;
+    for (col = 0; col < cells; ++col) {
+	Char *next = snapPutChar(buffer + used, (unsigned) ld->charData[col]);
+	used = (size_t) (next - buffer);
+    }
+    head.bytes = (unsigned) (used - text);
+
+    memcpy(buffer, &head, sizeof(head));
+    return used;
+}
+
+/*
+ * Decode a record into a line with at least as many cells as the record.
+ */
+static void
+snapDecode(LineData *ld, const Char *data, size_t length)
+{
+    SnapLine head;
+    const Char *text;
+    const Char *last = data + length;
+    unsigned cells;
+    unsigned col = 0;
+    unsigned n;
+
+    memcpy(&head, data, sizeof(head));
+    data += sizeof(head);
+    text = data + (head.runs * sizeof(SnapRun));
+    if (text + head.bytes > last)
+	return;
+    cells = Min(head.cells, ld->lineSize);
+
+    SetLineFlags(ld, head.flags);
+    for (n = 0; n < head.runs; ++n) {
+	SnapRun run;
+	unsigned k;
+
+	memcpy(&run, data, sizeof(run));
+	data += sizeof(run);
+	for (k = 0; k < run.count && col < cells; ++k, ++col) {
+	    ld->attribs[col] = run.attribs;
+#if OPT_ISO_COLORS
+	    ld->color[col] = run.color;
+#endif
+	}
+    }
+
+    last = text + head.bytes;
+    for (col = 0; col < cells && text < last; ++col) {
+	unsigned ch = *text++;
+
+	if (ch >= 0xc0) {
+	    int more = (ch >= 0xfc ? 5
+			: ch >= 0xf8 ? 4
+			: ch >= 0xf0 ? 3
+			: ch >= 0xe0 ? 2
+			: 1);
+	    ch &= (0x3fu >> more);
+	    while (more-- > 0 && text < last)
+		ch = (ch << 6) | (*text++ & 0x3f);
+	}
+	ld->charData[col] = (CharData) ch;
+    }
+}
+
+/*
+ * Return the record for a restored line which has not been used yet.
+ */
+static const Char *
+snapRecord(long id, size_t *length)
+{
+    long record = snap.first + id;
+    size_t count = snap.offsets_size / sizeof(SnapOffset);
+    SnapOffset start, end;
+
+    if (id < 0 || id >= snap.restored || (size_t) record >= count)
+	return NULL;
+    start = snap.offsets[record];
+    end = ((size_t) record + 1 < count)
+	? snap.offsets[record + 1]
+	: (SnapOffset) snap.map_size;
+    if (start < 0 || end > (SnapOffset) snap.map_size
+	|| end - start < (SnapOffset) sizeof(SnapLine))
+	return NULL;
+    *length = (size_t) (end - start);
+    return snap.map + start;
+}
+
+/*
+ * Fill in a restored saved line when it is first used.
+ */
+static void
+snapLoadLine(TScreen *screen, ScrnBuf where, int row)
+{
+    size_t length;
+    const Char *record = snapRecord(screen->saved_total + row, &length);
+    SnapLine head;
+    unsigned ncols = (unsigned) MaxCols(screen);
+    Char *block;
+
+    if (record != NULL) {
+	memcpy(&head, record, sizeof(head));
+	if (ncols < head.width)
+	    ncols = head.width;
+    }
+    /* a line which cannot be restored is left blank */
+    block = allocScrnData(screen, 1, ncols, False);
+    setupLineData(screen, where, block, 1, ncols, False);
+    if (record != NULL)
+	snapDecode((LineData *) where, record, length);
+}
+
+/*
+ * Replace a snapshot file with the ".tmp" file written in its place.
+ */
+static void
+snapReplace(TScreen *screen, const char *suffix)
+{
+    char *name = x_strdup(snapName(screen, suffix));
+    char *temp;
+
+    if (name != NULL && (temp = malloc(strlen(name) + 5)) != NULL) {
+	sprintf(temp, "%s.tmp", name);
+	IGNORE_RC(rename(temp, name));
+	free(temp);
+    }
+    free(name);
+}
+
+static void
+snapAppend(const Char *record, size_t length)
+{
+    SnapOffset offset = snap.size;
+
+    if (fwrite(record, sizeof(Char), length, snap.data) == length
+	&& fwrite(&offset, sizeof(offset), (size_t) 1, snap.index) == 1) {
+	snap.size += (SnapOffset) length;
+	snap.records++;
+    }
+}
+
+/*
+ * Remove a ".tmp" file, e.g., one left by a rewrite which failed.
+ */
+static void
+snapDiscard(TScreen *screen, const char *suffix)
+{
+    char *name = snapName(screen, suffix);
+    struct stat sb;
+
+    if (name != NULL
+	&& lstat(name, &sb) == 0
+	&& sb.st_uid == screen->uid)
+	IGNORE_RC(unlink(name));
+}
+
+/*
+ * Open a snapshot file.  A new file replaces any earlier one, since it is
+ * created exclusively.  The files hold the scrollback, so only the user may
+ * read them.
+ */
+static FILE *
+snapOpen(TScreen *screen, const char *suffix, Bool append)
+{
+    char *name;
+    mode_t save_umask;
+    int fd;
+
+    if (!append)
+	snapDiscard(screen, suffix);
+    if ((name = snapName(screen, suffix)) == NULL)
+	return NULL;
+    save_umask = umask(0177);
+    fd = open_userfile(screen->uid, screen->gid, name, append);
+    umask(save_umask);
+    if (fd < 0)
+	return NULL;
+    return fdopen(fd, "ab");
+}
+
+/*
+ * Flush the record and index files, returning false if either could not be
+ * written completely.
+ */
+static Boolean
+snapFlush(void)
+{
+    Boolean ok = True;
+
+    if (fflush(snap.data) != 0 || ferror(snap.data))
+	ok = False;
+    if (fflush(snap.index) != 0 || ferror(snap.index))
+	ok = False;
+    return ok;
+}
+
+static void
+snapClose(void)
+{
+    if (snap.data) {
+	fclose(snap.data);
+	snap.data = NULL;
+    }
+    if (snap.index) {
+	fclose(snap.index);
+	snap.index = NULL;
+    }
+}
+
+/*
+ * Start the record and index files again from the lines which are saved now.
+ * Lines which were restored but not used yet are copied from the old files,
+ * which stay mapped after the new ones replace them.
+ */
+static Boolean
+snapRewrite(TScreen *screen)
+{
+    long valid = Min(screen->saved_fifo, (long) screen->savelines);
+    long id;
+
+    snapClose();
+    if ((snap.data = snapOpen(screen, ".tmp", False)) == NULL)
+	return False;
+    if ((snap.index = snapOpen(screen, ".idx.tmp", False)) == NULL) {
+	snapClose();
+	snapDiscard(screen, ".tmp");
+	return False;
+    }
+
+    snap.size = 0;
+    snap.records = 0;
+    for (id = screen->saved_total - valid; id < screen->saved_total; ++id) {
+	int row = (int) (id - screen->saved_total);
+	ScrnBuf where = scrnHeadAddr(screen,
+				     screen->saveBuf_index,
+				     ROW2FIFO(screen, row));
+	const Char *record;
+	size_t length;
+
+	if (((LineData *) where)->attribs == NULL
+	    && (record = snapRecord(id, &length)) != NULL) {
+	    snapAppend(record, length);
+	} else if ((length = snapEncode(getLineData(screen, row))) != 0) {
+	    snapAppend(snap.buffer, length);
+	}
+    }
+    if (!snapFlush()) {
+	/* keep the old files rather than replace them with partial ones */
+	snapClose();
+	snapDiscard(screen, ".tmp");
+	snapDiscard(screen, ".idx.tmp");
+	return False;
+    }
+
+    snapReplace(screen, "");
+    snapReplace(screen, ".idx");
+
+    snap.upto = screen->saved_total;
+    TRACE(("snapRewrite %ld records\n", snap.records));
+    return True;
+}
+
+/*
+ * Write the screen, with the header which makes the new records valid.
+ */
+static void
+snapWriteScreen(XtermWidget xw)
+{
+    TScreen *screen = TScreenOf(xw);
+    int save_which = screen->whichBuf;
+    SnapHeader header;
+    FILE *fp;
+    Boolean ok;
+    int row;
+
+    if ((fp = snapOpen(screen, ".scr.tmp", False)) == NULL)
+	return;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAP_MAGIC, sizeof(header.magic));
+    snapSizes(header.sizes);
+    header.rows = MaxRows(screen);
+    if (save_which) {
+	/* save the normal screen, leaving the cursor below its text */
+	header.cur_row = screen->max_row;
+	header.cur_col = 0;
+    } else {
+	header.cur_row = screen->cur_row;
+	header.cur_col = screen->cur_col;
+    }
+    header.flags = xw->flags;
+    header.keyboard = xw->keyboard.flags;
+    header.lines = Min((long) screen->savedlines, snap.records);
+    header.records = snap.records;
+
+    if (fwrite(&header, sizeof(header), (size_t) 1, fp) == 1) {
+	if (save_which)
+	    SwitchBufPtrs(xw, 0);
+	for (row = 0; row < header.rows; ++row) {
+	    size_t length = snapEncode(getLineData(screen, row));
+	    if (length != 0)
+		IGNORE_RC(fwrite(snap.buffer, sizeof(Char), length, fp));
+	}
+	if (save_which)
+	    SwitchBufPtrs(xw, save_which);
+    }
+
+    ok = !ferror(fp);
+    if (fclose(fp) != 0)
+	ok = False;
+    if (ok)
+	snapReplace(screen, ".scr");
+    else
+	snapDiscard(screen, ".scr.tmp");
+}
+
+/*
+ * Append the lines saved since the last snapshot, and rewrite the screen.
+ * If lines were lost or removed from the scrollback since then, or the files
+ * hold more than twice the lines which may be saved, start them again.
+ */
+void
+xtermSaveSnapshot(XtermWidget xw)
+{
+    TScreen *screen = TScreenOf(xw);
+    long valid;
+    long oldest;
+
+    if (IsEmpty(screen->snapshot_file)
+	|| screen->saveBuf_index == NULL
+	|| (snap.writes == screen->cell_writes
+	    && snap.upto == screen->saved_total
+	    && snap.data != NULL))
+	return;
+
+    valid = Min(screen->saved_fifo, (long) screen->savelines);
+    oldest = screen->saved_total - valid;
+
+    if (snap.data == NULL
+	|| snap.index == NULL
+	|| snap.upto < oldest
+	|| snap.upto > screen->saved_total
+	|| snap.records > 2 * (long) screen->savelines + 1024) {
+	if (!snapRewrite(screen))
+	    return;
+    } else {
+	while (snap.upto < screen->saved_total) {
+	    int row = (int) (snap.upto++ - screen->saved_total);
+	    size_t length = snapEncode(getLineData(screen, row));
+	    if (length != 0)
+		snapAppend(snap.buffer, length);
+	}
+	if (!snapFlush()) {
+	    /* the header would count records which are not there */
+	    snapClose();
+	    return;
+	}
+    }
+    snapWriteScreen(xw);
+    snap.writes = screen->cell_writes;
+}
+
+static void
+snapTimer(XtPointer closure, XtIntervalId * id GCC_UNUSED)
+{
+    XtermWidget xw = (XtermWidget) closure;
+    TScreen *screen = TScreenOf(xw);
+
+    xtermSaveSnapshot(xw);
+    snap.timer = XtAppAddTimeOut(app_con,
+				 (unsigned long) screen->snapshot_interval
+				 * 1000L,
+				 snapTimer, closure);
+}
+
+/*
+ * Map a snapshot file, returning its size.
+ */
+static void *
+snapMap(TScreen *screen, const char *suffix, size_t *size)
+{
+    char *name = snapName(screen, suffix);
+    void *result = NULL;
+    struct stat sb;
+    int fd;
+
+    *size = 0;
+    if (name != NULL && (fd = open(name, O_RDONLY)) >= 0) {
+	if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+	    result = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE,
+			  fd, (off_t) 0);
+	    if (result == MAP_FAILED) {
+		result = NULL;
+	    } else {
+		*size = (size_t) sb.st_size;
+	    }
+	}
+	close(fd);
+    }
+    return result;
+}
+
+/*
+ * Restore the screen from the snapshot file if asked, and start saving
+ * snapshots.  The saved lines become a range of restored line numbers in the
+ * scrollback, whose records are decoded by getScrollback.
+ */
+void
+xtermRestoreSnapshot(XtermWidget xw)
+{
+    TScreen *screen = TScreenOf(xw);
+    unsigned short sizes[4];
+    SnapHeader header;
+    Char *screen_data;
+    size_t screen_size;
+
+    if (IsEmpty(screen->snapshot_file))
+	return;
+
+    snapSizes(sizes);
+    if (screen->snapshot_restore
+	&& (screen_data = snapMap(screen, ".scr", &screen_size)) != NULL) {
+	memcpy(&header, screen_data, Min(sizeof(header), screen_size));
+	if (screen_size >= sizeof(header)
+	    && !memcmp(header.magic, SNAP_MAGIC, sizeof(header.magic))
+	    && !memcmp(header.sizes, sizes, sizeof(sizes))) {
+	    size_t used = sizeof(header);
+	    size_t count;
+	    int row;
+
+	    snap.map = snapMap(screen, "", &snap.map_size);
+	    snap.offsets = snapMap(screen, ".idx", &snap.offsets_size);
+	    count = snap.offsets_size / sizeof(SnapOffset);
+	    if ((long) count > header.records)
+		count = (size_t) header.records;
+
+	    /* records after the last snapshot are not part of it */
+	    if (snap.map != NULL && snap.offsets != NULL && count != 0) {
+		long lines = Min(header.lines, (long) count);
+
+		if (lines > screen->savelines)
+		    lines = screen->savelines;
+		snap.first = (long) count - lines;
+		snap.restored = lines;
+		if ((size_t) count < snap.offsets_size / sizeof(SnapOffset)) {
+		    SnapOffset end = snap.offsets[count];
+		    char *name;
+
+		    if (end >= 0 && end <= (SnapOffset) snap.map_size)
+			snap.map_size = (size_t) end;
+		    snap.offsets_size = count * sizeof(SnapOffset);
+		    if ((name = snapName(screen, ".idx")) != NULL)
+			IGNORE_RC(truncate(name, (off_t) snap.offsets_size));
+		    if ((name = snapName(screen, "")) != NULL)
+			IGNORE_RC(truncate(name, (off_t) snap.map_size));
+		}
+		snap.records = (long) count;
+		snap.size = (SnapOffset) snap.map_size;
+
+		screen->saved_fifo = lines;
+		screen->saved_total = lines;
+		screen->savedlines = (int) lines;
+		snap.upto = lines;
+	    }
+
+	    for (row = 0; row < header.rows && used < screen_size; ++row) {
+		SnapLine line;
+		size_t length;
+
+		if (used + sizeof(line) > screen_size)
+		    break;
+		memcpy(&line, screen_data + used, sizeof(line));
+		length = (sizeof(line)
+			  + (line.runs * sizeof(SnapRun))
+			  + line.bytes);
+		if (row <= screen->max_row) {
+		    snapDecode(getLineData(screen, row),
+			       screen_data + used,
+			       Min(length, screen_size - used));
+		}
+		used += length;
+	    }
+
+	    UIntClr(xw->flags, (WRAPAROUND | REVERSEWRAP));
+	    UIntSet(xw->flags, (header.flags & (WRAPAROUND | REVERSEWRAP)));
+	    CursorSet(screen,
+		      Min(header.cur_row, screen->max_row),
+		      Min(header.cur_col, screen->max_col),
+		      xw->flags);
+	    ScrollBarDrawThumb(xw, 1);
+	    TRACE(("xtermRestoreSnapshot %d rows, %ld of %ld lines\n",
+		   header.rows, snap.restored, header.records));
+	}
+	munmap(screen_data, screen_size);
+    }
+
+    if (snap.restored != 0) {
+	snap.data = snapOpen(screen, "", True);
+	snap.index = snapOpen(screen, ".idx", True);
+    }
+    if (screen->snapshot_interval > 0) {
+	snap.timer = XtAppAddTimeOut(app_con,
+				     (unsigned long) screen->snapshot_interval
+				     * 1000L,
+				     snapTimer, (XtPointer) xw);
+    }
 }
+#endif /* OPT_SNAPSHOT */
@@ -0,0 +1,1272 @@
+/* $XTermId: search.c,v 1.1 2025/06/21 00:00:00 claude Exp $ */
+
+/*
+ * Copyright 2025 by Claude (Anthropic)
+ *
+ *                         All Rights Reserved
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE ABOVE LISTED COPYRIGHT HOLDER(S) BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Text search over the screen and the scrollback.
+ *
+ * Rows which are joined by wrapping are searched as one logical line, so
+ * that a match may span the wrap.  Each logical line is converted to UTF-8
+ * along with an index from byte offsets back to cells, and matched with
+ * strstr() or regexec().
+ *
+ * The interactive search (the search() action) scans a slice of rows at a
+ * time from a timer, so that a large scrollback does not stall the event
+ * loop.  The first match is shown as soon as it is found; later ones are
+ * collected for search-next() and search-prev().  Matches are recorded by
+ * line number counting from the first line ever saved (see saved_total),
+ * which does not change as output scrolls the screen.
+ *
+ * With the searchIndex resource, saved lines are also entered in a trigram
+ * index as they scroll off the screen.  Each trigram maps to the blocks of
+ * INDEX_BLOCK lines in which it occurs, kept as varint-encoded deltas.  A
+ * literal pattern looks up its trigrams and intersects their blocks, and
+ * the scan skips the saved lines outside of those blocks.
+ */
+
+#include <xterm.h>
+#include <search.h>
+#include <data.h>
+#include <error.h>
+#include <fontutils.h>
+#include <xstrings.h>
+
+#include <ctype.h>
+
+#ifdef OPT_LUA_SCRIPTING
+#include <lua_api.h>
+#endif
+
+#define SEARCH_SLICE	4096	/* rows scanned per timer callback */
+
+#define INDEX_BLOCK	16	/* lines per entry in the index */
+#define INDEX_MINIMUM	1024	/* initial size of the index's hash table */
+
+#define LineId(screen, row)	((screen)->saved_total + (row))
+#define IdRow(screen, line)	((int) ((line) - (screen)->saved_total))
+
+/*
+ * SEARCH_ICASE folds only ASCII letters.  The text is UTF-8, and tolower()
+ * could change the bytes of multibyte sequences in some C libraries.
+ */
+#define FoldCase(c) \
+	((char) ((CharOf(c) >= 'A' && CharOf(c) <= 'Z') \
+		 ? (CharOf(c) - 'A' + 'a') \
+		 : CharOf(c)))
+
+struct _SearchPattern {
+    unsigned flags;
+    char *text;			/* literal pattern, folded for SEARCH_ICASE */
+#if OPT_SELECT_REGEX
+    regex_t regex;
+#endif
+    Bool looked_up;		/* blocks[] has been taken from the index */
+    long *blocks;		/* the index blocks which may hold a match */
+    unsigned nblocks;
+    long blocks_upto;		/* lines below this were in the index */
+    unsigned generation;	/* ...and the index it came from */
+};
+
+typedef struct {
+    size_t offset;		/* of the cell's text in the line */
+    int row;
+    int col;
+    int width;
+} SearchCell;
+
+/*
+ * A logical line, rebuilt for each line which is searched.
+ */
+typedef struct {
+    char *text;
+    size_t used;
+    size_t size;
+    char *folded;
+    size_t folded_size;
+    SearchCell *cells;
+    size_t ncells;
+    size_t cells_size;
+    SearchMatch *found;		/* matches of one line, for reversing */
+    size_t nfound;
+    size_t found_size;
+} SearchLine;
+
+typedef struct {
+    long start_line;
+    int start_col;
+    long end_line;
+    int end_col;
+} SearchHit;
+
+typedef struct {
+    XtermWidget xw;
+    SearchPattern *pattern;
+    char *text;			/* the pattern, for repeating the search */
+    unsigned flags;
+    SearchHit *hits;		/* in the order they were found */
+    unsigned used;
+    unsigned size;
+    int current;		/* the hit which is shown, or -1 */
+    long next_line;		/* the next row to scan */
+    long rows_left;
+    XtIntervalId timer;
+    Bool running;
+    Bool want_next;		/* search-next() is waiting for a hit */
+    Bool hilited;
+} SearchState;
+
+typedef struct {
+    unsigned key;		/* trigram plus one, zero for an empty slot */
+    long first;			/* the first and last blocks in data[] */
+    long last;
+    Char *data;			/* differences between blocks, as varints */
+    size_t used;
+    size_t size;
+} IndexPosting;
+
+typedef struct {
+    IndexPosting *table;	/* open hash table, by trigram */
+    unsigned size;		/* a power of two */
+    unsigned count;
+    long upto;			/* lines below this are indexed */
+    long pending;		/* lines below this wrap onto the next one */
+    long compacted;		/* the oldest saved line at the last compact */
+    unsigned generation;	/* bumped when the index is discarded */
+} SearchIndex;
+
+static SearchLine search_line;
+static SearchState search_state;
+static SearchIndex search_index;
+
+static void
+growText(SearchLine *line, size_t want)
+{
+    if (line->used + want + 1 > line->size) {
+	size_t size = (line->used + want + 1) * 2;
+	char *text = TypeRealloc(char, size, line->text);
+	if (text == NULL)
+	    SysError(ERROR_SRMALLOC);
+	line->text = text;
+	line->size = size;
+    }
+}
+
+static void
+addCode(SearchLine *line, TScreen *screen, unsigned ch)
+{
+    Char utf8[8];
+    Char *last = convertCellToUTF8(screen, utf8, ch);
+
+    growText(line, (size_t) (last - utf8));
+    memcpy(line->text + line->used, utf8, (size_t) (last - utf8));
+    line->used += (size_t) (last - utf8);
+}
+
+static void
+addCell(SearchLine *line, int row, int col)
+{
+    SearchCell *cell;
+
+    if (line->ncells >= line->cells_size) {
+	size_t size = (line->cells_size + 80) * 2;
+	SearchCell *cells = TypeRealloc(SearchCell, size, line->cells);
+	if (cells == NULL)
+	    SysError(ERROR_SRMALLOC);
+	line->cells = cells;
+	line->cells_size = size;
+    }
+    cell = &line->cells[line->ncells++];
+    cell->offset = line->used;
+    cell->row = row;
+    cell->col = col;
+    cell->width = 1;
+}
+
+/*
+ * Find the column just past the last cell which has been written.
+ */
+static int
+lastDrawn(CLineData *ld, int limit)
+{
+    int col = Min(limit, (int) ld->lineSize);
+
+    while (col > 0 && !(ld->attribs[col - 1] & CHARDRAWN)) {
+	--col;
+    }
+    return col;
+}
+
+/*
+ * Find the rows of the logical line which contains the given row.
+ */
+static void
+logicalLine(TScreen *screen, int row, int *first, int *last)
+{
+    int top = -screen->savedlines;
+
+    *first = row;
+    while (*first > top && LineTstWrapped(getLineData(screen, *first - 1))) {
+	--(*first);
+    }
+    *last = row;
+    while (*last < screen->max_row && LineTstWrapped(getLineData(screen, *last))) {
+	++(*last);
+    }
+}
+
+#if OPT_WIDE_CHARS
+/*
+ * Add the combining marks stored on a cell.  Those of a wide character are
+ * stored on its right half, so they follow the character's own code.
+ */
+static void
+addMarks(SearchLine *line, TScreen *screen, CLineData *ld, int col)
+{
+    size_t off;
+
+    if (ld->attribs[col] & INVISIBLE)
+	return;
+    for_each_combData(off, ld) {
+	unsigned comb = ld->combData[off][col];
+	if (comb == 0)
+	    break;
+	addCode(line, screen, comb);
+    }
+}
+#endif
+
+/*
+ * Convert rows first..last to UTF-8, recording where each cell starts.
+ * Only the last row has its unwritten cells trimmed, since the others are
+ * continued by wrapping.
+ */
+static void
+buildLine(SearchLine *line, TScreen *screen, int first, int last)
+{
+    int row;
+
+    line->used = 0;
+    line->ncells = 0;
+    for (row = first; row <= last; ++row) {
+	CLineData *ld = getLineData(screen, row);
+	int limit;
+	int col;
+
+	if (ld == NULL)
+	    continue;
+	limit = Min((int) ld->lineSize, MaxCols(screen));
+	if (row == last)
+	    limit = lastDrawn(ld, limit);
+	for (col = 0; col < limit; ++col) {
+	    IChar ch = ld->charData[col];
+#if OPT_WIDE_CHARS
+	    if (ch == HIDDEN_CHAR) {
+		if (line->ncells != 0) {
+		    line->cells[line->ncells - 1].width++;
+		    addMarks(line, screen, ld, col);
+		}
+		continue;
+	    }
+#endif
+	    addCell(line, row, col);
+	    if (ld->attribs[col] & INVISIBLE)
+		ch = ' ';
+	    addCode(line, screen, (unsigned) ch);
+#if OPT_WIDE_CHARS
+	    addMarks(line, screen, ld, col);
+#endif
+	}
+    }
+    growText(line, (size_t) 0);
+    line->text[line->used] = '\0';
+}
+
+/*
+ * Find the cell which holds the given byte of the line.
+ */
+static const SearchCell *
+offsetCell(SearchLine *line, size_t offset)
+{
+    size_t lo = 0;
+    size_t hi = line->ncells;
+
+    while (hi - lo > 1) {
+	size_t mid = (lo + hi) / 2;
+	if (line->cells[mid].offset <= offset)
+	    lo = mid;
+	else
+	    hi = mid;
+    }
+    return &line->cells[lo];
+}
+
+static void
+addFound(SearchLine *line, size_t start, size_t end)
+{
+    const SearchCell *first = offsetCell(line, start);
+    const SearchCell *last = offsetCell(line, end - 1);
+    SearchMatch *match;
+
+    if (line->nfound >= line->found_size) {
+	size_t size = (line->found_size + 8) * 2;
+	SearchMatch *found = TypeRealloc(SearchMatch, size, line->found);
+	if (found == NULL)
+	    SysError(ERROR_SRMALLOC);
+	line->found = found;
+	line->found_size = size;
+    }
+    match = &line->found[line->nfound++];
+    match->start_row = first->row;
+    match->start_col = first->col;
+    match->end_row = last->row;
+    match->end_col = last->col + last->width;
+}
+
+/*
+ * Find the matches in the line which was built last, leaving them in found[].
+ * Matches do not overlap, and empty matches are ignored.
+ */
+static void
+matchLine(SearchLine *line, SearchPattern *pattern)
+{
+    size_t pos = 0;
+
+    line->nfound = 0;
+    if (line->ncells == 0)
+	return;
+
+#if OPT_SELECT_REGEX
+    if (pattern->flags & SEARCH_REGEX) {
+	regmatch_t match;
+
+	while (pos < line->used
+	       && regexec(&pattern->regex,
+			  line->text + pos,
+			  (size_t) 1,
+			  &match,
+			  (pos != 0) ? REG_NOTBOL : 0) == 0) {
+	    size_t start = pos + (size_t) match.rm_so;
+	    size_t end = pos + (size_t) match.rm_eo;
+
+	    if (end > start) {
+		addFound(line, start, end);
+		pos = end;
+	    } else {
+		pos = start + 1;
+	    }
+	}
+	return;
+    }
+#endif
+    {
+	const char *text = line->text;
+	size_t length = strlen(pattern->text);
+	const char *found;
+
+	if (length == 0)
+	    return;
+	if (pattern->flags & SEARCH_ICASE) {
+	    size_t n;
+
+	    if (line->used + 1 > line->folded_size) {
+		size_t size = (line->used + 1) * 2;
+		char *folded = TypeRealloc(char, size, line->folded);
+		if (folded == NULL)
+		    SysError(ERROR_SRMALLOC);
+		line->folded = folded;
+		line->folded_size = size;
+	    }
+	    for (n = 0; n <= line->used; ++n) {
+		line->folded[n] = FoldCase(line->text[n]);
+	    }
+	    text = line->folded;
+	}
+	while ((found = strstr(text + pos, pattern->text)) != NULL) {
+	    size_t start = (size_t) (found - text);
+	    addFound(line, start, start + length);
+	    pos = start + length;
+	}
+    }
+}
+
+/*
+ * Compile a pattern.  On failure, return NULL and set *errmsg (if given) to
+ * an allocated message.
+ */
+SearchPattern *
+xtermSearchCompile(const char *text, unsigned flags, char **errmsg)
+{
+    SearchPattern *result = TypeCalloc(SearchPattern);
+
+    if (errmsg != NULL)
+	*errmsg = NULL;
+    if (result == NULL || text == NULL) {
+	free(result);
+	return NULL;
+    }
+    result->flags = flags;
+    result->text = x_strdup(text);
+
+    if (flags & SEARCH_REGEX) {
+#if OPT_SELECT_REGEX
+	int status = regcomp(&result->regex,
+			     text,
+			     REG_EXTENDED
+			     | ((flags & SEARCH_ICASE) ? REG_ICASE : 0));
+	if (status != 0) {
+	    if (errmsg != NULL) {
+		char buffer[256];
+		regerror(status, &result->regex, buffer, sizeof(buffer));
+		*errmsg = x_strdup(buffer);
+	    }
+	    TRACE(("xtermSearchCompile: bad regex \"%s\"\n", text));
+	    free(result->text);
+	    free(result);
+	    result = NULL;
+	}
+#else
+	if (errmsg != NULL)
+	    *errmsg = x_strdup("regular expressions are not supported");
+	free(result->text);
+	free(result);
+	result = NULL;
+#endif
+    } else if (flags & SEARCH_ICASE) {
+	char *s;
+	for (s = result->text; *s != '\0'; ++s) {
+	    *s = FoldCase(*s);
+	}
+    }
+    return result;
+}
+
+void
+xtermSearchFree(SearchPattern *pattern)
+{
+    if (pattern != NULL) {
+#if OPT_SELECT_REGEX
+	if (pattern->flags & SEARCH_REGEX)
+	    regfree(&pattern->regex);
+#endif
+	free(pattern->text);
+	free(pattern->blocks);
+	free(pattern);
+    }
+}
+
+/*
+ * Trigram index.
+ */
+#define TrigramOf(s) \
+	(((unsigned) CharOf((s)[0]) << 16) | \
+	 ((unsigned) CharOf((s)[1]) << 8) | \
+	 (unsigned) CharOf((s)[2]))
+
+static unsigned
+indexSlot(SearchIndex *index, unsigned key)
+{
+    unsigned mask = index->size - 1;
+    unsigned slot = (key * 2654435761U) & mask;
+
+    while (index->table[slot].key != 0 && index->table[slot].key != key) {
+	slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static IndexPosting *
+indexLookup(SearchIndex *index, unsigned key)
+{
+    IndexPosting *result = NULL;
+
+    if (index->table != NULL) {
+	result = &index->table[indexSlot(index, key)];
+	if (result->key == 0)
+	    result = NULL;
+    }
+    return result;
+}
+
+static void
+indexRehash(SearchIndex *index, unsigned size)
+{
+    IndexPosting *old_table = index->table;
+    unsigned old_size = index->size;
+    unsigned n;
+
+    if ((index->table = TypeCallocN(IndexPosting, size)) == NULL)
+	SysError(ERROR_SRMALLOC);
+    index->size = size;
+    index->count = 0;
+    for (n = 0; n < old_size; ++n) {
+	if (old_table[n].key != 0) {
+	    if (old_table[n].used != 0) {
+		index->table[indexSlot(index, old_table[n].key)] = old_table[n];
+		index->count++;
+	    } else {
+		free(old_table[n].data);
+	    }
+	}
+    }
+    free(old_table);
+}
+
+static void
+postingAdd(IndexPosting *posting, long block)
+{
+    unsigned long delta;
+
+    if (posting->used != 0 && posting->last == block)
+	return;
+    if (posting->used + 10 > posting->size) {
+	size_t size = (posting->size + 8) * 2;
+	Char *data = TypeRealloc(Char, size, posting->data);
+	if (data == NULL)
+	    SysError(ERROR_SRMALLOC);
+	posting->data = data;
+	posting->size = size;
+    }
+    if (posting->used == 0) {
+	posting->first = block;
+	delta = (unsigned long) block;
+    } else {
+	delta = (unsigned long) (block - posting->last);
+    }
+    while (delta >= 0x80) {
+	posting->data[posting->used++] = (Char) (0x80 | (delta & 0x7f));
+	delta >>= 7;
+    }
+    posting->data[posting->used++] = (Char) delta;
+    posting->last = block;
+}
+
+/*
+ * Decode the blocks of a posting which are not before the given one.
+ */
+static long *
+postingBlocks(IndexPosting *posting, long oldest, unsigned *count)
+{
+    long *result = TypeMallocN(long, posting->used + 1);
+    size_t n = 0;
+    long block = 0;
+
+    *count = 0;
+    if (result == NULL)
+	SysError(ERROR_SRMALLOC);
+    while (n < posting->used) {
+	unsigned long delta = 0;
+	int shift = 0;
+
+	do {
+	    delta |= (unsigned long) (posting->data[n] & 0x7f) << shift;
+	    shift += 7;
+	} while (posting->data[n++] & 0x80);
+	block += (long) delta;
+	if (block >= oldest)
+	    result[(*count)++] = block;
+    }
+    return result;
+}
+
+/*
+ * Drop the blocks which are no longer in the scrollback.
+ */
+static void
+indexCompact(SearchIndex *index, long oldest)
+{
+    unsigned n;
+
+    TRACE(("indexCompact: %u trigrams, oldest block %ld\n",
+	   index->count, oldest));
+    for (n = 0; n < index->size; ++n) {
+	IndexPosting *posting = &index->table[n];
+
+	if (posting->key != 0 && posting->first < oldest) {
+	    unsigned count;
+	    unsigned k;
+	    long *blocks = postingBlocks(posting, oldest, &count);
+
+	    posting->used = 0;
+	    for (k = 0; k < count; ++k) {
+		postingAdd(posting, blocks[k]);
+	    }
+	    free(blocks);
+	}
+    }
+    /* trigrams with nothing left are dropped by rehashing */
+    indexRehash(index, index->size);
+}
+
+/*
+ * Enter the trigrams of the line which was built last.  Those which are all
+ * blanks are left out, since they would match most of the scrollback.
+ */
+static void
+indexLine(SearchIndex *index, SearchLine *line, long block)
+{
+    size_t n;
+
+    for (n = 0; n + 3 <= line->used; ++n) {
+	char folded[3];
+	IndexPosting *posting;
+	unsigned key;
+
+	folded[0] = FoldCase(line->text[n]);
+	folded[1] = FoldCase(line->text[n + 1]);
+	folded[2] = FoldCase(line->text[n + 2]);
+	if (folded[0] == ' ' && folded[1] == ' ' && folded[2] == ' ')
+	    continue;
+	key = TrigramOf(folded) + 1;
+
+	if (2 * (index->count + 1) > index->size) {
+	    indexRehash(index, index->size ? 2 * index->size : INDEX_MINIMUM);
+	}
+	posting = &index->table[indexSlot(index, key)];
+	if (posting->key == 0) {
+	    posting->key = key;
+	    index->count++;
+	}
+	postingAdd(posting, block);
+    }
+}
+
+/*
+ * Enter the saved lines which are not yet indexed.  A line which wraps is
+ * indexed as a whole, once its last row has been saved.
+ *
+ * This is called from addScrollback(), whose callers copy a row into the
+ * scrollback after allocating it, so only the lines before saved_total are
+ * complete.  Rows are addressed through the FIFO, since savedlines may
+ * already count the row which is being added.
+ */
+void
+xtermSearchIndexLines(TScreen *screen)
+{
+    SearchIndex *index = &search_index;
+    long valid = Min(screen->saved_fifo, (long) screen->savelines);
+    long oldest = screen->saved_total - valid;
+
+    if (index->upto < oldest) {
+	index->upto = oldest;
+	index->pending = oldest;
+    }
+    while (index->upto < screen->saved_total) {
+	int first = IdRow(screen, index->upto);
+	int last;
+
+	if (index->pending < index->upto)
+	    index->pending = index->upto;
+	while (index->pending < screen->saved_total
+	       && LineTstWrapped(getLineData(screen,
+					     IdRow(screen, index->pending)))) {
+	    index->pending++;
+	}
+	if (index->pending >= screen->saved_total)
+	    break;		/* the line continues on the screen */
+
+	last = IdRow(screen, index->pending);
+	buildLine(&search_line, screen, first, last);
+	indexLine(index, &search_line, index->upto / INDEX_BLOCK);
+	index->upto = ++(index->pending);
+    }
+
+    if (oldest - index->compacted > Max(valid / 2, 4 * INDEX_BLOCK)) {
+	indexCompact(index, oldest / INDEX_BLOCK);
+	index->compacted = oldest;
+    }
+}
+
+void
+xtermSearchIndexReset(void)
+{
+    SearchIndex *index = &search_index;
+    unsigned n;
+
+    if (index->table != NULL) {
+	TRACE(("xtermSearchIndexReset\n"));
+	for (n = 0; n < index->size; ++n) {
+	    free(index->table[n].data);
+	}
+	FreeAndNull(index->table);
+    }
+    index->size = 0;
+    index->count = 0;
+    index->upto = 0;
+    index->pending = 0;
+    index->compacted = 0;
+    index->generation++;
+}
+
+/*
+ * Find the blocks of saved lines which hold all of the pattern's trigrams.
+ * Regular expressions and patterns shorter than a trigram cannot use the
+ * index, and leave blocks[] null.
+ */
+static void
+indexCandidates(TScreen *screen, SearchPattern *pattern)
+{
+    SearchIndex *index = &search_index;
+    long oldest = (screen->saved_total - screen->savedlines) / INDEX_BLOCK;
+    size_t length = strlen(pattern->text);
+    size_t n;
+
+    if (pattern->looked_up)
+	return;
+    pattern->looked_up = True;
+    if (!screen->search_index
+	|| (pattern->flags & SEARCH_REGEX)
+	|| length < 3)
+	return;
+
+    xtermSearchIndexLines(screen);
+    pattern->generation = index->generation;
+    pattern->blocks_upto = index->upto;
+    pattern->nblocks = 0;
+
+    for (n = 0; n + 3 <= length; ++n) {
+	char folded[3];
+	IndexPosting *posting;
+	long *blocks;
+	unsigned count;
+	unsigned i, j, k;
+
+	folded[0] = FoldCase(pattern->text[n]);
+	folded[1] = FoldCase(pattern->text[n + 1]);
+	folded[2] = FoldCase(pattern->text[n + 2]);
+	if (folded[0] == ' ' && folded[1] == ' ' && folded[2] == ' ')
+	    continue;
+
+	if ((posting = indexLookup(index, TrigramOf(folded) + 1)) == NULL) {
+	    free(pattern->blocks);
+	    pattern->blocks = TypeMallocN(long, 1);
+	    pattern->nblocks = 0;
+	    break;
+	}
+	blocks = postingBlocks(posting, oldest, &count);
+	if (pattern->blocks == NULL) {
+	    pattern->blocks = blocks;
+	    pattern->nblocks = count;
+	    continue;
+	}
+	/* intersect the sorted lists */
+	for (i = j = k = 0; i < pattern->nblocks && j < count;) {
+	    if (pattern->blocks[i] < blocks[j]) {
+		++i;
+	    } else if (pattern->blocks[i] > blocks[j]) {
+		++j;
+	    } else {
+		pattern->blocks[k++] = pattern->blocks[i];
+		++i;
+		++j;
+	    }
+	}
+	pattern->nblocks = k;
+	free(blocks);
+	if (k == 0)
+	    break;
+    }
+    TRACE(("indexCandidates \"%s\": %u blocks\n",
+	   pattern->text, pattern->nblocks));
+}
+
+/*
+ * Return the row at which to continue scanning.  If the logical line which
+ * holds the row lies only in blocks of saved lines which cannot match, skip
+ * to the next block which can, or past the indexed lines.
+ *
+ * A line is indexed in the block of its first row.  The row may be in the
+ * middle of the line, e.g., at the top of a chunk of rows, so test every
+ * block which the line spans.
+ */
+static int
+indexSkip(TScreen *screen, SearchPattern *pattern, int row, Bool backward)
+{
+    int first, last;
+    long block;
+    unsigned lo = 0;
+    unsigned hi;
+    long target;
+
+    if (pattern->blocks == NULL
+	|| pattern->generation != search_index.generation
+	|| row >= 0
+	|| LineId(screen, row) >= pattern->blocks_upto) {
+	return row;
+    }
+    logicalLine(screen, row, &first, &last);
+    if (last >= 0 || LineId(screen, last) >= pattern->blocks_upto)
+	return row;
+    block = LineId(screen, first) / INDEX_BLOCK;
+
+    hi = pattern->nblocks;
+    while (lo < hi) {
+	unsigned mid = (lo + hi) / 2;
+	if (pattern->blocks[mid] < block)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (lo < pattern->nblocks
+	&& pattern->blocks[lo] <= LineId(screen, last) / INDEX_BLOCK)
+	return row;
+
+    if (backward) {
+	target = ((lo > 0)
+		  ? ((pattern->blocks[lo - 1] + 1) * INDEX_BLOCK - 1)
+		  : (LineId(screen, -screen->savedlines) - 1));
+    } else {
+	target = ((lo < pattern->nblocks)
+		  ? Min(pattern->blocks[lo] * INDEX_BLOCK, pattern->blocks_upto)
+		  : pattern->blocks_upto);
+    }
+    return IdRow(screen, target);
+}
+
+/*
+ * Report the matches which start in rows first..last, top to bottom.
+ * Returns the number of matches reported.
+ */
+int
+xtermSearchRows(TScreen *screen,
+		SearchPattern *pattern,
+		int first,
+		int last,
+		SearchCallback callback,
+		void *closure)
+{
+    int result = 0;
+    int row;
+
+    if (first < -screen->savedlines)
+	first = -screen->savedlines;
+    if (last > screen->max_row)
+	last = screen->max_row;
+
+    indexCandidates(screen, pattern);
+    for (row = first; row <= last;) {
+	int top, bottom;
+	size_t n;
+	int skip = indexSkip(screen, pattern, row, False);
+
+	if (skip != row) {
+	    row = skip;
+	    continue;
+	}
+	logicalLine(screen, row, &top, &bottom);
+	buildLine(&search_line, screen, top, bottom);
+	matchLine(&search_line, pattern);
+	for (n = 0; n < search_line.nfound; ++n) {
+	    SearchMatch *match = &search_line.found[n];
+	    if (match->start_row < first || match->start_row > last)
+		continue;
+	    ++result;
+	    if (!callback(match, closure))
+		return result;
+	}
+	row = bottom + 1;
+    }
+    return result;
+}
+
+/*
+ * Interactive search.
+ */
+static void
+showHit(SearchState *state)
+{
+    XtermWidget xw = state->xw;
+    TScreen *screen = TScreenOf(xw);
+    SearchHit *hit = &state->hits[state->current];
+    int srow = IdRow(screen, hit->start_line);
+    int erow = IdRow(screen, hit->end_line);
+    CELL first, last;
+
+    if (srow < -screen->savedlines || erow > screen->max_row) {
+	TRACE(("showHit: match %d has scrolled away\n", state->current));
+	Bell(xw, XkbBI_MinorError, 0);
+	return;
+    }
+    if (srow < screen->topline || erow > screen->topline + screen->max_row) {
+	WindowScroll(xw, srow - MaxRows(screen) / 2, True);
+    }
+    first.row = INX2ROW(screen, srow);
+    first.col = hit->start_col;
+    last.row = INX2ROW(screen, erow);
+    last.col = hit->end_col;
+    xtermHiliteRange(xw, &first, &last);
+    state->hilited = True;
+}
+
+static Bool
+addHit(const SearchMatch *match, void *closure)
+{
+    SearchState *state = (SearchState *) closure;
+    TScreen *screen = TScreenOf(state->xw);
+    SearchHit *hit;
+
+    if (state->used >= state->size) {
+	unsigned size = (state->size + 32) * 2;
+	SearchHit *hits = TypeRealloc(SearchHit, size, state->hits);
+	if (hits == NULL)
+	    return False;
+	state->hits = hits;
+	state->size = size;
+    }
+    hit = &state->hits[state->used++];
+    hit->start_line = LineId(screen, match->start_row);
+    hit->start_col = match->start_col;
+    hit->end_line = LineId(screen, match->end_row);
+    hit->end_col = match->end_col;
+
+    if (state->current < 0 || state->want_next) {
+	state->current = (int) state->used - 1;
+	state->want_next = False;
+	showHit(state);
+    }
+    return True;
+}
+
+/*
+ * Scan the next logical line, or skip the lines which the index rules out.
+ * Returns the number of rows which were passed.
+ */
+static int
+scanNext(SearchState *state, Bool *skipped)
+{
+    TScreen *screen = TScreenOf(state->xw);
+    Bool backward = (state->flags & SEARCH_BACKWARD) != 0;
+    int row = IdRow(screen, state->next_line);
+    int first, last;
+    int used;
+    int skip;
+    size_t n;
+
+    if (row < -screen->savedlines) {
+	row = backward ? screen->max_row : -screen->savedlines;
+    } else if (row > screen->max_row) {
+	row = backward ? screen->max_row : -screen->savedlines;
+    }
+    if ((skip = indexSkip(screen, state->pattern, row, backward)) != row) {
+	*skipped = True;
+	state->next_line = LineId(screen, skip);
+	return backward ? (row - skip) : (skip - row);
+    }
+    *skipped = False;
+    logicalLine(screen, row, &first, &last);
+    buildLine(&search_line, screen, first, last);
+    matchLine(&search_line, state->pattern);
+
+    if (backward) {
+	used = row - first + 1;
+	state->next_line = LineId(screen, first - 1);
+	for (n = search_line.nfound; n != 0; --n) {
+	    if (!addHit(&search_line.found[n - 1], state))
+		break;
+	}
+    } else {
+	used = last - row + 1;
+	state->next_line = LineId(screen, last + 1);
+	for (n = 0; n < search_line.nfound; ++n) {
+	    if (!addHit(&search_line.found[n], state))
+		break;
+	}
+    }
+    return used;
+}
+
+static void
+searchDone(SearchState *state)
+{
+    state->running = False;
+    TRACE(("searchDone: %u matches\n", state->used));
+    if (state->used == 0) {
+	Bell(state->xw, XkbBI_MinorError, 0);
+    } else if (state->want_next) {
+	/* search-next() was waiting at the end: wrap around */
+	state->want_next = False;
+	state->current = 0;
+	showHit(state);
+    }
+#ifdef OPT_LUA_SCRIPTING
+    if (lua_xterm_has_listeners())
+	lua_xterm_emit("search", "si", state->text, (int) state->used);
+#endif
+}
+
+static void
+searchSlice(XtPointer closure, XtIntervalId * id GCC_UNUSED)
+{
+    SearchState *state = (SearchState *) closure;
+    int budget = SEARCH_SLICE;
+
+    state->timer = 0;
+    while (state->rows_left > 0 && budget > 0) {
+	Bool skipped;
+	int used = scanNext(state, &skipped);
+	state->rows_left -= used;
+	budget -= skipped ? 1 : used;
+    }
+    if (state->rows_left > 0) {
+	state->timer = XtAppAddTimeOut(app_con, 0L, searchSlice, closure);
+    } else {
+	searchDone(state);
+    }
+}
+
+void
+xtermSearchCancel(XtermWidget xw)
+{
+    SearchState *state = &search_state;
+
+    if (state->timer) {
+	XtRemoveTimeOut(state->timer);
+	state->timer = 0;
+    }
+    if (state->hilited) {
+	UnhiliteSelection(xw);
+	state->hilited = False;
+    }
+    xtermSearchFree(state->pattern);
+    state->pattern = NULL;
+    state->used = 0;
+    state->current = -1;
+    state->running = False;
+    state->want_next = False;
+}
+
+/*
+ * Start a search from the visible part of the screen: downward from its top
+ * row, or upward from its bottom row when searching backward.  The search
+ * wraps around, so every row is scanned once.
+ */
+void
+xtermSearchStart(XtermWidget xw, const char *text, unsigned flags)
+{
+    SearchState *state = &search_state;
+    TScreen *screen = TScreenOf(xw);
+    char *errmsg = NULL;
+    int first, last;
+    int origin;
+
+    TRACE(("xtermSearchStart \"%s\" flags %#x\n", NonNull(text), flags));
+    xtermSearchCancel(xw);
+    if (text == NULL || *text == '\0') {
+	if (state->text == NULL)
+	    return;
+	text = state->text;
+	flags = state->flags;
+    } else {
+	free(state->text);
+	state->text = x_strdup(text);
+	state->flags = flags;
+    }
+
+    if ((state->pattern = xtermSearchCompile(state->text,
+					     state->flags,
+					     &errmsg)) == NULL) {
+	xtermWarning("search: %s\n", errmsg ? errmsg : "bad pattern");
+	free(errmsg);
+	Bell(xw, XkbBI_MinorError, 0);
+	return;
+    }
+
+    if (flags & SEARCH_BACKWARD) {
+	origin = ROW2INX(screen, screen->max_row);
+	logicalLine(screen, origin, &first, &last);
+	origin = last;
+    } else {
+	origin = ROW2INX(screen, 0);
+	logicalLine(screen, origin, &first, &last);
+	origin = first;
+    }
+    indexCandidates(screen, state->pattern);
+    state->xw = xw;
+    state->next_line = LineId(screen, origin);
+    state->rows_left = screen->savedlines + screen->max_row + 1;
+    state->current = -1;
+    state->running = True;
+    searchSlice((XtPointer) state, NULL);
+}
+
+/*
+ * Show the next match, in the direction of the search (or the opposite one
+ * if reverse is set).  Returns False if there is nothing to show.
+ */
+Bool
+xtermSearchNext(XtermWidget xw, Bool reverse)
+{
+    SearchState *state = &search_state;
+
+    if (state->pattern == NULL) {
+	if (state->text == NULL)
+	    return False;
+	xtermSearchStart(xw, NULL, 0);
+	return (state->pattern != NULL);
+    }
+    if (!reverse) {
+	if (state->current + 1 < (int) state->used) {
+	    state->current++;
+	} else if (state->running) {
+	    state->want_next = True;
+	    return True;
+	} else if (state->used != 0) {
+	    state->current = 0;
+	} else {
+	    return False;
+	}
+    } else {
+	if (state->current > 0) {
+	    state->current--;
+	} else if (!state->running && state->used != 0) {
+	    state->current = (int) state->used - 1;
+	} else {
+	    return False;
+	}
+    }
+    showHit(state);
+    return True;
+}
+
+/*
+ * Return the number of matches found so far, the index of the one which is
+ * shown, and whether the scan has finished.
+ */
+int
+xtermSearchStatus(int *current, Bool *done)
+{
+    SearchState *state = &search_state;
+
+    if (current != NULL)
+	*current = state->current;
+    if (done != NULL)
+	*done = (Bool) (state->pattern != NULL && !state->running);
+    return (int) state->used;
+}
+
+static unsigned
+searchFlags(String *params, Cardinal num_params)
+{
+    unsigned result = 0;
+    Cardinal n;
+
+    for (n = 1; n < num_params; ++n) {
+	if (!x_strcasecmp(params[n], "backward")) {
+	    result |= SEARCH_BACKWARD;
+	} else if (!x_strcasecmp(params[n], "icase")) {
+	    result |= SEARCH_ICASE;
+	} else if (!x_strcasecmp(params[n], "regex")) {
+	    result |= SEARCH_REGEX;
+	} else {
+	    xtermWarning("search: unknown option \"%s\"\n", params[n]);
+	}
+    }
+    return result;
+}
+
+/* ARGSUSED */
+void
+HandleSearch(Widget w,
+	     XEvent *event GCC_UNUSED,
+	     String *params,
+	     Cardinal *num_params)
+{
+    XtermWidget xw;
+
+    if ((xw = getXtermWidget(w)) != NULL) {
+	if (*num_params != 0) {
+	    xtermSearchStart(xw, params[0], searchFlags(params, *num_params));
+	} else {
+	    xtermSearchStart(xw, NULL, 0);
+	}
+    }
+}
+
+/* ARGSUSED */
+void
+HandleSearchNext(Widget w,
+		 XEvent *event GCC_UNUSED,
+		 String *params GCC_UNUSED,
+		 Cardinal *num_params GCC_UNUSED)
+{
+    XtermWidget xw;
+
+    if ((xw = getXtermWidget(w)) != NULL) {
+	if (!xtermSearchNext(xw, False))
+	    Bell(xw, XkbBI_MinorError, 0);
+    }
+}
+
+/* ARGSUSED */
+void
+HandleSearchPrev(Widget w,
+		 XEvent *event GCC_UNUSED,
+		 String *params GCC_UNUSED,
+		 Cardinal *num_params GCC_UNUSED)
+{
+    XtermWidget xw;
+
+    if ((xw = getXtermWidget(w)) != NULL) {
+	if (!xtermSearchNext(xw, True))
+	    Bell(xw, XkbBI_MinorError, 0);
+    }
+}
+
+/* ARGSUSED */
+void
+HandleSearchCancel(Widget w,
+		   XEvent *event GCC_UNUSED,
+		   String *params GCC_UNUSED,
+		   Cardinal *num_params GCC_UNUSED)
+{
+    XtermWidget xw;
+
+    if ((xw = getXtermWidget(w)) != NULL) {
+	xtermSearchCancel(xw);
+    }
+}
+
+#ifdef NO_LEAKS
+void
+noleaks_search(void)
+{
+    if (search_state.pattern != NULL) {
+	if (search_state.timer)
+	    XtRemoveTimeOut(search_state.timer);
+	xtermSearchFree(search_state.pattern);
+    }
+    free(search_state.text);
+    free(search_state.hits);
+    memset(&search_state, 0, sizeof(search_state));
+
+    free(search_line.text);
+    free(search_line.folded);
+    free(search_line.cells);
+    free(search_line.found);
+    memset(&search_line, 0, sizeof(search_line));
+
+    xtermSearchIndexReset();
+}
+#endif
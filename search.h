@@ -0,0 +1,103 @@
+/* $XTermId: search.h,v 1.1 2025/06/21 00:00:00 claude Exp $ */
+
+/*
+ * Copyright 2025 by Claude (Anthropic)
+ *
+ *                         All Rights Reserved
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE ABOVE LISTED COPYRIGHT HOLDER(S) BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef included_search_h
+#define included_search_h
+
+#include <ptyx.h>
+
+#if OPT_SELECT_REGEX
+#if defined(HAVE_PCRE2POSIX_H)
+#include <pcre2posix.h>
+
+/* pcre2 used to provide its "POSIX" entrypoints using the same names as the
+ * standard ones in the C runtime, but that never worked because the linker
+ * would use the C runtime.  Debian patched the library to fix this symbol
+ * conflict, but overlooked the header file, and Debian's patch was made
+ * obsolete when pcre2 was changed early in 2019 to provide different names.
+ *
+ * Here is a workaround to make the older version of Debian's package work.
+ */
+#if !defined(PCRE2regcomp) && defined(HAVE_PCRE2REGCOMP)
+
+#undef regcomp
+#undef regexec
+#undef regfree
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+    PCRE2POSIX_EXP_DECL int PCRE2regcomp(regex_t *, const char *, int);
+    PCRE2POSIX_EXP_DECL int PCRE2regexec(const regex_t *, const char *, size_t,
+					 regmatch_t *, int);
+    PCRE2POSIX_EXP_DECL void PCRE2regfree(regex_t *);
+#ifdef __cplusplus
+}				/* extern "C" */
+#endif
+#define regcomp(r,s,n)          PCRE2regcomp(r,s,n)
+#define regexec(r,s,n,m,x)      PCRE2regexec(r,s,n,m,x)
+#define regfree(r)              PCRE2regfree(r)
+#endif
+/* end workaround... */
+#elif defined(HAVE_PCREPOSIX_H)
+#include <pcreposix.h>
+#else /* POSIX regex.h */
+#include <sys/types.h>
+#include <regex.h>
+#endif
+#endif /* OPT_SELECT_REGEX */
+
+/*
+ * Flags for xtermSearchCompile() and xtermSearchStart().
+ */
+#define SEARCH_BACKWARD	1	/* search toward the top of the scrollback */
+#define SEARCH_ICASE	2	/* ignore (ASCII) case */
+#define SEARCH_REGEX	4	/* the pattern is an extended regular expression */
+
+/*
+ * A match spans from (start_row, start_col) up to, but not including,
+ * (end_row, end_col).  Rows use the internal numbering of getLineData(),
+ * i.e., negative rows are in the scrollback.  A match may cover several
+ * rows when the text wraps.
+ */
+typedef struct {
+    int start_row;
+    int start_col;
+    int end_row;
+    int end_col;
+} SearchMatch;
+
+typedef struct _SearchPattern SearchPattern;
+
+/* return False to stop the scan */
+typedef Bool (*SearchCallback) (const SearchMatch *, void *);
+
+extern SearchPattern *xtermSearchCompile(const char * /* pattern */, unsigned /* flags */, char ** /* errmsg */);
+extern void xtermSearchFree(SearchPattern * /* pattern */);
+extern int xtermSearchRows(TScreen * /* screen */, SearchPattern * /* pattern */, int /* first */, int /* last */, SearchCallback /* callback */, void * /* closure */);
+
+#endif /* included_search_h */
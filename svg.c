@@ -33,14 +33,6 @@
 #include <xterm.h>
 #include <version.h>
 
-#define MakeDim(color) \
-	color = (unsigned short) ((2 * (unsigned) color) / 3)
-
-#define RGBPCT(c) \
- 	((double)c.red   / 655.35), \
-	((double)c.green / 655.35), \
-	((double)c.blue  / 655.35)
-
 #define CELLW 10
 #define CELLH 20
 
@@ -53,21 +45,30 @@ static int rows = 0;
 static int cols = 0;
 static Dimension bw = 0;	/* borderWidth */
 static int ib = 0;		/* internalBorder */
+static int first_row;
+static int last_row;
+static int plain_bg;		/* color index of the default background */
 
 void
-xtermDumpSvg(XtermWidget xw)
+xtermDumpSvg(XtermWidget xw, int first, int last)
 {
     char *saveLocale;
     FILE *fp;
 
-    TRACE(("xtermDumpSvg...\n"));
+    TRACE(("xtermDumpSvg %d..%d\n", first, last));
+    xtermDumpLimits(xw, &first, &last);
+    if (first > last)
+	return;
+    first_row = first;
+    last_row = last;
     saveLocale = xtermSetLocale(LC_NUMERIC, "C");
-    fp = create_printfile(xw, ".svg");
-    if (fp != NULL) {
+    if (xtermDumpColors(xw, first, last)
+	&& (plain_bg = xtermDumpPixelColor(xw, xw->old_background)) >= 0
+	&& (fp = xtermOpenDump(xw, ".svg")) != NULL) {
 	dumpSvgHeader(xw, fp);
 	dumpSvgScreen(xw, fp);
 	dumpSvgFooter(xw, fp);
-	fclose(fp);
+	xtermCloseDump(fp);
     }
     xtermResetLocale(LC_NUMERIC, saveLocale);
     TRACE(("...xtermDumpSvg done\n"));
@@ -77,8 +78,9 @@ static void
 dumpSvgHeader(XtermWidget xw, FILE *fp)
 {
     TScreen *s = TScreenOf(xw);
+    int n;
 
-    rows = s->bot_marg - s->top_marg + 1;
+    rows = last_row - first_row + 1;
     cols = MaxCols(s);
     bw = BorderWidth(xw);
     ib = s->border;
@@ -92,6 +94,15 @@ dumpSvgHeader(XtermWidget xw, FILE *fp)
 	    (bw + ib) +
 	    rows * CELLH);
     fprintf(fp, " <desc>%s Screen Dump</desc>\n", xtermVersion());
+
+    /* each color is a class, for filling text and rectangles, or lines */
+    fputs(" <style type='text/css'>\n", fp);
+    for (n = 0; n < xtermDumpColorCount(); ++n) {
+	fprintf(fp, "  .f%d { fill: %s }\n", n, xtermDumpCSSColor(n));
+	fprintf(fp, "  .s%d { stroke: %s }\n", n, xtermDumpCSSColor(n));
+    }
+    fputs(" </style>\n", fp);
+
     fprintf(fp,
 	    " <g font-size='%.2f' font-family='monospace, monospace'>\n",
 	    0.80 * CELLH);
@@ -114,9 +125,11 @@ dumpSvgScreen(XtermWidget xw, FILE *fp)
 	    (unsigned) (rows * CELLH + 2 * ib),
 	    PixelToCSSColor(xw, xw->old_background));
 
-    for (row = s->top_marg; row <= s->bot_marg; ++row) {
-	fprintf(fp, "  <!-- Row %d -->\n", row);
+    for (row = first_row; row <= last_row; ++row) {
+	fprintf(fp, "  <!-- Row %d -->\n", INX2ROW(s, row));
 	dumpSvgLine(xw, row, fp);
+	if ((row & 63) == 0)
+	    xevents(xw);
     }
 }
 
@@ -124,77 +137,39 @@ static void
 dumpSvgLine(XtermWidget xw, int row, FILE *fp)
 {
     TScreen *s = TScreenOf(xw);
-    int inx = ROW2INX(s, row);
-    LineData *ld = getLineData(s, inx);
+    LineData *ld = getLineData(s, row);
+    int y = bw + ib + (row - first_row) * CELLH;
     int col, sal, i;		/* sal: same attribute length */
+    int blank;
+    DumpStyle style;
+    DumpStyle next;
 
     if (ld == NULL)
 	return;
 
+    memset(&next, 0, sizeof(next));
     for (col = 0; col < MaxCols(s); col += sal) {
-	XColor fgcolor, bgcolor;
+	if (col == 0)
+	    xtermDumpStyle(xw, ld, col, &next);
+	style = next;
 
-	/* Count how many consecutive cells have the same color & attributes. */
+	/* Count how many consecutive cells look the same. */
 	for (sal = 1; col + sal < MaxCols(s); ++sal) {
-#if OPT_ISO_COLORS
-	    if (!isSameCColor(ld->color[col], ld->color[col + sal]))
-		break;
-#endif
-	    if (ld->attribs[col] != ld->attribs[col + sal])
-		break;
+	    if (!xtermDumpSameCell(ld, col + sal)) {
+		xtermDumpStyle(xw, ld, col + sal, &next);
+		if (next.flags != style.flags
+		    || next.fg != style.fg
+		    || next.bg != style.bg)
+		    break;
+	    }
 	}
 
-	fgcolor.pixel = xw->old_foreground;
-	bgcolor.pixel = xw->old_background;
-#if OPT_ISO_COLORS
-	if (ld->attribs[col] & FG_COLOR) {
-	    Pixel fg = extract_fg(xw, ld->color[col], ld->attribs[col]);
-#if OPT_DIRECT_COLOR
-	    if (ld->attribs[col] & ATR_DIRECT_FG)
-		fgcolor.pixel = fg;
-	    else
-#endif
-		fgcolor.pixel = s->Acolors[fg].value;
-	}
-	if (ld->attribs[col] & BG_COLOR) {
-	    Pixel bg = extract_bg(xw, ld->color[col], ld->attribs[col]);
-#if OPT_DIRECT_COLOR
-	    if (ld->attribs[col] & ATR_DIRECT_BG)
-		bgcolor.pixel = bg;
-	    else
-#endif
-		bgcolor.pixel = s->Acolors[bg].value;
+	/* Draw the background rectangle, unless it is the default. */
+	if (style.bg != plain_bg) {
+	    fprintf(fp, "  <rect x='%d' y='%d' ", bw + ib + col * CELLW, y);
+	    fprintf(fp, "height='%d' width='%d' ", CELLH, sal * CELLW);
+	    fprintf(fp, "class='f%d'/>\n", style.bg);
 	}
-#endif
-
-	(void) QueryOneColor(xw, &fgcolor);
-	(void) QueryOneColor(xw, &bgcolor);
-	xevents(xw);
-
-	if (ld->attribs[col] & BLINK) {
-	    /* White on red. */
-	    fgcolor.red = fgcolor.green = fgcolor.blue = MAX_U_COLOR;
-	    bgcolor.red = MAX_U_COLOR;
-	    bgcolor.green = bgcolor.blue = 0u;
-	}
-#if OPT_WIDE_ATTRS
-	if (ld->attribs[col] & ATR_FAINT) {
-	    MakeDim(fgcolor.red);
-	    MakeDim(fgcolor.green);
-	    MakeDim(fgcolor.blue);
-	}
-#endif
-	if (ld->attribs[col] & INVERSE) {
-	    XColor tmp = fgcolor;
-	    fgcolor = bgcolor;
-	    bgcolor = tmp;
-	}
-
-	/* Draw the background rectangle. */
-	fprintf(fp, "  <rect x='%d' y='%d' ", bw + ib + col * CELLW, bw + ib
-		+ row * CELLH);
-	fprintf(fp, "height='%d' width='%d' ", CELLH, sal * CELLW);
-	fprintf(fp, "fill='rgb(%.2f%%, %.2f%%, %.2f%%)'/>\n", RGBPCT(bgcolor));
 
 	/* Now the <text>. */
 	/*
@@ -203,79 +178,81 @@ dumpSvgLine(XtermWidget xw, int row, FILE *fp)
 	 * attribute, while others ignore it. The only predictable way to place
 	 * (even monospaced) text properly is to do it character by character.
 	 */
+	for (blank = 1, i = 0; i < sal; ++i) {
+	    IChar chr = ld->charData[col + i];
+	    if (chr != ' ' && chr != 0) {
+		blank = 0;
+		break;
+	    }
+	}
 
-	fprintf(fp, "  <g");
-	if (ld->attribs[col] & BOLD)
-	    fprintf(fp, " font-weight='bold'");
+	if (!blank) {
+	    fprintf(fp, "  <g");
+	    if (style.flags & BOLD)
+		fprintf(fp, " font-weight='bold'");
 #if OPT_WIDE_ATTRS
-	if (ld->attribs[col] & ATR_ITALIC)
-	    fprintf(fp, " font-style='italic'");
+	    if (style.flags & ATR_ITALIC)
+		fprintf(fp, " font-style='italic'");
 #endif
-	fprintf(fp, " fill='rgb(%.2f%%, %.2f%%, %.2f%%)'>\n", RGBPCT(fgcolor));
+	    fprintf(fp, " class='f%d'>\n", style.fg);
 
-	for (i = 0; i < sal; ++i) {
-	    IChar chr = ld->charData[col + i];
+	    for (i = 0; i < sal; ++i) {
+		IChar chr = ld->charData[col + i];
 
-	    if (chr == ' ')
-		continue;
-	    fprintf(fp, "   <text x='%d' y='%d'>", bw + ib + (col + i) *
-		    CELLW, bw + ib + row * CELLH + (CELLH * 3) / 4);
+		if (chr == ' ' || chr == 0)
+		    continue;
+		fprintf(fp, "   <text x='%d' y='%d'>", bw + ib + (col + i) *
+			CELLW, y + (CELLH * 3) / 4);
 #if OPT_WIDE_CHARS
-	    if (chr > 127) {
-		/* Ignore hidden characters. */
-		if (chr != HIDDEN_CHAR) {
-		    Char temp[10];
-		    *convertToUTF8(temp, chr) = 0;
-		    fputs((char *) temp, fp);
-		}
-	    } else
+		if (chr > 127) {
+		    /* Ignore hidden characters. */
+		    if (chr != HIDDEN_CHAR) {
+			Char temp[10];
+			*convertToUTF8(temp, chr) = 0;
+			fputs((char *) temp, fp);
+		    }
+		} else
 #endif
-		switch (chr) {
-		case 0:
-		    fputc(' ', fp);
-		    break;
-		case '&':
-		    fputs("&amp;", fp);
-		    break;
-		case '<':
-		    fputs("&lt;", fp);
-		    break;
-		case '>':
-		    fputs("&gt;", fp);
-		    break;
-		default:
-		    fputc((int) chr, fp);
-		}
-	    fprintf(fp, "</text>\n");
-	    xevents(xw);
+		    switch (chr) {
+		    case '&':
+			fputs("&amp;", fp);
+			break;
+		    case '<':
+			fputs("&lt;", fp);
+			break;
+		    case '>':
+			fputs("&gt;", fp);
+			break;
+		    default:
+			fputc((int) chr, fp);
+		    }
+		fprintf(fp, "</text>\n");
+	    }
+	    fprintf(fp, "  </g>\n");
 	}
-	fprintf(fp, "  </g>\n");
-	xevents(xw);
 
 #define HLINE(x) \
   fprintf(fp, "  <line x1='%d' y1='%d' " \
                       "x2='%d' y2='%d' " \
-                  "stroke='rgb(%.2f%%, %.2f%%, %.2f%%)'/>\n", \
-    bw + ib + col * CELLW,         bw + ib + row * CELLH + CELLH - (x), \
-    bw + ib + (col + sal) * CELLW, bw + ib + row * CELLH + CELLH - (x), \
-    RGBPCT(fgcolor))
+                  "class='s%d'/>\n", \
+    bw + ib + col * CELLW,         y + CELLH - (x), \
+    bw + ib + (col + sal) * CELLW, y + CELLH - (x), \
+    style.fg)
 
 	/* Now the line attributes. */
-	if (ld->attribs[col] & UNDERLINE) {
+	if (style.flags & UNDERLINE) {
 	    HLINE(4);
 	}
 #if OPT_WIDE_ATTRS
-	if (ld->attribs[col] & ATR_STRIKEOUT) {
+	if (style.flags & ATR_STRIKEOUT) {
 	    HLINE(9);
 	}
-	if (ld->attribs[col] & ATR_DBL_UNDER) {
+	if (style.flags & ATR_DBL_UNDER) {
 	    HLINE(3);
 	    HLINE(1);
 	}
 #endif
-	xevents(xw);
     }
-    xevents(xw);
 }
 
 static void
@@ -0,0 +1,62 @@
+-- Test script for xterm.events dispatch
+
+print("Testing xterm.events...")
+
+local order = {}
+
+local low = xterm.events.on("test_event", function(tag)
+    table.insert(order, "low:" .. tag)
+end, -5)
+
+xterm.events.on("test_event", function(tag)
+    table.insert(order, "high:" .. tag)
+end, { priority = 10 })
+
+xterm.events.once("test_event", function(tag)
+    table.insert(order, "once:" .. tag)
+end)
+
+print("Listeners:", xterm.events.count("test_event"))
+
+xterm.events.emit("test_event", "a")
+xterm.events.emit("test_event", "b")
+
+local got = table.concat(order, " ")
+local want = "high:a once:a low:a high:b low:b"
+if got == want then
+    print("✓ Listeners ran by priority, once-listener ran once")
+else
+    print("✗ Unexpected order: " .. got)
+end
+
+-- A listener returning true stops the event
+xterm.events.on("stop_event", function() return true end, 1)
+xterm.events.on("stop_event", function() print("✗ Event was not stopped") end)
+if xterm.events.emit("stop_event") then
+    print("✓ Event handled and stopped")
+end
+
+xterm.events.off("test_event", low)
+print("Listeners after off(fn):", xterm.events.count("test_event"))
+xterm.events.off("test_event")
+xterm.events.off("stop_event")
+print("Listeners after off():", xterm.events.count("test_event"))
+
+xterm.events.on("title", function(text)
+    print("Title changed to: " .. text)
+end)
+io.write("\027]2;events test\007")
+
+xterm.events.on("osc", function(code, text)
+    print("OSC " .. code .. ": " .. text)
+end)
+io.write("\027]777;notify;events test\007")
+
+xterm.events.on("selection_own", function(name, text)
+    print("Owned " .. name .. " (" .. #text .. " bytes)")
+end)
+xterm.events.on("selection_lose", function(name)
+    print("Lost " .. name)
+end)
+
+print("xterm.events test completed!")
@@ -0,0 +1,71 @@
+-- Test script for the xterm.screen views
+
+print("Testing xterm.screen views...")
+
+local rows, cols = xterm.screen.size()
+print("Screen size:", rows, cols)
+print("Saved lines:", xterm.screen.saved())
+
+print("Line A: plain ASCII text")
+print("Line B: UTF-8 text: héllo wörld ✓")
+
+-- Scan the visible screen lazily, one reused line view per step
+local found_ascii, found_utf8 = false, false
+for row, line in xterm.screen.lines() do
+    local text = line:text()
+    if text:find("plain ASCII", 1, true) then
+        found_ascii = true
+    end
+    if text:find("wörld ✓", 1, true) then
+        found_utf8 = true
+    end
+end
+
+if found_ascii then
+    print("✓ Found ASCII line through xterm.screen.lines()")
+else
+    print("✗ ASCII line not found")
+end
+
+if found_utf8 then
+    print("✓ Found UTF-8 line through xterm.screen.lines()")
+else
+    print("✗ UTF-8 line not found")
+end
+
+-- Attributes of the first cell on the cursor row
+local cur_row = xterm.screen.cursor()
+local line = xterm.screen.line(cur_row)
+if line then
+    local attrs = line:attrs(0) or {}
+    for name, value in pairs(attrs) do
+        print("  attr", name, value)
+    end
+    print("✓ Cursor row has", #line, "columns")
+end
+
+-- Scrollback, if there is any
+if xterm.screen.saved() > 0 then
+    local range = xterm.screen.range(-xterm.screen.saved(), 0, -1)
+    print("✓ Scrollback range covers", #range, "rows")
+    local count = 0
+    for row, text in range:lines() do
+        count = count + 1
+    end
+    print("✓ Iterated", count, "scrollback rows")
+else
+    print("No scrollback yet")
+end
+
+-- Graphics memory counters, if xterm supports sixel/ReGIS
+local stats = xterm.screen.graphics()
+if stats then
+    print(string.format("✓ Graphics: %d bytes used, %d pooled, limit %d",
+                        stats.bytes_used, stats.bytes_pooled, stats.bytes_limit))
+    print(string.format("  %d allocations, %d reuses, %d evictions",
+                        stats.allocations, stats.reuses, stats.evictions))
+else
+    print("No graphics support")
+end
+
+print("xterm.screen test completed!")
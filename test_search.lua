@@ -0,0 +1,48 @@
+-- Test script for xterm.search
+
+print("Testing xterm.search...")
+
+print("search target: Needle in a haystack")
+print("search target: another needle")
+
+local matches = xterm.search("needle")
+print("Literal matches:", #matches)
+for _, m in ipairs(matches) do
+    print(string.format("  row %d col %d .. row %d col %d",
+                        m.row, m.col, m.end_row, m.end_col))
+end
+
+local folded = xterm.search("needle", { icase = true })
+if #folded > #matches then
+    print("✓ Case-folded search found more matches")
+else
+    print("✗ Case-folded search found " .. #folded .. " matches")
+end
+
+local latest = xterm.search("search target", { backward = true, limit = 1 })
+if #latest == 1 then
+    local text = xterm.screen.text(latest[1].row)
+    print("✓ Most recent match: " .. text)
+else
+    print("✗ Backward search with limit returned " .. #latest .. " matches")
+end
+
+local regex = xterm.search("an(other)? ", { regex = true })
+print("Regex matches:", #regex)
+
+local bad, err = xterm.search("(", { regex = true })
+if bad == nil then
+    print("✓ Bad regex reported: " .. err)
+else
+    print("✗ Bad regex was accepted")
+end
+
+xterm.events.once("search", function(pattern, count)
+    print("Interactive search for " .. pattern .. " finished: " .. count)
+end)
+xterm.search.start("needle", { backward = true, icase = true })
+print("Status:", xterm.search.status())
+xterm.search.next()
+xterm.search.cancel()
+
+print("xterm.search test completed!")
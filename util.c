@@ -1120,7 +1120,7 @@ WriteText(XtermWidget xw, Cardinal offset, Cardinal length)
 
 #ifdef OPT_LUA_SCRIPTING
     /* Call pre-character processing hook */
-    if (length > 0 && lua_xterm_is_enabled()) {
+    if (length > 0 && lua_xterm_has_hook(LUA_HOOK_CHAR_PRE)) {
         lua_xterm_call_hook(LUA_HOOK_CHAR_PRE, (int)str[0], (int)attr_flags);
     }
 #endif
@@ -1218,7 +1218,7 @@ WriteText(XtermWidget xw, Cardinal offset, Cardinal length)
 
 #ifdef OPT_LUA_SCRIPTING
     /* Call post-character processing hook */
-    if (length > 0 && lua_xterm_is_enabled()) {
+    if (length > 0 && lua_xterm_has_hook(LUA_HOOK_CHAR_POST)) {
         lua_xterm_call_hook(LUA_HOOK_CHAR_POST, (int)str[0], (int)attr_flags);
     }
 #endif
@@ -0,0 +1,151 @@
+#!/usr/bin/env perl
+# $XTermId: rectops.pl,v 1.1 2025/06/21 00:00:00 claude Exp $
+# -----------------------------------------------------------------------------
+# this file is part of xterm
+#
+# Copyright 2025 by Claude (Anthropic)
+#
+#                         All Rights Reserved
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+# OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE ABOVE LISTED COPYRIGHT HOLDER(S) BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Except as contained in this notice, the name(s) of the above copyright
+# holders shall not be used in advertising or otherwise to promote the
+# sale, use or other dealings in this Software without prior written
+# authorization.
+# -----------------------------------------------------------------------------
+# Time the rectangle operations (DECFRA, DECCRA, DECERA, DECSERA) and the
+# rectangle checksum (DECRQCRA) over the whole screen.  Each checksum waits
+# for its reply, so its timing includes the round-trip.
+#
+# The terminal should be in VT420 mode or better, with the checksum reply
+# allowed (see the allowWindowOps and checksumExtension resources).
+
+use strict;
+use warnings;
+
+use Getopt::Std;
+use IO::Handle;
+use Time::HiRes qw(time);
+
+our ( $opt_c, $opt_n, $opt_r );
+
+$Getopt::Std::STANDARD_HELP_VERSION = 1;
+&getopts('c:n:r:') || die(
+    "Usage: $0 [options]\n
+Options:\n
+  -c COLS  columns to use (default: from stty)
+  -n COUNT number of times to repeat each operation (default: 200)
+  -r ROWS  rows to use (default: from stty)
+"
+);
+
+our $CSI = "\x1b[";
+our $count = $opt_n || 200;
+our ( $rows, $cols );
+
+sub get_size() {
+    my $size = `stty size 2>/dev/null`;
+    if ( defined $size and $size =~ /^\s*(\d+)\s+(\d+)/ ) {
+        return ( $1, $2 );
+    }
+    return ( 24, 80 );
+}
+
+sub get_reply($) {
+    open TTY, "+</dev/tty" or die("Cannot open /dev/tty\n");
+    autoflush TTY 1;
+    my $old = `stty -g`;
+    system "stty raw -echo min 0 time 5";
+
+    print TTY @_;
+    my $reply = <TTY>;
+    close TTY;
+    system "stty $old";
+    if ( defined $reply ) {
+        die("^C received\n") if ( "$reply" eq "\003" );
+    }
+    return $reply;
+}
+
+sub report($$) {
+    my $name  = shift;
+    my $start = shift;
+    my $spent = time - $start;
+    printf STDERR "%-10s %6d in %8.3f s, %8.3f ms each\n", $name, $count,
+      $spent, ( 1000 * $spent ) / $count;
+}
+
+sub timed($$) {
+    my $name = shift;
+    my $code = shift;
+    my $start = time;
+    for my $n ( 1 .. $count ) {
+        print &$code($n);
+    }
+    STDOUT->flush;
+
+    # the checksum reply tells us that xterm has caught up
+    &get_reply( sprintf( "%s1;1;1;1;%d;%d*y", $CSI, $rows, $cols ) );
+    &report( $name, $start );
+}
+
+( $rows, $cols ) = &get_size;
+$rows = $opt_r if ($opt_r);
+$cols = $opt_c if ($opt_c);
+
+STDOUT->autoflush(0);
+printf "%s2J%sH", $CSI, $CSI;
+for my $row ( 1 .. $rows ) {
+    my $text = "";
+    $text .= chr( 0x21 + ( ( $row + $_ ) % 94 ) ) for ( 1 .. $cols );
+    printf "%s%dH%s", $CSI, $row, $text;
+}
+
+&timed(
+    "DECFRA",
+    sub {
+        sprintf( "%s%d;1;1;%d;%d\$x",
+            $CSI, 0x21 + ( $_[0] % 94 ),
+            $rows, $cols );
+    }
+);
+&timed(
+    "DECCRA",
+    sub {
+        my $down = ( $_[0] % 2 );
+        sprintf( "%s%d;1;%d;%d;1;%d;1;1\$v",
+            $CSI, 1 + $down, $rows - 1 + $down, $cols,
+            2 - $down );
+    }
+);
+&timed( "DECERA", sub { sprintf( "%s1;1;%d;%d\$z", $CSI, $rows, $cols ) } );
+&timed( "DECSERA", sub { sprintf( "%s1;1;%d;%d\${", $CSI, $rows, $cols ) } );
+
+printf "%s2J%sH", $CSI, $CSI;
+STDOUT->flush;
+
+my $start = time;
+for my $n ( 1 .. $count ) {
+    &get_reply( sprintf( "%s%d;1;1;1;%d;%d*y", $CSI, $n, $rows, $cols ) );
+}
+&report( "DECRQCRA", $start );
+
+1;
@@ -0,0 +1,113 @@
+#!/usr/bin/env perl
+# $XTermId: regis.pl,v 1.1 2025/06/21 00:00:00 claude Exp $
+# -----------------------------------------------------------------------------
+# this file is part of xterm
+#
+# Copyright 2025 by Claude (Anthropic)
+#
+#                         All Rights Reserved
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+# OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE ABOVE LISTED COPYRIGHT HOLDER(S) BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Except as contained in this notice, the name(s) of the above copyright
+# holders shall not be used in advertising or otherwise to promote the
+# sale, use or other dealings in this Software without prior written
+# authorization.
+# -----------------------------------------------------------------------------
+# Time the drawing of filled ReGIS shapes (rectangles and circles) and of
+# wide lines.  After each batch, a request for the cursor position shows
+# that xterm has caught up.
+#
+# The terminal should have ReGIS graphics enabled, e.g., with -ti vt340.
+
+use strict;
+use warnings;
+
+use Getopt::Std;
+use IO::Handle;
+use Time::HiRes qw(time);
+
+our ( $opt_c, $opt_n, $opt_p );
+
+$Getopt::Std::STANDARD_HELP_VERSION = 1;
+&getopts('c:n:p:') || die(
+    "Usage: $0 [options]\n
+Options:\n
+  -c STYLE  write style: V (overlay), R (replace), C (complement) (default: R)
+  -n COUNT  number of times to repeat each drawing (default: 50)
+  -p DIGIT  write pattern, 0-9 (default: 1, i.e., solid)
+"
+);
+
+our $CSI   = "\x1b[";
+our $count = $opt_n || 50;
+our $style = $opt_c || "R";
+our $pat   = defined($opt_p) ? $opt_p : 1;
+
+sub get_reply($) {
+    open TTY, "+</dev/tty" or die("Cannot open /dev/tty\n");
+    autoflush TTY 1;
+    my $old = `stty -g`;
+    system "stty raw -echo min 0 time 50";
+
+    print TTY @_;
+    my $reply = <TTY>;
+    close TTY;
+    system "stty $old";
+    if ( defined $reply ) {
+        die("^C received\n") if ( "$reply" eq "\003" );
+    }
+    return $reply;
+}
+
+sub timed($$) {
+    my $name  = shift;
+    my $code  = shift;
+    my $start = time;
+    for my $n ( 1 .. $count ) {
+        printf "\x1bP0p;W(%s)W(P%s)W(I%d)%s\x1b\\", $style, $pat, 1 + ( $n % 7 ),
+          &$code($n);
+    }
+    STDOUT->flush;
+    &get_reply( $CSI . "6n" );
+    my $spent = time - $start;
+    printf STDERR "%-10s %6d in %8.3f s, %8.3f ms each\n", $name, $count,
+      $spent, ( 1000 * $spent ) / $count;
+}
+
+printf "%s2J%sH\x1bP0p;S(E)\x1b\\", $CSI, $CSI;
+STDOUT->flush;
+
+&timed( "rectangle", sub { "P[20,20]F(V[+760][,+440][-760][,-440])" } );
+&timed( "circle",    sub { "P[400,240]F(C[+220])" } );
+&timed(
+    "lines",
+    sub {
+        my $text = "";
+        $text .= sprintf( "P[0,%d]V[799,%d]", $_, 479 - $_ )
+          for ( map { $_ * 8 } 0 .. 59 );
+        return $text;
+    }
+);
+
+printf "\x1bP0p;S(E)\x1b\\%s2J%sH", $CSI, $CSI;
+STDOUT->flush;
+
+1;
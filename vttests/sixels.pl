@@ -0,0 +1,134 @@
+#!/usr/bin/env perl
+# $XTermId: sixels.pl,v 1.1 2025/06/21 00:00:00 claude Exp $
+# -----------------------------------------------------------------------------
+# this file is part of xterm
+#
+# Copyright 2025 by Claude (Anthropic)
+#
+#                         All Rights Reserved
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+# OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE ABOVE LISTED COPYRIGHT HOLDER(S) BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+# Except as contained in this notice, the name(s) of the above copyright
+# holders shall not be used in advertising or otherwise to promote the
+# sale, use or other dealings in this Software without prior written
+# authorization.
+# -----------------------------------------------------------------------------
+# Time the decoding of sixel images.  The image is made of vertical color
+# bands, written either as repeats (the usual output of image converters for
+# flat areas) or as plain sixels (like dithered photographs).  Each image is
+# followed by a request for the cursor position, whose reply shows that xterm
+# has caught up.
+#
+# The terminal should have sixel graphics enabled, e.g., with -ti vt340.
+
+use strict;
+use warnings;
+
+use Getopt::Std;
+use IO::Handle;
+use Time::HiRes qw(time);
+
+our ( $opt_c, $opt_h, $opt_n, $opt_p, $opt_w );
+
+$Getopt::Std::STANDARD_HELP_VERSION = 1;
+&getopts('c:h:n:pw:') || die(
+    "Usage: $0 [options]\n
+Options:\n
+  -c COLORS number of color registers to use (default: 16)
+  -h HEIGHT image height in pixels (default: 480)
+  -n COUNT  number of times to repeat the image (default: 20)
+  -p        write plain sixels rather than repeats
+  -w WIDTH  image width in pixels (default: 640)
+"
+);
+
+our $CSI    = "\x1b[";
+our $colors = $opt_c || 16;
+our $height = $opt_h || 480;
+our $count  = $opt_n || 20;
+our $width  = $opt_w || 640;
+
+sub get_reply($) {
+    open TTY, "+</dev/tty" or die("Cannot open /dev/tty\n");
+    autoflush TTY 1;
+    my $old = `stty -g`;
+    system "stty raw -echo min 0 time 50";
+
+    print TTY @_;
+    my $reply = <TTY>;
+    close TTY;
+    system "stty $old";
+    if ( defined $reply ) {
+        die("^C received\n") if ( "$reply" eq "\003" );
+    }
+    return $reply;
+}
+
+sub make_image() {
+    my $band  = int( ( $width + $colors - 1 ) / $colors );
+    my $image = "\x1bP0;1;0q\"1;1;$width;$height";
+    for my $n ( 0 .. $colors - 1 ) {
+        $image .= sprintf( "#%d;2;%d;%d;%d", $n,
+            ( 100 * $n ) / $colors,
+            100 - ( 100 * $n ) / $colors,
+            ( 50 * $n ) / $colors );
+    }
+    for my $row ( 0 .. int( ( $height + 5 ) / 6 ) - 1 ) {
+        my $sixel = chr( 0x3f + ( ( $row % 2 ) ? 0x3f : 0x2a ) );
+        for my $n ( 0 .. $colors - 1 ) {
+            my $left = $n * $band;
+            my $size = $width - $left;
+            $size = $band if ( $size > $band );
+            next if ( $size <= 0 );
+            $image .= "#$n";
+            $image .= "!$left?" if ( $left > 0 );
+            if ($opt_p) {
+                $image .= $sixel x $size;
+            }
+            else {
+                $image .= "!$size$sixel";
+            }
+            $image .= "\$";
+        }
+        $image .= "-";
+    }
+    return $image . "\x1b\\";
+}
+
+my $image = &make_image;
+
+printf "%s2J%sH", $CSI, $CSI;
+STDOUT->flush;
+
+my $start = time;
+for my $n ( 1 .. $count ) {
+    printf "%sH%s", $CSI, $image;
+    STDOUT->flush;
+}
+&get_reply( $CSI . "6n" );
+my $spent = time - $start;
+
+printf STDERR "%dx%d %s, %d colors: %d in %.3f s, %.3f ms each, %.1f MB/s\n",
+  $width, $height, $opt_p ? "sixels" : "repeats", $colors, $count, $spent,
+  ( 1000 * $spent ) / $count,
+  ( length($image) * $count ) / ( $spent * 1024 * 1024 );
+
+1;
@@ -143,6 +143,174 @@ x_encode_hex(const char *source)
     return result;
 }
 
+/*
+ * Base64 encoding and decoding, used for OSC 52 and bracketed paste.  Both
+ * directions work on whole buffers, a group of 3 bytes (4 characters) at a
+ * time, and can be continued across calls: 'accu' and 'count' hold the bits
+ * (and the number of bits) left over from the previous call.
+ */
+static const char base64_code[] = "\
+ABCDEFGHIJKLMNOPQRSTUVWXYZ\
+abcdefghijklmnopqrstuvwxyz\
+0123456789+/";
+
+#define BASE64_INVALID 0xff
+
+static const Char *
+base64_values(void)
+{
+    static Char table[256];
+    static Boolean ready;
+
+    if (!ready) {
+	unsigned n;
+
+	memset(table, BASE64_INVALID, sizeof(table));
+	for (n = 0; n < 64; ++n)
+	    table[CharOf(base64_code[n])] = (Char) n;
+	ready = True;
+    }
+    return table;
+}
+
+/*
+ * Encode 'length' bytes, returning the number of characters written to
+ * 'target', which must have room for (length * 4) / 3 + 2.
+ */
+size_t
+x_encode_base64(char *target, const char *source, size_t length,
+		unsigned *accu, unsigned *count)
+{
+    const Char *s = (const Char *) source;
+    char *t = target;
+
+    while (length != 0) {
+	if (*count == 0 && length >= 3) {
+	    unsigned bits = ((unsigned) s[0] << 16)
+	    | ((unsigned) s[1] << 8)
+	    | (unsigned) s[2];
+
+	    t[0] = base64_code[(bits >> 18) & 0x3f];
+	    t[1] = base64_code[(bits >> 12) & 0x3f];
+	    t[2] = base64_code[(bits >> 6) & 0x3f];
+	    t[3] = base64_code[bits & 0x3f];
+	    t += 4;
+	    s += 3;
+	    length -= 3;
+	    continue;
+	}
+	switch (*count) {
+	case 0:
+	    *t++ = base64_code[*s >> 2];
+	    *accu = (unsigned) (*s & 0x3);
+	    *count = 2;
+	    break;
+	case 2:
+	    *t++ = base64_code[(*accu << 4) + (unsigned) (*s >> 4)];
+	    *accu = (unsigned) (*s & 0xf);
+	    *count = 4;
+	    break;
+	default:
+	    *t++ = base64_code[(*accu << 2) + (unsigned) (*s >> 6)];
+	    *t++ = base64_code[*s & 0x3f];
+	    *accu = 0;
+	    *count = 0;
+	    break;
+	}
+	++s;
+	--length;
+    }
+    return (size_t) (t - target);
+}
+
+/*
+ * Write the last character of an encoding and its padding, at most 3
+ * characters, returning the number written.
+ */
+size_t
+x_finish_base64(char *target, unsigned *accu, unsigned *count)
+{
+    size_t result = 0;
+
+    switch (*count) {
+    case 2:
+	target[result++] = base64_code[*accu << 4];
+	target[result++] = '=';
+	target[result++] = '=';
+	break;
+    case 4:
+	target[result++] = base64_code[*accu << 2];
+	target[result++] = '=';
+	break;
+    }
+    *accu = 0;
+    *count = 0;
+    return result;
+}
+
+/*
+ * Decode 'length' characters, ignoring any which are not base64 (such as
+ * padding or whitespace), returning the number of bytes written to 'target',
+ * which must have room for (length * 3) / 4 + 1.
+ */
+size_t
+x_decode_base64(char *target, const char *source, size_t length,
+		unsigned *accu, unsigned *count)
+{
+    const Char *values = base64_values();
+    const Char *s = (const Char *) source;
+    char *t = target;
+
+    while (length != 0) {
+	unsigned six;
+
+	if (*count == 0 && length >= 4) {
+	    unsigned a = values[s[0]];
+	    unsigned b = values[s[1]];
+	    unsigned c = values[s[2]];
+	    unsigned d = values[s[3]];
+
+	    if (((a | b | c | d) & 0x80) == 0) {
+		unsigned bits = (a << 18) | (b << 12) | (c << 6) | d;
+
+		t[0] = (char) (bits >> 16);
+		t[1] = (char) (bits >> 8);
+		t[2] = (char) bits;
+		t += 3;
+		s += 4;
+		length -= 4;
+		continue;
+	    }
+	}
+	six = values[*s++];
+	--length;
+	if (six == BASE64_INVALID)
+	    continue;
+	switch (*count) {
+	case 0:
+	    *accu = six;
+	    *count = 6;
+	    break;
+	case 6:
+	    *t++ = (char) ((*accu << 2) + (six >> 4));
+	    *accu = (six & 0xf);
+	    *count = 4;
+	    break;
+	case 4:
+	    *t++ = (char) ((*accu << 4) + (six >> 2));
+	    *accu = (six & 0x3);
+	    *count = 2;
+	    break;
+	default:
+	    *t++ = (char) ((*accu << 6) + six);
+	    *accu = 0;
+	    *count = 0;
+	    break;
+	}
+    }
+    return (size_t) (t - target);
+}
+
 char *
 x_getenv(const char *name)
 {
@@ -59,6 +59,9 @@ extern int x_hex2int(int /* ch */);
 extern int x_strcasecmp(const char * /* s1 */, const char * /* s2 */);
 extern int x_strncasecmp(const char * /* s1 */, const char * /* s2 */, unsigned  /* n */);
 extern int x_wildstrcmp(const char * /* pattern */, const char * /* actual */);
+extern size_t x_decode_base64(char * /* target */, const char * /* source */, size_t /* length */, unsigned * /* accu */, unsigned * /* count */);
+extern size_t x_encode_base64(char * /* target */, const char * /* source */, size_t /* length */, unsigned * /* accu */, unsigned * /* count */);
+extern size_t x_finish_base64(char * /* target */, unsigned * /* accu */, unsigned * /* count */);
 extern unsigned x_countargv(char ** /* argv */);
 extern void x_appendargv(char ** /* target */, char ** /* source */);
 extern void x_freeargs(char ** /* argv */);
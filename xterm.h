@@ -578,12 +578,16 @@ extern char **environ;
 #define XtNlimitResponse	"limitResponse"
 #define XtNlocale		"locale"
 #define XtNlocaleFilter		"localeFilter"
+#define XtNlogAsync		"logAsync"
+#define XtNlogBufferSize	"logBufferSize"
 #define XtNlogFile		"logFile"
+#define XtNlogFormat		"logFormat"
 #define XtNlogInhibit		"logInhibit"
 #define XtNlogging		"logging"
 #define XtNloginShell		"loginShell"
 #define XtNmarginBell		"marginBell"
 #define XtNmaxBufSize		"maxBufSize"
+#define XtNmaxGraphicMemory	"maxGraphicMemory"
 #define XtNmaxGraphicSize	"maxGraphicSize"
 #define XtNmaxStringParse	"maxStringParse"
 #define XtNmaximized		"maximized"
@@ -629,6 +633,7 @@ extern char **environ;
 #define XtNprintOptsImmediate	"printOptsImmediate"
 #define XtNprintOptsOnXError	"printOptsOnXError"
 #define XtNprintRawChars	"printRawChars"
+#define XtNprinterAsync		"printerAsync"
 #define XtNprinterAutoClose	"printerAutoClose"
 #define XtNprinterCommand	"printerCommand"
 #define XtNprinterControlMode	"printerControlMode"
@@ -640,6 +645,7 @@ extern char **environ;
 #define XtNptyInitialErase	"ptyInitialErase"
 #define XtNptySttySize		"ptySttySize"
 #define XtNquietGrab		"quietGrab"
+#define XtNreflowLines		"reflowLines"
 #define XtNregisDefaultFont	"regisDefaultFont"
 #define XtNregisScreenSize	"regisScreenSize"
 #define XtNrenderFont		"renderFont"
@@ -649,7 +655,9 @@ extern char **environ;
 #define XtNreportIcons		"reportIcons"
 #define XtNreportXRes		"reportXRes"
 #define XtNresizeByPixel	"resizeByPixel"
+#define XtNresizeDelay		"resizeDelay"
 #define XtNresizeGravity	"resizeGravity"
+#define XtNrestoreSnapshot	"restoreSnapshot"
 #define XtNretryInputMethod	"retryInputMethod"
 #define XtNreverseWrap		"reverseWrap"
 #define XtNrightScrollBar	"rightScrollBar"
@@ -662,6 +670,7 @@ extern char **environ;
 #define XtNscrollKey		"scrollKey"
 #define XtNscrollLines		"scrollLines"
 #define XtNscrollTtyOutput	"scrollTtyOutput"
+#define XtNsearchIndex		"searchIndex"
 #define XtNselectToClipboard	"selectToClipboard"
 #define XtNsessionMgt		"sessionMgt"
 #define XtNshiftEscape		"shiftEscape"
@@ -672,6 +681,8 @@ extern char **environ;
 #define XtNsignalInhibit	"signalInhibit"
 #define XtNsixelScrolling	"sixelScrolling"
 #define XtNsixelScrollsRight	"sixelScrollsRight"
+#define XtNsnapshotFile		"snapshotFile"
+#define XtNsnapshotInterval	"snapshotInterval"
 #define XtNsunFunctionKeys	"sunFunctionKeys"
 #define XtNsunKeyboard		"sunKeyboard"
 #define XtNtcapFunctionKeys	"tcapFunctionKeys"
@@ -848,12 +859,16 @@ extern char **environ;
 #define XtCLimitResponse	"LimitResponse"
 #define XtCLocale		"Locale"
 #define XtCLocaleFilter		"LocaleFilter"
+#define XtCLogAsync		"LogAsync"
+#define XtCLogBufferSize	"LogBufferSize"
+#define XtCLogFormat		"LogFormat"
 #define XtCLogInhibit		"LogInhibit"
 #define XtCLogfile		"Logfile"
 #define XtCLogging		"Logging"
 #define XtCLoginShell		"LoginShell"
 #define XtCMarginBell		"MarginBell"
 #define XtCMaxBufSize		"MaxBufSize"
+#define XtCMaxGraphicMemory	"MaxGraphicMemory"
 #define XtCMaxGraphicSize	"MaxGraphicSize"
 #define XtCMaxStringParse	"MaxStringParse"
 #define XtCMaximized		"Maximized"
@@ -895,6 +910,7 @@ extern char **environ;
 #define XtCPrintOptsImmediate	"PrintOptsImmediate"
 #define XtCPrintOptsOnXError	"PrintOptsOnXError"
 #define XtCPrintRawChars	"PrintRawChars"
+#define XtCPrinterAsync		"PrinterAsync"
 #define XtCPrinterAutoClose	"PrinterAutoClose"
 #define XtCPrinterCommand	"PrinterCommand"
 #define XtCPrinterControlMode	"PrinterControlMode"
@@ -906,6 +922,7 @@ extern char **environ;
 #define XtCPtyInitialErase	"PtyInitialErase"
 #define XtCPtySttySize		"PtySttySize"
 #define XtCQuietGrab		"QuietGrab"
+#define XtCReflowLines		"ReflowLines"
 #define XtCRegisDefaultFont	"RegisDefaultFont"
 #define XtCRegisScreenSize	"RegisScreenSize"
 #define XtCRenderFont		"RenderFont"
@@ -915,7 +932,9 @@ extern char **environ;
 #define XtCReportIcons		"ReportIcons"
 #define XtCReportXRes		"ReportXRes"
 #define XtCResizeByPixel	"ResizeByPixel"
+#define XtCResizeDelay		"ResizeDelay"
 #define XtCResizeGravity	"ResizeGravity"
+#define XtCRestoreSnapshot	"RestoreSnapshot"
 #define XtCRetryInputMethod	"RetryInputMethod"
 #define XtCReverseWrap		"ReverseWrap"
 #define XtCRightScrollBar	"RightScrollBar"
@@ -927,6 +946,7 @@ extern char **environ;
 #define XtCScrollBarBorder	"ScrollBarBorder"
 #define XtCScrollCond		"ScrollCond"
 #define XtCScrollLines		"ScrollLines"
+#define XtCSearchIndex		"SearchIndex"
 #define XtCSelectToClipboard	"SelectToClipboard"
 #define XtCSessionMgt		"SessionMgt"
 #define XtCShiftEscape		"ShiftEscape"
@@ -937,6 +957,8 @@ extern char **environ;
 #define XtCSignalInhibit	"SignalInhibit"
 #define XtCSixelScrolling	"SixelScrolling"
 #define XtCSixelScrollsRight	"SixelScrollsRight"
+#define XtCSnapshotFile		"SnapshotFile"
+#define XtCSnapshotInterval	"SnapshotInterval"
 #define XtCSunFunctionKeys	"SunFunctionKeys"
 #define XtCSunKeyboard		"SunKeyboard"
 #define XtCTcapFunctionKeys	"TcapFunctionKeys"
@@ -1045,6 +1067,8 @@ extern XtermMouseModes okSendMousePos(XtermWidget /* xw */);
 extern void DiredButton                PROTO_XT_ACTIONS_ARGS;
 extern void DisownSelection (XtermWidget /* xw */);
 extern void UnhiliteSelection (XtermWidget /* xw */);
+extern void xtermHiliteRange (XtermWidget /* xw */, const CELL * /* first */, const CELL * /* last */);
+extern void HandleCancelPaste          PROTO_XT_ACTIONS_ARGS;
 extern void HandleCopySelection        PROTO_XT_ACTIONS_ARGS;
 extern void HandleInsertSelection      PROTO_XT_ACTIONS_ARGS;
 extern void HandleKeyboardSelectEnd    PROTO_XT_ACTIONS_ARGS;
@@ -1064,6 +1088,10 @@ extern void TrackMouse (XtermWidget /* xw */, int /* func */, const CELL * /* st
 extern void ViButton                   PROTO_XT_ACTIONS_ARGS;
 
 extern void UnmapSelections (XtermWidget /* xw */);
+extern Bool xtermPastePending (void);
+extern int xtermPasteProgress (void);
+extern void xtermPasteContinue (XtermWidget /* xw */);
+extern void xtermPasteInterrupt (XtermWidget /* xw */);
 extern int xtermUtf8ToTextList (XtermWidget /* xw */, XTextProperty * /* text_prop */, char *** /* text_list */, int * /* text_list_count */);
 extern void xtermButtonInit (XtermWidget /* xw */);
 
@@ -1079,7 +1107,7 @@ extern void SendFocusButton(XtermWidget /* xw */, XFocusChangeEvent * /* event *
 #endif
 
 #if OPT_PASTE64
-extern void AppendToSelectionBuffer (TScreen * /* screen */, unsigned /* c */, String /* selection */);
+extern void AppendToSelectionBuffer (TScreen * /* screen */, const char * /* text */, size_t /* len */, String /* selection */);
 extern void ClearSelectionBuffer (TScreen * /* screen */, String /* selection */);
 extern void CompleteSelection (XtermWidget /* xw */, String * /* args */, Cardinal /* len */);
 extern void xtermGetSelection (Widget /* w */, Time /* ev_time */, String * /* params */, Cardinal /* num_params */, Atom * /* targets */);
@@ -1093,6 +1121,10 @@ extern void ReadLineButton             PROTO_XT_ACTIONS_ARGS;
 extern void report_char_class(XtermWidget);
 #endif
 
+#ifdef NO_LEAKS
+extern void noleaks_button (void);
+#endif
+
 #define IsAscii1(n)  (((n) >= 32 && (n) <= 126))
 
 #if OPT_WIDE_CHARS
@@ -1404,6 +1436,7 @@ extern void xtermReportTitleStack(XtermWidget /* xw */);
 
 #if OPT_DABBREV
 extern void HandleDabbrevExpand        PROTO_XT_ACTIONS_ARGS;
+extern void xtermDabbrevLines (TScreen * /* screen */);
 #endif
 
 #if OPT_DIRECT_COLOR
@@ -1513,14 +1546,29 @@ extern void xtermMediaControl (XtermWidget /* xw */, int /* param */, int /* pri
 extern void xtermPrintScreen (XtermWidget /* xw */, Bool /* use_DECPEX */, PrinterFlags * /* p */);
 extern void xtermPrintEverything (XtermWidget /* xw */, PrinterFlags * /* p */);
 extern void xtermPrintImmediately (XtermWidget /* xw */, String /* filename */, int /* opts */, int /* attributes */);
+extern void xtermPrintLines (XtermWidget /* xw */, String * /* params */, Cardinal * /* param_count */);
 extern void xtermPrintOnXError (XtermWidget /* xw */, int /* n */);
 
 #if OPT_SCREEN_DUMPS
 /* html.c */
-extern void xtermDumpHtml (XtermWidget /* xw */);
+extern Boolean xtermDumpRange (XtermWidget /* xw */, String * /* params */, Cardinal /* count */, int * /* first */, int * /* last */);
+extern Boolean xtermDumpSameCell (LineData * /* ld */, int /* col */);
+extern FILE *xtermOpenDump (XtermWidget /* xw */, const char * /* suffix */);
 extern char *PixelToCSSColor(XtermWidget /* xw */, Pixel /* p */);
+extern char *xtermDumpCSSColor (int /* color */);
+extern int xtermDumpColorCount (void);
+extern int xtermDumpPixelColor (XtermWidget /* xw */, Pixel /* p */);
+extern void xtermCloseDump (FILE * /* fp */);
+extern Boolean xtermDumpColors (XtermWidget /* xw */, int /* first */, int /* last */);
+extern void xtermDumpHtml (XtermWidget /* xw */, int /* first */, int /* last */);
+extern void xtermDumpLimits (XtermWidget /* xw */, int * /* first */, int * /* last */);
+extern void xtermDumpStyle (XtermWidget /* xw */, LineData * /* ld */, int /* col */, DumpStyle * /* style */);
 /* svg.c */
-extern void xtermDumpSvg (XtermWidget /* xw */);
+extern void xtermDumpSvg (XtermWidget /* xw */, int /* first */, int /* last */);
+
+#ifdef NO_LEAKS
+extern void noleaks_html (void);
+#endif
 #endif
 
 /* ptydata.c */
@@ -1532,6 +1580,8 @@ extern void fillPtyData (XtermWidget /* xw */, PtyData * /* data */, const char
 extern void initPtyData (PtyData ** /* data */);
 extern void trimPtyData (XtermWidget /* xw */, PtyData * /* data */);
 
+extern Char *convertCellToUTF8 (TScreen * /* screen */, Char * /* lp */, unsigned /* ch */);
+
 #ifdef NO_LEAKS
 extern void noleaks_ptydata ( void );
 #endif
@@ -1684,6 +1734,29 @@ extern void ChangeToWide(XtermWidget /* xw */);
 extern LineData *getScrollback (TScreen * /* screen */, int /* row */);
 extern LineData *addScrollback (TScreen * /* screen */);
 extern void deleteScrollback (TScreen * /* screen */);
+#if OPT_SNAPSHOT
+extern void xtermRestoreSnapshot (XtermWidget /* xw */);
+extern void xtermSaveSnapshot (XtermWidget /* xw */);
+#else
+#define xtermRestoreSnapshot(xw) /* nothing */
+#define xtermSaveSnapshot(xw) /* nothing */
+#endif
+
+/* search.c */
+extern Bool xtermSearchNext (XtermWidget /* xw */, Bool /* reverse */);
+extern int xtermSearchStatus (int * /* current */, Bool * /* done */);
+extern void HandleSearch               PROTO_XT_ACTIONS_ARGS;
+extern void HandleSearchCancel         PROTO_XT_ACTIONS_ARGS;
+extern void HandleSearchNext           PROTO_XT_ACTIONS_ARGS;
+extern void HandleSearchPrev           PROTO_XT_ACTIONS_ARGS;
+extern void xtermSearchCancel (XtermWidget /* xw */);
+extern void xtermSearchIndexLines (TScreen * /* screen */);
+extern void xtermSearchIndexReset (void);
+extern void xtermSearchStart (XtermWidget /* xw */, const char * /* pattern */, unsigned /* flags */);
+
+#ifdef NO_LEAKS
+extern void noleaks_search (void);
+#endif
 
 /* scrollbar.c */
 extern void DoResizeScreen (XtermWidget /* xw */);